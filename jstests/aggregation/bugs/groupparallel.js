@@ -0,0 +1,90 @@
+// With aggregationThreads above 1, the stages before a $group run on several threads over ranges
+// of the primary key, and their partial groups are merged.  The results must be the same as
+// when the whole pipeline runs on one thread.  A $group whose accumulators depend on input order
+// isn't run this way, since the partial groups reach the merge in no particular order.
+
+var t = db.jstests_aggregation_groupparallel;
+t.drop();
+
+var padding = new Array(256).join("x");
+for (var i = 0; i < 20000; i++) {
+    t.insert({_id: i, a: i % 7, b: i % 2, c: i, tags: ["t" + (i % 3), "t" + (i % 5)],
+              padding: padding});
+}
+assert.eq(null, db.getLastError());
+
+var pipelines = [
+    [{$group: {_id: "$a", total: {$sum: "$c"}, avg: {$avg: "$c"}, n: {$sum: 1}}}],
+    [{$match: {b: 1}},
+     {$group: {_id: {a: "$a"}, lo: {$min: "$c"}, hi: {$max: "$c"}}}],
+    [{$project: {a: 1, tags: 1}},
+     {$unwind: "$tags"},
+     {$group: {_id: "$tags", as: {$addToSet: "$a"}, n: {$sum: 1}}}],
+    [{$group: {_id: "$b", n: {$sum: 1}}},
+     {$sort: {n: -1}},
+     {$limit: 1}],
+    // no documents in any range
+    [{$match: {a: 100}}, {$group: {_id: "$a", n: {$sum: 1}}}]
+];
+var orderedPipelines = [
+    [{$group: {_id: "$a", first: {$first: "$c"}, last: {$last: "$c"}}}],
+    [{$match: {a: 3}}, {$group: {_id: "$b", cs: {$push: "$c"}, n: {$sum: 1}}}]
+];
+
+function parallelRuns() {
+    return db.serverStatus().metrics.aggregate.parallel.pipelines;
+}
+
+function normalize(result) {
+    result.forEach(function(group) {
+        if (group.as) {
+            group.as.sort();
+        }
+    });
+    return result.sort(function(x, y) {
+        var l = tojson(x._id), r = tojson(y._id);
+        return l < r ? -1 : (l > r ? 1 : 0);
+    });
+}
+
+function runAll(threads, list) {
+    assert.commandWorked(db.adminCommand({setParameter: 1, aggregationThreads: threads}));
+    return (list || pipelines).map(function(pipeline) {
+        return normalize(t.aggregate(pipeline).result);
+    });
+}
+
+var saved = db.adminCommand({getParameter: 1, aggregationThreads: 1}).aggregationThreads;
+var runsBefore = parallelRuns();
+var serial = runAll(1);
+assert.eq(runsBefore, parallelRuns());
+var parallel = runAll(4);
+// every pipeline actually took the parallel path
+assert.eq(runsBefore + pipelines.length, parallelRuns());
+
+var orderedSerial = runAll(1, orderedPipelines);
+runsBefore = parallelRuns();
+var orderedParallel = runAll(4, orderedPipelines);
+assert.eq(runsBefore, parallelRuns());
+for (var i = 0; i < orderedPipelines.length; i++) {
+    assert.eq(orderedSerial[i], orderedParallel[i], tojson(orderedPipelines[i]));
+}
+
+// The workers' partial groups spill to disk rather than piling up in memory.
+var savedSpill = db.adminCommand({getParameter: 1, aggregationSpillThreshold: 1})
+                   .aggregationSpillThreshold;
+assert.commandWorked(db.adminCommand({setParameter: 1, aggregationSpillThreshold: 1024}));
+runsBefore = parallelRuns();
+var spilled = runAll(4);
+assert.eq(runsBefore + pipelines.length, parallelRuns());
+assert.commandWorked(db.adminCommand({setParameter: 1, aggregationSpillThreshold: savedSpill}));
+assert.commandWorked(db.adminCommand({setParameter: 1, aggregationThreads: saved}));
+
+for (var i = 0; i < pipelines.length; i++) {
+    assert.eq(serial[i], parallel[i], tojson(pipelines[i]));
+    assert.eq(serial[i], spilled[i], tojson(pipelines[i]));
+}
+assert.eq(7, serial[0].length);
+assert.eq(0, serial[4].length);
+
+t.drop();
@@ -0,0 +1,86 @@
+// A $group on the fields of an index streams its groups out in index order rather than
+// building every group first, when nothing else could change the grouping.
+
+var t = db.jstests_aggregation_groupstreaming;
+t.drop();
+
+for (var i = 0; i < 1000; i++) {
+    t.insert({_id: i, a: i % 10, b: i % 3, c: i});
+}
+t.ensureIndex({a: 1, b: 1});
+
+function explainGroup(pipeline) {
+    var res = db.runCommand({aggregate: t.getName(), pipeline: pipeline, explain: true});
+    assert.commandWorked(res);
+    var stages = res.serverPipeline.filter(function(stage) { return stage.$group; });
+    assert.eq(1, stages.length, tojson(res));
+    return stages[0].$group;
+}
+
+// Checks the totals of a grouping on {a: "$a", b: "$b"}.
+function checkTotalsByAB(result) {
+    var expected = {};
+    t.find().forEach(function(doc) {
+        var key = tojson({a: doc.a, b: doc.b});
+        expected[key] = (expected[key] || 0) + doc.c;
+    });
+    assert.eq(Object.keySet(expected).length, result.length);
+    result.forEach(function(group) {
+        assert.eq(expected[tojson(group._id)], group.total, tojson(group._id));
+    });
+}
+
+// The index gives the order by itself when there's nothing to match.
+var byA = [{$group: {_id: "$a", total: {$sum: "$c"}}}];
+assert(explainGroup(byA).streaming, tojson(explainGroup(byA)));
+var result = t.aggregate(byA).result;
+assert.eq(10, result.length);
+for (var i = 0; i < result.length; i++) {
+    assert.eq(i, result[i]._id);
+    assert.eq(100 * i + 49500, result[i].total);
+}
+
+// An object key doesn't stream even over an index on its fields: a missing field is left out of
+// the _id but a null one isn't, and the index interleaves the two.
+var byAB = [{$group: {_id: {a: "$a", b: "$b"}, total: {$sum: "$c"}}}];
+assert(!explainGroup(byAB).streaming);
+checkTotalsByAB(t.aggregate(byAB).result);
+
+// Computed keys and keys without an index group the usual way.
+assert(!explainGroup([{$group: {_id: {$mod: ["$a", 2]}, n: {$sum: 1}}}]).streaming);
+assert(!explainGroup([{$group: {_id: "$b", n: {$sum: 1}}}]).streaming);
+
+// With a query, the $group streams only behind an explicit $sort on its key.
+assert(!explainGroup([{$match: {c: {$gte: 500}}}, {$group: {_id: "$a", n: {$sum: 1}}}]).streaming);
+var sorted = [{$match: {c: {$gte: 500}}}, {$sort: {a: 1}}, {$group: {_id: "$a", n: {$sum: 1}}}];
+assert(explainGroup(sorted).streaming);
+result = t.aggregate(sorted).result;
+assert.eq(10, result.length);
+result.forEach(function(group) { assert.eq(50, group.n); });
+
+// Missing and null values mixed in the index order.
+for (var i = 0; i < 6; i++) {
+    var doc = {_id: "n" + i, b: 0, c: 1};
+    if (i % 2)
+        doc.a = null;
+    t.insert(doc);
+}
+assert(explainGroup(byA).streaming);
+result = t.aggregate(byA).result;
+assert.eq(11, result.length);
+assert.eq(null, result[0]._id);
+assert.eq(6, result[0].total);
+// {b: 0} and {a: null, b: 0} are separate groups.
+var nullGroups = t.aggregate(byAB).result.filter(function(group) {
+    return group._id.a === undefined || group._id.a === null;
+});
+assert.eq(2, nullGroups.length, tojson(nullGroups));
+nullGroups.forEach(function(group) { assert.eq(3, group.total, tojson(group)); });
+t.remove({_id: /^n/});
+
+// An array is grouped as a whole, but indexed by its elements.
+t.insert({_id: 1000, a: [1, 2], b: 0, c: 0});
+assert(!explainGroup(byA).streaming);
+assert.eq(11, t.aggregate(byA).result.length);
+
+t.drop();
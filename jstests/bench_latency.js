@@ -0,0 +1,48 @@
+// benchRun reports latency percentiles for each op type, and can start ops at a fixed rate
+// (opsPerSecond) instead of as fast as it can.
+
+t = db.bench_latency;
+t.drop();
+
+t.insert( { _id : 1 , x : 1 } );
+
+ops = [
+    { op : "findOne" , ns : t.getFullName() , query : { _id : 1 } } ,
+    { op : "update" , ns : t.getFullName() , query : { _id : 1 } , update : { $inc : { x : 1 } } } ,
+    { op : "command" , ns : db.getName() , command : { ping : 1 } }
+];
+
+benchArgs = { ops : ops , parallel : 2 , seconds : 1 , host : db.getMongo().host };
+
+if (jsTest.options().auth) {
+    benchArgs['db'] = 'admin';
+    benchArgs['username'] = jsTest.options().adminUser;
+    benchArgs['password'] = jsTest.options().adminPassword;
+}
+
+function checkLatency( res , name ) {
+    var l = res[name];
+    assert( l , name + " missing: " + tojson( res ) );
+    assert.lt( 0 , l.count , name );
+    assert.lte( l.p50 , l.p90 , name );
+    assert.lte( l.p90 , l.p99 , name );
+    assert.lte( l.p99 , l.p999 , name );
+    assert.lte( l.p999 , l.maxMicros , name );
+    return l;
+}
+
+// closed loop
+res = benchRun( benchArgs );
+checkLatency( res , "findOneLatencyMicros" );
+checkLatency( res , "updateLatencyMicros" );
+checkLatency( res , "commandLatencyMicros" );
+assert.eq( undefined , res.insertLatencyMicros );
+
+// open loop, at 300 ops a second over both threads
+benchArgs['opsPerSecond'] = 300;
+res = benchRun( benchArgs );
+var n = checkLatency( res , "findOneLatencyMicros" ).count +
+        checkLatency( res , "updateLatencyMicros" ).count +
+        checkLatency( res , "commandLatencyMicros" ).count;
+assert.lte( n , 300 * 1.2 + 10 , tojson( res ) );
+assert.gte( n , 300 * 0.5 , tojson( res ) );
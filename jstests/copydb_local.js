@@ -0,0 +1,30 @@
+// copydb from this same server clones through a direct client while holding the global write
+// lock, so it must read synchronously.  Reading ahead on another thread would wait on that lock
+// forever.  Copy enough documents for several batches, with each way of naming this server.
+
+var port = db.getMongo().host.split( ":" )[1];
+var src = db.getSisterDB( db.getName() + "-local-src" );
+src.dropDatabase();
+
+var big = new Array( 1024 ).join( "x" );
+for ( var i = 0; i < 5000; i++ ) {
+    src.foo.insert( { _id : i , big : big } );
+}
+src.bar.insert( { _id : 1 } );
+src.foo.ensureIndex( { x : 1 } );
+assert.eq( null , src.getLastError() );
+
+[ undefined , "localhost:" + port , "127.0.0.1:" + port ].forEach( function( fromhost , n ) {
+    var dst = db.getSisterDB( db.getName() + "-local-dst" + n );
+    dst.dropDatabase();
+
+    var res = src.copyDatabase( src.getName() , dst.getName() , fromhost );
+    assert.commandWorked( res , tojson( fromhost ) );
+    assert.eq( 5000 , dst.foo.count() , tojson( fromhost ) );
+    assert.eq( 1 , dst.bar.count() , tojson( fromhost ) );
+    assert.eq( 2 , dst.foo.getIndexes().length , tojson( fromhost ) );
+
+    dst.dropDatabase();
+} );
+
+src.dropDatabase();
@@ -0,0 +1,63 @@
+// getLastError with j:true flushes the recovery log through the group commit, whose activity
+// is reported in serverStatus().ft.log.groupCommit.  With logFlushPeriod 0, every committed
+// write goes through it, but reads don't.
+
+t = db.jstests_group_commit;
+t.drop();
+
+function groupCommit() {
+    return db.serverStatus().ft.log.groupCommit;
+}
+
+function totalCount(histogram) {
+    var n = 0;
+    histogram.forEach(function(bucket) { n += bucket.count; });
+    return n;
+}
+
+function checkFlushes(before, after, requests) {
+    assert.lte(before.requests + requests, after.requests);
+    assert.lt(before.flushes, after.flushes);
+    // every flush covers at least one request
+    assert.lte(after.flushes - before.flushes, after.requests - before.requests);
+    assert.eq(after.flushes, totalCount(after.batchSizes));
+    assert.eq(after.flushes, totalCount(after.flushMicros));
+}
+
+function insertInParallel(getLastError) {
+    t.drop();
+    var shells = [];
+    for (var i = 0; i < 4; i++) {
+        shells.push(startParallelShell(
+            "for (var i = 0; i < 100; i++) {" +
+            "    db.jstests_group_commit.insert({i: i});" +
+            "    assert.eq(null, db.getLastErrorObj(" + tojson(getLastError) + ").err);" +
+            "}"));
+    }
+    shells.forEach(function(join) { join(); });
+    assert.eq(400, t.count());
+}
+
+var period = db.adminCommand({getParameter: 1, logFlushPeriod: 1}).logFlushPeriod;
+
+// j:true asks for the flush
+assert.commandWorked(db.adminCommand({setParameter: 1, logFlushPeriod: 100}));
+var before = groupCommit();
+insertInParallel({j: true});
+checkFlushes(before, groupCommit(), 400);
+
+// every root commit of a write flushes
+assert.commandWorked(db.adminCommand({setParameter: 1, logFlushPeriod: 0}));
+before = groupCommit();
+insertInParallel({});
+checkFlushes(before, groupCommit(), 400);
+
+// queries commit read only transactions, which have nothing to flush
+before = groupCommit();
+for (var i = 0; i < 200; i++) {
+    t.findOne({i: i % 100});
+}
+assert.gt(before.requests + 20, groupCommit().requests);
+
+assert.commandWorked(db.adminCommand({setParameter: 1, logFlushPeriod: period}));
+t.drop();
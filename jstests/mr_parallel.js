@@ -0,0 +1,97 @@
+// With mapReduceThreads above 1, the map stage of a big enough scan runs on several threads and
+// their output is merged by key.  The results must be the same as with one thread.
+
+var t = db.mr_parallel;
+t.drop();
+
+var padding = new Array(256).join("x");
+for (var i = 0; i < 20000; i++) {
+    t.insert({_id: i, a: i % 7, b: i % 2, padding: padding});
+}
+assert.eq(null, db.getLastError());
+
+function mapA() {
+    emit(this.a, {n: 1, total: this._id});
+}
+
+// one key per document, which makes the workers spill
+function mapId() {
+    emit(this._id, {n: 1, total: this.b});
+}
+
+function reduce(key, values) {
+    var res = {n: 0, total: 0};
+    values.forEach(function(v) {
+        res.n += v.n;
+        res.total += v.total;
+    });
+    return res;
+}
+
+function finalize(key, value) {
+    value.avg = value.total / value.n;
+    return value;
+}
+
+var outName = "mr_parallel_out";
+
+var tests = [
+    {map: mapA, opts: {out: {inline: 1}}},
+    {map: mapA, opts: {out: {inline: 1}, query: {b: 1}, finalize: finalize}},
+    {map: mapA, opts: {out: outName, finalize: finalize}},
+    {map: mapId, opts: {out: outName}},
+    {map: mapId, opts: {out: outName, query: {a: 3}}},
+    // no documents in any range
+    {map: mapA, opts: {out: {inline: 1}, query: {a: 100}}}
+];
+
+function results(res) {
+    var docs = res.results ? res.results : db[outName].find().toArray();
+    return docs.sort(function(x, y) { return x._id - y._id; });
+}
+
+function runAll(threads) {
+    assert.commandWorked(db.adminCommand({setParameter: 1, mapReduceThreads: threads}));
+    return tests.map(function(test) {
+        db[outName].drop();
+        var res = t.mapReduce(test.map, reduce, test.opts);
+        assert(res.ok, tojson(res));
+        return {counts: res.counts, docs: results(res)};
+    });
+}
+
+var saved = db.adminCommand({getParameter: 1, mapReduceThreads: 1}).mapReduceThreads;
+var serial = runAll(1);
+var parallel = runAll(3);
+
+// the output to an existing collection is reduced into it
+db[outName].drop();
+t.mapReduce(mapA, reduce, {out: outName});
+var reduced = t.mapReduce(mapA, reduce, {out: {reduce: outName}});
+assert(reduced.ok, tojson(reduced));
+results(reduced).forEach(function(doc) {
+    assert.eq(2 * t.count({a: doc._id}), doc.value.n, tojson(doc));
+});
+
+// verbose output shows how the work was split
+var verbose = db.runCommand({mapReduce: t.getName(), map: mapId, reduce: reduce,
+                             out: {inline: 1}, query: {a: 1}, verbose: true});
+assert.commandWorked(verbose);
+assert.eq(3, verbose.timing.threads, tojson(verbose.timing));
+assert.lt(1, verbose.timing.ranges, tojson(verbose.timing));
+assert(verbose.timing.mergeTime !== undefined, tojson(verbose.timing));
+
+assert.commandWorked(db.adminCommand({setParameter: 1, mapReduceThreads: saved}));
+
+for (var i = 0; i < tests.length; i++) {
+    assert.eq(serial[i].counts.input, parallel[i].counts.input, tojson(tests[i].opts));
+    assert.eq(serial[i].counts.emit, parallel[i].counts.emit, tojson(tests[i].opts));
+    assert.eq(serial[i].counts.output, parallel[i].counts.output, tojson(tests[i].opts));
+    assert.eq(serial[i].docs, parallel[i].docs, tojson(tests[i].opts));
+}
+assert.eq(7, serial[0].docs.length);
+assert.eq(20000, serial[3].docs.length);
+assert.eq(0, serial[5].docs.length);
+
+db[outName].drop();
+t.drop();
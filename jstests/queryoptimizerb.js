@@ -0,0 +1,42 @@
+// Writes alone don't clear the query plan cache, but a cached plan is evicted once it keeps
+// scanning many more documents per match than when it was cached.
+
+t = db.jstests_queryoptimizerb;
+t.drop();
+
+function evictions() {
+    return db.serverStatus().metrics.queryOptimizer.cachedPlansEvicted;
+}
+
+function hasCachedPlan() {
+    return !!t.find( { a:1, b:1 } ).explain( true ).oldPlan;
+}
+
+t.ensureIndex( { a:1 } );
+t.ensureIndex( { b:1 } );
+// Index b leads with documents that don't match, so the a:1 plan wins.
+for( i = 0; i < 1000; ++i ) {
+    t.save( { a:2, b:1 } );
+}
+for( i = 0; i < 150; ++i ) {
+    t.save( { a:1, b:1 } );
+}
+
+t.find( { a:1, b:1 } ).itcount();
+assert( hasCachedPlan() );
+
+// Many more writes than used to flush the cache leave the plan in place.
+for( i = 0; i < 300; ++i ) {
+    t.save( { a:3, b:3 } );
+}
+assert( hasCachedPlan() );
+
+// Now the a:1 plan scans the same documents but finds no matches.
+var before = evictions();
+t.update( { a:1 }, { $set:{ b:2 } }, false, true );
+for( i = 0; i < 5 && evictions() == before; ++i ) {
+    t.find( { a:1, b:1 } ).itcount();
+}
+assert.lt( before, evictions() );
+
+t.drop();
@@ -0,0 +1,36 @@
+// Queries with $appliedSnapshot report the replicated state their snapshot reflects.
+
+var replTest = new ReplSetTest({name: "applied_snapshot", nodes: 2});
+replTest.startSet();
+replTest.initiate();
+
+var master = replTest.getMaster();
+var mdb = master.getDB("test");
+for (var i = 0; i < 100; i++) {
+    mdb.foo.insert({_id: i, a: i});
+}
+assert.eq(null, mdb.getLastErrorObj(2).err);
+
+var secondary = replTest.liveNodes.slaves[0];
+secondary.setSlaveOk();
+var sdb = secondary.getDB("test");
+
+var explain = sdb.foo.find({a: {$gte: 50}})._addSpecial("$appliedSnapshot", true).explain();
+assert.eq(50, explain.n);
+var gtid = explain.appliedSnapshot.minUnappliedGTID;
+assert(gtid, tojson(explain));
+
+// Nothing is being applied, so every oplog entry is before the snapshot's GTID.
+var oplog = secondary.getDB("local").oplog.rs;
+assert.eq(0, oplog.find({_id: {$gte: gtid}}).itcount());
+assert.lt(0, oplog.find({_id: {$lt: gtid}}).itcount());
+
+assert.eq(100, sdb.foo.find()._addSpecial("$appliedSnapshot", true).itcount());
+
+// Tailable cursors read uncommitted data, so they can't be pinned to a snapshot.
+assert.throws(function() {
+    secondary.getDB("local").oplog.rs.find().addOption(DBQuery.Option.tailable)
+        ._addSpecial("$appliedSnapshot", true).itcount();
+});
+
+replTest.stopSet();
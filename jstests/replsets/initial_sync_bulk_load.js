@@ -0,0 +1,58 @@
+// Initial sync bulk loads ordinary collections together with their secondary indexes, and
+// still clones capped and partitioned collections the usual way.
+
+var replTest = new ReplSetTest({name: "initial_sync_bulk_load", nodes: 2});
+var conns = replTest.startSet();
+var config = replTest.getReplSetConfig();
+config.members[1].priority = 0;
+replTest.initiate(config);
+
+var master = replTest.getMaster();
+var mdb = master.getDB("test");
+
+mdb.plain.ensureIndex({a: 1});
+mdb.plain.ensureIndex({b: 1}, {unique: true});
+mdb.plain.ensureIndex({c: 1}, {sparse: true, clustering: true});
+for (var i = 0; i < 20000; i++) {
+    var doc = {_id: i, a: i % 100, b: i, s: "some padding to fill batches with"};
+    if (i % 2 == 0) {
+        doc.c = i;
+    }
+    mdb.plain.insert(doc);
+}
+mdb.createCollection("capped", {capped: true, size: 100000});
+mdb.createCollection("part", {partitioned: true});
+for (var i = 0; i < 100; i++) {
+    mdb.capped.insert({i: i});
+    mdb.part.insert({i: i});
+}
+assert.eq(null, mdb.getLastError());
+
+// Resync the secondary from scratch.
+replTest.stop(1);
+resetDbpath(replTest.getPath(1));
+var secondary = replTest.restart(1);
+replTest.awaitSecondaryNodes();
+replTest.awaitReplication();
+
+secondary.setSlaveOk();
+var sdb = secondary.getDB("test");
+
+function sortedIndexes(db, coll) {
+    return db.system.indexes.find({ns: "test." + coll}, {_id: 0}).sort({name: 1}).toArray();
+}
+
+["plain", "capped", "part"].forEach(function(coll) {
+    assert.eq(mdb[coll].count(), sdb[coll].count(), coll);
+    assert.eq(sortedIndexes(mdb, coll), sortedIndexes(sdb, coll), coll);
+});
+assert.eq(10000, sdb.plain.find({c: {$exists: true}}).hint({c: 1}).itcount());
+assert.eq(200, sdb.plain.find({a: 7}).hint({a: 1}).itcount());
+
+// The per-collection progress is only shown while the sync runs.
+var status = secondary.getDB("admin").runCommand({replSetGetStatus: 1});
+status.members.forEach(function(m) {
+    assert(!m.initialSyncProgress, tojson(m));
+});
+
+replTest.stopSet();
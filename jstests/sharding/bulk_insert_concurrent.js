@@ -0,0 +1,103 @@
+//
+// Continue-on-error bulk inserts through mongos are partitioned by shard and sent to all the
+// shards at once; every valid document is inserted and errors from any shard are reported.
+//
+
+var st = new ShardingTest({shards : 3, mongos : 1, verbose : 0});
+st.stopBalancer();
+
+var mongos = st.s;
+var admin = mongos.getDB("admin");
+var shards = mongos.getDB("config").shards.find().toArray();
+var coll = mongos.getCollection(jsTestName() + ".coll");
+
+assert.commandWorked(admin.runCommand({enableSharding : coll.getDB() + ""}));
+printjson(admin.runCommand({movePrimary : coll.getDB() + "", to : shards[0]._id}));
+coll.ensureIndex({ukey : 1}, {unique : true});
+assert.eq(null, coll.getDB().getLastError());
+assert.commandWorked(admin.runCommand({shardCollection : coll + "", key : {ukey : 1}}));
+assert.commandWorked(admin.runCommand({split : coll + "", middle : {ukey : 100}}));
+assert.commandWorked(admin.runCommand({split : coll + "", middle : {ukey : 200}}));
+assert.commandWorked(admin.runCommand({moveChunk : coll + "", find : {ukey : 100},
+                                       to : shards[1]._id}));
+assert.commandWorked(admin.runCommand({moveChunk : coll + "", find : {ukey : 200},
+                                       to : shards[2]._id}));
+
+var isDupKeyError = function(err) {
+    return /dup(licate)? key/.test(err + "");
+}
+
+// Documents alternate between the three shards.
+var makeInserts = function(n) {
+    var inserts = [];
+    for (var i = 0; i < n; i++) {
+        inserts.push({ukey : (i % 3) * 100 + Math.floor(i / 3), i : i});
+    }
+    return inserts;
+}
+
+jsTest.log("Bulk insert (yes COE) spread over all shards...");
+
+coll.insert(makeInserts(300), 1);
+assert.eq(null, coll.getDB().getLastError());
+assert.eq(300, coll.find().itcount());
+assert.eq(100, coll.find({ukey : {$gte : 100, $lt : 200}}).itcount());
+for (var i = 0; i < shards.length; i++) {
+    assert.eq(100, new Mongo(shards[i].host).getCollection(coll + "").find().itcount());
+}
+
+jsTest.log("Bulk insert (yes COE) with mongod errors on every shard...");
+
+coll.remove({});
+assert.eq(null, coll.getDB().getLastError());
+coll.insert([{ukey : 1}, {ukey : 101}, {ukey : 201}]);
+assert.eq(null, coll.getDB().getLastError());
+
+coll.insert(makeInserts(300), 1);
+var err = coll.getDB().getLastError();
+printjson(err);
+assert(isDupKeyError(err));
+// the three existing documents collide with one insert each
+assert.eq(300, coll.find().itcount());
+
+jsTest.log("Bulk insert (yes COE) with a mongos error last...");
+
+coll.remove({});
+assert.eq(null, coll.getDB().getLastError());
+var inserts = makeInserts(30);
+inserts.push({hello : "world"});
+coll.insert(inserts, 1);
+var err = coll.getDB().getLastError();
+printjson(err);
+assert.neq(null, err);
+assert(!isDupKeyError(err));
+assert.eq(30, coll.find().itcount());
+
+jsTest.log("Bulk insert (yes COE) larger than one batch per shard...");
+
+coll.remove({});
+assert.eq(null, coll.getDB().getLastError());
+var big = new Array(256 * 1024).join("x");
+var inserts = [];
+for (var i = 0; i < 120; i++) {
+    inserts.push({ukey : (i % 3) * 100 + Math.floor(i / 3), big : big});
+}
+coll.insert(inserts, 1);
+assert.eq(null, coll.getDB().getLastError());
+assert.eq(120, coll.find().itcount());
+
+jsTest.log("Bulk insert (yes COE) with one shard down...");
+
+coll.remove({});
+assert.eq(null, coll.getDB().getLastError());
+MongoRunner.stopMongod(st.shard2);
+
+coll.insert(makeInserts(300), 1);
+var err = coll.getDB().getLastError();
+printjson(err);
+assert.neq(null, err);
+// the shards still up get their documents
+assert.eq(100, new Mongo(shards[0].host).getCollection(coll + "").find().itcount());
+assert.eq(100, new Mongo(shards[1].host).getCollection(coll + "").find().itcount());
+
+st.stop();
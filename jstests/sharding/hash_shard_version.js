@@ -0,0 +1,36 @@
+// Hashed shard keys are computed with hashVersion 0, so sharding on (or splitting over) a hashed
+// index built with another hashVersion must be refused.
+
+var s = new ShardingTest({ name : jsTestName(), shards : 2, mongos : 1, verbose : 1 });
+var dbname = "test";
+var coll = "foo";
+var ns = dbname + "." + coll;
+var db = s.getDB(dbname);
+db.adminCommand({ enablesharding : dbname });
+s.stopBalancer();
+
+for (var i = 0; i < 100; i++) {
+    db.getCollection(coll).insert({ a : i });
+}
+db.getCollection(coll).ensureIndex({ a : "hashed" }, { clustering : true, hashVersion : 1 });
+assert.eq(null, db.getLastError());
+
+var res = db.adminCommand({ shardcollection : ns, key : { a : "hashed" } });
+assert.eq(0, res.ok, "sharded on a hashVersion 1 index: " + tojson(res));
+assert.eq(17393, res.code, tojson(res));
+assert.eq(null, s.config.collections.findOne({ _id : ns, dropped : false }));
+
+// The shard's own lookups refuse it too.
+var primary = s.getServer(dbname).getDB("admin");
+res = primary.runCommand({ splitVector : ns, keyPattern : { a : "hashed" }, maxChunkSizeBytes : 1024 });
+assert.eq(0, res.ok, "splitVector used a hashVersion 1 index: " + tojson(res));
+assert.eq(17393, res.code, tojson(res));
+
+// With hashVersion 0 it works as before.
+db.getCollection(coll).dropIndex({ a : "hashed" });
+db.getCollection(coll).ensureIndex({ a : "hashed" }, { clustering : true, hashVersion : 0 });
+assert.eq(null, db.getLastError());
+res = db.adminCommand({ shardcollection : ns, key : { a : "hashed" } });
+assert.eq(1, res.ok, "shardcollection didn't work: " + tojson(res));
+
+s.stop();
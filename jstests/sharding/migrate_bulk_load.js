@@ -0,0 +1,46 @@
+// A chunk moved to a shard that doesn't have the collection yet is bulk loaded together with
+// the collection's secondary indexes, and the migration reports its throughput per phase.
+
+var st = new ShardingTest('migrate_bulk_load', 2);
+st.stopBalancer();
+
+var db = st.getDB('migrate_bulk_load');
+st.adminCommand({enableSharding: 'migrate_bulk_load'});
+st.adminCommand({shardCollection: 'migrate_bulk_load.foo', key: {a: 1}});
+db.foo.ensureIndex({b: 1});
+db.foo.ensureIndex({c: 1}, {sparse: true, clustering: true});
+
+var s = 'a';
+while (s.length < 1024) { s += s; }
+for (var i = 0; i < 8 * 1024; ++i) {
+    var doc = {a: i, b: i % 100, s: s};
+    if (i % 2 == 0) {
+        doc.c = i;
+    }
+    db.foo.insert(doc);
+}
+assert.eq(null, db.getLastError());
+
+var to = st.getNonPrimaries('migrate_bulk_load')[0];
+assert.commandWorked(st.s.adminCommand({moveChunk: 'migrate_bulk_load.foo', find: {a: 1}, to: to}));
+
+var toDB = st.getOther(st.getServer('migrate_bulk_load')).getDB('migrate_bulk_load');
+assert.eq(8 * 1024, toDB.foo.count());
+assert.eq(4 * 1024, toDB.foo.find({c: {$exists: true}}).hint({c: 1}).itcount());
+assert.eq(82, toDB.foo.find({b: 7}).hint({b: 1}).itcount());
+
+function sortedIndexes(db) {
+    return db.system.indexes.find({ns: 'migrate_bulk_load.foo'}, {_id: 0}).sort({name: 1}).toArray();
+}
+assert.eq(sortedIndexes(db.getSiblingDB('migrate_bulk_load')), sortedIndexes(toDB));
+
+var config = st.s.getDB('config');
+var toEntry = config.changelog.find({what: 'moveChunk.to', ns: 'migrate_bulk_load.foo'}).sort({time: -1}).next();
+printjson(toEntry);
+assert.eq("bulkLoad", toEntry.details.note, tojson(toEntry));
+assert.eq(8 * 1024, toEntry.details.clone.docs, tojson(toEntry));
+
+var fromEntry = config.changelog.find({what: 'moveChunk.from', ns: 'migrate_bulk_load.foo'}).sort({time: -1}).next();
+assert.eq(8 * 1024, fromEntry.details.clone.docs, tojson(fromEntry));
+
+st.stop();
@@ -0,0 +1,63 @@
+// Sorted queries through mongos merge the shard results in order while the next batch from each
+// shard is prefetched, including with small batches, limits and skips.
+
+var s = new ShardingTest( "sort_merge" , 3 , 0 , 1 );
+s.stopBalancer();
+
+s.adminCommand( { enablesharding : "test" } );
+s.adminCommand( { shardcollection : "test.data" , key : { _id : 1 } } );
+
+var db = s.getDB( "test" );
+
+var N = 3000;
+for ( var i = 0; i < N; i++ ) {
+    // x interleaves across the _id ranges so every shard contributes to every batch
+    db.data.insert( { _id : i , x : ( i * 7 ) % N , y : i % 10 } );
+}
+assert.eq( null , db.getLastError() );
+
+s.adminCommand( { split : "test.data" , middle : { _id : 1000 } } );
+s.adminCommand( { split : "test.data" , middle : { _id : 2000 } } );
+var shards = s.config.shards.find().toArray();
+s.adminCommand( { movechunk : "test.data" , find : { _id : 1500 } , to : shards[1]._id ,
+                  waitForDelete : true } );
+s.adminCommand( { movechunk : "test.data" , find : { _id : 2500 } , to : shards[2]._id ,
+                  waitForDelete : true } );
+assert.eq( 3 , s.config.chunks.find( { ns : "test.data" } ).itcount() );
+
+function checkSorted( arr , dir ) {
+    for ( var i = 1; i < arr.length; i++ ) {
+        assert.lte( 0 , dir * ( arr[i].x - arr[i-1].x ) , "out of order at " + i );
+    }
+}
+
+[ 1 , -1 ].forEach( function( dir ) {
+    [ 0 , 2 , 50 ].forEach( function( batchSize ) {
+        var all = db.data.find().sort( { x : dir } ).batchSize( batchSize ).toArray();
+        assert.eq( N , all.length , "batchSize " + batchSize );
+        checkSorted( all , dir );
+
+        var limited = db.data.find().sort( { x : dir } ).batchSize( batchSize ).limit( 120 )
+                             .toArray();
+        assert.eq( 120 , limited.length );
+        assert.eq( all.slice( 0 , 120 ) , limited );
+
+        var skipped = db.data.find().sort( { x : dir } ).batchSize( batchSize ).skip( 2900 )
+                             .toArray();
+        assert.eq( all.slice( 2900 ) , skipped );
+    } );
+} );
+
+// ties on the sort key still return every document exactly once
+var ids = {};
+db.data.find().sort( { y : 1 } ).batchSize( 7 ).forEach( function( doc ) {
+    assert( !ids[doc._id] , "duplicate " + doc._id );
+    ids[doc._id] = true;
+} );
+assert.eq( N , Object.keySet( ids ).length );
+
+// abandoning a cursor mid-stream leaves the shard connections usable
+db.data.find().sort( { x : 1 } ).batchSize( 10 ).next();
+assert.eq( N , db.data.find().sort( { x : 1 } ).itcount() );
+
+s.stop();
@@ -0,0 +1,57 @@
+/**
+ * The TTL monitor deletes expired documents in batches of ttlDeleteBatchSize, each in its own
+ * transaction, and reports its progress in the "ttl" serverStatus section.
+ */
+
+var t = db.ttl_batches;
+t.drop();
+
+var now = (new Date()).getTime();
+var past = new Date(now - 3600 * 1000);
+for (var i = 0; i < 1000; i++) {
+    t.insert({x: past, i: i});
+}
+for (var i = 0; i < 10; i++) {
+    t.insert({x: new Date(now + 3600 * 1000), i: i});
+}
+db.getLastError();
+assert.eq(1010, t.count());
+
+var batchesBefore = db.serverStatus().ttl.batches;
+assert.commandWorked(db.adminCommand({setParameter: 1, ttlDeleteBatchSize: 100}));
+
+t.ensureIndex({x: 1}, {expireAfterSeconds: 60});
+
+assert.soon(
+    function() {
+        return t.count() == 10;
+    }, "TTL index on x didn't delete", 70 * 1000
+);
+
+var ttl = db.serverStatus().ttl;
+assert.eq(100, ttl.batchSize);
+// 1000 documents in batches of 100, plus the empty batch that finds nothing left
+assert.lte(batchesBefore + 10, ttl.batches);
+assert.lte(1000, db.serverStatus().metrics.ttl.deletedDocuments);
+
+// with a rate limit of 100 docs/sec, 500 more expired documents take several seconds
+assert.commandWorked(db.adminCommand({setParameter: 1, ttlDeletesPerSecond: 100}));
+for (var i = 0; i < 500; i++) {
+    t.insert({x: past, i: i});
+}
+db.getLastError();
+assert.soon(
+    function() {
+        return t.count() < 510;
+    }, "TTL monitor never started deleting", 70 * 1000, 10
+);
+var start = new Date();
+assert.soon(
+    function() {
+        return t.count() == 10;
+    }, "TTL index on x didn't delete with a rate limit", 70 * 1000
+);
+assert.lte(3000, new Date() - start);
+
+assert.commandWorked(db.adminCommand({setParameter: 1, ttlDeletesPerSecond: 0,
+                                      ttlDeleteBatchSize: 1000}));
@@ -0,0 +1,50 @@
+/**
+ * A partitioned collection created with expireAfterSeconds gets a new partition every
+ * partitionIntervalSeconds, and the TTL monitor drops its partitions once everything in them
+ * has expired.
+ */
+
+var tn = "ttl_partitioned";
+var t = db[tn];
+t.drop();
+
+assert.commandFailed(db.createCollection(tn, {partitioned: 1, expireAfterSeconds: -1}));
+assert.commandFailed(db.createCollection(tn, {partitioned: 1, partitionIntervalSeconds: 60}));
+
+assert.commandWorked(db.createCollection(tn, {partitioned: 1, primaryKey: {ts: 1, _id: 1},
+                                              expireAfterSeconds: 3600,
+                                              partitionIntervalSeconds: 1}));
+
+var now = (new Date()).getTime();
+for (var i = 0; i < 100; i++) {
+    t.insert({ts: new Date(now - 2 * 3600 * 1000 + i)});
+}
+// an explicit pivot, in case the TTL monitor already capped the first partition itself
+assert.commandWorked(db.runCommand({addPartition: tn,
+                                    newMax: {ts: new Date(now - 3600 * 1000 - 1000), _id: 0}}));
+for (var i = 0; i < 10; i++) {
+    t.insert({ts: new Date(now + i)});
+}
+db.getLastError();
+assert.eq(110, t.count());
+assert.lte(2, db.runCommand({getPartitionInfo: tn}).numPartitions);
+
+var dropped = db.serverStatus().metrics.ttl.partitionsDropped;
+assert.soon(
+    function() {
+        return t.count() == 10;
+    }, "TTL monitor didn't drop the expired partition", 70 * 1000
+);
+assert.lt(dropped, db.serverStatus().metrics.ttl.partitionsDropped);
+
+// the partition holding the recent documents is older than the interval, so it gets capped
+// and a new one started
+assert.soon(
+    function() {
+        var info = db.runCommand({getPartitionInfo: tn});
+        return info.numPartitions == 2 && info.partitions[0].max.ts.getTime() == now + 9;
+    }, "TTL monitor didn't add a partition", 70 * 1000
+);
+assert.eq(10, t.count());
+
+t.drop();
@@ -0,0 +1,64 @@
+// dump with --numThreads and --compress, and restore the part files they write
+
+t = new ToolTest( "dumprestore_parallel" );
+t.startDB( "foo" );
+db = t.db;
+
+var padding = new Array( 1024 ).join( "x" );
+for ( var i = 0; i < 4000; i++ ) {
+    db.big.insert( { _id : i , a : i % 13 , padding : padding } );
+}
+db.small.insert( { _id : 1 , a : 1 } );
+db.big.ensureIndex( { a : 1 } );
+db.getLastError();
+
+function dumpFiles() {
+    return listFiles( t.ext + "/" + db.getName() ).map( function( f ) {
+        return f.name.substring( f.name.lastIndexOf( "/" ) + 1 );
+    } );
+}
+
+function checkRestored( options ) {
+    db.big.drop();
+    db.small.drop();
+    assert.eq( 0 , db.big.count() , "after drop" );
+
+    t.runTool.apply( t , [ "restore" , "--dir" , t.ext ].concat( options ) );
+    assert.eq( 4000 , db.big.count() , "big after restore" );
+    assert.eq( 1 , db.small.count() , "small after restore" );
+    for ( var i = 0; i < 4000; i += 397 ) {
+        var doc = db.big.findOne( { _id : i } );
+        assert( doc , "missing " + i );
+        assert.eq( i % 13 , doc.a );
+        assert.eq( padding , doc.padding );
+    }
+    assert.eq( 308 , db.big.find( { a : 12 } ).hint( { a : 1 } ).itcount() , "index after restore" );
+}
+
+// 1MB ranges, so big is split into parts, while small is too small to split
+t.runTool( "dump" , "--out" , t.ext , "--numThreads" , "3" , "--splitSize" , "1" , "--compress" );
+var files = dumpFiles();
+printjson( files );
+assert.contains( "big.bson.part0.zlib" , files );
+assert.contains( "big.bson.part1.zlib" , files );
+assert.contains( "small.bson.zlib" , files );
+assert.eq( -1 , files.indexOf( "small.bson.part0.zlib" ) );
+assert.eq( -1 , files.indexOf( "big.bson" ) );
+checkRestored( [ "--numThreads" , "2" ] );
+checkRestored( [ "--numThreads" , "1" ] );
+
+// parts without compression, and compression without parts
+resetDbpath( t.ext );
+t.runTool( "dump" , "--out" , t.ext , "--numThreads" , "2" , "--splitSize" , "1" );
+files = dumpFiles();
+assert.contains( "big.bson.part0" , files );
+assert.contains( "big.bson.part1" , files );
+checkRestored( [] );
+
+resetDbpath( t.ext );
+t.runTool( "dump" , "--out" , t.ext , "--compress" );
+files = dumpFiles();
+assert.contains( "big.bson.zlib" , files );
+checkRestored( [] );
+
+t.stop();
@@ -0,0 +1,48 @@
+// Top keeps latency histograms for each namespace and op type, shown by the top command and by
+// the latency section of serverStatus.
+
+t = db.top_latency;
+t.drop();
+var ns = t.getFullName();
+
+for ( var i = 0; i < 20; i++ ) {
+    t.insert( { _id : i } );
+}
+t.update( { _id : 1 } , { $set : { x : 1 } } );
+t.remove( { _id : 2 } );
+for ( var i = 0; i < 10; i++ ) {
+    t.findOne( { _id : i } );
+}
+db.getLastError();
+
+function checkHistogram( h , name ) {
+    assert( h , name + " missing" );
+    var total = 0;
+    h.buckets.forEach( function( b ) { total += b.count; } );
+    assert.eq( h.count , total , name + ": " + tojson( h ) );
+    assert.lte( h.p50 , h.p90 , name );
+    assert.lte( h.p90 , h.p99 , name );
+    assert.lte( h.p99 , h.p999 , name );
+    assert.lte( h.p999 , h.maxMicros , name );
+    return h;
+}
+
+var latency = db.adminCommand( "top" ).totals[ns].latency;
+assert( latency , "no latency in top" );
+assert.lte( 20 , checkHistogram( latency.insert , "insert" ).count );
+assert.lte( 1 , checkHistogram( latency.update , "update" ).count );
+assert.lte( 1 , checkHistogram( latency.remove , "remove" ).count );
+assert.lte( 10 , checkHistogram( latency.queries , "queries" ).count );
+
+// the namespaces are only there when asked for
+var status = db.serverStatus().latency;
+assert( status , "no latency in serverStatus" );
+checkHistogram( status.global.insert , "global insert" );
+assert.eq( undefined , status.namespaces );
+
+status = db.serverStatus( { latency : { namespaces : 1 } } ).latency;
+assert.lte( 20 , checkHistogram( status.namespaces[ns].insert , "serverStatus insert" ).count );
+
+// a dropped collection starts over
+t.drop();
+assert.eq( undefined , db.adminCommand( "top" ).totals[ns] );
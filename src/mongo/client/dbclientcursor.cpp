@@ -35,15 +35,15 @@ namespace mongo {
         _originalHost = _client->toString();
     }
 
-    int DBClientCursor::nextBatchSize() {
+    int DBClientCursor::nextBatchSize( int toReturn ) {
 
-        if ( nToReturn == 0 )
+        if ( toReturn == 0 )
             return batchSize;
 
         if ( batchSize == 0 )
-            return nToReturn;
+            return toReturn;
 
-        return batchSize < nToReturn ? batchSize : nToReturn;
+        return batchSize < toReturn ? batchSize : toReturn;
     }
 
     void DBClientCursor::_assembleInit( Message& toSend ) {
@@ -117,21 +117,30 @@ namespace mongo {
         return ok;
     }
 
+    void DBClientCursor::_assembleGetMore( Message& toSend, int toReturn ) {
+        BufBuilder b;
+        b.appendNum(opts);
+        b.appendStr(ns);
+        b.appendNum(nextBatchSize(toReturn));
+        b.appendNum(cursorId);
+        toSend.setData(dbGetMore, b.buf(), b.len());
+    }
+
     void DBClientCursor::requestMore() {
         verify( cursorId && batch.pos == batch.nReturned );
 
+        if ( _prefetchConn ) {
+            receivePrefetched();
+            return;
+        }
+
         if (haveLimit) {
             nToReturn -= batch.nReturned;
             verify(nToReturn > 0);
         }
-        BufBuilder b;
-        b.appendNum(opts);
-        b.appendStr(ns);
-        b.appendNum(nextBatchSize());
-        b.appendNum(cursorId);
 
         Message toSend;
-        toSend.setData(dbGetMore, b.buf(), b.len());
+        _assembleGetMore(toSend, nToReturn);
         auto_ptr<Message> response(new Message());
 
         if ( _client ) {
@@ -152,6 +161,108 @@ namespace mongo {
         }
     }
 
+    AtomicInt32 DBClientCursor::_prefetchesInFlight;
+
+    void DBClientCursor::enablePrefetch( int maxInFlight ) {
+        _prefetchEnabled = true;
+        _maxPrefetches = maxInFlight;
+        prefetchMore();
+    }
+
+    ScopedDbConnection* DBClientCursor::takePrefetchConn() {
+        ScopedDbConnection* conn = _prefetchConn;
+        _prefetchConn = NULL;
+        _prefetchesInFlight.subtractAndFetch( 1 );
+        return conn;
+    }
+
+    void DBClientCursor::prefetchMore() {
+        if ( !_prefetchEnabled || _prefetchConn || _client || !cursorId || _scopedHost.empty() )
+            return;
+        if ( opts & ( QueryOption_CursorTailable | QueryOption_Exhaust ) )
+            return;
+
+        // The getMore is sent before the current batch has been consumed, so the limit has to
+        // account for the whole of that batch up front.
+        int toReturn = nToReturn;
+        if ( haveLimit ) {
+            toReturn -= batch.nReturned;
+            if ( toReturn <= 0 )
+                return;
+        }
+
+        if ( _prefetchesInFlight.addAndFetch( 1 ) > _maxPrefetches ) {
+            // too many connections are held by prefetches already
+            _prefetchesInFlight.subtractAndFetch( 1 );
+            return;
+        }
+
+        auto_ptr<ScopedDbConnection> conn;
+        try {
+            conn.reset( ScopedDbConnection::getScopedDbConnection( _scopedHost ) );
+        }
+        catch (...) {
+            _prefetchesInFlight.subtractAndFetch( 1 );
+            throw;
+        }
+        if ( !conn->get()->lazySupported() ) {
+            conn->done();
+            _prefetchesInFlight.subtractAndFetch( 1 );
+            _prefetchEnabled = false;
+            return;
+        }
+
+        Message toSend;
+        _assembleGetMore(toSend, toReturn);
+        try {
+            conn->get()->say(toSend);
+        }
+        catch (...) {
+            _prefetchesInFlight.subtractAndFetch( 1 );
+            throw;
+        }
+        _prefetchRequestId = toSend.header()->id;
+        _prefetchConn = conn.release();
+    }
+
+    void DBClientCursor::receivePrefetched() {
+        verify( _prefetchConn );
+        scoped_ptr<ScopedDbConnection> conn( takePrefetchConn() );
+
+        if (haveLimit) {
+            nToReturn -= batch.nReturned;
+            verify(nToReturn > 0);
+        }
+
+        auto_ptr<Message> response(new Message());
+        if ( !conn->get()->recv( *response ) ) {
+            // the connection is in an unknown state, let the pool discard it
+            uasserted(17383, str::stream() << "recv failed while prefetching getMore from "
+                                           << _scopedHost);
+        }
+        if ( response->header()->responseTo != _prefetchRequestId ) {
+            // not the reply to our getMore, so the connection can't be trusted either
+            uasserted(17392, str::stream() << "prefetched getMore from " << _scopedHost
+                                           << " got a reply to request "
+                                           << response->header()->responseTo << ", expected "
+                                           << _prefetchRequestId);
+        }
+        _client = conn->get();
+        this->batch.m = response;
+        try {
+            dataReceived();
+        }
+        catch (...) {
+            _client = 0;
+            conn->done();
+            throw;
+        }
+        _client = 0;
+        conn->done();
+
+        prefetchMore();
+    }
+
     /** with QueryOption_Exhaust, the server just blasts data at us (marked at end with cursorid==0). */
     void DBClientCursor::exhaustReceiveMore() {
         verify( cursorId && batch.pos == batch.nReturned );
@@ -321,6 +432,21 @@ namespace mongo {
 
         DESTRUCTOR_GUARD (
 
+        if ( _prefetchConn ) {
+            // drain the reply to the getMore in flight so the connection can be reused
+            scoped_ptr<ScopedDbConnection> conn( takePrefetchConn() );
+            Message response;
+            if ( conn->get()->recv( response ) &&
+                 response.header()->responseTo == _prefetchRequestId ) {
+                QueryResult *qr = (QueryResult *) response.singleData();
+                if ( qr->resultFlags() & ResultFlag_CursorNotFound )
+                    cursorId = 0;
+                else if ( !( opts & QueryOption_CursorTailable ) )
+                    cursorId = qr->cursorId;
+                conn->done();
+            }
+        }
+
         if ( cursorId && _ownCursor && ! inShutdown() ) {
             BufBuilder b;
             b.appendNum( (int)0 ); // reserved
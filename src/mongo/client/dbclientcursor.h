@@ -24,11 +24,13 @@
 #include "mongo/client/dbclientinterface.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/json.h"
+#include "mongo/platform/atomic_word.h"
 #include "mongo/util/net/message.h"
 
 namespace mongo {
 
     class AScopedConnection;
+    class ScopedDbConnection;
 
     /** for mock purposes only -- do not create variants of DBClientCursor, nor hang code here 
         @see DBClientMockCursor
@@ -133,6 +135,18 @@ namespace mongo {
         /// Change batchSize after construction. Can change after requesting first batch.
         void setBatchSize(int newBatchSize) { batchSize = newBatchSize; }
 
+        /**
+         * Request each next batch as soon as the previous one arrives, so the server prepares
+         * it while the current batch is being consumed.  The getMore is sent without waiting
+         * for its reply, on a pooled connection held until more() needs the batch, or until the
+         * cursor is destroyed.  So that idle cursors can't hold on to a connection each, at most
+         * maxInFlight prefetches, counted over all cursors in the process, are in flight at
+         * once; beyond that, cursors request their next batch when they need it.  Only applies
+         * once the cursor has been attach()ed, since until then its connection belongs to
+         * someone else.
+         */
+        void enablePrefetch( int maxInFlight );
+
         DBClientCursor( DBClientBase* client, const string &_ns, BSONObj _query, int _nToReturn,
                         int _nToSkip, const BSONObj *_fieldsToReturn, int queryOptions , int bs ) :
             _client(client),
@@ -147,7 +161,11 @@ namespace mongo {
             resultFlags(0),
             cursorId(),
             _ownCursor( true ),
-            wasError( false ) {
+            wasError( false ),
+            _prefetchEnabled( false ),
+            _maxPrefetches( 0 ),
+            _prefetchConn( NULL ),
+            _prefetchRequestId( 0 ) {
             _finishConsInit();
         }
 
@@ -163,7 +181,11 @@ namespace mongo {
             resultFlags(0),
             cursorId(_cursorId),
             _ownCursor(true),
-            wasError(false) {
+            wasError(false),
+            _prefetchEnabled(false),
+            _maxPrefetches(0),
+            _prefetchConn(NULL),
+            _prefetchRequestId(0) {
             _finishConsInit();
         }
 
@@ -241,7 +263,8 @@ namespace mongo {
         friend class DBClientBase;
         friend class DBClientConnection;
 
-        int nextBatchSize();
+        int nextBatchSize() { return nextBatchSize( nToReturn ); }
+        int nextBatchSize( int toReturn );
         void _finishConsInit();
         
         Batch batch;
@@ -262,11 +285,23 @@ namespace mongo {
         string _scopedHost;
         string _lazyHost;
         bool wasError;
+        bool _prefetchEnabled;
+        int _maxPrefetches;
+        ScopedDbConnection* _prefetchConn; // holds the connection while a prefetch is in flight
+        MSGID _prefetchRequestId;          // the id of the getMore in flight
+
+        // prefetches in flight over all cursors, each holding a pooled connection
+        static AtomicInt32 _prefetchesInFlight;
 
         void dataReceived() { bool retry; string lazyHost; dataReceived( retry, lazyHost ); }
         void dataReceived( bool& retry, string& lazyHost );
         void requestMore();
         void exhaustReceiveMore(); // for exhaust
+        void _assembleGetMore( Message& toSend, int toReturn );
+        void prefetchMore();
+        void receivePrefetched();
+        /** @return the connection of the prefetch in flight, and stops counting it */
+        ScopedDbConnection* takePrefetchConn();
 
         // Don't call from a virtual function
         void _assertIfNull() const { uassert(13348, "connection died", this); }
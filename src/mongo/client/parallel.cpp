@@ -23,6 +23,7 @@
 #include "mongo/client/dbclientcursor.h"
 #include "mongo/client/parallel.h"
 #include "mongo/db/dbmessage.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/s/chunk.h"
 #include "mongo/s/chunk_version.h"
 #include "mongo/s/config.h"
@@ -34,6 +35,9 @@ namespace mongo {
 
     LabeledLevel pc( "pcursor", 2 );
 
+    // Each shard getMore prefetched for a merge holds a pooled connection until it is read.
+    MONGO_EXPORT_SERVER_PARAMETER(maxShardPrefetches, int, 100);
+
     // --------  ClusteredCursor -----------
 
     ClusteredCursor::ClusteredCursor( const QuerySpec& q ) {
@@ -478,6 +482,7 @@ namespace mongo {
         _numServers = _servers.size();
         _lastFrom = 0;
         _cursors = 0;
+        _mergeStarted = false;
 
         if( ! _qSpec.isEmpty() ){
 
@@ -1599,6 +1604,10 @@ namespace mongo {
             _needToSkip = n;
         }
 
+        _startMerge();
+        if ( ! _sortKey.isEmpty() )
+            return ! _mergeHeap.empty();
+
         for ( int i=0; i<_numServers; i++ ) {
             if ( _cursors[i].more() )
                 return true;
@@ -1606,7 +1615,82 @@ namespace mongo {
         return false;
     }
 
+    namespace {
+
+        /**
+         * Heap ordering for the sorted merge: the cursor whose next document sorts first ends up
+         * on top, ties going to the later shard.
+         */
+        class MergeOrder {
+        public:
+            MergeOrder( FilteringClientCursor* cursors, const BSONObj& sortKey )
+                : _cursors( cursors ), _sortKey( sortKey ) {
+            }
+
+            bool operator()( int a, int b ) const {
+                int comp = _cursors[a].peek().woSortOrder( _cursors[b].peek(), _sortKey, true );
+                return comp > 0 || ( comp == 0 && a < b );
+            }
+
+        private:
+            FilteringClientCursor* _cursors;
+            const BSONObj& _sortKey;
+        };
+
+    } // namespace
+
+    void ParallelSortClusteredCursor::_startMerge() {
+        if ( _mergeStarted )
+            return;
+        _mergeStarted = true;
+
+        for ( int i = 0; i < _numServers; i++ ) {
+            if ( _cursors[i].raw() )
+                _cursors[i].raw()->enablePrefetch( maxShardPrefetches );
+        }
+
+        if ( _sortKey.isEmpty() )
+            return;
+
+        _mergeHeap.reserve( _numServers );
+        for ( int i = 0; i < _numServers; i++ ) {
+            if ( _cursors[i].more() ) {
+                _mergeHeap.push_back( i );
+            }
+            else if ( _cursors[i].rawMData() ) {
+                _cursors[i].rawMData()->pcState->done = true;
+            }
+        }
+        make_heap( _mergeHeap.begin(), _mergeHeap.end(), MergeOrder( _cursors, _sortKey ) );
+    }
+
     BSONObj ParallelSortClusteredCursor::next() {
+        _startMerge();
+
+        if ( ! _sortKey.isEmpty() ) {
+            uassert( 10019 ,  "no more elements" , ! _mergeHeap.empty() );
+            MergeOrder order( _cursors, _sortKey );
+
+            pop_heap( _mergeHeap.begin(), _mergeHeap.end(), order );
+            const int from = _mergeHeap.back();
+            BSONObj best = _cursors[from].next();
+
+            if( _cursors[from].rawMData() )
+                _cursors[from].rawMData()->pcState->count++;
+
+            if ( _cursors[from].more() ) {
+                push_heap( _mergeHeap.begin(), _mergeHeap.end(), order );
+            }
+            else {
+                _mergeHeap.pop_back();
+                if( _cursors[from].rawMData() )
+                    _cursors[from].rawMData()->pcState->done = true;
+            }
+
+            _lastFrom = from;
+            return best;
+        }
+
         BSONObj best = BSONObj();
         int bestFrom = -1;
 
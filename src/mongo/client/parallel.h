@@ -321,6 +321,12 @@ namespace mongo {
     typedef ParallelConnectionMetadata PCMData;
     typedef shared_ptr<PCMData> PCMDataPtr;
 
+    /**
+     * The maxInFlight passed to DBClientCursor::enablePrefetch() for cursors on shards, the
+     * maxShardPrefetches server parameter.
+     */
+    extern int maxShardPrefetches;
+
     /**
      * Runs a query in parallel across N servers.  New logic has several modes -
      * 1) Standard query, enforces compatible chunk versions for queries across all results
@@ -392,7 +398,15 @@ namespace mongo {
         FilteringClientCursor * _cursors;
         int _needToSkip;
 
+        // Indexes into _cursors of the shards that still have results, kept as a heap ordered
+        // by _sortKey so next() can find the smallest document in O(log n).
+        vector<int> _mergeHeap;
+        bool _mergeStarted;
+
     private:
+        /** Starts prefetching on every shard cursor and, if sorted, builds the merge heap. */
+        void _startMerge();
+
         /**
          * Setups the shard version of the connection. When using a replica
          * set connection and the primary cannot be reached, the version
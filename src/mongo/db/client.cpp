@@ -482,6 +482,7 @@ namespace mongo {
         fastmodinsert = false;
         upsert = false;
         keyUpdates = 0;  // unsigned, so -1 not possible
+        appliedSnapshot = BSONObj();
         
         exceptionInfo.reset();
         lockNotGrantedInfo = BSONObj();
@@ -542,6 +543,10 @@ namespace mongo {
         OPDEBUG_TOSTRING_HELP_BOOL( fastmodinsert );
         OPDEBUG_TOSTRING_HELP_BOOL( upsert );
         OPDEBUG_TOSTRING_HELP( keyUpdates );
+
+        if ( ! appliedSnapshot.isEmpty() ) {
+            s << " appliedSnapshot: " << appliedSnapshot.toString();
+        }
         
         if ( extra.len() )
             s << " " << extra.str();
@@ -610,6 +615,8 @@ namespace mongo {
         OPDEBUG_APPEND_BOOL( fastmodinsert );
         OPDEBUG_APPEND_BOOL( upsert );
         OPDEBUG_APPEND_NUMBER( keyUpdates );
+        if ( ! appliedSnapshot.isEmpty() )
+            b.append( "appliedSnapshot" , appliedSnapshot );
 
         b.append( "lockStats" , curop.lockStat().report() );
         
@@ -24,6 +24,7 @@
 #include "pch.h"
 
 #include "mongo/db/client.h"
+#include "mongo/db/storage/env.h"
 
 namespace mongo {
 
@@ -59,7 +60,17 @@ namespace mongo {
     }
 
     void Client::TransactionStack::commitTxn() {
-        int flags = (cmdLine.logFlushPeriod == 0) ? 0 : DB_TXN_NOSYNC;
+        // A read only transaction has nothing to make durable, and must not wait for others'
+        // flushes.
+        const bool syncOnCommit = cmdLine.logFlushPeriod == 0 && !txn().readOnly();
+        if (syncOnCommit && _txns.size() == 1) {
+            // Fsync on commit, but through the group commit so that clients committing at
+            // the same time share one flush of the recovery log.
+            commitTxn(DB_TXN_NOSYNC);
+            storage::group_log_flush();
+            return;
+        }
+        int flags = syncOnCommit ? 0 : DB_TXN_NOSYNC;
         commitTxn(flags);
     }
 
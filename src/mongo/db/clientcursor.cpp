@@ -31,6 +31,8 @@
 #include <time.h>
 #include <vector>
 
+#include <boost/thread/tss.hpp>
+
 #include "mongo/base/init.h"
 #include "mongo/base/status.h"
 #include "mongo/client/dbclientinterface.h"
@@ -58,19 +60,76 @@
 
 namespace mongo {
 
-    CCById ClientCursor::clientCursorsById;
-    boost::recursive_mutex& ClientCursor::ccmutex( *(new boost::recursive_mutex()) );
-    long long ClientCursor::numberTimedOut = 0;
+    // leaked, so that cursors destroyed during shutdown can still unregister themselves
+    CacheLinePadded<ClientCursor::Stripe> *const ClientCursor::_stripes =
+            new CacheLinePadded<ClientCursor::Stripe>[ClientCursor::NumStripes];
+    AtomicUInt32 ClientCursor::_numCursors;
+    AtomicInt64 ClientCursor::numberTimedOut;
+
+    template <typename Predicate>
+    void ClientCursor::eraseMatching(Predicate &shouldErase) {
+        for (int i = 0; i < NumStripes; i++) {
+            Stripe &stripe = _stripes[i];
+            vector<ClientCursor *> toDelete;
+            {
+                recursive_scoped_lock lock(stripe.mutex);
+                for (CCById::iterator it = stripe.cursors.begin(); it != stripe.cursors.end(); ) {
+                    ClientCursor *cursor = it->second;
+                    if (shouldErase(cursor)) {
+                        toDelete.push_back(cursor);
+                        stripe.cursors.erase(it++);
+                        _numCursors.fetchAndSubtract(1);
+                    }
+                    else {
+                        ++it;
+                    }
+                }
+            }
+
+            // A cursor that owns another one finds it by id when it is destroyed, so deleting
+            // cursors that have already been removed from the registry can't delete them twice.
+            for (vector<ClientCursor *>::const_iterator it = toDelete.begin();
+                 it != toDelete.end(); ++it) {
+                delete *it;
+            }
+        }
+    }
+
+    namespace {
+        struct EraseAll {
+            bool operator()(ClientCursor *cursor) const { return true; }
+        };
+    }
 
     void ClientCursor::invalidateAllCursors() {
         verify(Lock::isW());
-        for( LockedIterator i; i.ok(); ) {
-            i.deleteAndAdvance();
-        }
+        EraseAll all;
+        eraseMatching(all);
     }
 
     /* ------------------------------------------- */
 
+    namespace {
+        struct EraseForNamespace {
+            EraseForNamespace(const StringData &ns, Database *db, bool isDB)
+                : _ns(ns), _db(db), _isDB(isDB) {}
+            bool operator()(ClientCursor *cc) const {
+                if (!cc->c()->shouldDestroyOnNSDeletion() || cc->db() != _db) {
+                    return false;
+                }
+                if (_isDB) {
+                    // already checked that db matched above
+                    dassert( StringData(cc->ns()).startsWith(_ns) );
+                    return true;
+                }
+                return _ns == cc->ns();
+            }
+            const StringData &_ns;
+            Database *_db;
+            bool _isDB;
+        };
+    }
+
     // ns is either a full namespace or "dbname." when invalidating for a whole db
     void ClientCursor::invalidate(const StringData &ns) {
         Lock::assertWriteLocked(ns);
@@ -78,36 +137,12 @@ namespace mongo {
         verify(dotpos != string::npos);
         bool isDB = (dotpos + 1) == ns.size(); // first (and only) dot is the last char
 
-        {
-            //cout << "\nTEMP invalidate " << ns << endl;
-            Database *db = cc().database();
-            verify(db);
-            verify( ns.startsWith(db->name()) );
-
-            for( LockedIterator i; i.ok(); ) {
-                ClientCursor *cc = i.current();
-
-                bool shouldDelete = false;
-                if (cc->c()->shouldDestroyOnNSDeletion() && cc->_db == db) {
-                    if (isDB) {
-                        // already checked that db matched above
-                        dassert( StringData(cc->_ns).startsWith(ns) );
-                        shouldDelete = true;
-                    }
-                    else {
-                        if ( ns == cc->_ns )
-                            shouldDelete = true;
-                    }
-                }
+        Database *db = cc().database();
+        verify(db);
+        verify( ns.startsWith(db->name()) );
 
-                if ( shouldDelete ) {
-                    i.deleteAndAdvance();
-                }
-                else {
-                    i.advance();
-                }
-            }
-        }
+        EraseForNamespace forNamespace(ns, db, isDB);
+        eraseMatching(forNamespace);
     }
 
     int ClientCursor::idleAgeTimeoutMillis = 600000;
@@ -136,7 +171,7 @@ namespace mongo {
         return Status::OK();
     }
 
-    /* note called outside of locks (other than ccmutex) so care must be exercised */
+    /* note called outside of locks (other than the cursor's stripe mutex) so care must be exercised */
     bool ClientCursor::shouldTimeout( unsigned millis ) {
         _idleAgeMillis += millis;
         dassert(idleAgeTimeoutMillis > 0);
@@ -147,37 +182,44 @@ namespace mongo {
         _idleAgeMillis = 0;
     }
 
+    namespace {
+        struct EraseTimedOut {
+            EraseTimedOut(unsigned millis) : _millis(millis), _n(0) {}
+            bool operator()(ClientCursor *cc) {
+                if (!cc->shouldTimeout(_millis)) {
+                    return false;
+                }
+                LOG(1) << "killing old cursor " << cc->cursorid() << ' ' << cc->ns()
+                       << " idle:" << cc->idleTime() << "ms" << endl;
+                _n++;
+                return true;
+            }
+            unsigned _millis;
+            long long _n;
+        };
+    }
+
     /* called every 4 seconds.  millis is amount of idle time passed since the last call -- could be zero */
     void ClientCursor::idleTimeReport(unsigned millis) {
-        LockedIterator i;
-        unsigned sz = clientCursorsById.size();
+        unsigned sz = numCursors();
         if (sz >= 100000) { 
             RATELIMITED(300000) log() << "warning number of open cursors is very large: " << sz << endl;
         }
-        while (i.ok()) {
-            ClientCursor *cc = i.current();
-            if (cc->shouldTimeout(millis)) {
-                LOG(1) << "killing old cursor " << cc->_cursorid << ' ' << cc->_ns
-                       << " idle:" << cc->idleTime() << "ms" << endl;
-                i.deleteAndAdvance();
-            } else {
-                i.advance();
-            }
-        }
-    }
-
-    void ClientCursor::LockedIterator::deleteAndAdvance() {
-        ClientCursor *cc = current();
-        CursorId id = cc->cursorid();
-        delete cc;
-        _i = clientCursorsById.upper_bound( id );
+        EraseTimedOut timedOut(millis);
+        eraseMatching(timedOut);
+        numberTimedOut.fetchAndAdd(timedOut._n);
     }
 
     void ClientCursor::initCursorID() {
-        {
-            recursive_scoped_lock lock(ccmutex);
-            _cursorid = allocCursorId_inlock();
-            clientCursorsById.insert( make_pair(_cursorid, this) );
+        while (true) {
+            const CursorId id = allocCursorId();
+            Stripe &stripe = stripeFor(id);
+            recursive_scoped_lock lock(stripe.mutex);
+            if (stripe.cursors.insert(make_pair(id, this)).second) {
+                _cursorid = id;
+                _numCursors.fetchAndAdd(1);
+                break;
+            }
         }
         
         if (_partOfMultiStatementTxn) {
@@ -233,9 +275,13 @@ namespace mongo {
         }
 
         if (_cursorid != INVALID_CURSOR_ID) {
-            recursive_scoped_lock lock(ccmutex);
+            Stripe &stripe = stripeFor(_cursorid);
+            recursive_scoped_lock lock(stripe.mutex);
 
-            clientCursorsById.erase(_cursorid);
+            // already gone if we were removed by eraseMatching or erase
+            if (stripe.cursors.erase(_cursorid)) {
+                _numCursors.fetchAndSubtract(1);
+            }
 
             // defensive:
             _cursorid = INVALID_CURSOR_ID;
@@ -334,38 +380,32 @@ namespace mongo {
     }
 
     namespace {
-        // so we don't have to do find() which is a little slow very often.
-        long long cursorGenTSLast = 0;
-        PseudoRandom* cursorGenRandom = NULL;
+        // each thread has its own generator, so allocating an id takes no lock
+        boost::thread_specific_ptr<PseudoRandom> cursorGenRandom;
     }
 
-    long long ClientCursor::allocCursorId_inlock() {
-        // It is important that cursor IDs not be reused within a short period of time.
+    long long ClientCursor::allocCursorId() {
+        // It is important that cursor IDs not be reused within a short period of time.  The
+        // high bits come from the clock, and initCursorID makes sure the id is not in use.
 
-        if ( ! cursorGenRandom ) {
+        PseudoRandom *random = cursorGenRandom.get();
+        if ( ! random ) {
             scoped_ptr<SecureRandom> sr( SecureRandom::create() );
-            cursorGenRandom = new PseudoRandom( sr->nextInt64() );
+            random = new PseudoRandom( sr->nextInt64() );
+            cursorGenRandom.reset( random );
         }
 
         const long long ts = Listener::getElapsedTimeMillis();
 
-        long long x;
-
-        while ( 1 ) {
-            x = ts << 32;
-            x |= cursorGenRandom->nextInt32();
-
-            if ( x == 0 )
-                continue;
+        long long x = ts << 32;
+        x |= random->nextInt32();
 
-            if ( x < 0 )
-                x *= -1;
+        // 0 means no cursor
+        if ( x == 0 )
+            x = 1;
 
-            if ( ts != cursorGenTSLast || ClientCursor::find_inlock(x, false) == 0 )
-                break;
-        }
-
-        cursorGenTSLast = ts;
+        if ( x < 0 )
+            x *= -1;
 
         return x;
     }
@@ -387,18 +427,21 @@ namespace mongo {
     }
 
     void ClientCursor::appendStats( BSONObjBuilder& result ) {
-        recursive_scoped_lock lock(ccmutex);
-        result.appendNumber("totalOpen", clientCursorsById.size() );
+        result.appendNumber("totalOpen", static_cast<size_t>(numCursors()) );
         result.appendNumber("clientCursors_size", (int) numCursors());
-        result.appendNumber("timedOut" , numberTimedOut);
+        result.appendNumber("timedOut" , numberTimedOut.load());
         unsigned pinned = 0;
         unsigned notimeout = 0;
-        for ( CCById::iterator i = clientCursorsById.begin(); i != clientCursorsById.end(); i++ ) {
-            unsigned p = i->second->_pinValue;
-            if( p >= 100 )
-                pinned++;
-            else if( p > 0 )
-                notimeout++;
+        for ( int s = 0; s < NumStripes; s++ ) {
+            Stripe &stripe = _stripes[s];
+            recursive_scoped_lock lock(stripe.mutex);
+            for ( CCById::iterator i = stripe.cursors.begin(); i != stripe.cursors.end(); i++ ) {
+                unsigned p = i->second->_pinValue;
+                if( p >= 100 )
+                    pinned++;
+                else if( p > 0 )
+                    notimeout++;
+            }
         }
         if( pinned ) 
             result.append("pinned", pinned);
@@ -455,38 +498,45 @@ namespace mongo {
     }
 
     void ClientCursor::find( const string& ns , set<CursorId>& all ) {
-        recursive_scoped_lock lock(ccmutex);
-
-        for ( CCById::iterator i=clientCursorsById.begin(); i!=clientCursorsById.end(); ++i ) {
-            if ( i->second->_ns == ns )
-                all.insert( i->first );
+        for ( int s = 0; s < NumStripes; s++ ) {
+            Stripe &stripe = _stripes[s];
+            recursive_scoped_lock lock(stripe.mutex);
+            for ( CCById::iterator i = stripe.cursors.begin(); i != stripe.cursors.end(); ++i ) {
+                if ( i->second->_ns == ns )
+                    all.insert( i->first );
+            }
         }
     }
 
-    bool ClientCursor::_erase_inlock(ClientCursor* cursor) {
+    void ClientCursor::_remove_inlock(ClientCursor* cursor) {
         // Must not have an active ClientCursor::Pin.
         massert( 16089,
                 str::stream() << "Cannot kill active cursor " << cursor->cursorid(),
                 cursor->_pinValue < 100 );
 
-        delete cursor;
-        return true;
+        stripeFor(cursor->_cursorid).cursors.erase(cursor->_cursorid);
+        _numCursors.fetchAndSubtract(1);
     }
 
     bool ClientCursor::erase(CursorId id) {
-        recursive_scoped_lock lock(ccmutex);
-        ClientCursor* cursor = find_inlock(id);
-        if (!cursor) {
-            return false;
+        ClientCursor* cursor;
+        {
+            recursive_scoped_lock lock(stripeFor(id).mutex);
+            cursor = find_inlock(id);
+            if (!cursor) {
+                return false;
+            }
+            _remove_inlock(cursor);
         }
 
-        return _erase_inlock(cursor);
+        delete cursor;
+        return true;
     }
 
     bool ClientCursor::eraseIfAuthorized(CursorId id) {
         std::string ns;
         {
-            recursive_scoped_lock lock(ccmutex);
+            recursive_scoped_lock lock(stripeFor(id).mutex);
             ClientCursor* cursor = find_inlock(id);
             if (!cursor) {
                 return false;
@@ -502,19 +552,24 @@ namespace mongo {
         // It is safe to lookup the cursor again after temporarily releasing the mutex because
         // of 2 invariants: that the cursor ID won't be re-used in a short period of time, and that
         // the namespace associated with a cursor cannot change.
-        recursive_scoped_lock lock(ccmutex);
-        ClientCursor* cursor = find_inlock(id);
-        if (!cursor) {
-            // Cursor was deleted in another thread since we found it earlier in this function.
-            return false;
-        }
-        if (cursor->ns() != ns) {
-            warning() << "Cursor namespace changed. Previous ns: " << ns << ", current ns: "
-                    << cursor->ns() << endl;
-            return false;
+        ClientCursor* cursor;
+        {
+            recursive_scoped_lock lock(stripeFor(id).mutex);
+            cursor = find_inlock(id);
+            if (!cursor) {
+                // Cursor was deleted in another thread since we found it earlier in this function.
+                return false;
+            }
+            if (cursor->ns() != ns) {
+                warning() << "Cursor namespace changed. Previous ns: " << ns << ", current ns: "
+                        << cursor->ns() << endl;
+                return false;
+            }
+            _remove_inlock(cursor);
         }
 
-        return _erase_inlock(cursor);
+        delete cursor;
+        return true;
     }
 
     int ClientCursor::erase(int n, long long *ids) {
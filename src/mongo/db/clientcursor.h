@@ -34,6 +34,7 @@
 #include "mongo/db/matcher.h"
 #include "mongo/db/projection.h"
 #include "mongo/db/keypattern.h"
+#include "mongo/platform/atomic_word.h"
 #include "mongo/s/d_chunk_manager.h"
 #include "mongo/util/net/message.h"
 #include "mongo/util/net/listen.h"
@@ -69,7 +70,7 @@ namespace mongo {
         public:
             Pin( long long cursorid ) :
                 _cursorid( INVALID_CURSOR_ID ) {
-                recursive_scoped_lock lock( ccmutex );
+                recursive_scoped_lock lock( stripeFor( cursorid ).mutex );
                 ClientCursor *cursor = ClientCursor::find_inlock( cursorid, true );
                 if ( cursor ) {
                     uassert( 12051, "clientcursor already in use? driver problem?",
@@ -82,7 +83,8 @@ namespace mongo {
                 if ( _cursorid == INVALID_CURSOR_ID ) {
                     return;
                 }
-                ClientCursor *cursor = c();
+                recursive_scoped_lock lock( stripeFor( _cursorid ).mutex );
+                ClientCursor *cursor = ClientCursor::find_inlock( _cursorid, true );
                 _cursorid = INVALID_CURSOR_ID;
                 if ( cursor ) {
                     verify( cursor->_pinValue >= 100 );
@@ -141,26 +143,6 @@ namespace mongo {
             CursorId _id;
         };
 
-        /**
-         * Iterates through all ClientCursors, under its own ccmutex lock.
-         * Also supports deletion on the fly.
-         */
-        class LockedIterator : boost::noncopyable {
-        public:
-            LockedIterator() : _lock( ccmutex ), _i( clientCursorsById.begin() ) {}
-            bool ok() const { return _i != clientCursorsById.end(); }
-            ClientCursor *current() const { return _i->second; }
-            void advance() { ++_i; }
-            /**
-             * Delete 'current' and advance. Properly handles cascading deletions that may occur
-             * when one ClientCursor is directly deleted.
-             */
-            void deleteAndAdvance();
-        private:
-            recursive_scoped_lock _lock;
-            CCById::const_iterator _i;
-        };
-        
         ClientCursor(int queryOptions, const shared_ptr<Cursor>& c, const string& ns,
                      BSONObj query = BSONObj(), const bool inMultiStatementTxn = false,
                      bool createCursorID = true);
@@ -249,9 +231,11 @@ namespace mongo {
         ShardChunkManagerPtr getChunkManager(){ return _chunkManager; }
 
     private:
+        // caller must hold stripeFor(id).mutex
         static ClientCursor* find_inlock(CursorId id, bool warn = true) {
-            CCById::iterator it = clientCursorsById.find(id);
-            if ( it == clientCursorsById.end() ) {
+            const CCById &cursors = stripeFor(id).cursors;
+            CCById::const_iterator it = cursors.find(id);
+            if ( it == cursors.end() ) {
                 if ( warn )
                     OCCASIONALLY out() << "ClientCursor::find(): cursor not found in map " << id << " (ok after a drop)\n";
                 return 0;
@@ -261,7 +245,7 @@ namespace mongo {
 
     public:
         static ClientCursor* find(CursorId id, bool warn = true) {
-            recursive_scoped_lock lock(ccmutex);
+            recursive_scoped_lock lock(stripeFor(id).mutex);
             ClientCursor *c = find_inlock(id, warn);
             // if this asserts, your code was not thread safe - you either need to set no timeout
             // for the cursor or keep a ClientCursor::Pointer in scope for it.
@@ -278,7 +262,7 @@ namespace mongo {
         static bool erase(CursorId id);
         // Same as erase but checks to make sure this thread has read permission on the cursor's
         // namespace.  This should be called when receiving killCursors from a client.  This should
-        // not be called when ccmutex is held.
+        // not be called when a stripe's mutex is held.
         static bool eraseIfAuthorized(CursorId id);
 
         /**
@@ -303,7 +287,7 @@ namespace mongo {
         static void idleTimeReport(unsigned millis);
 
         static void appendStats( BSONObjBuilder& result );
-        static unsigned numCursors() { return clientCursorsById.size(); }
+        static unsigned numCursors() { return _numCursors.load(); }
         static void find( const string& ns , set<CursorId>& all );
 
     public:
@@ -330,7 +314,14 @@ namespace mongo {
         // setting this prevents timeout of the cursor in question.
         void noTimeout() { _pinValue++; }
 
-        static bool _erase_inlock(ClientCursor* cursor);
+        // Removes cursor from its stripe, the caller deletes it once the stripe's mutex has been
+        // released.  Must not have an active ClientCursor::Pin.
+        static void _remove_inlock(ClientCursor* cursor);
+
+        // Removes every cursor for which shouldErase returns true and deletes it. Stripes are
+        // visited one at a time, so only one stripe's cursors are blocked at any moment.
+        template <typename Predicate>
+        static void eraseMatching(Predicate &shouldErase);
 
         CursorId _cursorid;
 
@@ -367,10 +358,28 @@ namespace mongo {
 
     private: // static members
 
-        static CCById clientCursorsById;
-        static long long numberTimedOut;
-        static boost::recursive_mutex& ccmutex;   // must use this for all statics above!
-        static CursorId allocCursorId_inlock();
+        /* The registry of cursors by id is split into stripes, each with its own mutex, so
+           that getMores on different cursors don't contend on a single lock.  A cursor lives
+           in the stripe picked by the low (random) bits of its id.  The stripe's mutex must
+           be held to look up a cursor, to insert or remove it, and to change its _pinValue.
+           Cursors are never deleted while a stripe's mutex is held, since a cursor's
+           destructor may delete other cursors, which may live in other stripes.
+        */
+        struct Stripe {
+            boost::recursive_mutex mutex;
+            CCById cursors;
+        };
+        static const int NumStripes = 16;
+        static CacheLinePadded<Stripe> *const _stripes;
+        static Stripe& stripeFor(CursorId id) {
+            return _stripes[id & (NumStripes - 1)];
+        }
+
+        static AtomicUInt32 _numCursors;
+        static AtomicInt64 numberTimedOut;
+
+        // Picks a cursor id without taking any lock, initCursorID retries if it is in use.
+        static CursorId allocCursorId();
 
     };
 
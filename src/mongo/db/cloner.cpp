@@ -18,6 +18,9 @@
 */
 
 #include "mongo/pch.h"
+
+#include <boost/thread/thread.hpp>
+
 #include "mongo/base/init.h"
 #include "mongo/base/status.h"
 #include "mongo/base/string_data.h"
@@ -41,8 +44,10 @@
 #include "mongo/db/database.h"
 #include "mongo/db/collection.h"
 #include "mongo/db/storage/exception.h"
+#include "mongo/platform/atomic_word.h"
 #include "mongo/util/progress_meter.h"
 #include "mongo/util/mongoutils/str.h"
+#include "mongo/util/queue.h"
 
 namespace mongo {
 
@@ -56,6 +61,75 @@ namespace mongo {
         }
     }
 
+    void CloneProgress::clear() {
+        SimpleMutex::scoped_lock lk(_mutex);
+        _colls.clear();
+    }
+
+    bool CloneProgress::empty() const {
+        SimpleMutex::scoped_lock lk(_mutex);
+        return _colls.empty();
+    }
+
+    CloneProgress::CollectionProgress *CloneProgress::find(const string &ns) {
+        // The collection being copied is almost always the last one started.
+        for (vector<CollectionProgress>::reverse_iterator it = _colls.rbegin(); it != _colls.rend(); ++it) {
+            if (it->ns == ns) {
+                return &*it;
+            }
+        }
+        return NULL;
+    }
+
+    void CloneProgress::start(const string &ns, long long estimatedBytes) {
+        SimpleMutex::scoped_lock lk(_mutex);
+        CollectionProgress coll;
+        coll.ns = ns;
+        coll.docs = 0;
+        coll.bytes = 0;
+        coll.estimatedBytes = estimatedBytes;
+        coll.started = jsTime();
+        coll.finished = 0;
+        _colls.push_back(coll);
+    }
+
+    void CloneProgress::noteCopied(const string &ns, long long docs, long long bytes) {
+        SimpleMutex::scoped_lock lk(_mutex);
+        CollectionProgress *coll = find(ns);
+        if (coll != NULL) {
+            coll->docs += docs;
+            coll->bytes += bytes;
+        }
+    }
+
+    void CloneProgress::finish(const string &ns) {
+        SimpleMutex::scoped_lock lk(_mutex);
+        CollectionProgress *coll = find(ns);
+        if (coll != NULL) {
+            coll->finished = jsTime();
+        }
+    }
+
+    void CloneProgress::append(BSONObjBuilder &b, const StringData &name) const {
+        SimpleMutex::scoped_lock lk(_mutex);
+        BSONArrayBuilder arr(b.subarrayStart(name));
+        for (vector<CollectionProgress>::const_iterator it = _colls.begin(); it != _colls.end(); ++it) {
+            BSONObjBuilder coll(arr.subobjStart());
+            coll.append("ns", it->ns);
+            coll.append("docs", it->docs);
+            coll.append("bytes", it->bytes);
+            if (it->estimatedBytes >= 0) {
+                coll.append("estimatedBytes", it->estimatedBytes);
+            }
+            coll.appendDate("started", it->started);
+            if (it->finished != 0) {
+                coll.appendDate("finished", it->finished);
+            }
+            coll.doneFast();
+        }
+        arr.doneFast();
+    }
+
     bool masterSameProcess(const char *masterHost) {
         stringstream a,b;
         a << "localhost:" << cmdLine.port;
@@ -99,6 +173,7 @@ namespace mongo {
 
     class Cloner: boost::noncopyable {
         shared_ptr<DBClientBase> conn;
+        CloneProgress *_progress;
         void copy(
             const char *from_ns, 
             const char *to_ns, 
@@ -111,8 +186,10 @@ namespace mongo {
             ProgressMeter *parentProgress = NULL
             );
         struct Fun;
+        class Prefetcher;
+        bool canPrefetch() const;
     public:
-        Cloner(shared_ptr<DBClientBase> &c) : conn(c) {}
+        Cloner(shared_ptr<DBClientBase> &c) : conn(c), _progress(NULL) {}
 
         /* slaveOk     - if true it is ok if the source of the data is !ismaster.
            useReplAuth - use the credentials we normally use as a replication slave for the cloning
@@ -195,67 +272,81 @@ namespace mongo {
 
     struct Cloner::Fun {
         void operator()(DBClientCursorBatchIterator &i) {
-            const string to_dbname = nsToDatabase(to_collection);
+            long long docs = 0;
+            long long bytes = 0;
             while (i.moreInCurrentBatch()) {
-                if (n % 128 == 127) {
-                    mayInterrupt(_mayBeInterrupted);
-                }
-
                 BSONObj js = i.nextSafe();
-                ++n;
+                load(js);
+                docs++;
+                bytes += js.objsize();
+            }
+            noteBatch(docs, bytes);
+        }
 
-                if (isindex) {
-                    verify(nsToCollectionSubstring(from_collection) == "system.indexes");
-                    storedForLater->push_back(fixindex(js, to_dbname).getOwned());
-                }
-                else {
-                    try {
-                        LOCK_REASON(lockReason, "cloner: copying documents into local collection");
-                        Client::ReadContext ctx(to_collection, lockReason);
-                        if (_isCapped) {
-                            Collection *cl = getCollection(to_collection);
-                            verify(cl->isCapped());
-                            BSONObj pk = js["$_"].Obj();
-                            BSONObjBuilder rowBuilder;                        
-                            BSONObjIterator it(js);
-                            while (it.moreWithEOO()) {
-                                BSONElement e = it.next();
-                                if (e.eoo()) {
-                                    break;
-                                }
-                                if (!mongoutils::str::equals(e.fieldName(), "$_")) {
-                                    rowBuilder.append(e);
-                                }
+        void noteBatch(long long docs, long long bytes) {
+            if (cloneProgress != NULL && !isindex) {
+                cloneProgress->noteCopied(to_collection, docs, bytes);
+            }
+        }
+
+        void load(const BSONObj &js) {
+            if (n % 128 == 127) {
+                mayInterrupt(_mayBeInterrupted);
+            }
+
+            ++n;
+
+            if (isindex) {
+                verify(nsToCollectionSubstring(from_collection) == "system.indexes");
+                storedForLater->push_back(fixindex(js, nsToDatabase(to_collection)).getOwned());
+            }
+            else {
+                try {
+                    LOCK_REASON(lockReason, "cloner: copying documents into local collection");
+                    Client::ReadContext ctx(to_collection, lockReason);
+                    if (_isCapped) {
+                        Collection *cl = getCollection(to_collection);
+                        verify(cl->isCapped());
+                        BSONObj pk = js["$_"].Obj();
+                        BSONObjBuilder rowBuilder;                        
+                        BSONObjIterator it(js);
+                        while (it.moreWithEOO()) {
+                            BSONElement e = it.next();
+                            if (e.eoo()) {
+                                break;
                             }
-                            BSONObj row = rowBuilder.obj();
-                            CappedCollection *cappedCl = cl->as<CappedCollection>();
-                            bool indexBitChanged = false;
-                            cappedCl->insertObjectWithPK(pk, row, Collection::NO_LOCKTREE, &indexBitChanged);
-                            // Hack copied from Collection::insertObject. TODO: find a better way to do this                        
-                            if (indexBitChanged) {
-                                cl->noteMultiKeyChanged();
+                            if (!mongoutils::str::equals(e.fieldName(), "$_")) {
+                                rowBuilder.append(e);
                             }
                         }
-                        else {
-                            insertObject(to_collection, js, 0, logForRepl);
-                        }
-                        if (progress == NULL) {
-                            RATELIMITED(3000) LOG(0) << "Cloning collection " << from_collection << " progress " << n << endl;
-                        } else if (progress->hit(js.objsize())) {
-                            std::string status = progress->treeString();
-                            if (cc().curop()) {
-                                cc().curop()->setMessage(status.c_str());
-                            }
-                            if (!logForRepl) {
-                                sethbmsg(status, 2);
-                            }
+                        BSONObj row = rowBuilder.obj();
+                        CappedCollection *cappedCl = cl->as<CappedCollection>();
+                        bool indexBitChanged = false;
+                        cappedCl->insertObjectWithPK(pk, row, Collection::NO_LOCKTREE, &indexBitChanged);
+                        // Hack copied from Collection::insertObject. TODO: find a better way to do this                        
+                        if (indexBitChanged) {
+                            cl->noteMultiKeyChanged();
                         }
                     }
-                    catch (UserException& e) {
-                        error() << "error: exception cloning object in " << from_collection << ' ' << e.what() << " obj:" << js.toString() << '\n';
-                        throw;
+                    else {
+                        insertObject(to_collection, js, 0, logForRepl);
+                    }
+                    if (progress == NULL) {
+                        RATELIMITED(3000) LOG(0) << "Cloning collection " << from_collection << " progress " << n << endl;
+                    } else if (progress->hit(js.objsize())) {
+                        std::string status = progress->treeString();
+                        if (cc().curop()) {
+                            cc().curop()->setMessage(status.c_str());
+                        }
+                        if (!logForRepl) {
+                            sethbmsg(status, 2);
+                        }
                     }
                 }
+                catch (UserException& e) {
+                    error() << "error: exception cloning object in " << from_collection << ' ' << e.what() << " obj:" << js.toString() << '\n';
+                    throw;
+                }
             }
         }
         int n;
@@ -267,8 +358,103 @@ namespace mongo {
         bool _mayBeInterrupted;
         bool _isCapped;
         ProgressMeter *progress;
+        CloneProgress *cloneProgress;
     };
 
+    /**
+     * Runs a query in a background thread and hands the batches it receives to the caller
+     * through a small bounded queue, so that the caller can insert one batch while the next
+     * ones are on their way over the network.  Nothing else may use the connection until the
+     * Prefetcher is destroyed.
+     */
+    class Cloner::Prefetcher : boost::noncopyable {
+    public:
+        typedef shared_ptr<vector<BSONObj> > Batch;
+
+        Prefetcher(DBClientBase &conn, const string &ns, const Query &query, int options) :
+            _conn(conn),
+            _ns(ns),
+            _query(query),
+            _options(options),
+            _batches(maxQueuedBatches + 1),
+            _finished(false),
+            _thread(boost::bind(&Prefetcher::run, this)) {
+        }
+
+        ~Prefetcher() {
+            if (!_finished) {
+                // Make the query stop at its next batch, and wait for it to let go of the
+                // connection.
+                _aborted.store(1);
+                while (_batches.blockingPop()) {
+                }
+            }
+            _thread.join();
+        }
+
+        /** @return the next batch, or an empty Batch once the query is done. */
+        Batch next() {
+            verify(!_finished);
+            Batch batch = _batches.blockingPop();
+            if (!batch) {
+                _finished = true;
+                uassert(17379, str::stream() << "error fetching " << _ns << ": " << _error,
+                        _error.empty());
+            }
+            return batch;
+        }
+
+    private:
+        static const size_t maxQueuedBatches = 4;
+
+        void run() {
+            Client::initThread("clonePrefetcher");
+            try {
+                _conn.query(boost::function<void(DBClientCursorBatchIterator &)>(
+                                    boost::bind(&Prefetcher::gotBatch, this, _1)),
+                            _ns, _query, 0, _options);
+            }
+            catch (std::exception &e) {
+                _error = e.what();
+            }
+            catch (...) {
+                _error = "unknown exception";
+            }
+            // An empty batch marks the end.  _error is read only after it has been popped.
+            _batches.push(Batch());
+            cc().shutdown();
+        }
+
+        void gotBatch(DBClientCursorBatchIterator &i) {
+            uassert(17380, "clone prefetch aborted", !_aborted.load());
+            Batch batch(new vector<BSONObj>);
+            while (i.moreInCurrentBatch()) {
+                batch->push_back(i.nextSafe().getOwned());
+            }
+            _batches.push(batch);
+        }
+
+        DBClientBase &_conn;
+        const string _ns;
+        const Query _query;
+        const int _options;
+        BlockingQueue<Batch> _batches;
+        AtomicUInt32 _aborted;
+        string _error;
+        bool _finished;
+        boost::thread _thread; // last, so it starts after everything else is initialized
+    };
+
+    /**
+     * Only a connection to another server can be read from a Prefetcher's thread.  A
+     * DBDirectClient (cloning from this process) would query under the lock the clone already
+     * holds, and outside the clone's transaction.
+     */
+    bool Cloner::canPrefetch() const {
+        DBClientConnection *remote = dynamic_cast<DBClientConnection *>(conn.get());
+        return remote != NULL && !masterSameProcess(remote->getServerAddress().c_str());
+    }
+
     /* copy the specified collection
        isindex - if true, this is system.indexes collection, in which we do some transformation when copying.
     */
@@ -312,12 +498,33 @@ namespace mongo {
         f._mayBeInterrupted = mayBeInterrupted;
         f._isCapped = isCapped;
         f.progress = dataProgress.get();
+        f.cloneProgress = _progress;
 
         int options = QueryOption_NoCursorTimeout | QueryOption_AddHiddenPK |
             ( slaveOk ? QueryOption_SlaveOk : 0 );
 
         mayInterrupt( mayBeInterrupted );
-        conn->query(boost::function<void(DBClientCursorBatchIterator &)>(f), from_collection, query, 0, options);
+        if (!isindex && _progress != NULL) {
+            _progress->start(to_collection, dataProgress ? res["size"].numberLong() : -1);
+        }
+        if (!isindex && canPrefetch()) {
+            // Overlap fetching the next batches with inserting this one.
+            Prefetcher prefetcher(*conn, from_collection, query, options);
+            for (Prefetcher::Batch batch = prefetcher.next(); batch; batch = prefetcher.next()) {
+                long long bytes = 0;
+                for (vector<BSONObj>::const_iterator it = batch->begin(); it != batch->end(); ++it) {
+                    f.load(*it);
+                    bytes += it->objsize();
+                }
+                f.noteBatch(batch->size(), bytes);
+            }
+        }
+        else {
+            conn->query(boost::function<void(DBClientCursorBatchIterator &)>(f), from_collection, query, 0, options);
+        }
+        if (!isindex && _progress != NULL) {
+            _progress->finish(to_collection);
+        }
 
         if (dataProgress) {
             dataProgress->finished();
@@ -486,6 +693,8 @@ namespace mongo {
 
         string todb = cc().database()->name();
         verify(conn.get());
+        massert(17381, "bulkLoad is not written to replication log", !opts.bulkLoad || !opts.logForRepl);
+        _progress = opts.progress;
 
         /* todo: we can put these releases inside dbclient or a dbclient specialization.
            or just wait until we get rid of global lock anyway.
@@ -591,7 +800,28 @@ namespace mongo {
             string to_name = todb + p;
             bool isCapped = options["capped"].trueValue();
 
-            {
+            scoped_ptr<Client::Transaction> loadTxn;
+            if (opts.bulkLoad && bulkLoadable(to_name, options)) {
+                // Create the collection with its indexes and load all of them in one pass.
+                vector<BSONObj> indexes;
+                if (opts.syncIndexes) {
+                    auto_ptr<DBClientCursor> c = conn->query(
+                        getSisterNS(opts.fromDB, "system.indexes"),
+                        BSON("ns" << from_name << "name" << NE << "_id_"),
+                        0, 0, 0, opts.slaveOk ? QueryOption_SlaveOk : 0);
+                    uassert(17382, str::stream() << "couldn't query indexes of " << from_name, c.get());
+                    while (c->more()) {
+                        indexes.push_back(fixindex(c->nextSafe(), todb).getOwned());
+                    }
+                }
+                collsToIgnoreBarr.append(from_name);
+
+                loadTxn.reset(new Client::Transaction(DB_SERIALIZABLE));
+                LOCK_REASON(lockReason, "cloner: beginning bulk load");
+                Client::WriteContext ctx(to_name, lockReason);
+                beginBulkLoad(to_name, indexes, options);
+            }
+            else {
                 string err;
                 const char *toname = to_name.c_str();
                 userCreateNS(toname, options, err, opts.logForRepl);
@@ -630,6 +860,14 @@ namespace mongo {
                 q,
                 &collsProgress
                 );
+            if (loadTxn) {
+                {
+                    LOCK_REASON(lockReason, "cloner: committing bulk load");
+                    Client::WriteContext ctx(to_name, lockReason);
+                    commitBulkLoad(to_name);
+                }
+                loadTxn->commit();
+            }
             if (collsProgress.hit()) {
                 std::string status = collsProgress.treeString();
                 if (cc().curop()) {
@@ -20,10 +20,49 @@
 #pragma once
 
 #include "jsobj.h"
+#include "mongo/util/concurrency/mutex.h"
 #include "mongo/util/progress_meter.h"
 
 namespace mongo {
 
+    /**
+     * Per-collection progress of a running clone, for reporting to users (the initial sync's
+     * is shown by replSetGetStatus).  Thread safe.
+     */
+    class CloneProgress : boost::noncopyable {
+    public:
+        CloneProgress() : _mutex("CloneProgress") {}
+
+        void clear();
+
+        bool empty() const;
+
+        /** Note that cloning 'ns' has started, with an estimate of its size (-1 if unknown). */
+        void start(const string &ns, long long estimatedBytes);
+
+        void noteCopied(const string &ns, long long docs, long long bytes);
+
+        void finish(const string &ns);
+
+        /** Append an array named 'name' with an object for each collection started so far. */
+        void append(BSONObjBuilder &b, const StringData &name) const;
+
+    private:
+        struct CollectionProgress {
+            string ns;
+            long long docs;
+            long long bytes;
+            long long estimatedBytes;
+            Date_t started;
+            Date_t finished;
+        };
+
+        CollectionProgress *find(const string &ns);
+
+        mutable SimpleMutex _mutex;
+        vector<CollectionProgress> _colls;
+    };
+
     struct CloneOptions {
 
         CloneOptions() {
@@ -34,6 +73,9 @@ namespace mongo {
 
             syncData = true;
             syncIndexes = true;
+
+            bulkLoad = false;
+            progress = NULL;
         }
             
         string fromDB;
@@ -46,6 +88,15 @@ namespace mongo {
 
         bool syncData;
         bool syncIndexes;
+
+        // Create each collection that can be bulk loaded with its indexes, and fill it with
+        // the loader in a child transaction, instead of inserting documents one by one and
+        // building the indexes afterwards.  Not logged for replication, so only for use with
+        // logForRepl = false.
+        bool bulkLoad;
+
+        // If set, updated with the progress of each collection as it is copied.
+        CloneProgress *progress;
     };
 
     class DBClientBase;
@@ -172,6 +172,10 @@ namespace mongo {
         if (e.ok() && !e.isNull()) {
             b.append(e);
         }
+        e = options["keyFormat"];
+        if (e.ok() && !e.isNull()) {
+            b.append(e);
+        }
         return b.obj();
     }
 
@@ -217,6 +221,14 @@ namespace mongo {
             _cd.reset(new ProfileCollection(ns, options));
         } else if (options["partitioned"].trueValue()) {
             uassert(17266, "Partitioned Collection cannot be capped", !options["capped"].trueValue());
+            // expireAfterSeconds and partitionIntervalSeconds are read by the TTL monitor,
+            // which adds and drops partitions of such collections on a schedule
+            BSONElement expire = options["expireAfterSeconds"];
+            uassert(17376, "expireAfterSeconds must be a positive number",
+                    expire.eoo() || (expire.isNumber() && expire.numberLong() > 0));
+            BSONElement interval = options["partitionIntervalSeconds"];
+            uassert(17377, "partitionIntervalSeconds must be a positive number and requires expireAfterSeconds",
+                    interval.eoo() || (!expire.eoo() && interval.isNumber() && interval.numberLong() > 0));
             _cd = PartitionedCollection::make(ns, options);
         } else if (options["capped"].trueValue()) {
             _cd.reset(new CappedCollection(ns, options));
@@ -611,7 +623,7 @@ namespace mongo {
     bool CollectionBase::findByPK(const BSONObj &key, BSONObj &result) const {
         TOKULOG(3) << "CollectionBase::findByPK looking for " << key << endl;
 
-        storage::Key sKey(key, NULL);
+        storage::Key sKey(key, NULL, getPKIndexBase().keyFormat());
         DBT key_dbt = sKey.dbt();
         DB *db = getPKIndexBase().db();
 
@@ -686,7 +698,7 @@ namespace mongo {
         storage::DBTArrays valArrays(n);
         uint32_t put_flags[n];
 
-        storage::Key sPK(pk, NULL);
+        storage::Key sPK(pk, NULL, getPKIndexBase().keyFormat());
         DBT src_key = storage::dbt_make(sPK.buf(), sPK.size());
         DBT src_val = storage::dbt_make(obj.objdata(), obj.objsize());
 
@@ -726,7 +738,7 @@ namespace mongo {
                 DBT_ARRAY *array = &keyArrays[i];
                 storage::dbt_array_clear_and_resize(array, idxKeys.size());
                 for (BSONObjSet::const_iterator it = idxKeys.begin(); it != idxKeys.end(); it++) {
-                    const storage::Key sKey(*it, &pk);
+                    const storage::Key sKey(*it, &pk, idx.keyFormat());
                     storage::dbt_array_push(array, sKey.buf(), sKey.size());
                 }
             }
@@ -766,7 +778,7 @@ namespace mongo {
         storage::DBTArrays keyArrays(n);
         uint32_t del_flags[n];
 
-        storage::Key sPK(pk, NULL);
+        storage::Key sPK(pk, NULL, getPKIndexBase().keyFormat());
         DBT src_key = storage::dbt_make(sPK.buf(), sPK.size());
         DBT src_val = storage::dbt_make(obj.objdata(), obj.objsize());
 
@@ -796,7 +808,7 @@ namespace mongo {
                 DBT_ARRAY *array = &keyArrays[i];
                 storage::dbt_array_clear_and_resize(array, idxKeys.size());
                 for (BSONObjSet::const_iterator it = idxKeys.begin(); it != idxKeys.end(); it++) {
-                    const storage::Key sKey(*it, &pk);
+                    const storage::Key sKey(*it, &pk, idx.keyFormat());
                     storage::dbt_array_push(array, sKey.buf(), sKey.size());
                 }
             }
@@ -858,7 +870,7 @@ namespace mongo {
         storage::DBTArrays valArrays(n);
         uint32_t update_flags[n];
 
-        storage::Key sPK(pk, NULL);
+        storage::Key sPK(pk, NULL, getPKIndexBase().keyFormat());
         DBT src_key = storage::dbt_make(sPK.buf(), sPK.size());
         DBT new_src_val = storage::dbt_make(newObj.objdata(), newObj.objsize());
         DBT old_src_val = storage::dbt_make(oldObj.objdata(), oldObj.objsize());
@@ -910,13 +922,13 @@ namespace mongo {
                 DBT_ARRAY *array = &keyArrays[i];
                 storage::dbt_array_clear_and_resize(array, newIdxKeys.size());
                 for (BSONObjSet::const_iterator it = newIdxKeys.begin(); it != newIdxKeys.end(); it++) {
-                    const storage::Key sKey(*it, &pk);
+                    const storage::Key sKey(*it, &pk, idx.keyFormat());
                     storage::dbt_array_push(array, sKey.buf(), sKey.size());
                 }
                 array = &keyArrays[i + n];
                 storage::dbt_array_clear_and_resize(array, oldIdxKeys.size());
                 for (BSONObjSet::const_iterator it = oldIdxKeys.begin(); it != oldIdxKeys.end(); it++) {
-                    const storage::Key sKey(*it, &pk);
+                    const storage::Key sKey(*it, &pk, idx.keyFormat());
                     storage::dbt_array_push(array, sKey.buf(), sKey.size());
                 }
             }
@@ -1188,9 +1200,9 @@ namespace mongo {
             const bool isPK = isPKIndex(idx);
 
             storage::Key leftSKey(ascending ? minKey : maxKey,
-                                  isPK ? NULL : &minKey);
+                                  isPK ? NULL : &minKey, idx.keyFormat());
             storage::Key rightSKey(ascending ? maxKey : minKey,
-                                   isPK ? NULL : &maxKey);
+                                   isPK ? NULL : &maxKey, idx.keyFormat());
             uint64_t loops_run;
             idx.optimize(leftSKey, rightSKey, true, 0, &loops_run);
             return false;
@@ -1741,6 +1753,13 @@ namespace mongo {
         verify(opened);
     }
 
+    bool bulkLoadable(const StringData &ns, const BSONObj &options) {
+        return !NamespaceString::isSystem(ns) &&
+               !options["capped"].trueValue() &&
+               !options["natural"].trueValue() &&
+               !options["partitioned"].trueValue();
+    }
+
     void commitBulkLoad(const StringData &ns) {
         CollectionMap *cm = collectionMap(ns);
         const bool closed = cm->close_ns(ns);
@@ -2598,7 +2617,7 @@ namespace mongo {
     void BulkLoadedCollection::insertObject(BSONObj &obj, uint64_t flags, bool* indexBitChanged) {
         const BSONObj pk = getValidatedPKFromObject(obj);
 
-        storage::Key sPK(pk, NULL);
+        storage::Key sPK(pk, NULL, getPKIndexBase().keyFormat());
         DBT key = storage::dbt_make(sPK.buf(), sPK.size());
         DBT val = storage::dbt_make(obj.objdata(), obj.objsize());
         const int r = _loader->put(&key, &val);
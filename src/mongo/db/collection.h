@@ -79,6 +79,9 @@ namespace mongo {
     // To begin a load, the ns must exist and be empty.
     void beginBulkLoad(const StringData &ns, const vector<BSONObj> &indexes,
                        const BSONObj &options);
+    // Whether a new collection with these options can be bulk loaded: the restrictions
+    // beginBulkLoad enforces, plus partitioned collections, which aren't IndexedCollections.
+    bool bulkLoadable(const StringData &ns, const BSONObj &options);
     void commitBulkLoad(const StringData &ns);
     void abortBulkLoad(const StringData &ns);
 
@@ -372,10 +375,6 @@ namespace mongo {
             return _queryCache;
         }
 
-        void notifyOfWriteOp() {
-            _queryCache.notifyOfWriteOp();
-        }
-
         //
         // Simple collection metadata - common to all collections.
         //
@@ -66,8 +66,17 @@ namespace mongo {
         }
     }
 
+    static BSONObj metadbKeyPattern() {
+        return BSON("ns" << 1);
+    }
+
+    // The format of the metadb's { ns: <namespace> } keys, as its descriptor records it.
+    static storage::KeyFormat metadbKeyFormat() {
+        return Descriptor(metadbKeyPattern()).keyFormat();
+    }
+
     NOINLINE_DECL void CollectionMap::_init(bool may_create) {
-        const BSONObj keyPattern = BSON("ns" << 1 );
+        const BSONObj keyPattern = metadbKeyPattern();
         const BSONObj info = BSON("key" << keyPattern);
         Descriptor descriptor(keyPattern);
 
@@ -176,7 +185,7 @@ namespace mongo {
             cl->close();
         }
 
-        storage::Key sKey(nsobj, NULL);
+        storage::Key sKey(nsobj, NULL, metadbKeyFormat());
         DBT ndbt = sKey.dbt();
         DB *db = _metadb->db();
         int r = db->del(db, cc().txn().db_txn(), &ndbt, 0);
@@ -201,7 +210,7 @@ namespace mongo {
         verify(allocated());
         BSONObj serialized;
         BSONObj nsobj = BSON("ns" << ns);
-        storage::Key sKey(nsobj, NULL);
+        storage::Key sKey(nsobj, NULL, metadbKeyFormat());
         DBT ndbt = sKey.dbt();
 
         // If this transaction is read only, then we cannot possible already
@@ -291,7 +300,7 @@ namespace mongo {
         rollback.noteNs(ns);
 
         BSONObj nsobj = BSON("ns" << ns);
-        storage::Key sKey(nsobj, NULL);
+        storage::Key sKey(nsobj, NULL, metadbKeyFormat());
         DBT ndbt = sKey.dbt();
         DBT ddbt = storage::dbt_make(serialized.objdata(), serialized.objsize());
         DB *db = _metadb->db();
@@ -20,6 +20,9 @@
 
 #include "mongo/db/commands/mr.h"
 
+#include <boost/thread/thread.hpp>
+#include <queue>
+
 #include "mongo/util/scopeguard.h"
 
 #include "mongo/client/connpool.h"
@@ -30,8 +33,12 @@
 #include "mongo/db/instance.h"
 #include "mongo/db/kill_current_op.h"
 #include "mongo/db/matcher.h"
+#include "mongo/db/parallel_scan.h"
+#include "mongo/db/parsed_query.h"
+#include "mongo/db/pipeline/spill_file.h"
 #include "mongo/db/query_optimizer.h"
 #include "mongo/db/replutil.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/ops/insert.h"
 #include "mongo/db/ops/update.h"
 #include "mongo/scripting/engine.h"
@@ -44,6 +51,10 @@ namespace mongo {
 
     namespace mr {
 
+        // Number of threads a mapReduce may run its map stage on.  Only used when the input is
+        // a big enough scan of the primary key, see ParallelMap.
+        MONGO_EXPORT_SERVER_PARAMETER(mapReduceThreads, int, 1);
+
         AtomicUInt Config::JOB_NUMBER;
 
         JSFunction::JSFunction( const std::string& type , const BSONElement& e ) {
@@ -607,6 +618,7 @@ namespace mongo {
                 _useIncremental(true),
                 _size(0),
                 _dupCount(0),
+                _spillToFile(false),
                 _numEmits(0) {
             _temp.reset( new InMemory() );
             _onDisk = _config.outputOptions.outType != Config::INMEMORY;
@@ -975,9 +987,26 @@ namespace mongo {
         }
 
         /**
-         * Dumps the entire in memory map to the inc collection.
+         * Dumps the entire in memory map to the inc collection,
+         * or to the SpillFile as one sorted run.
          */
         void State::dumpToInc() {
+            if ( _spillToFile ) {
+                if ( ! _spill )
+                    _spill.reset( new SpillFile() );
+
+                // the map is ordered by key, so this makes a sorted run
+                for ( InMemory::iterator i=_temp->begin(); i!=_temp->end(); i++ ) {
+                    BSONList& all = i->second;
+                    for ( BSONList::iterator j=all.begin(); j!=all.end(); j++ )
+                        _spill->write( *j );
+                }
+                _spill->endRun();
+                _temp->clear();
+                _size = 0;
+                return;
+            }
+
             if ( ! _onDisk )
                 return;
 
@@ -997,6 +1026,35 @@ namespace mongo {
 
         }
 
+        void State::releaseOutput( scoped_ptr<InMemory>& temp , scoped_ptr<SpillFile>& spill ) {
+            temp.swap( _temp );
+            _temp.reset( new InMemory() );
+            _size = 0;
+            _dupCount = 0;
+            spill.swap( _spill );
+            _spill.reset();
+        }
+
+        void State::reduceMerged( BSONList& values ) {
+            if ( values.empty() )
+                return;
+
+            if ( _onDisk ) {
+                finalReduce( values );
+                return;
+            }
+
+            if ( values.size() == 1 )
+                _add( _temp.get() , values[0] , _size );
+            else
+                _add( _temp.get() , _config.reducer->reduce( values ) , _size );
+        }
+
+        void State::addWorkerCounts( long long emits , long long reduces ) {
+            _numEmits += emits;
+            _config.reducer->numReduces += reduces;
+        }
+
         /**
          * Adds object to in memory map
          */
@@ -1047,9 +1105,9 @@ namespace mongo {
                 LOG(1) << "  MR - did reduceInMemory: size=" << oldSize << " dups=" << _dupCount << " newSize=" << _size << " time=" << t.millis() << "ms" << endl;
 
                 // if size is still high, or values are not reducing well, dump
-                if ( _onDisk && (_size > _config.maxInMemSize || _size > oldSize / 2) ) {
+                if ( (_onDisk || _spillToFile) && (_size > _config.maxInMemSize || _size > oldSize / 2) ) {
                     dumpToInc();
-                    LOG(1) << "  MR - dumping to db" << endl;
+                    LOG(1) << "  MR - dumping to " << (_spillToFile ? "spill file" : "db") << endl;
                 }
             }
         }
@@ -1090,6 +1148,363 @@ namespace mongo {
             return BSONObj();
         }
 
+        // -------- ParallelMap ----------
+
+        struct ParallelMap::Worker {
+            Worker() : opNum(0) , numEmits(0) , numReduces(0) {}
+
+            unsigned opNum; // of the worker's CurOp once it has one, so that it can be killed
+            scoped_ptr<InMemory> output; // fully reduced in memory map, sorted by key
+            scoped_ptr<SpillFile> spill; // sorted runs it had no room for
+            long long numEmits;
+            long long numReduces;
+        };
+
+        /**
+         * Tuples {"0": key, "1": value} in key order, from one run of a SpillFile or from an
+         * in memory map.
+         */
+        class ParallelMap::TupleStream : boost::noncopyable {
+        public:
+            TupleStream( SpillFile& file , size_t run ) :
+                _reader( new SpillFile::Reader( file , run ) ) , _map( NULL ) {}
+            TupleStream( InMemory& map ) : _map( &map ) , _keys( map.begin() ) , _value( 0 ) {}
+
+            bool more() {
+                if ( _reader )
+                    return _reader->more();
+                while ( _keys != _map->end() && _value >= _keys->second.size() ) {
+                    ++_keys;
+                    _value = 0;
+                }
+                return _keys != _map->end();
+            }
+
+            BSONObj next() {
+                if ( _reader )
+                    return _reader->next().getOwned();
+                return _keys->second[_value++];
+            }
+
+        private:
+            scoped_ptr<SpillFile::Reader> _reader;
+            InMemory* _map;
+            InMemory::iterator _keys;
+            size_t _value;
+        };
+
+        namespace {
+
+            // the next tuple of each TupleStream, smallest key first
+            struct MergeHead {
+                MergeHead( const BSONObj& tuple , size_t stream ) : tuple( tuple ) , stream( stream ) {}
+                BSONObj tuple;
+                size_t stream;
+            };
+
+            struct MergeHeadGreater {
+                bool operator()( const MergeHead& l , const MergeHead& r ) const {
+                    return TupleKeyCmp()( r.tuple , l.tuple );
+                }
+            };
+
+        } // namespace
+
+        ParallelMap::ParallelMap( const string& dbname , const BSONObj& cmdObj ,
+                                  const vector<BSONObj>& splitKeys , int nThreads ) :
+            _dbname( dbname ) ,
+            _nThreads( nThreads ) ,
+            _rangesStarted( 0 ) ,
+            _workersRunning( 0 ) ,
+            _aborted( false ) ,
+            _errorCode( 0 ) {
+            verify( nThreads > 0 );
+
+            for ( vector<BSONObj>::const_iterator i = splitKeys.begin(); i != splitKeys.end(); ++i )
+                _splitKeys.push_back( i->getOwned() );
+
+            // each worker maps and reduces into memory, the output and finalize are ours
+            BSONObjBuilder b;
+            BSONObjIterator i( cmdObj );
+            while ( i.more() ) {
+                BSONElement e = i.next();
+                if ( str::equals( e.fieldName() , "out" ) ||
+                     str::equals( e.fieldName() , "finalize" ) ||
+                     str::equals( e.fieldName() , "shardedFirstPass" ) ||
+                     str::equals( e.fieldName() , "splitInfo" ) ||
+                     str::equals( e.fieldName() , "verbose" ) )
+                    continue;
+                b.append( e );
+            }
+            b.append( "out" , BSON( "inline" << 1 ) );
+            _workerCmd = b.obj();
+        }
+
+        ParallelMap::~ParallelMap() {
+        }
+
+        long long ParallelMap::numEmits() const {
+            long long n = 0;
+            for ( size_t i = 0; i < _workers.size(); i++ )
+                n += _workers[i]->numEmits;
+            return n;
+        }
+
+        long long ParallelMap::numReduces() const {
+            long long n = 0;
+            for ( size_t i = 0; i < _workers.size(); i++ )
+                n += _workers[i]->numReduces;
+            return n;
+        }
+
+        size_t ParallelMap::numSpilledRuns() const {
+            size_t n = 0;
+            for ( size_t i = 0; i < _workers.size(); i++ ) {
+                if ( _workers[i]->spill )
+                    n += _workers[i]->spill->numRuns();
+            }
+            return n;
+        }
+
+        long long ParallelMap::bytesSpilled() const {
+            long long n = 0;
+            for ( size_t i = 0; i < _workers.size(); i++ ) {
+                if ( _workers[i]->spill )
+                    n += _workers[i]->spill->bytesSpilled();
+            }
+            return n;
+        }
+
+        void ParallelMap::run( ProgressMeterHolder& pm ) {
+            // there is no point in having more workers than ranges
+            const size_t nWorkers = std::min( static_cast<size_t>( _nThreads ) , numRanges() );
+            for ( size_t i = 0; i < nWorkers; i++ )
+                _workers.push_back( shared_ptr<Worker>( new Worker() ) );
+
+            boost::thread_group threads;
+            try {
+                for ( size_t i = 0; i < nWorkers; i++ ) {
+                    {
+                        boost::unique_lock<boost::mutex> lock( _mutex );
+                        ++_workersRunning;
+                    }
+                    try {
+                        threads.create_thread( boost::bind( &ParallelMap::workerThread , this ,
+                                                            _workers[i].get() , i ) );
+                    }
+                    catch ( ... ) {
+                        boost::unique_lock<boost::mutex> lock( _mutex );
+                        --_workersRunning;
+                        throw;
+                    }
+                }
+
+                // wake up now and then to report progress and see if we were killed
+                long long reported = 0;
+                bool running = true;
+                while ( running ) {
+                    bool failed;
+                    {
+                        boost::unique_lock<boost::mutex> lock( _mutex );
+                        _doneCond.timed_wait( lock , boost::posix_time::milliseconds( 100 ) );
+                        running = _workersRunning > 0;
+                        failed = _aborted;
+                    }
+                    if ( failed ) {
+                        // don't wait for the others to get to the end of a range
+                        killWorkers();
+                    }
+
+                    const long long input = numInput();
+                    pm.hit( static_cast<int>( input - reported ) );
+                    reported = input;
+
+                    killCurrentOp.checkForInterrupt();
+                }
+            }
+            catch ( ... ) {
+                {
+                    boost::unique_lock<boost::mutex> lock( _mutex );
+                    _aborted = true;
+                }
+                killWorkers();
+                threads.join_all();
+                throw;
+            }
+            threads.join_all();
+
+            if ( ! _errorMessage.empty() )
+                uasserted( _errorCode , _errorMessage );
+        }
+
+        void ParallelMap::workerThread( Worker* worker , size_t id ) {
+            const string threadName = str::stream() << "mapReduce worker " << id;
+            Client::initThread( threadName.c_str() );
+
+            // a CurOp of our own lets run() kill the JavaScript we are running
+            cc().curop()->reset();
+            {
+                boost::unique_lock<boost::mutex> lock( _mutex );
+                worker->opNum = cc().curop()->opNum().get();
+            }
+
+            try {
+                Config config( _dbname , _workerCmd );
+                State state( config );
+                state.init();
+                state.spillToFile();
+
+                size_t range;
+                while ( nextRange( &range ) ) {
+                    mapRange( config , state , range );
+                }
+
+                if ( ! isAborted() ) {
+                    // leave a single value per key, for the merge
+                    state.reduceInMemory();
+                    worker->numEmits = state.numEmits();
+                    worker->numReduces = state.numReduces();
+                    state.releaseOutput( worker->output , worker->spill );
+                }
+            }
+            catch ( const DBException& e ) {
+                fail( e.getCode() , e.what() );
+            }
+            catch ( const std::exception& e ) {
+                fail( 17390 , str::stream() << "parallel map/reduce worker failed: " << e.what() );
+            }
+
+            cc().shutdown();
+
+            boost::unique_lock<boost::mutex> lock( _mutex );
+            if ( --_workersRunning == 0 )
+                _doneCond.notify_all();
+        }
+
+        void ParallelMap::mapRange( Config& config , State& state , size_t range ) {
+            BSONObjBuilder b;
+            b.append( "$query" , config.filter );
+            const BSONObj min = parallelScanMin( _splitKeys , range );
+            if ( ! min.isEmpty() )
+                b.append( "$min" , min );
+            const BSONObj max = parallelScanMax( _splitKeys , range );
+            if ( ! max.isEmpty() )
+                b.append( "$max" , max );
+
+            LOCK_REASON(lockReason, "m/r: parallel emit phase");
+            Client::ReadContext ctx( config.ns , lockReason );
+            Client::Transaction transaction( DB_TXN_SNAPSHOT | DB_TXN_READ_ONLY );
+
+            {
+                shared_ptr<ParsedQuery> pq( new ParsedQuery( config.ns.c_str() , 0 , 0 ,
+                                                             QueryOption_NoCursorTimeout ,
+                                                             b.obj() , BSONObj() ) );
+                shared_ptr<Cursor> temp = getOptimizedCursor( config.ns.c_str() , config.filter ,
+                                                              BSONObj() ,
+                                                              QueryPlanSelectionPolicy::any() , pq );
+                uassert( 17391 , str::stream() << "could not create cursor over " << config.ns
+                                               << " for query : " << config.filter
+                                               << " in range [" << min << ", " << max << ")" ,
+                         temp.get() );
+                ClientCursor::Holder cursor( new ClientCursor( QueryOption_NoCursorTimeout ,
+                                                               temp ,
+                                                               config.ns.c_str() ) );
+
+                long long n = 0;
+                for ( ; cursor->ok() ; cursor->advance() ) {
+                    if ( ! cursor->currentMatches() || cursor->currentIsDup() )
+                        continue;
+
+                    config.mapper->map( cursor->current() );
+                    state.checkSize();
+                    _numInput.fetchAndAdd( 1 );
+
+                    if ( ( ++n % 128 ) == 0 ) {
+                        killCurrentOp.checkForInterrupt();
+                        if ( isAborted() )
+                            break;
+                    }
+                }
+            }
+            transaction.commit();
+        }
+
+        bool ParallelMap::nextRange( size_t* range ) {
+            boost::unique_lock<boost::mutex> lock( _mutex );
+            if ( _aborted || _rangesStarted >= numRanges() )
+                return false;
+            *range = _rangesStarted++;
+            return true;
+        }
+
+        void ParallelMap::fail( int code , const string& message ) {
+            boost::unique_lock<boost::mutex> lock( _mutex );
+            if ( _errorMessage.empty() ) {
+                _errorCode = ( code != 0 ? code : 17390 );
+                _errorMessage = message;
+            }
+            _aborted = true;
+        }
+
+        bool ParallelMap::isAborted() {
+            boost::unique_lock<boost::mutex> lock( _mutex );
+            return _aborted;
+        }
+
+        void ParallelMap::killWorkers() {
+            vector<unsigned> opNums;
+            {
+                boost::unique_lock<boost::mutex> lock( _mutex );
+                for ( size_t i = 0; i < _workers.size(); i++ ) {
+                    if ( _workers[i]->opNum != 0 )
+                        opNums.push_back( _workers[i]->opNum );
+                }
+            }
+            // a worker that already finished has no op left to kill
+            for ( size_t i = 0; i < opNums.size(); i++ )
+                killCurrentOp.kill( AtomicUInt( opNums[i] ) );
+        }
+
+        void ParallelMap::merge( State& state , ProgressMeterHolder& pm ) {
+            vector< shared_ptr<TupleStream> > streams;
+            for ( size_t i = 0; i < _workers.size(); i++ ) {
+                Worker& worker = *_workers[i];
+                if ( worker.spill ) {
+                    for ( size_t run = 0; run < worker.spill->numRuns(); run++ )
+                        streams.push_back( shared_ptr<TupleStream>( new TupleStream( *worker.spill , run ) ) );
+                }
+                if ( worker.output )
+                    streams.push_back( shared_ptr<TupleStream>( new TupleStream( *worker.output ) ) );
+            }
+
+            std::priority_queue< MergeHead , vector<MergeHead> , MergeHeadGreater > heap;
+            for ( size_t i = 0; i < streams.size(); i++ ) {
+                if ( streams[i]->more() )
+                    heap.push( MergeHead( streams[i]->next() , i ) );
+            }
+
+            TupleKeyCmp keyLess;
+            BSONList values;
+            while ( ! heap.empty() ) {
+                MergeHead head = heap.top();
+                heap.pop();
+                if ( streams[head.stream]->more() )
+                    heap.push( MergeHead( streams[head.stream]->next() , head.stream ) );
+
+                if ( ! values.empty() && keyLess( values[0] , head.tuple ) ) {
+                    // every value for the previous key has been seen
+                    state.reduceMerged( values );
+                    values.clear();
+                    killCurrentOp.checkForInterrupt();
+                }
+                values.push_back( head.tuple );
+                pm.hit();
+            }
+            state.reduceMerged( values );
+
+            pm.finished();
+        }
+
         /**
          * This class represents a map/reduce command executed on a single server
          */
@@ -1152,6 +1567,15 @@ namespace mongo {
                 BSONObjBuilder countsBuilder;
                 BSONObjBuilder timingBuilder;
 
+                // A big scan of the primary key can be mapped on several threads.  This must be
+                // planned before our transaction starts, the workers read snapshots of their own.
+                const int nThreads = mapReduceThreads;
+                vector<BSONObj> splitKeys;
+                const bool parallel = ! chunkManager && ! config.jsMode &&
+                                      config.sort.isEmpty() && config.limit == 0 &&
+                                      splitForParallelScan( config.ns , config.filter ,
+                                                            nThreads , &splitKeys );
+
                 try {
                     Client::Transaction transaction(DB_TXN_SNAPSHOT);
                     {
@@ -1171,6 +1595,10 @@ namespace mongo {
                         }
                         
                         state.init();
+                        if ( parallel ) {
+                            // the workers spill to files, the inc collection isn't needed
+                            state._useIncremental = false;
+                        }
                         state.prepTempCollection();
                         ON_BLOCK_EXIT_OBJ(state, &State::dropTempCollections);
 
@@ -1193,7 +1621,16 @@ namespace mongo {
 
                         wassert( config.limit < 0x4000000 ); // see case on next line to 32 bit unsigned
                         long long mapTime = 0;
-                        {
+                        scoped_ptr<ParallelMap> parallelMap;
+                        if ( parallel ) {
+                            parallelMap.reset( new ParallelMap( dbname , cmd , splitKeys ,
+                                                                nThreads ) );
+                            parallelMap->run( pm );
+                            num = parallelMap->numInput();
+                            state.addWorkerCounts( parallelMap->numEmits() ,
+                                                   parallelMap->numReduces() );
+                        }
+                        else {
                             LOCK_REASON(lockReason, "m/r: emit phase");
                             Client::ReadContext ctx(config.ns, lockReason);
 
@@ -1255,20 +1692,41 @@ namespace mongo {
                         op->setMessage("m/r: (2/3) final reduce in memory",
                                        "M/R: (2/3) Final In-Memory Reduce Progress");
                         Timer rt;
-                        // do reduce in memory
-                        // this will be the last reduce needed for inline mode
-                        state.reduceInMemory();
-                        // if not inline: dump the in memory map to inc collection, all data is on disk
-                        state.dumpToInc();
-                        // final reduce
-                        state.finalReduce( op , pm );
+                        if ( parallelMap ) {
+                            op->setMessage("m/r: (2/3) merge",
+                                           "M/R: (2/3) Merge Progress");
+                            // reduces each key into the temp collection, or into memory if inline
+                            parallelMap->merge( state , pm );
+                            timingBuilder.appendNumber( "mergeTime" , rt.millis() );
+                            timingBuilder.appendNumber( "threads" , parallelMap->numThreads() );
+                            timingBuilder.appendNumber( "ranges" , parallelMap->numRanges() );
+                            timingBuilder.appendNumber( "spilledRuns" ,
+                                                        parallelMap->numSpilledRuns() );
+                            timingBuilder.appendNumber( "spilledBytes" ,
+                                                        parallelMap->bytesSpilled() );
+                            parallelMap.reset();
+                            // finalize for inline mode
+                            if ( ! state.isOnDisk() )
+                                state.finalReduce( op , pm );
+                        }
+                        else {
+                            // do reduce in memory
+                            // this will be the last reduce needed for inline mode
+                            state.reduceInMemory();
+                            // if not inline: dump the in memory map to inc collection, all data is on disk
+                            state.dumpToInc();
+                            // final reduce
+                            state.finalReduce( op , pm );
+                        }
                         inReduce += rt.micros();
                         countsBuilder.appendNumber( "reduce" , state.numReduces() );
                         timingBuilder.appendNumber( "reduceTime" , inReduce / 1000 );
                         timingBuilder.append( "mode" , state.jsMode() ? "js" : "mixed" );
 
+                        Timer ppt;
                         long long finalCount = state.postProcessCollection(op, pm);
                         state.appendResults( result );
+                        timingBuilder.appendNumber( "postProcessTime" , ppt.millis() );
 
                         timingBuilder.appendNumber( "total" , t.millis() );
                         result.appendNumber( "timeMillis" , t.millis() );
@@ -19,6 +19,8 @@
 #pragma once
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 #include <string>
 #include <vector>
 
@@ -26,10 +28,13 @@
 #include "mongo/db/curop.h"
 #include "mongo/db/instance.h"
 #include "mongo/db/jsobj.h"
+#include "mongo/platform/atomic_word.h"
 #include "mongo/scripting/engine.h"
 
 namespace mongo {
 
+    class SpillFile;
+
     namespace mr {
 
         typedef vector<BSONObj> BSONList;
@@ -251,7 +256,8 @@ namespace mongo {
             void reduceInMemory();
 
             /**
-             * transfers in memory storage to temp collection
+             * transfers in memory storage to temp collection,
+             * or to a sorted run of the SpillFile after spillToFile()
              */
             void dumpToInc();
             void insertToInc( BSONObj& o );
@@ -265,6 +271,29 @@ namespace mongo {
 
             void finalReduce( CurOp * op , ProgressMeterHolder& pm );
 
+            // ------ parallel map -----------
+
+            /**
+             * for the workers of a ParallelMap: when the in memory map gets too big, write it
+             * out as a sorted run of a SpillFile instead of to the inc collection
+             */
+            void spillToFile() { _spillToFile = true; }
+
+            /**
+             * hands the in memory map and the SpillFile, if anything was spilled, over to the
+             * caller, leaving this State empty
+             */
+            void releaseOutput( scoped_ptr<InMemory>& temp , scoped_ptr<SpillFile>& spill );
+
+            /**
+             * reduces all the values merged for one key: into the temp collection if the output
+             * is on disk, else into the in memory map, to be finalized by finalReduce()
+             */
+            void reduceMerged( BSONList& values );
+
+            /** counts the emits and reduces done by a ParallelMap's workers as our own */
+            void addWorkerCounts( long long emits , long long reduces );
+
             // ------- cleanup/data positioning ----------
 
             /**
@@ -323,6 +352,9 @@ namespace mongo {
             long _size; // bytes in _temp
             long _dupCount; // number of duplicate key entries
 
+            bool _spillToFile;
+            scoped_ptr<SpillFile> _spill;
+
             long long _numEmits;
 
             bool _jsMode;
@@ -332,6 +364,69 @@ namespace mongo {
             ScriptingFunction _reduceAndFinalizeAndInsert;
         };
 
+        /**
+         * Runs the map stage of a map/reduce on several threads.  Each worker takes ranges of
+         * the primary key (see splitForParallelScan()) in turn, and maps and reduces them with a
+         * Config, Scope and in memory map of its own, spilling sorted runs to a SpillFile when
+         * the map gets too big.  merge() then k-way merges all of that by key into a State.
+         *
+         * Only for the mixed (not jsMode) path, and for a map/reduce with no sort or limit.
+         */
+        class ParallelMap : boost::noncopyable {
+        public:
+            ParallelMap( const string& dbname , const BSONObj& cmdObj ,
+                         const vector<BSONObj>& splitKeys , int nThreads );
+            ~ParallelMap();
+
+            /**
+             * maps every range, returns once all the workers are done
+             * @param pm counts the input documents
+             */
+            void run( ProgressMeterHolder& pm );
+
+            /**
+             * merges the workers' output by key, and gives each key's values to
+             * State::reduceMerged()
+             */
+            void merge( State& state , ProgressMeterHolder& pm );
+
+            long long numInput() const { return _numInput.load(); }
+            long long numEmits() const;
+            long long numReduces() const;
+            size_t numSpilledRuns() const;
+            long long bytesSpilled() const;
+            size_t numThreads() const { return _workers.size(); }
+            size_t numRanges() const { return _splitKeys.size() + 1; }
+
+        private:
+            struct Worker;
+            class TupleStream;
+
+            void workerThread( Worker* worker , size_t id );
+            void mapRange( Config& config , State& state , size_t range );
+            bool nextRange( size_t* range );
+            void fail( int code , const string& message );
+            bool isAborted();
+            void killWorkers();
+
+            const string _dbname;
+            BSONObj _workerCmd;
+            vector<BSONObj> _splitKeys;
+            const int _nThreads;
+
+            vector< shared_ptr<Worker> > _workers;
+            AtomicUInt64 _numInput;
+
+            // protects everything below, and the opNum of each Worker
+            boost::mutex _mutex;
+            boost::condition_variable _doneCond;
+            size_t _rangesStarted;
+            int _workersRunning;
+            bool _aborted;
+            int _errorCode;
+            string _errorMessage;
+        };
+
         BSONObj fast_emit( const BSONObj& args, void* data );
         BSONObj _bailFromJS( const BSONObj& args, void* data );
 
@@ -72,6 +72,7 @@ namespace mongo {
         bool fastmodinsert;  // upsert of an $operation. builds a default object
         bool upsert;         // true if the update actually did an insert
         int keyUpdates;
+        BSONObj appliedSnapshot; // replicated state read by an $appliedSnapshot query
 
         // error handling
         ExceptionInfo exceptionInfo;
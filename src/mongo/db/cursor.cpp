@@ -138,7 +138,7 @@ namespace mongo {
         IndexCursor(cl, idx, startKey, endKey, endKeyInclusive, 1, 0),
         _bufferedRowCount(0),
         _exhausted(false),
-        _endSKeyPrefix(_endKey, NULL) {
+        _endSKeyPrefix(_endKey, NULL, idx.keyFormat()) {
         TOKULOG(3) << toString() << ": constructor: bounds " << prettyIndexBounds() << endl;
         checkAssumptionsAndInit();
     }
@@ -150,7 +150,7 @@ namespace mongo {
         IndexCursor(cl, idx, bounds, false, 1, 0),
         _bufferedRowCount(0),
         _exhausted(false),
-        _endSKeyPrefix(_endKey, NULL) {
+        _endSKeyPrefix(_endKey, NULL, idx.keyFormat()) {
         TOKULOG(3) << toString() << ": constructor: bounds " << prettyIndexBounds() << endl;
         dassert(_startKey == bounds->startKey());
         dassert(_endKey == bounds->endKey());
@@ -37,7 +37,7 @@ namespace mongo {
      * concept and is for the user's cursor.
      *
      * WARNING concurrency: the vfunctions below are called back from within a
-     * ClientCursor::ccmutex.  Don't cause a deadlock, you've been warned.
+     * ClientCursor stripe mutex.  Don't cause a deadlock, you've been warned.
      */
     class Cursor : boost::noncopyable {
     public:
@@ -235,6 +235,11 @@ namespace mongo {
         // only reset it fields if there is something in the buffer.
         void empty();
 
+        // Appends the keys and primary keys of up to n rows, starting with the
+        // current one, to keys and pks. Only meaningful for rows of a secondary
+        // index.
+        void peekKeys(size_t n, vector<BSONObj> &keys, vector<BSONObj> &pks) const;
+
     private:
         class HeaderBits {
         public:
@@ -343,6 +348,11 @@ namespace mongo {
 
         /** Get the current key/pk/obj from the row buffer and set _currKey/PK/Obj */
         void getCurrentFromBuffer();
+        /** Look up _currObj by _currPK, prefetching the documents of the rows buffered after it */
+        bool findCurrentByPK();
+        void prefetchBufferedDocs();
+        /** @return true if a row with this key could be returned without passing the end key */
+        bool withinEndKey(const BSONObj &key) const;
         /** Advance the internal DBC, not updating nscanned or checking the key against our bounds. */
         void _advance();
 
@@ -434,6 +444,14 @@ namespace mongo {
         RowBuffer _buffer;
         int _getf_iteration;
 
+        // Documents for the pks of upcoming rows in _buffer, looked up in pk order
+        // when a non-clustering secondary index row first needs its document.
+        // An empty document means it wasn't found. Cleared whenever _buffer is.
+        typedef map<BSONObj, BSONObj, BSONObjCmp> PrefetchMap;
+        PrefetchMap _prefetched;
+        // How many buffered rows the next prefetch looks at, doubled each time.
+        int _prefetchRows;
+
         // for interrupt checking
         ExceptionSaver _interrupt_extra;
 
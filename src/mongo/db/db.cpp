@@ -56,8 +56,10 @@
 #include "mongo/db/ttl.h"
 #include "mongo/db/txn_complete_hooks.h"
 #include "mongo/plugins/loader.h"
+#include "mongo/s/d_logic.h"
 #include "mongo/s/d_writeback.h"
 #include "mongo/scripting/engine.h"
+#include "mongo/util/processinfo.h"
 #include "mongo/util/background.h"
 #include "mongo/util/concurrency/task.h"
 #include "mongo/util/exception_filter_win32.h"
@@ -97,6 +99,8 @@ namespace mongo {
     CmdLine cmdLine;
     static bool scriptingEnabled = true;
     static bool noHttpInterface = false;
+    static bool asyncConnections = false;
+    static int connectionWorkers = 0;
     bool shouldRepairDatabases = 0;
     Timer startupSrandTimer;
 
@@ -176,6 +180,25 @@ namespace mongo {
             Client::initThread("conn", p);
         }
 
+        virtual ConnectionState* detach( AbstractMessagingPort* p ) {
+            Client* c = currentClient.get();
+            if ( c && c->hasTxn() ) {
+                // multi-statement transactions and bulk loads stay on the thread that began them
+                return NULL;
+            }
+            return new State( currentClient.release(), ShardedConnectionInfo::release() );
+        }
+
+        virtual void attach( ConnectionState* s ) {
+            scoped_ptr<State> state( static_cast<State*>( s ) );
+            verify( ! currentClient.get() );
+            currentClient.reset( state->client.release() );
+            ShardedConnectionInfo::set( state->shardedInfo.release() );
+            if ( currentClient.get() ) {
+                setThreadName( cc().desc().c_str() );
+            }
+        }
+
         virtual void process( Message& m , AbstractMessagingPort* port , LastError * le) {
             while ( true ) {
                 if ( inShutdown() ) {
@@ -229,6 +252,13 @@ namespace mongo {
             if( c ) c->shutdown();
         }
 
+    private:
+        class State : public ConnectionState {
+        public:
+            State( Client* c, ShardedConnectionInfo* info ) : client( c ), shardedInfo( info ) {}
+            auto_ptr<Client> client;
+            auto_ptr<ShardedConnectionInfo> shardedInfo;
+        };
     };
 
     void logStartup() {
@@ -261,6 +291,8 @@ namespace mongo {
         MessageServer::Options options;
         options.port = port;
         options.ipList = cmdLine.bind_ip;
+        options.async = asyncConnections;
+        options.workers = connectionWorkers;
 
         MessageServer * server = createServer( options , new MyMessageHandler() );
         server->setAsTimeTracker();
@@ -839,6 +871,8 @@ static void buildOptionsDescriptions(po::options_description *pVisible,
     ("checkpointPeriod", po::value<uint32_t>(), "tokumx time between checkpoints, 0 means never checkpoint")
     ("cleanerIterations", po::value<uint32_t>(), "tokumx number of iterations per cleaner thread operation, 0 means never run")
     ("cleanerPeriod", po::value<uint32_t>(), "tokumx time between cleaner thread operations, 0 means never run")
+    ("connectionModel", po::value<string>(), "\"thread\" (default) serves each connection on its own thread, \"async\" polls idle connections and runs their requests on a pool of worker threads")
+    ("connectionWorkers", po::value<int>(), "size of the worker pool for --connectionModel async (default 4 per core)")
     ("cpu", "periodically show cpu and iowait utilization")
     ("dbpath", po::value<string>() , dbpathBuilder.str().c_str())
     ("diaglog", po::value<int>(), "0=off 1=W 2=R 3=both 7=W+some reads")
@@ -997,6 +1031,26 @@ static void processCommandLineOptions(const std::vector<std::string>& argv) {
         }
 #endif
 
+        if (params.count("connectionModel")) {
+            const string model = params["connectionModel"].as<string>();
+            if (model == "async") {
+                asyncConnections = true;
+            }
+            else if (model != "thread") {
+                out() << "--connectionModel must be \"thread\" or \"async\"" << endl;
+                dbexit( EXIT_BADOPTIONS );
+            }
+        }
+        if (params.count("connectionWorkers")) {
+            connectionWorkers = params["connectionWorkers"].as<int>();
+            if (connectionWorkers < 1) {
+                out() << "--connectionWorkers must be at least 1" << endl;
+                dbexit( EXIT_BADOPTIONS );
+            }
+        }
+        else {
+            connectionWorkers = 4 * std::max(1U, ProcessInfo().getNumCores());
+        }
         if (params.count("cpu")) {
             cmdLine.cpu = true;
         }
@@ -167,9 +167,10 @@ namespace mongo {
                 //
                 if ( cmdObj["j"].trueValue() || cmdObj["fsync"].trueValue()) {
                     // if there's a non-zero log flush period, transactions
-                    // do not fsync on commit and so we must do it here.
+                    // do not fsync on commit and so we must do it here,
+                    // sharing the flush with any other clients waiting on one.
                     if (cmdLine.logFlushPeriod != 0) {
-                        storage::log_flush();
+                        storage::group_log_flush();
                     }
                 }
 
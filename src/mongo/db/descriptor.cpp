@@ -26,19 +26,22 @@ namespace mongo {
                            const bool hashed,
                            const int hashSeed,
                            const bool sparse,
-                           const bool clustering) :
-        _data(NULL), _size(serializedSize(keyPattern)), _dataOwned(new char[_size]) {
+                           const bool clustering,
+                           const storage::KeyFormat::Version keyFormat,
+                           const int hashVersion) :
+        _data(NULL), _size(serializedSize(keyPattern, keyFormat)), _dataOwned(new char[_size]) {
         _data = _dataOwned.get();
 
         // Create a header and write it first.
         Header h(Ordering::make(keyPattern),
-                 hashed, sparse, clustering, hashSeed, keyPattern.nFields());
-        memcpy(_dataOwned.get(), &h, sizeof(Header));
+                 hashed ? hashVersion + 1 : 0, sparse, clustering, hashSeed, keyPattern.nFields(), keyFormat);
+        const size_t hSize = h.version >= Header::VERSION_2 ? FixedSize : FixedSizeV1;
+        memcpy(_dataOwned.get(), &h, hSize);
 
         // The offsets array is based after the header. It is an array of
         // size h.numFields, where each element is sizeof(uint32_t) bytes.
         // The fields array is based after the offsets array.
-        uint32_t *const offsetsBase = reinterpret_cast<uint32_t *>(_dataOwned.get() + sizeof(Header));
+        uint32_t *const offsetsBase = reinterpret_cast<uint32_t *>(_dataOwned.get() + hSize);
         char *const fieldsBase = reinterpret_cast<char *>(&offsetsBase[h.numFields]);
 
         // Write each field's offset and value into each array, respectively.
@@ -59,11 +62,13 @@ namespace mongo {
         _data(data), _size(size) {
         verify(_data != NULL);
         // Strictly greater, since there should be at least one field.
-        verify(_size > (size_t) FixedSize);
+        verify(_size > (size_t) FixedSizeV1);
+        verify(_size > headerSize());
     }
 
-    size_t Descriptor::serializedSize(const BSONObj &keyPattern) {
-        size_t size = FixedSize;
+    size_t Descriptor::serializedSize(const BSONObj &keyPattern,
+                                      const storage::KeyFormat::Version keyFormat) {
+        size_t size = Header::versionFor(keyFormat) >= Header::VERSION_2 ? FixedSize : FixedSizeV1;
         for (BSONObjIterator o(keyPattern); o.more(); ++o) {
             const BSONElement &e = *o;
             // Each field will take up 4 bytes in the offset array
@@ -71,7 +76,7 @@ namespace mongo {
             size += 4;
             size += strlen(e.fieldName()) + 1;
         }
-        verify(size > (size_t) FixedSize);
+        verify(size > (size_t) FixedSizeV1);
         return size;
     }
 
@@ -84,6 +89,18 @@ namespace mongo {
         return h.version;
     }
 
+    size_t Descriptor::headerSize() const {
+        return version() >= Header::VERSION_2 ? FixedSize : FixedSizeV1;
+    }
+
+    storage::KeyFormat Descriptor::keyFormat() const {
+        const Header &h(*reinterpret_cast<const Header *>(_data));
+        const storage::KeyFormat::Version v = h.version >= Header::VERSION_2
+                                              ? (storage::KeyFormat::Version) h.keyFormat
+                                              : storage::KeyFormat::V1;
+        return storage::KeyFormat(v, h.ordering);
+    }
+
     const Ordering &Descriptor::ordering() const {
         const Header &h(*reinterpret_cast<const Header *>(_data));
         return h.ordering;
@@ -91,7 +108,7 @@ namespace mongo {
 
     void Descriptor::fieldNames(vector<const char *> &fields) const {
         const Header &h(*reinterpret_cast<const Header *>(_data));
-        const uint32_t *const offsetsBase = reinterpret_cast<const uint32_t *>(_data + sizeof(Header));
+        const uint32_t *const offsetsBase = reinterpret_cast<const uint32_t *>(_data + headerSize());
         const char *const fieldsBase = reinterpret_cast<const char *>(offsetsBase + h.numFields);
         fields.resize(h.numFields);
         for (uint32_t i = 0; i < h.numFields; i++) {
@@ -120,9 +137,7 @@ namespace mongo {
         vector<const char *> fields;
         fieldNames(fields);
         if (h.hashed) {
-            // If we ever add new hash versions in the future, we'll need to add
-            // a hashVersion field to the descriptor and up the descriptor version.
-            const HashVersion hashVersion = 0;
+            const HashVersion hashVersion = h.hashed - 1;
             HashKeyGenerator generator(fields[0], h.hashSeed, hashVersion, h.sparse);
             generator.getKeys(obj, keys);
         } else {
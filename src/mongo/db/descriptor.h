@@ -39,7 +39,9 @@ namespace mongo {
                    const bool hashed = false,
                    const int hashSeed = 0,
                    const bool sparse = false,
-                   const bool clustering = false);
+                   const bool clustering = false,
+                   const storage::KeyFormat::Version keyFormat = storage::KeyFormat::V1,
+                   const int hashVersion = 0);
         // For interpretting a memory buffer as a descriptor.
         Descriptor(const char *data, const size_t size);
 
@@ -51,8 +53,15 @@ namespace mongo {
 
         DBT dbt() const;
 
+        // The key format this dictionary's keys are serialized in.
+        storage::KeyFormat keyFormat() const;
+
         int compareKeys(const storage::Key &key1, const storage::Key &key2) const {
-            return key1.woCompare(key2, ordering());
+            const Header &h(*reinterpret_cast<const Header *>(_data));
+            if (h.version >= Header::VERSION_2 && h.keyFormat == storage::KeyFormat::MEMCMP) {
+                return storage::Key::memcmpCompare(key1, key2);
+            }
+            return key1.woCompare(key2, h.ordering);
         }
 
         void generateKeys(const BSONObj &obj, BSONObjSet &keys) const;
@@ -64,38 +73,50 @@ namespace mongo {
             return h.clustering;
         }
 
-        static size_t serializedSize(const BSONObj &keyPattern);
+        static size_t serializedSize(const BSONObj &keyPattern,
+                                     storage::KeyFormat::Version keyFormat = storage::KeyFormat::V1);
 
     private:
         void fieldNames(vector<const char *> &fields) const;
 
+        // Size of the fixed header, which depends on the descriptor's version.
+        size_t headerSize() const;
+
 #pragma pack(1)
         // Descriptor format:
         //   [
         //     4 bytes: ordering,
         //     1 byte: version,
-        //     1 byte: hashed boolean,
+        //     1 byte: hashed, 0 if not hashed, otherwise one more than the hash version
+        //             (so a hash version 0 index, from before there were others, reads 1),
         //     1 byte: sparse boolean,
         //     1 byte: clustering boolean,
         //     4 bytes: hash seed integer,
         //     4 bytes: integer number of fields
+        //     1 byte: key format (storage::KeyFormat::Version), since version 2
         //     integer array: array of offsets into subsequent byte array for each field string
         //     byte array: array of null terminated field strings
         //   ]
         struct Header {
-        private:
             enum Version {
                 // Version 0 is kind of a fake version.
                 VERSION_0 = 0,
                 VERSION_1 = 1,
-                NEXT_VERSION = 2
+                // Adds the key format byte.
+                VERSION_2 = 2,
+                NEXT_VERSION = 3
             };
             static const int CURRENT_VERSION = (int) NEXT_VERSION - 1;
 
-        public:
-            Header(const Ordering &o, char h, char s, char c, int hs, uint32_t n)
-                : ordering(o), version((char) CURRENT_VERSION), hashed(h), sparse(s), clustering(c),
-                  hashSeed(hs), numFields(n) {
+            // V1 keys get a version 1 header, so that opening an existing dictionary doesn't
+            // upgrade its descriptor and older versions can still read it.
+            static int versionFor(const storage::KeyFormat::Version kf) {
+                return kf == storage::KeyFormat::V1 ? (int) VERSION_1 : CURRENT_VERSION;
+            }
+
+            Header(const Ordering &o, char h, char s, char c, int hs, uint32_t n, char kf)
+                : ordering(o), version((char) versionFor((storage::KeyFormat::Version) kf)),
+                  hashed(h), sparse(s), clustering(c), hashSeed(hs), numFields(n), keyFormat(kf) {
             }
 
             Ordering ordering;
@@ -105,10 +126,13 @@ namespace mongo {
             char clustering;
             int hashSeed;
             uint32_t numFields;
+            // Only valid if version >= VERSION_2, older headers end before it.
+            char keyFormat;
         };
 
         static const int FixedSize = sizeof(Header);
-        BOOST_STATIC_ASSERT(FixedSize == 16);
+        BOOST_STATIC_ASSERT(FixedSize == 17);
+        static const int FixedSizeV1 = 16;
 #pragma pack()
 
         const char *_data;
@@ -240,6 +240,9 @@ namespace mongo {
         if ( !_ancillaryInfo._oldPlan.isEmpty() ) {
             bob.append( "oldPlan", _ancillaryInfo._oldPlan );
         }
+        if ( !_ancillaryInfo._appliedSnapshot.isEmpty() ) {
+            bob.append( "appliedSnapshot", _ancillaryInfo._appliedSnapshot );
+        }
         bob.append( "server", server() );
         
         return bob.obj();
@@ -132,6 +132,7 @@ namespace mongo {
         /* Additional information describing the query. */
         struct AncillaryInfo {
             BSONObj _oldPlan;
+            BSONObj _appliedSnapshot;
         };
         void setAncillaryInfo( const AncillaryInfo &ancillaryInfo );
         
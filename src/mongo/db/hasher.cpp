@@ -23,28 +23,49 @@
 
 #include "mongo/db/hasher.h"
 #include "mongo/db/jsobj.h"
+#include "mongo/util/mongoutils/str.h"
 #include "mongo/util/startup_test.h"
+#include "third_party/murmurhash3/MurmurHash3.h"
 
 namespace mongo {
 
-    Hasher::Hasher( HashSeed seed ) : _seed( seed ) {
-        md5_init( &_md5State );
-        md5_append( &_md5State , reinterpret_cast< const md5_byte_t * >( & _seed ) , sizeof( _seed ) );
+    Hasher::Hasher( HashSeed seed , HashVersion version ) : _version( version ), _seed( seed ) {
+        if ( _version == HASH_VERSION_MD5 ) {
+            md5_init( &_md5State );
+            md5_append( &_md5State , reinterpret_cast< const md5_byte_t * >( & _seed ) , sizeof( _seed ) );
+        }
+        else {
+            massert( 17378 ,
+                     mongoutils::str::stream() << "unknown hash version " << _version ,
+                     _version == HASH_VERSION_MURMUR3 );
+        }
     }
 
     void Hasher::addData( const void * keyData , size_t numBytes ) {
-        md5_append( &_md5State , static_cast< const md5_byte_t * >( keyData ), numBytes );
+        if ( _version == HASH_VERSION_MD5 ) {
+            md5_append( &_md5State , static_cast< const md5_byte_t * >( keyData ), numBytes );
+        }
+        else {
+            _buf.appendBuf( keyData , numBytes );
+        }
     }
 
     void Hasher::finish( HashDigest out ) {
-        md5_finish( &_md5State , out );
+        if ( _version == HASH_VERSION_MD5 ) {
+            md5_finish( &_md5State , out );
+        }
+        else {
+            MurmurHash3_x64_128( _buf.buf() , _buf.len() , _seed , out );
+        }
     }
 
-    long long int BSONElementHasher::hash64( const BSONElement& e , HashSeed seed ){
-        scoped_ptr<Hasher> h( HasherFactory::createHasher( seed ) );
-        recursiveHash( h.get() , e , false );
+    long long int BSONElementHasher::hash64( const BSONElement& e , HashSeed seed ,
+                                             HashVersion version ){
+        // on the stack, this is called for every hashed key
+        Hasher h( seed , version );
+        recursiveHash( &h , e , false );
         HashDigest d;
-        h->finish(d);
+        h.finish(d);
         //HashDigest is actually 16 bytes, but we just get 8 via truncation
         // NOTE: assumes little-endian
         return *reinterpret_cast< long long int * >( d );
@@ -98,6 +119,8 @@ namespace mongo {
             // Hard-coded check to ensure the hash function is consistent across platforms
             BSONObj o = BSON( "check" << 42 );
             verify( BSONElementHasher::hash64( o.firstElement(), 0 ) == -944302157085130861LL );
+            verify( BSONElementHasher::hash64( o.firstElement(), 0, HASH_VERSION_MURMUR3 ) ==
+                    8715208212397937794LL );
         }
     } hasherUnitTest;
 }
@@ -25,6 +25,7 @@
 
 #include "mongo/pch.h"
 #include "mongo/bson/bsonelement.h"
+#include "mongo/bson/util/builder.h"
 #include "mongo/util/md5.hpp"
 
 namespace mongo {
@@ -33,10 +34,19 @@ namespace mongo {
     typedef int HashVersion;
     typedef unsigned char HashDigest[16];
 
+    /* Hash versions a hashed index may use.  Version 0 is MD5, which hashed shard keys
+     * depend on.  Version 1 is MurmurHash3 (x64, 128-bit), which is much cheaper to compute.
+     */
+    enum HashVersions {
+        HASH_VERSION_MD5 = 0,
+        HASH_VERSION_MURMUR3 = 1,
+        HASH_VERSION_MAX = HASH_VERSION_MURMUR3
+    };
+
     class Hasher : private boost::noncopyable {
     public:
 
-        explicit Hasher( HashSeed seed );
+        explicit Hasher( HashSeed seed , HashVersion version = HASH_VERSION_MD5 );
         ~Hasher() { };
 
         //pointer to next part of input key, length in bytes to read
@@ -47,8 +57,11 @@ namespace mongo {
         void finish( HashDigest out );
 
     private:
+        const HashVersion _version;
         md5_state_t _md5State;
         HashSeed _seed;
+        // MurmurHash3 isn't incremental, so the input is gathered here and hashed in finish()
+        StackBufBuilder _buf;
     };
 
     class HasherFactory : private boost::noncopyable  {
@@ -56,8 +69,8 @@ namespace mongo {
         /* Eventually this may be a more sophisticated factory
          * for creating other hashers, but for now use MD5.
          */
-        static Hasher* createHasher( HashSeed seed ) {
-            return new Hasher( seed );
+        static Hasher* createHasher( HashSeed seed , HashVersion version = HASH_VERSION_MD5 ) {
+            return new Hasher( seed , version );
         }
 
     private:
@@ -83,9 +96,11 @@ namespace mongo {
          * This function is used in the computation of hashed indexes
          * and hashed shard keys, and thus should not be changed unless
          * the associated "getKeys" and "makeSingleKey" method in the
-         * hashindex type is changed accordingly.
+         * hashindex type is changed accordingly.  "version" picks the hash
+         * function, see HashVersions; hashed shard keys always use MD5.
          */
-        static long long int hash64( const BSONElement& e , HashSeed seed );
+        static long long int hash64( const BSONElement& e , HashSeed seed ,
+                                     HashVersion version = HASH_VERSION_MD5 );
 
     private:
         BSONElementHasher();
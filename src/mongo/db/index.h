@@ -161,6 +161,11 @@ namespace mongo {
             return _clustering;
         }
 
+        /** @return the format this index's keys are stored in */
+        const storage::KeyFormat &keyFormat() const {
+            return _keyFormat;
+        }
+
         string toString() const {
             return _info.toString();
         }
@@ -250,6 +255,7 @@ namespace mongo {
         const bool _unique;
         const bool _sparse;
         const bool _clustering;
+        const storage::KeyFormat _keyFormat;
 
     private:
         mutable AccessStats _accessStats;
@@ -384,17 +390,11 @@ namespace mongo {
                 CallbackWrapper *t = static_cast<CallbackWrapper *>(thisv);
                 try {
                     if (endKeyDBT == NULL) {
-                        t->_cb(NULL, NULL, skipped);
+                        t->_cb(NULL, skipped);
                     }
-                    else {                
-                        storage::KeyV1 endKey(static_cast<char *>(endKeyDBT->data));
-                        if (endKey.dataSize() < (ssize_t) endKeyDBT->size) {
-                            BSONObj endPK(static_cast<char *>(endKeyDBT->data) + endKey.dataSize());
-                            t->_cb(&endKey, &endPK, skipped);
-                        }
-                        else {
-                            t->_cb(&endKey, NULL, skipped);
-                        }
+                    else {
+                        const storage::Key endKey(endKeyDBT);
+                        t->_cb(&endKey, skipped);
                     }
                 }
                 catch (std::exception &e) {
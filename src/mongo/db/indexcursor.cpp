@@ -23,6 +23,8 @@
 #include "mongo/db/jsobj.h"
 #include "mongo/db/queryutil.h"
 #include "mongo/db/collection.h"
+#include "mongo/base/units.h"
+#include "mongo/db/server_parameters.h"
 
 namespace mongo {
 
@@ -86,7 +88,7 @@ namespace mongo {
         }
 
         // Determine what to put in the header byte.
-        const bool hasPK = !sKey.pk().isEmpty();
+        const bool hasPK = sKey.hasPK();
         const bool hasObj = obj_size > 0;
         const unsigned char headerBits = (hasPK ? HeaderBits::hasPK : 0) | (hasObj ? HeaderBits::hasObj : 0);
         dassert(headerBits >= 1 && headerBits <= 3);
@@ -150,8 +152,39 @@ namespace mongo {
         }
     }
 
+    void RowBuffer::peekKeys(size_t n, vector<BSONObj> &keys, vector<BSONObj> &pks) const {
+        size_t offset = _current_offset;
+        for (size_t i = 0; i < n && offset < _end_offset; i++) {
+            const char headerBits = *(_buf + offset);
+            dassert(headerBits >= 1 && headerBits <= 3);
+            offset += 1;
+
+            storage::Key sKey(_buf + offset, headerBits & HeaderBits::hasPK);
+            keys.push_back(sKey.key());
+            pks.push_back(sKey.pk());
+            offset += sKey.size();
+
+            if (headerBits & HeaderBits::hasObj) {
+                BSONObj obj(_buf + offset);
+                offset += obj.objsize();
+            }
+        }
+        verify(offset <= _end_offset);
+    }
+
     /* ---------------------------------------------------------------------- */
 
+    // Maximum number of documents a secondary index cursor looks up at once, see
+    // IndexCursor::prefetchBufferedDocs(). 0 or 1 turns prefetching off.
+    MONGO_EXPORT_SERVER_PARAMETER(indexCursorPrefetchDocs, int, 256);
+
+    // Maximum size of the documents a secondary index cursor holds prefetched.
+    MONGO_EXPORT_SERVER_PARAMETER(indexCursorPrefetchBytes, BytesQuantity<uint64_t>, 1 << 20);
+
+    // The first prefetch of a cursor looks at this many rows; later ones double it, up to
+    // indexCursorPrefetchDocs, so a scan that stops early doesn't read much it won't return.
+    static const int initialPrefetchRows = 16;
+
     IndexCursor::IndexCursor( CollectionData *cl, const IndexDetails &idx,
                               const BSONObj &startKey, const BSONObj &endKey,
                               bool endKeyInclusive, int direction, int numWanted ) :
@@ -170,7 +203,9 @@ namespace mongo {
         _prelock(!cc().opSettings().getJustOne() && numWanted == 0),
         _tailable(false),
         _ok(false),
-        _getf_iteration(0)
+        _getf_iteration(0),
+        _prefetched(BSONObjCmp(cl->pkPattern())),
+        _prefetchRows(initialPrefetchRows)
     {
         verify( _cl != NULL );
         TOKULOG(3) << toString() << ": constructor: bounds " << prettyIndexBounds() << endl;
@@ -198,7 +233,9 @@ namespace mongo {
         _prelock(!cc().opSettings().getJustOne() && numWanted == 0),
         _tailable(false),
         _ok(false),
-        _getf_iteration(0)
+        _getf_iteration(0),
+        _prefetched(BSONObjCmp(cl->pkPattern())),
+        _prefetchRows(initialPrefetchRows)
     {
         verify( _cl != NULL );
         _boundsIterator.reset( new FieldRangeVectorIterator( *_bounds , singleIntervalLimit ) );
@@ -314,8 +351,8 @@ namespace mongo {
         const BSONObj &rightKey = forward() ? endKey : startKey; 
         dassert(leftKey.woCompare(rightKey, _ordering) <= 0);
 
-        storage::Key sKey(leftKey, isSecondary ? &minKey : NULL);
-        storage::Key eKey(rightKey, isSecondary ? &maxKey : NULL);
+        storage::Key sKey(leftKey, isSecondary ? &minKey : NULL, _idx.keyFormat());
+        storage::Key eKey(rightKey, isSecondary ? &maxKey : NULL, _idx.keyFormat());
         DBT start = sKey.dbt();
         DBT end = eKey.dbt();
 
@@ -507,9 +544,10 @@ namespace mongo {
 
         // Empty row buffer, reset fetch iteration, go get more rows.
         _buffer.empty();
+        _prefetched.clear();
         _getf_iteration = 0;
 
-        storage::Key sKey( key, !pk.isEmpty() ? &pk : NULL );
+        storage::Key sKey( key, !pk.isEmpty() ? &pk : NULL, _idx.keyFormat() );
         DBT key_dbt = sKey.dbt();;
 
         int r;
@@ -692,24 +730,30 @@ again:      while ( !allInclusive && ok() ) {
         return false;
     }
 
+    bool IndexCursor::withinEndKey( const BSONObj &key ) const {
+        if ( _endKey.isEmpty() ) {
+            return true;
+        }
+        const int cmp = _endKey.woCompare( key, _ordering );
+        const int sign = cmp == 0 ? 0 : (cmp > 0 ? 1 : -1);
+        return !( (sign != 0 && sign != _direction) || (sign == 0 && !_endKeyInclusive) );
+    }
+
     // Check if the current key is beyond endKey.
     void IndexCursor::checkEnd() {
         if ( !ok() ) {
             return;
         }
-        if ( !_endKey.isEmpty() ) {
-            const int cmp = _endKey.woCompare( _currKey, _ordering );
-            const int sign = cmp == 0 ? 0 : (cmp > 0 ? 1 : -1);
-            if ( (sign != 0 && sign != _direction) || (sign == 0 && !_endKeyInclusive) ) {
-                _ok = false;
-                TOKULOG(3) << toString() << ": checkEnd() stopping @ curr, end: " << _currKey << _endKey << endl;
-            }
+        if ( !withinEndKey( _currKey ) ) {
+            _ok = false;
+            TOKULOG(3) << toString() << ": checkEnd() stopping @ curr, end: " << _currKey << _endKey << endl;
         }
     }
 
     bool IndexCursor::fetchMoreRows() {
         // We're going to get more rows, so get rid of what's there.
         _buffer.empty();
+        _prefetched.clear();
 
         int r;
         const int rows_to_fetch = getf_fetch_count();
@@ -795,7 +839,7 @@ again:      while ( !allInclusive && ok() ) {
         // with the full document on the first call to current().
         if ( _currObj.isEmpty() ) {
             _nscannedObjects++;
-            bool found = _cl->findByPK( _currPK, _currObj );
+            bool found = findCurrentByPK();
             if ( !found ) {
                 // If we didn't find the associated object, we must be either:
                 // - a snapshot transaction whose context deleted the current pk
@@ -804,7 +848,7 @@ again:      while ( !allInclusive && ok() ) {
                 TOKULOG(4) << "current() did not find associated object for pk " << _currPK << endl;
                 advance();
                 if ( ok() ) {
-                    found = _cl->findByPK( _currPK, _currObj );
+                    found = findCurrentByPK();
                     uassert( 16741, str::stream()
                                 << toString() << ": could not find associated document with pk "
                                 << _currPK << ", index key " << _currKey, found );
@@ -821,6 +865,79 @@ again:      while ( !allInclusive && ok() ) {
         return _currObj;
     }
 
+    bool IndexCursor::findCurrentByPK() {
+        PrefetchMap::const_iterator it = _prefetched.find( _currPK );
+        if ( it == _prefetched.end() ) {
+            prefetchBufferedDocs();
+            it = _prefetched.find( _currPK );
+        }
+        if ( it != _prefetched.end() && !it->second.isEmpty() ) {
+            _currObj = it->second;
+            return true;
+        }
+        return _cl->findByPK( _currPK, _currObj );
+    }
+
+    // A range scan over a non-clustering secondary index needs one primary key
+    // lookup per row, in index order, which is random order in the primary key
+    // dictionary. When a row's document is first needed, look up the documents
+    // for it and the rows buffered after it together, sorted by primary key, so
+    // the primary key dictionary's nodes are read in order and each only once per
+    // batch. Only read-only cursors bulk fetch more than one row at a time, so
+    // the prefetched documents can't be changed underneath us by the caller.
+    //
+    // Rows past the end key, out of bounds, or ruled out by the key matcher
+    // won't need their documents, so they're skipped. How many rows are looked
+    // at grows with each prefetch, and the documents kept stop at
+    // indexCursorPrefetchBytes; the rest are looked up when they're reached.
+    void IndexCursor::prefetchBufferedDocs() {
+        _prefetched.clear();
+        const int maxRows = indexCursorPrefetchDocs;
+        if ( maxRows <= 1 ) {
+            return;
+        }
+        const int rows = std::min( _prefetchRows, maxRows );
+        _prefetchRows = std::min( rows * 2, maxRows );
+
+        vector<BSONObj> keys;
+        vector<BSONObj> pks;
+        _buffer.peekKeys( rows, keys, pks );
+
+        const CoveredIndexMatcher *keyMatcher = ( _matcher && !_multiKey ) ? _matcher.get() : NULL;
+        // The first row is the current one, which needs its document regardless.
+        for ( size_t i = 0; i < pks.size(); ++i ) {
+            if ( i > 0 ) {
+                if ( !withinEndKey( keys[i] ) ) {
+                    break;
+                }
+                if ( _bounds && !_bounds->matchesKey( keys[i] ) ) {
+                    continue;
+                }
+                if ( keyMatcher != NULL && !keyMatcher->keyMatches( keys[i] ) ) {
+                    continue;
+                }
+            }
+            _prefetched.insert( make_pair( pks[i].getOwned(), BSONObj() ) );
+        }
+        if ( _prefetched.size() <= 1 ) {
+            _prefetched.clear();
+            return;
+        }
+
+        const uint64_t maxBytes = indexCursorPrefetchBytes;
+        uint64_t bytes = 0;
+        PrefetchMap::iterator i = _prefetched.begin();
+        for ( ; i != _prefetched.end() && bytes < maxBytes; ++i ) {
+            BSONObj obj;
+            if ( _cl->findByPK( i->first, obj ) ) {
+                i->second = obj.getOwned();
+                bytes += i->second.objsize();
+            }
+        }
+        // Forget the rows we didn't get to, so they're looked up again when reached.
+        _prefetched.erase( i, _prefetched.end() );
+    }
+
     bool IndexCursor::currentMatches( MatchDetails *details ) {
          // If currKey() might not match the specified _bounds, check whether or not it does.
          if ( !_boundsMustMatch && _bounds && !_bounds->matchesKey( currKey() ) ) {
@@ -34,8 +34,9 @@ namespace mongo {
     long long int HashKeyGenerator::makeSingleKey(const BSONElement &e,
                                                   const HashSeed &seed,
                                                   const HashVersion &v) {
-        massert( 16245, "Only HashVersion 0 has been defined", v == 0 );
-        return BSONElementHasher::hash64( e , seed );
+        massert( 16245, "Only HashVersions 0 and 1 have been defined",
+                 v >= 0 && v <= HASH_VERSION_MAX );
+        return BSONElementHasher::hash64( e , seed , v );
     }
 
     void HashKeyGenerator::getKeys(const BSONObj &obj, BSONObjSet &keys) {
@@ -578,6 +578,7 @@ namespace mongo {
         while ( i.more() ) {
             parseMatchExpressionElement( i.next(), nested );
         }
+        compile();
     }
 
     Matcher::Matcher( const Matcher &docMatcher, const BSONObj &key ) :
@@ -634,6 +635,116 @@ namespace mongo {
         for( list< shared_ptr< Matcher > >::const_iterator i = docMatcher._orMatchers.begin(); i != docMatcher._orMatchers.end(); ++i ) {
             _orMatchers.push_back( shared_ptr< Matcher >( new Matcher( **i, key ) ) );
         }
+        compile();
+    }
+
+    namespace {
+        /** Rough relative cost of evaluating a basic predicate on one value. */
+        int predicateCost( int compareOp ) {
+            switch ( compareOp ) {
+            case BSONObj::opIN:
+            case BSONObj::NIN:
+            case BSONObj::opSIZE:
+                return 2;
+            case BSONObj::opALL:
+            case BSONObj::opELEM_MATCH:
+                return 4;
+            default:
+                return 0;
+            }
+        }
+    }
+
+    /* Compile _basics into _program: split every field path once, assign the top level fields
+       to slots filled by a single pass over each document, and order the predicates so that the
+       cheapest ones are tried first and can reject a document early.
+    */
+    void Matcher::compile() {
+        // Key matchers read index keys by index field name, so they keep looking fields up.
+        const bool indexed = !_constrainIndexKey.isEmpty();
+        vector< pair< int, int > > costs;
+        _program.resize( _basics.size() );
+        for ( size_t i = 0; i < _basics.size(); i++ ) {
+            const ElementMatcher &bm = _basics[ i ];
+            CompiledPredicate &p = _program[ i ];
+            const char *fieldName = bm._toMatch.fieldName();
+            const char *dot = strchr( fieldName, '.' );
+            p.slot = -1;
+            p.rest = NULL;
+            // $all gathers every value along the whole dotted path itself.
+            if ( !indexed && bm._compareOp != BSONObj::opALL ) {
+                p.slot = fieldSlot( dot ? StringData( fieldName, dot - fieldName ) :
+                                          StringData( fieldName ) );
+                if ( p.slot >= 0 && dot ) {
+                    p.rest = dot + 1;
+                }
+            }
+            p.cost = predicateCost( bm._compareOp ) + ( dot ? 1 : 0 ) + ( p.slot < 0 ? 1 : 0 );
+            costs.push_back( make_pair( p.cost, (int)i ) );
+        }
+        // Ties keep query order.
+        std::sort( costs.begin(), costs.end() );
+        _evalOrder.clear();
+        for ( vector< pair< int, int > >::const_iterator it = costs.begin(); it != costs.end(); ++it ) {
+            _evalOrder.push_back( it->second );
+        }
+    }
+
+    int Matcher::fieldSlot( const StringData &field ) {
+        for ( size_t i = 0; i < _fieldSlots.size(); i++ ) {
+            if ( _fieldSlots[ i ] == field ) {
+                return i;
+            }
+        }
+        if ( _fieldSlots.size() == MaxFieldSlots ) {
+            return -1;
+        }
+        _fieldSlots.push_back( field );
+        return _fieldSlots.size() - 1;
+    }
+
+    /* Fill extracted, parallel to _fieldSlots, with the first occurrence of each slot's field in
+       obj, as getField() would find it, stopping as soon as all of them are found.
+    */
+    void Matcher::extractFields( const BSONObj &obj, BSONElement *extracted ) const {
+        size_t remaining = _fieldSlots.size();
+        BSONObjIterator i( obj );
+        while ( remaining > 0 && i.more() ) {
+            const BSONElement e = i.next();
+            const StringData name( e.fieldName(), e.fieldNameSize() - 1 );
+            for ( size_t j = 0; j < _fieldSlots.size(); j++ ) {
+                if ( extracted[ j ].eoo() && _fieldSlots[ j ] == name ) {
+                    extracted[ j ] = e;
+                    --remaining;
+                    break;
+                }
+            }
+        }
+    }
+
+    bool Matcher::referencedTopLevelFields( set<string> *fields ) const {
+        if ( _where ) {
+            return false;
+        }
+        for ( vector<ElementMatcher>::const_iterator i = _basics.begin(); i != _basics.end(); ++i ) {
+            fields->insert( str::before( i->_toMatch.fieldName(), '.' ) );
+        }
+        for ( vector<RegexMatcher>::const_iterator i = _regexs.begin(); i != _regexs.end(); ++i ) {
+            fields->insert( str::before( i->_fieldName, '.' ) );
+        }
+        for ( vector<GeoMatcher>::const_iterator i = _geo.begin(); i != _geo.end(); ++i ) {
+            fields->insert( str::before( i->getFieldName(), '.' ) );
+        }
+        const list< shared_ptr< Matcher > > *nested[] = { &_andMatchers, &_orMatchers, &_norMatchers };
+        for ( size_t n = 0; n < sizeof( nested ) / sizeof( nested[ 0 ] ); n++ ) {
+            for ( list< shared_ptr< Matcher > >::const_iterator i = nested[ n ]->begin();
+                  i != nested[ n ]->end(); ++i ) {
+                if ( !(*i)->referencedTopLevelFields( fields ) ) {
+                    return false;
+                }
+            }
+        }
+        return true;
     }
 
     inline bool regexMatches(const RegexMatcher& rm, const BSONElement& e) {
@@ -719,6 +830,37 @@ namespace mongo {
         return bm._toMatch.trueValue() ? 1 : -1;
     }
 
+    /* Equivalent to matchesDotted() on the whole object for the i'th basic, given the top level
+       fields extracted by extractFields().
+    */
+    int Matcher::matchesCompiled( size_t i, const BSONElement *extracted, const BSONObj &obj, MatchDetails * details ) const {
+        const ElementMatcher &em = _basics[ i ];
+        const CompiledPredicate &p = _program[ i ];
+        if ( p.slot < 0 ) {
+            return matchesDotted( em._toMatch.fieldName(), em._toMatch, obj, em._compareOp, em, false, details );
+        }
+        if ( em.negativeCompareOp() ) {
+            // as in inverseMatch()
+            int inverseRet = matchesTopLevel( em, p, extracted[ p.slot ], em.inverseOfNegativeCompareOp(), details );
+            if ( em.negativeCompareOpContainsNull() ) {
+                return ( inverseRet <= 0 ) ? 1 : 0;
+            }
+            return -inverseRet;
+        }
+        return matchesTopLevel( em, p, extracted[ p.slot ], em._compareOp, details );
+    }
+
+    int Matcher::matchesTopLevel( const ElementMatcher &em, const CompiledPredicate &p, const BSONElement &top, int compareOp, MatchDetails * details ) const {
+        if ( p.rest == NULL ) {
+            return matchesElement( top, em._toMatch, compareOp, em, false, details );
+        }
+        if ( top.type() != Object && top.type() != Array ) {
+            // Left portion of field name was not found or wrong type.
+            return 0;
+        }
+        return matchesDotted( p.rest, em._toMatch, top.embeddedObject(), compareOp, em, top.type() == Array, details );
+    }
+
     /* Check if a particular field matches.
 
        fieldName - field to match "a.b" if we are reaching into an embedded object.
@@ -884,6 +1026,13 @@ namespace mongo {
             }
         }
 
+        return matchesElement( e, toMatch, compareOp, em, indexed, details );
+    }
+
+    /* Match the element found at the end of a field path, which is eoo if it is missing.
+       Returns the same values as matchesDotted().
+    */
+    int Matcher::matchesElement(const BSONElement& e, const BSONElement& toMatch, int compareOp, const ElementMatcher& em, bool indexed, MatchDetails * details ) const {
         if ( compareOp == BSONObj::opEXISTS ) {
             if( e.eoo() ) {
                 return 0;
@@ -952,12 +1101,20 @@ namespace mongo {
         /* assuming there is usually only one thing to match.  if more this
            could be slow sometimes. */
 
-        // check normal non-regex cases:
-        for ( unsigned i = 0; i < _basics.size(); i++ ) {
+        BSONElement extracted[ MaxFieldSlots ];
+        if ( !_fieldSlots.empty() ) {
+            extractFields( jsobj, extracted );
+        }
+
+        // check normal non-regex cases, cheapest first unless the array element that matched
+        // is requested, which depends on the order of the query
+        const bool queryOrder = details && details->needRecord();
+        for ( unsigned n = 0; n < _basics.size(); n++ ) {
+            const unsigned i = queryOrder ? n : _evalOrder[n];
             const ElementMatcher& bm = _basics[i];
             const BSONElement& m = bm._toMatch;
             // -1=mismatch. 0=missing element. 1=match
-            int cmp = matchesDotted(m.fieldName(), m, jsobj, bm._compareOp, bm , false , details );
+            int cmp = matchesCompiled( i, extracted, jsobj, details );
             if ( cmp == 0 && bm._compareOp == BSONObj::opEXISTS ) {
                 // If missing, match cmp is opposite of $exists spec.
                 cmp = -retExistsFound(bm);
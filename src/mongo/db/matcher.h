@@ -318,7 +318,28 @@ namespace mongo {
 
         const BSONObj *getQuery() const { return &_jsobj; };
 
+        /**
+         * Adds the names of the top level fields this Matcher (and its nested Matchers) reads to
+         * fields.  Returns false if a match may depend on the rest of the document as well, as
+         * it does with $where.
+         */
+        bool referencedTopLevelFields( set<string> *fields ) const;
+
     private:
+        /**
+         * A basic ElementMatcher compiled at construction: its field path is split once into the
+         * top level field it starts with, which matches() extracts together with the others in a
+         * single pass over the document, and the dotted remainder below it.
+         */
+        struct CompiledPredicate {
+            int slot;           // index in _fieldSlots, or -1 to look the path up in the object
+            const char *rest;   // path below the top level field, or NULL
+            int cost;           // relative cost of evaluating the predicate
+        };
+
+        // top level fields extracted per document, the rest are looked up as before
+        static const size_t MaxFieldSlots = 16;
+
         /**
          * Generate a matcher for the provided index key format using the
          * provided full doc matcher.
@@ -337,6 +358,17 @@ namespace mongo {
 
         int valuesMatch(const BSONElement& l, const BSONElement& r, int op, const ElementMatcher& bm) const;
 
+        int matchesElement( const BSONElement& e, const BSONElement& toMatch, int compareOp,
+                            const ElementMatcher& em, bool indexed, MatchDetails * details ) const;
+
+        void compile();
+        int fieldSlot( const StringData &field );
+        void extractFields( const BSONObj &obj, BSONElement *extracted ) const;
+        int matchesCompiled( size_t i, const BSONElement *extracted, const BSONObj &obj,
+                             MatchDetails * details ) const;
+        int matchesTopLevel( const ElementMatcher &em, const CompiledPredicate &p,
+                             const BSONElement &top, int compareOp, MatchDetails * details ) const;
+
         bool parseClause( const BSONElement &e );
         void parseExtractedClause( const BSONElement &e, list< shared_ptr< Matcher > > &matchers );
 
@@ -347,6 +379,9 @@ namespace mongo {
         BSONObj _jsobj;                  // the query pattern.  e.g., { name: "joe" }
         BSONObj _constrainIndexKey;
         vector<ElementMatcher> _basics;
+        vector<CompiledPredicate> _program;     // parallel to _basics
+        vector<int> _evalOrder;                 // indexes of _program, cheapest first
+        vector<StringData> _fieldSlots;
         bool _haveSize;
         bool _all;
         bool _hasArray;
@@ -375,6 +410,12 @@ namespace mongo {
         bool matchesCurrent( Cursor * cursor , MatchDetails * details = 0 ) const;
         bool needRecord() const { return _needRecord; }
 
+        /**
+         * @return false if an index key alone rules out a match, as matchesCurrent() would
+         * find for a cursor that is not multikey.
+         */
+        bool keyMatches( const BSONObj &key ) const { return _keyMatcher.matches( key ); }
+
         const Matcher &docMatcher() const { return *_docMatcher; }
 
         /**
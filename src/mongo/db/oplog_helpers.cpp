@@ -371,7 +371,6 @@ namespace mongo {
             if (indexBitChanged) {
                 cl->noteMultiKeyChanged();
             }
-            cl->notifyOfWriteOp();
         }
 
         static void runCappedInsertFromOplog(const char *ns, const BSONObj &op) {
@@ -421,7 +420,6 @@ namespace mongo {
             CappedCollection *cappedCl = cl->as<CappedCollection>();
             const uint64_t flags = Collection::NO_LOCKTREE;
             cappedCl->deleteObjectWithPK(pk, row, flags);
-            cl->notifyOfWriteOp();
         }
 
         static void runUpdateFromOplogWithLock(
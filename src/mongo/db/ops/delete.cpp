@@ -33,7 +33,6 @@ namespace mongo {
 
     void deleteOneObject(Collection *cl, const BSONObj &pk, const BSONObj &obj, uint64_t flags) {
         cl->deleteObject(pk, obj, flags);
-        cl->notifyOfWriteOp();
     }
     
     // Special-cased helper for deleting ranges out of an index.
@@ -69,7 +68,7 @@ namespace mongo {
         return nDeleted;
     }
 
-    long long _deleteObjects(const char *ns, BSONObj pattern, bool justOne, bool logop) {
+    long long _deleteObjects(const char *ns, BSONObj pattern, bool justOne, bool logop, long long limit) {
         Collection *cl = getCollection(ns);
         if (cl == NULL) {
             return 0;
@@ -127,7 +126,7 @@ namespace mongo {
             deleteOneObject(cl, pk, obj);
             nDeleted++;
 
-            if (justOne) {
+            if (justOne || (limit > 0 && nDeleted >= limit)) {
                 break;
             }
         }
@@ -138,7 +137,7 @@ namespace mongo {
        pattern: the "where" clause / criteria
        justOne: stop after 1 match
     */
-    long long deleteObjects(const char *ns, BSONObj pattern, bool justOne, bool logop) {
+    long long deleteObjects(const char *ns, BSONObj pattern, bool justOne, bool logop, long long limit) {
         if (NamespaceString::isSystem(ns)) {
             uassert(12050, "cannot delete from system namespace",
                     legalClientSystemNS(ns, true));
@@ -149,6 +148,6 @@ namespace mongo {
             uasserted(10100, "cannot delete from collection with reserved $ in name");
         }
 
-        return _deleteObjects(ns, pattern, justOne, logop);
+        return _deleteObjects(ns, pattern, justOne, logop, limit);
     }
 }
@@ -47,9 +47,10 @@ namespace mongo {
                                uint64_t flags = 0);
 
     // System-y version of deleteObjects that allows you to delete from the system collections, used to be god = true.
-    long long _deleteObjects(const char *ns, BSONObj pattern, bool justOne, bool logop);
+    long long _deleteObjects(const char *ns, BSONObj pattern, bool justOne, bool logop, long long limit = 0);
 
     // If justOne is true, deletedId is set to the id of the deleted object.
-    long long deleteObjects(const char *ns, BSONObj pattern, bool justOne, bool logop = false);
+    // If limit is positive, at most that many objects are deleted.
+    long long deleteObjects(const char *ns, BSONObj pattern, bool justOne, bool logop = false, long long limit = 0);
 
 }
@@ -540,9 +540,10 @@ namespace mongo {
     QueryResponseBuilder *QueryResponseBuilder::make( const ParsedQuery &parsedQuery,
                                                      const shared_ptr<Cursor> &cursor,
                                                      const QueryPlanSummary &queryPlan,
-                                                     const BSONObj &oldPlan ) {
+                                                     const BSONObj &oldPlan,
+                                                     const BSONObj &appliedSnapshot ) {
         auto_ptr<QueryResponseBuilder> ret( new QueryResponseBuilder( parsedQuery, cursor ) );
-        ret->init( queryPlan, oldPlan );
+        ret->init( queryPlan, oldPlan, appliedSnapshot );
         return ret.release();
     }
     
@@ -554,9 +555,10 @@ namespace mongo {
     _buf( 32768 ) { // TODO be smarter here
     }
     
-    void QueryResponseBuilder::init( const QueryPlanSummary &queryPlan, const BSONObj &oldPlan ) {
+    void QueryResponseBuilder::init( const QueryPlanSummary &queryPlan, const BSONObj &oldPlan,
+                                     const BSONObj &appliedSnapshot ) {
         _chunkManager = newChunkManager();
-        _explain = newExplainRecordingStrategy( queryPlan, oldPlan );
+        _explain = newExplainRecordingStrategy( queryPlan, oldPlan, appliedSnapshot );
         _builder = newResponseBuildStrategy( queryPlan );
         _builder->resetBuf();
     }
@@ -622,12 +624,14 @@ namespace mongo {
     }
 
     shared_ptr<ExplainRecordingStrategy> QueryResponseBuilder::newExplainRecordingStrategy
-    ( const QueryPlanSummary &queryPlan, const BSONObj &oldPlan ) const {
+    ( const QueryPlanSummary &queryPlan, const BSONObj &oldPlan,
+      const BSONObj &appliedSnapshot ) const {
         if ( !_parsedQuery.isExplain() ) {
             return shared_ptr<ExplainRecordingStrategy>( new NoExplainStrategy() );
         }
         ExplainQueryInfo::AncillaryInfo ancillaryInfo;
         ancillaryInfo._oldPlan = oldPlan;
+        ancillaryInfo._appliedSnapshot = appliedSnapshot;
         if ( _queryOptimizerCursor ) {
             return shared_ptr<ExplainRecordingStrategy>
             ( new QueryOptimizerCursorExplainStrategy( ancillaryInfo, _queryOptimizerCursor ) );
@@ -725,7 +729,8 @@ namespace mongo {
         }
 
         scoped_ptr<QueryResponseBuilder> queryResponseBuilder
-                ( QueryResponseBuilder::make( pq, cursor, queryPlan, oldPlan ) );
+                ( QueryResponseBuilder::make( pq, cursor, queryPlan, oldPlan,
+                                              curop.debug().appliedSnapshot ) );
         bool saveClientCursor = false;
         int options = QueryOption_NoCursorTimeout;
         if (pq.hasOption( QueryOption_OplogReplay )) {
@@ -996,6 +1001,17 @@ namespace mongo {
         const int txnFlags = (tailable ? DB_READ_UNCOMMITTED : DB_TXN_SNAPSHOT) | DB_TXN_READ_ONLY;
         LOCK_REASON(lockReason, "query");
         Client::ReadContext ctx(ns, lockReason);
+
+        // An $appliedSnapshot query reports which replicated state its snapshot reflects.  The
+        // applier applies documents under a shared lock, so reading from the snapshot does not
+        // wait on it.  The GTID must be read before the transaction begins: anything applied
+        // by then is visible to the snapshot.
+        if (pq.appliedSnapshot()) {
+            uassert(17386, "$appliedSnapshot may not be used with a tailable cursor", !tailable);
+            uassert(17387, "$appliedSnapshot may not be used in a multi-statement transaction",
+                    !inMultiStatementTxn);
+            curop.debug().appliedSnapshot = replAppliedSnapshot();
+        }
         scoped_ptr<Client::Transaction> transaction(!inMultiStatementTxn ?
                                                     new Client::Transaction(txnFlags) : NULL);
 
@@ -259,11 +259,13 @@ namespace mongo {
         /**
          * @param queryPlan must be supplied if @param cursor is not a QueryOptimizerCursor and
          * results must be sorted or read with a covered index.
+         * @param appliedSnapshot is reported by explain, if nonempty.
          */
         static QueryResponseBuilder *make( const ParsedQuery &parsedQuery,
                                           const shared_ptr<Cursor> &cursor,
                                           const QueryPlanSummary &queryPlan,
-                                          const BSONObj &oldPlan );
+                                          const BSONObj &oldPlan,
+                                          const BSONObj &appliedSnapshot );
         /** @return true if the current iterate matches and is added. */
         bool addMatch();
         /** @return true if there are enough results to return the first batch. */
@@ -285,11 +287,13 @@ namespace mongo {
 
     private:
         QueryResponseBuilder( const ParsedQuery &parsedQuery, const shared_ptr<Cursor> &cursor );
-        void init( const QueryPlanSummary &queryPlan, const BSONObj &oldPlan );
+        void init( const QueryPlanSummary &queryPlan, const BSONObj &oldPlan,
+                   const BSONObj &appliedSnapshot );
 
         ShardChunkManagerPtr newChunkManager() const;
         shared_ptr<ExplainRecordingStrategy> newExplainRecordingStrategy
-        ( const QueryPlanSummary &queryPlan, const BSONObj &oldPlan ) const;
+        ( const QueryPlanSummary &queryPlan, const BSONObj &oldPlan,
+          const BSONObj &appliedSnapshot ) const;
         shared_ptr<ResponseBuildStrategy> newResponseBuildStrategy
         ( const QueryPlanSummary &queryPlan );
         /**
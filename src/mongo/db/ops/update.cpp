@@ -59,7 +59,6 @@ namespace mongo {
         } else {
             cl->updateObject(pk, oldObj, newObj, fromMigrate, flags);
         }
-        cl->notifyOfWriteOp();
     }
 
     static void checkNoMods(const BSONObj &obj) {
@@ -0,0 +1,107 @@
+/**
+*    Copyright (C) 2014 Tokutek Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mongo/pch.h"
+
+#include "mongo/db/parallel_scan.h"
+
+#include "mongo/db/client.h"
+#include "mongo/db/collection.h"
+#include "mongo/db/cursor.h"
+#include "mongo/db/d_concurrency.h"
+#include "mongo/db/instance.h"
+#include "mongo/db/query_optimizer.h"
+#include "mongo/db/queryoptimizercursor.h"
+
+namespace mongo {
+
+    namespace {
+
+        // a range should be worth starting a thread and a cursor for
+        const long long minRangeBytes = 1 << 20;
+
+        // a few ranges per thread, so that one slow range doesn't hold up the rest
+        const int rangesPerThread = 4;
+
+    } // namespace
+
+    bool splitForParallelScan(const string &ns, const BSONObj &query, int nThreads,
+                              vector<BSONObj> *splitKeys) {
+        if (nThreads <= 1 || Lock::isLocked() || cc().hasTxn()) {
+            return false;
+        }
+
+        BSONObj pkPattern;
+        long long dataSize;
+        {
+            LOCK_REASON(lockReason, "planning a parallel scan");
+            Client::ReadContext ctx(ns, lockReason);
+            Client::Transaction txn(DB_TXN_SNAPSHOT | DB_TXN_READ_ONLY);
+
+            Collection *cl = getCollection(ns);
+            if (cl == NULL || cl->isCapped() || cl->isPartitioned() || cl->isPKHidden()) {
+                return false;
+            }
+            pkPattern = cl->pkPattern().getOwned();
+
+            // A plan on another index, or on a range of the primary key, reads less than the
+            // ranges would.
+            BSONForEach(e, pkPattern) {
+                if (query.hasField(e.fieldName())) {
+                    return false;
+                }
+            }
+            shared_ptr<Cursor> cursor(getOptimizedCursor(ns, query));
+            if (!cursor || dynamic_cast<QueryOptimizerCursor *>(cursor.get()) != NULL) {
+                return false;
+            }
+            const BSONObj indexKey(cursor->indexKeyPattern());
+            if (!indexKey.isEmpty() && indexKey.woCompare(pkPattern) != 0) {
+                return false;
+            }
+
+            dataSize = cl->getPKIndex().getStats().dataSize;
+            txn.commit();
+        }
+
+        if (dataSize < nThreads * minRangeBytes) {
+            return false;
+        }
+
+        // splitVector puts a key about every maxChunkSizeBytes / 2 bytes
+        const int nRanges = rangesPerThread * nThreads;
+        DBDirectClient client;
+        BSONObj res;
+        if (!client.runCommand(nsToDatabase(ns),
+                               BSON("splitVector" << ns
+                                    << "keyPattern" << pkPattern
+                                    << "maxChunkSizeBytes" << 2 * dataSize / nRanges
+                                    << "maxSplitPoints" << nRanges - 1),
+                               res)) {
+            LOG(1) << "could not split " << ns << " for a parallel scan: " << res << endl;
+            return false;
+        }
+        if (res["splitKeys"].type() != Array || res["splitKeys"].Obj().isEmpty()) {
+            return false;
+        }
+
+        BSONForEach(e, res["splitKeys"].Obj()) {
+            splitKeys->push_back(e.Obj().getOwned());
+        }
+        return true;
+    }
+
+} // namespace mongo
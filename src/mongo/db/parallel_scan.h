@@ -0,0 +1,52 @@
+/**
+*    Copyright (C) 2014 Tokutek Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "mongo/pch.h"
+
+#include <vector>
+
+#include "mongo/db/jsobj.h"
+
+namespace mongo {
+
+    /**
+     * Plans a scan of a collection that is split into ranges of its primary key, so that the
+     * ranges can be read on several threads at once.
+     *
+     * A split is only worth it if the query would scan the whole primary key anyway: if it would
+     * use another index or a range of the primary key, or the collection is small, capped,
+     * partitioned or has a hidden primary key, this returns false and leaves splitKeys alone.
+     * Otherwise it fills splitKeys with ascending primary keys that cut the collection into
+     * a few ranges per thread, see parallelScanMin() and parallelScanMax(), and returns true.
+     *
+     * Must be called without a lock or a transaction.
+     */
+    bool splitForParallelScan(const string &ns, const BSONObj &query, int nThreads,
+                              vector<BSONObj> *splitKeys);
+
+    /** @return the inclusive lower bound ($min) of a range, empty for the first one. */
+    inline BSONObj parallelScanMin(const vector<BSONObj> &splitKeys, size_t range) {
+        return range == 0 ? BSONObj() : splitKeys[range - 1];
+    }
+
+    /** @return the exclusive upper bound ($max) of a range, empty for the last one. */
+    inline BSONObj parallelScanMax(const vector<BSONObj> &splitKeys, size_t range) {
+        return range == splitKeys.size() ? BSONObj() : splitKeys[range];
+    }
+
+} // namespace mongo
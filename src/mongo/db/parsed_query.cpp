@@ -111,6 +111,7 @@ namespace mongo {
         _wantMore = true;
         _explain = false;
         _returnKey = false;
+        _appliedSnapshot = false;
         _maxScan = 0;
     }
 
@@ -169,6 +170,8 @@ namespace mongo {
                     _hint = e.wrap();
                 else if ( strcmp( "returnKey" , name ) == 0 )
                     _returnKey = e.trueValue();
+                else if ( strcmp( "appliedSnapshot" , name ) == 0 )
+                    _appliedSnapshot = e.trueValue();
                 else if ( strcmp( "maxScan" , name ) == 0 )
                     _maxScan = e.numberInt();
                 else if ( strcmp( "comment" , name ) == 0 ) {
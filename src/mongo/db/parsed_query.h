@@ -57,6 +57,8 @@ namespace mongo {
         
         bool isExplain() const { return _explain; }
         bool returnKey() const { return _returnKey; }
+        /** @return true if the query should read the latest snapshot of applied replication. */
+        bool appliedSnapshot() const { return _appliedSnapshot; }
         
         const BSONObj& getMin() const { return _min; }
         const BSONObj& getMax() const { return _max; }
@@ -100,6 +102,7 @@ namespace mongo {
         bool _wantMore;
         bool _explain;
         bool _returnKey;
+        bool _appliedSnapshot;
         bool _hasReadPref;
         BSONObj _min;
         BSONObj _max;
@@ -34,7 +34,12 @@ namespace mongo {
     }
 
     Accumulator::Accumulator():
-        ExpressionNary() {
+        ExpressionNary(),
+        memUsageBytes(sizeof(*this)) {
+    }
+
+    size_t Accumulator::getMemUsage() const {
+        return memUsageBytes;
     }
 
     void Accumulator::opToBson(BSONObjBuilder *pBuilder, StringData opName,
@@ -44,9 +44,20 @@ namespace mongo {
          */
         virtual Value getValue() const = 0;
 
+        /*
+          Get the approximate amount of memory used by the accumulated state.
+          $group uses this to decide when to spill its groups to disk.
+
+          @returns the approximate size in bytes
+         */
+        virtual size_t getMemUsage() const;
+
     protected:
         Accumulator();
 
+        /* maintained by accumulators whose state grows as they evaluate */
+        mutable size_t memUsageBytes;
+
         /*
           Convenience method for doing this for accumulators.  The pattern
           is always the same, so a common implementation works, but requires
@@ -99,6 +110,9 @@ namespace mongo {
         // virtuals from Expression
         virtual Value getValue() const;
 
+        // virtuals from Accumulator
+        virtual size_t getMemUsage() const;
+
     protected:
         AccumulatorSingleValue();
 
@@ -28,7 +28,8 @@ namespace mongo {
 
         if (!pCtx->getDoingMerge()) {
             if (!prhs.missing()) {
-                set.insert(prhs);
+                if (set.insert(prhs).second)
+                    memUsageBytes += prhs.getApproximateSize();
             }
         } else {
             /*
@@ -40,7 +41,10 @@ namespace mongo {
             verify(prhs.getType() == Array);
             
             const vector<Value>& array = prhs.getArray();
-            set.insert(array.begin(), array.end());
+            for (size_t i = 0; i < array.size(); i++) {
+                if (set.insert(array[i]).second)
+                    memUsageBytes += array[i].getApproximateSize();
+            }
         }
 
         return Value();
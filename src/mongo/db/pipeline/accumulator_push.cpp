@@ -29,6 +29,7 @@ namespace mongo {
         if (!pCtx->getDoingMerge()) {
             if (!prhs.missing()) {
                 vpValue.push_back(prhs);
+                memUsageBytes += prhs.getApproximateSize();
             }
         }
         else {
@@ -42,6 +43,7 @@ namespace mongo {
             
             const vector<Value>& vec = prhs.getArray();
             vpValue.insert(vpValue.end(), vec.begin(), vec.end());
+            memUsageBytes += prhs.getApproximateSize();
         }
 
         return Value();
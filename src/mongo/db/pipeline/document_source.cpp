@@ -56,6 +56,18 @@ namespace mongo {
         return false;
     }
 
+    bool DocumentSource::getNextBatch(vector<Document>& batch, size_t maxDocs) {
+        if (eof())
+            return false;
+
+        for (size_t n = 0; n < maxDocs; ++n) {
+            batch.push_back(getCurrent());
+            if (!advance())
+                return false;
+        }
+        return true;
+    }
+
     void DocumentSource::dispose() {
         if ( pSource ) {
             // This is required for the DocumentSourceCursor to release its read lock, see
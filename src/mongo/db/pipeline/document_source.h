@@ -19,6 +19,8 @@
 
 #include "mongo/pch.h"
 
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/unordered_map.hpp>
 #include "util/intrusive_counter.h"
 #include "db/clientcursor.h"
@@ -26,6 +28,7 @@
 #include "db/pipeline/document.h"
 #include "db/pipeline/expression.h"
 #include "mongo/db/pipeline/expression_context.h"
+#include "db/pipeline/spill_file.h"
 #include "db/pipeline/value.h"
 #include "util/string_writer.h"
 #include "mongo/db/projection.h"
@@ -100,6 +103,22 @@ namespace mongo {
          */
         virtual Document getCurrent() = 0;
 
+        /**
+         * Append up to maxDocs Documents to batch, starting with the current one, and advance
+         * past them.  This is the same as getCurrent() and advance() in a loop, but lets stages
+         * that override it exchange Documents a batch at a time, with one virtual call and one
+         * interrupt check per batch instead of per Document.  The two ways of iterating may be
+         * mixed: afterwards, getCurrent() returns the Document after the last one appended.
+         *
+         * @returns false if the source is exhausted, true if it may have more Documents.  The
+         *   batch may be appended to either way, and may end up with fewer than maxDocs
+         *   Documents even if there are more.
+         */
+        virtual bool getNextBatch(vector<Document>& batch, size_t maxDocs);
+
+        /** The number of Documents stages ask their sources for at a time. */
+        static const size_t batchSize = 128;
+
         /**
          * Inform the source that it is no longer needed and may release its resources.  After
          * dispose() is called the source must still be able to handle iteration requests, but may
@@ -389,6 +408,7 @@ namespace mongo {
         virtual bool eof();
         virtual bool advance();
         virtual Document getCurrent();
+        virtual bool getNextBatch(vector<Document>& batch, size_t maxDocs);
         virtual void setSource(DocumentSource *pSource);
 
         /**
@@ -481,6 +501,124 @@ namespace mongo {
     };
 
 
+    /**
+     * Runs the shard half of a pipeline split by Pipeline::splitForSharded() on several threads,
+     * each over a range of the collection's primary key, and returns what they all produce.
+     * This is what DocumentSourceCommandShards does for a sharded aggregation, with the ranges
+     * standing in for the shards: the partial $group results are merged by the router half of
+     * the pipeline that follows this source.
+     *
+     * Each range gets its own pipeline, cursor, lock and snapshot transaction on the worker
+     * thread that reads it, so run() must be called without a lock.
+     */
+    class DocumentSourceParallelCursor :
+        public DocumentSource {
+    public:
+        // virtuals from DocumentSource
+        virtual ~DocumentSourceParallelCursor();
+        virtual bool eof();
+        virtual bool advance();
+        virtual Document getCurrent();
+        virtual bool getNextBatch(vector<Document>& batch, size_t maxDocs);
+        virtual void setSource(DocumentSource *pSource);
+        virtual void dispose();
+
+        /**
+          Create a source that will run a shard pipeline over ranges of a
+          primary key.
+
+          @param ns the namespace to read
+          @param shardPipeline the shard pipeline, as written by
+            Pipeline::toBson()
+          @param splitKeys the primary keys the ranges are split at, in
+            ascending order; there is one more range than there are keys
+          @param nThreads the number of worker threads to use
+          @param pExpCtx the expression context for the pipeline
+         */
+        static intrusive_ptr<DocumentSourceParallelCursor> create(
+            const string &ns,
+            const BSONObj &shardPipeline,
+            const vector<BSONObj> &splitKeys,
+            int nThreads,
+            const intrusive_ptr<ExpressionContext> &pExpCtx);
+
+        /**
+          Run the shard pipeline over every range, and keep the results.
+
+          This returns once all the workers are done.  If a worker fails, or
+          this operation is interrupted, the others are stopped and the error
+          is rethrown here.
+         */
+        void run();
+
+    protected:
+        // virtuals from DocumentSource
+        virtual void sourceToBson(BSONObjBuilder *pBuilder, bool explain) const;
+
+    private:
+        DocumentSourceParallelCursor(
+            const string &ns,
+            const BSONObj &shardPipeline,
+            const vector<BSONObj> &splitKeys,
+            int nThreads,
+            const intrusive_ptr<ExpressionContext> &pExpCtx);
+
+        void workerThread(size_t id);
+
+        /* run the shard pipeline over one range, appending to worker id's output */
+        void runRange(size_t range, size_t id);
+
+        /* write out worker id's output as a run of pSpill */
+        void spill(size_t id);
+
+        /*
+          Make results[position] the next Document, reading it back from
+          pSpill if need be; false once there are none left.
+         */
+        bool fillResults();
+
+        /* claim the next range to run; false once there are none left */
+        bool nextRange(size_t *pRange);
+
+        /* record the first failure, and stop the other workers */
+        void fail(int code, const string &message);
+
+        bool isAborted();
+
+        string ns;
+        BSONObj shardPipeline;
+        vector<BSONObj> splitKeys;
+        int nThreads;
+
+        /* protects the fields from here through errorMessage */
+        boost::mutex mutex;
+        boost::condition_variable doneCond;
+        size_t rangesStarted;
+        int workersRunning;
+        bool aborted;
+        int errorCode;
+        string errorMessage;
+
+        /* each worker only touches its own entry */
+        vector<vector<Document> > workerOutput;
+        vector<size_t> workerMemUsage;
+        uint64_t workerSpillThreshold;
+
+        /* output the workers spilled, in any order; spillMutex covers writing it */
+        boost::mutex spillMutex;
+        scoped_ptr<SpillFile> pSpill;
+
+        /*
+          The results, once run() has returned: what the workers held in
+          memory, then each run of pSpill in turn.
+         */
+        vector<Document> results;
+        size_t position;
+        size_t spillRun;
+        scoped_ptr<SpillFile::Reader> pSpillReader;
+    };
+
+
     /*
       This contains all the basic mechanics for filtering a stream of
       Documents, except for the actual predicate evaluation itself.  This was
@@ -495,6 +633,7 @@ namespace mongo {
         virtual bool eof();
         virtual bool advance();
         virtual Document getCurrent();
+        virtual bool getNextBatch(vector<Document>& batch, size_t maxDocs);
 
         /**
           Create a BSONObj suitable for Matcher construction.
@@ -529,6 +668,9 @@ namespace mongo {
         bool unstarted;
         bool hasCurrent;
         Document pCurrent;
+
+        /* reused by getNextBatch() for the input batches */
+        vector<Document> inputBatch;
     };
 
     class DocumentSourceGroup :
@@ -595,6 +737,33 @@ namespace mongo {
             BSONElement *pBsonElement,
             const intrusive_ptr<ExpressionContext> &pExpCtx);
 
+        /**
+          Get the field paths the group key is made of.
+
+          @param pPaths filled with the field path, without the '$'
+          @returns true if the _id is a single field path, so that documents
+            with the same value at that path, and only those, share a group
+            (missing and null values both group as null)
+         */
+        bool getIdFieldPaths(vector<string> *pPaths) const;
+
+        /**
+          @returns true if any accumulator's result depends on the order of
+            its input ($first, $last and $push), so that the group can't
+            merge partial groups that arrive in arbitrary order
+         */
+        bool isOrderSensitive() const;
+
+        /**
+          Group input whose equal _ids are known to be adjacent, such as
+          documents read in the order of an index on the _id's fields.
+
+          Rather than populating the whole table of groups before returning
+          anything, the group then accumulates one group at a time and
+          returns it as soon as the _id changes.
+         */
+        void setStreaming(bool streaming);
+
         // Virtuals for SplittableDocumentSource
         virtual intrusive_ptr<DocumentSource> getShardSource();
         virtual intrusive_ptr<DocumentSource> getRouterSource();
@@ -641,9 +810,66 @@ namespace mongo {
         vector<intrusive_ptr<Expression> > vpExpression;
 
 
-        Document makeDocument(const GroupsType::iterator &rIter);
+        Document makeDocument(const Value &id,
+                              const vector<intrusive_ptr<Accumulator> > &group);
 
         GroupsType::iterator groupsIterator;
+
+        /* evaluate the _id of each Document in batch, into ids */
+        void evaluateIds(const vector<Document> &batch, vector<Value> *pIds) const;
+
+        /*
+          Streaming grouping, see setStreaming().  streamNext() reads the
+          next group's run of Documents from the source into streamCurrent;
+          streamBatch holds the source's Documents from streamPosition on,
+          with their _ids in streamIds.
+         */
+        void streamNext();
+        bool fillStreamBatch();
+        bool streaming;
+        vector<Document> streamBatch;
+        vector<Value> streamIds;
+        size_t streamPosition;
+        bool streamSourceMore;
+        Document streamCurrent;
+        bool streamEof;
+
+        /*
+          External grouping.  Once the groups hold more than
+          aggregationSpillThreshold bytes, spill() writes them out to pSpill
+          as a run sorted by _id, with each accumulator's partial value (as
+          a shard would send it to the router), and populate() carries on
+          with an empty table.  When the input is exhausted, the runs are
+          k-way merged: the partial values for each _id are combined, in run
+          order, by accumulators set up the way getRouterSource() sets them
+          up.
+         */
+        void spill();
+        void startMerge();
+        void mergeNext();
+
+        /* accumulators are created with this so spill() can ask them for
+           partial values without affecting the rest of the pipeline */
+        intrusive_ptr<ExpressionContext> pAccumulatorCtx;
+        size_t memUsage;
+        scoped_ptr<SpillFile> pSpill;
+        /* for explain, these outlive pSpill */
+        long long bytesSpilled;
+        size_t nRuns;
+
+        struct MergeEntry {
+            Value id;
+            Document doc;
+            size_t run;
+            boost::shared_ptr<SpillFile::Reader> reader;
+        };
+        /* orders the merge heap so that the smallest _id, earliest run is at the top */
+        struct MergeEntryGreater {
+            bool operator()(const MergeEntry &lhs, const MergeEntry &rhs) const;
+        };
+        vector<MergeEntry> mergeHeap;
+        Document mergedCurrent;
+        bool mergedEof;
     };
 
 
@@ -691,6 +917,13 @@ namespace mongo {
             const intrusive_ptr<ExpressionContext> &pExpCtx);
 
         Matcher matcher;
+
+        /*
+          The top level fields the matcher reads, which are all that accept()
+          needs to convert to BSON, unless allFields is set.
+        */
+        vector<string> matcherFields;
+        bool allFields;
     };
 
 
@@ -739,6 +972,7 @@ namespace mongo {
         virtual bool advance();
         virtual const char *getSourceName() const;
         virtual Document getCurrent();
+        virtual bool getNextBatch(vector<Document>& batch, size_t maxDocs);
         virtual void optimize();
 
         virtual GetDepsReturn getDependencies(set<string>& deps) const;
@@ -769,6 +1003,12 @@ namespace mongo {
     private:
         DocumentSourceProject(const intrusive_ptr<ExpressionContext> &pExpCtx);
 
+        /* project one input document */
+        Document project(const Document& pInDocument) const;
+
+        /* reused by getNextBatch() for the input batches */
+        vector<Document> inputBatch;
+
         // configuration state
         intrusive_ptr<ExpressionObject> pEO;
         BSONObj _raw;
@@ -904,6 +1144,42 @@ namespace mongo {
         deque<KeyAndDoc> documents;
 
         intrusive_ptr<DocumentSourceLimit> limitSrc;
+
+        /*
+          External sorting.  Without a limit, once the buffered documents
+          take more than aggregationSpillThreshold bytes, populateAll() sorts
+          them and writes them to pSpill as a run.  Once the input is
+          exhausted, the runs are k-way merged with mergeHeap, and documents
+          is no longer used.
+         */
+        void spill();
+        void startMerge();
+
+        scoped_ptr<SpillFile> pSpill;
+        /* for explain, these outlive pSpill */
+        long long bytesSpilled;
+        size_t nRuns;
+
+        struct MergeEntry {
+            MergeEntry(const Document &d, const SortPaths &sp, size_t r,
+                       const boost::shared_ptr<SpillFile::Reader> &rd)
+                : kd(d, sp), run(r), reader(rd) {}
+            KeyAndDoc kd;
+            size_t run;
+            boost::shared_ptr<SpillFile::Reader> reader;
+        };
+        /* orders the merge heap so that the first document, earliest run is at the top */
+        class MergeComparator {
+        public:
+            explicit MergeComparator(const DocumentSourceSort& source): _source(source) {}
+            bool operator()(const MergeEntry& lhs, const MergeEntry& rhs) const {
+                const int cmp = _source.compare(lhs.kd, rhs.kd);
+                return cmp ? cmp > 0 : lhs.run > rhs.run;
+            }
+        private:
+            const DocumentSourceSort& _source;
+        };
+        vector<MergeEntry> mergeHeap;
     };
     inline void swap(DocumentSourceSort::KeyAndDoc& l, DocumentSourceSort::KeyAndDoc& r) {
         l.key.swap(r.key);
@@ -1048,6 +1324,7 @@ namespace mongo {
         virtual bool advance();
         virtual const char *getSourceName() const;
         virtual Document getCurrent();
+        virtual bool getNextBatch(vector<Document>& batch, size_t maxDocs);
 
         virtual GetDepsReturn getDependencies(set<string>& deps) const;
 
@@ -1181,4 +1458,8 @@ namespace mongo {
         const intrusive_ptr<Expression> &pExpression) {
         pIdExpression = pExpression;
     }
+
+    inline void DocumentSourceGroup::setStreaming(bool streaming) {
+        this->streaming = streaming;
+    }
 }
@@ -67,6 +67,24 @@ namespace mongo {
         return pCurrent;
     }
 
+    bool DocumentSourceCursor::getNextBatch(vector<Document>& batch, size_t maxDocs) {
+        pExpCtx->checkForInterrupt();
+
+        /* if we haven't gotten the first one yet, do so now */
+        if (unstarted)
+            findNext();
+
+        /* findNext() reads the rows the cursor has already buffered, without
+           going back through advance() for every document */
+        for (size_t n = 0; n < maxDocs; ++n) {
+            if (!hasCurrent)
+                return false;
+            batch.push_back(pCurrent);
+            findNext();
+        }
+        return hasCurrent;
+    }
+
     void DocumentSourceCursor::dispose() {
         _cursorWithContext.reset();
     }
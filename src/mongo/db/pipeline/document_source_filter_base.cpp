@@ -74,6 +74,40 @@ namespace mongo {
         return pCurrent;
     }
 
+    bool DocumentSourceFilterBase::getNextBatch(vector<Document>& batch, size_t maxDocs) {
+        pExpCtx->checkForInterrupt();
+
+        const size_t start = batch.size();
+        if (!unstarted) {
+            /* findNext() already left pSource after the current document */
+            if (!hasCurrent)
+                return false;
+            batch.push_back(pCurrent);
+            pCurrent = Document();
+            hasCurrent = false;
+            unstarted = true;
+        }
+
+        /*
+          Filter whole batches from the source until something passes, so
+          a selective filter doesn't hand back lots of empty batches.  Until
+          findNext() is called again, pSource is positioned at the next
+          document to test.
+        */
+        bool more = true;
+        while (more && batch.size() == start) {
+            inputBatch.clear();
+            more = pSource->getNextBatch(inputBatch, maxDocs);
+            for (vector<Document>::const_iterator it = inputBatch.begin();
+                 it != inputBatch.end(); ++it) {
+                if (accept(*it))
+                    batch.push_back(*it);
+            }
+        }
+        inputBatch.clear();
+        return more;
+    }
+
     DocumentSourceFilterBase::DocumentSourceFilterBase(
         const intrusive_ptr<ExpressionContext> &pExpCtx):
         DocumentSource(pExpCtx),
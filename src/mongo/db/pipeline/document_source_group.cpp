@@ -40,6 +40,12 @@ namespace mongo {
         if (!populated)
             populate();
 
+        if (streaming)
+            return streamEof;
+
+        if (pSpill)
+            return mergedEof;
+
         return (groupsIterator == groups.end());
     }
 
@@ -49,6 +55,26 @@ namespace mongo {
         if (!populated)
             populate();
 
+        if (streaming) {
+            verify(!streamEof);
+            streamNext();
+            if (streamEof) {
+                dispose();
+                return false;
+            }
+            return true;
+        }
+
+        if (pSpill) {
+            verify(!mergedEof);
+            mergeNext();
+            if (mergedEof) {
+                dispose();
+                return false;
+            }
+            return true;
+        }
+
         verify(groupsIterator != groups.end());
 
         ++groupsIterator;
@@ -64,13 +90,28 @@ namespace mongo {
         if (!populated)
             populate();
 
-        return makeDocument(groupsIterator);
+        if (streaming)
+            return streamCurrent;
+
+        if (pSpill)
+            return mergedCurrent;
+
+        return makeDocument(groupsIterator->first, groupsIterator->second);
     }
 
     void DocumentSourceGroup::dispose() {
         GroupsType().swap(groups);
         groupsIterator = groups.end();
 
+        mergeHeap.clear();
+        pSpill.reset();
+
+        vector<Document>().swap(streamBatch);
+        vector<Value>().swap(streamIds);
+        streamPosition = 0;
+        streamSourceMore = false;
+        streamCurrent = Document();
+
         pSource->dispose();
     }
 
@@ -89,6 +130,13 @@ namespace mongo {
             pA->addToBsonObj(&insides, vFieldName[i], true);
         }
 
+        if (explain) {
+            if (streaming)
+                insides.appendBool("streaming", true);
+            insides.appendNumber("bytesSpilled", bytesSpilled);
+            insides.appendNumber("runs", static_cast<long long>(nRuns));
+        }
+
         pBuilder->append(groupName, insides.done());
     }
 
@@ -122,7 +170,15 @@ namespace mongo {
         groups(),
         vFieldName(),
         vpAccumulatorFactory(),
-        vpExpression() {
+        vpExpression(),
+        memUsage(0),
+        bytesSpilled(0),
+        nRuns(0),
+        mergedEof(false),
+        streaming(false),
+        streamPosition(0),
+        streamSourceMore(true),
+        streamEof(false) {
     }
 
     void DocumentSourceGroup::addAccumulator(
@@ -136,6 +192,39 @@ namespace mongo {
     }
 
 
+    bool DocumentSourceGroup::getIdFieldPaths(vector<string> *pPaths) const {
+        BSONObjBuilder idBuilder;
+        pIdExpression->addToBsonObj(&idBuilder, "_id", true);
+        const BSONObj idObj(idBuilder.done());
+        const BSONElement idElement(idObj.firstElement());
+
+        /*
+          Only a lone field path qualifies.  In an object _id a missing
+          field is left out while a null one is kept, so {a: null} and {}
+          are different groups even though an index on "a" interleaves
+          them.
+        */
+        pPaths->clear();
+        if (idElement.type() != String)
+            return false;
+        const string path(idElement.str());
+        if (path.size() < 2 || path[0] != '$' || path[1] == '$')
+            return false;
+        pPaths->push_back(Expression::removeFieldPrefix(path));
+        return true;
+    }
+
+    bool DocumentSourceGroup::isOrderSensitive() const {
+        const size_t n = vpAccumulatorFactory.size();
+        for(size_t i = 0; i < n; ++i) {
+            if (vpAccumulatorFactory[i] == AccumulatorFirst::create ||
+                vpAccumulatorFactory[i] == AccumulatorLast::create ||
+                vpAccumulatorFactory[i] == AccumulatorPush::create)
+                return true;
+        }
+        return false;
+    }
+
     struct GroupOpDesc {
         const char *pName;
         intrusive_ptr<Accumulator> (*pFactory)(
@@ -287,43 +376,88 @@ namespace mongo {
         return pGroup;
     }
 
+    void DocumentSourceGroup::evaluateIds(const vector<Document> &batch,
+                                          vector<Value> *pIds) const {
+        pIds->clear();
+        pIds->reserve(batch.size());
+        for (size_t j = 0; j < batch.size(); j++) {
+            pIds->push_back(pIdExpression->evaluate(batch[j]));
+
+            /* treat missing values the same as NULL SERVER-4674 */
+            if (pIds->back().missing())
+                pIds->back() = Value(BSONNULL);
+        }
+    }
+
     void DocumentSourceGroup::populate() {
         const size_t numAccumulators = vpAccumulatorFactory.size();
         dassert(numAccumulators == vpExpression.size());
 
-        for (bool hasNext = !pSource->eof(); hasNext; hasNext = pSource->advance()) {
-            Document input  = pSource->getCurrent();
+        if (streaming) {
+            pAccumulatorCtx = pExpCtx->clone();
+            populated = true;
+            streamNext();
+            return;
+        }
 
-            /* get the _id value */
-            Value id = pIdExpression->evaluate(input);
+        /* mongos has nowhere to spill to */
+        const uint64_t spillThreshold = (pExpCtx->getInRouter()
+                                         ? 0 : static_cast<uint64_t>(aggregationSpillThreshold));
+        pAccumulatorCtx = pExpCtx->clone();
 
-            /* treat missing values the same as NULL SERVER-4674 */
-            if (id.missing())
-                id = Value(BSONNULL);
+        vector<Document> batch;
+        vector<Value> ids;
+        for (bool more = true; more; ) {
+            batch.clear();
+            more = pSource->getNextBatch(batch, batchSize);
 
-            /*
-              Look for the _id value in the map; if it's not there, add a
-              new entry with a blank accumulator.
-            */
-            vector<intrusive_ptr<Accumulator> >& group = groups[id];
-
-            if (numAccumulators == 0)
-                continue; // we are basically building a set
-
-            if (group.empty()) {
-                /* add the accumulators */
-                group.reserve(numAccumulators);
-                for (size_t i = 0; i < numAccumulators; i++) {
-                    intrusive_ptr<Accumulator> accum = (*vpAccumulatorFactory[i])(pExpCtx);
-                    accum->addOperand(vpExpression[i]);
-                    group.push_back(accum);
+            /* get the _id values for the whole batch first */
+            evaluateIds(batch, &ids);
+
+            for (size_t j = 0; j < batch.size(); j++) {
+                const Document& input = batch[j];
+                const Value& id = ids[j];
+
+                /*
+                  Look for the _id value in the map; if it's not there, add a
+                  new entry with a blank accumulator.
+                */
+                const size_t nGroups = groups.size();
+                vector<intrusive_ptr<Accumulator> >& group = groups[id];
+                if (groups.size() != nGroups)
+                    memUsage += id.getApproximateSize();
+
+                if (numAccumulators != 0) {
+                    if (group.empty()) {
+                        /* add the accumulators */
+                        group.reserve(numAccumulators);
+                        for (size_t i = 0; i < numAccumulators; i++) {
+                            intrusive_ptr<Accumulator> accum =
+                                (*vpAccumulatorFactory[i])(pAccumulatorCtx);
+                            accum->addOperand(vpExpression[i]);
+                            group.push_back(accum);
+                            memUsage += accum->getMemUsage();
+                        }
+                    }
+
+                    /* tickle all the accumulators for the group we found */
+                    dassert(numAccumulators == group.size());
+                    for (size_t i = 0; i < numAccumulators; i++) {
+                        const size_t before = group[i]->getMemUsage();
+                        group[i]->evaluate(input);
+                        memUsage += group[i]->getMemUsage() - before;
+                    }
                 }
+
+                if (spillThreshold && memUsage > spillThreshold)
+                    spill();
             }
+        }
 
-            /* tickle all the accumulators for the group we found */
-            dassert(numAccumulators == group.size());
-            for (size_t i = 0; i < numAccumulators; i++)
-                group[i]->evaluate(input);
+        if (pSpill) {
+            /* write out what's left so everything is merged the same way */
+            spill();
+            startMerge();
         }
 
         /* start the group iterator */
@@ -331,18 +465,180 @@ namespace mongo {
         populated = true;
     }
 
+    bool DocumentSourceGroup::fillStreamBatch() {
+        while (streamPosition == streamBatch.size()) {
+            if (!streamSourceMore)
+                return false;
+            streamBatch.clear();
+            streamPosition = 0;
+            streamSourceMore = pSource->getNextBatch(streamBatch, batchSize);
+            evaluateIds(streamBatch, &streamIds);
+        }
+        return true;
+    }
+
+    void DocumentSourceGroup::streamNext() {
+        if (!fillStreamBatch()) {
+            streamEof = true;
+            return;
+        }
+
+        const size_t numAccumulators = vpAccumulatorFactory.size();
+        vector<intrusive_ptr<Accumulator> > group;
+        group.reserve(numAccumulators);
+        for (size_t i = 0; i < numAccumulators; i++) {
+            intrusive_ptr<Accumulator> accum = (*vpAccumulatorFactory[i])(pAccumulatorCtx);
+            accum->addOperand(vpExpression[i]);
+            group.push_back(accum);
+        }
+
+        /* the group ends at the first Document with a different _id */
+        const Value id = streamIds[streamPosition];
+        do {
+            const Document& input = streamBatch[streamPosition];
+            for (size_t i = 0; i < numAccumulators; i++)
+                group[i]->evaluate(input);
+            ++streamPosition;
+        } while (fillStreamBatch() && Value::compare(streamIds[streamPosition], id) == 0);
+
+        streamCurrent = makeDocument(id, group);
+    }
+
+    /* orders the groups table by _id */
+    struct GroupIdLess {
+        template <typename GroupIterator>
+        bool operator()(const GroupIterator &lhs, const GroupIterator &rhs) const {
+            return Value::compare(lhs->first, rhs->first) < 0;
+        }
+    };
+
+    void DocumentSourceGroup::spill() {
+        if (!pSpill)
+            pSpill.reset(new SpillFile());
+
+        /* runs are sorted by _id so they can be merged */
+        typedef vector<GroupsType::iterator> SortedGroups;
+        SortedGroups sorted;
+        sorted.reserve(groups.size());
+        for (GroupsType::iterator it = groups.begin(); it != groups.end(); ++it)
+            sorted.push_back(it);
+        sort(sorted.begin(), sorted.end(), GroupIdLess());
+
+        /* write partial values, as a shard would, for the merge to combine */
+        const bool inShard = pAccumulatorCtx->getInShard();
+        pAccumulatorCtx->setInShard(true);
+
+        const size_t n = vFieldName.size();
+        for (SortedGroups::const_iterator it = sorted.begin(); it != sorted.end(); ++it) {
+            const vector<intrusive_ptr<Accumulator> > &group = (*it)->second;
+            MutableDocument out (1 + n);
+            out.addField("_id", (*it)->first);
+            for (size_t i = 0; i < n; ++i) {
+                /* missing values stay missing, the merge sees them as missing too */
+                out.addField(vFieldName[i], group[i]->getValue());
+            }
+
+            BSONObjBuilder builder;
+            out.freeze().toBson(&builder);
+            pSpill->write(builder.done());
+        }
+
+        pAccumulatorCtx->setInShard(inShard);
+
+        pSpill->endRun();
+        GroupsType().swap(groups);
+        memUsage = 0;
+
+        bytesSpilled = pSpill->bytesSpilled();
+        nRuns = pSpill->numRuns();
+    }
+
+    bool DocumentSourceGroup::MergeEntryGreater::operator()(const MergeEntry &lhs,
+                                                            const MergeEntry &rhs) const {
+        const int cmp = Value::compare(lhs.id, rhs.id);
+        return cmp ? cmp > 0 : lhs.run > rhs.run;
+    }
+
+    void DocumentSourceGroup::startMerge() {
+        LOG(1) << "$group merging " << nRuns << " runs, " << bytesSpilled
+               << " bytes spilled" << endl;
+
+        for (size_t run = 0; run < pSpill->numRuns(); run++) {
+            MergeEntry entry;
+            entry.reader.reset(new SpillFile::Reader(*pSpill, run));
+            entry.doc = Document(entry.reader->next());
+            entry.id = entry.doc["_id"];
+            entry.run = run;
+            mergeHeap.push_back(entry);
+        }
+        make_heap(mergeHeap.begin(), mergeHeap.end(), MergeEntryGreater());
+
+        mergeNext();
+    }
+
+    void DocumentSourceGroup::mergeNext() {
+        if (mergeHeap.empty()) {
+            mergedEof = true;
+            return;
+        }
+
+        /* combine the partial values the same way the router does */
+        intrusive_ptr<ExpressionContext> pMergeCtx = pExpCtx->clone();
+        pMergeCtx->setDoingMerge(true);
+
+        const size_t n = vFieldName.size();
+        vector<intrusive_ptr<Accumulator> > accums;
+        accums.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            intrusive_ptr<Accumulator> accum = (*vpAccumulatorFactory[i])(pMergeCtx);
+            accum->addOperand(ExpressionFieldPath::create(vFieldName[i]));
+            accums.push_back(accum);
+        }
+
+        /* equal _ids come off the heap in run order, so $first and $last still work */
+        const Value id = mergeHeap.front().id;
+        while (!mergeHeap.empty() && Value::compare(mergeHeap.front().id, id) == 0) {
+            pop_heap(mergeHeap.begin(), mergeHeap.end(), MergeEntryGreater());
+            MergeEntry &entry = mergeHeap.back();
+            for (size_t i = 0; i < n; ++i)
+                accums[i]->evaluate(entry.doc);
+
+            if (entry.reader->more()) {
+                entry.doc = Document(entry.reader->next());
+                entry.id = entry.doc["_id"];
+                push_heap(mergeHeap.begin(), mergeHeap.end(), MergeEntryGreater());
+            }
+            else {
+                mergeHeap.pop_back();
+            }
+        }
+
+        MutableDocument out (1 + n);
+        out.addField("_id", id);
+        for (size_t i = 0; i < n; ++i) {
+            Value pValue(accums[i]->getValue());
+            if (pValue.missing()) {
+                // we return null in this case so return objects are predictable
+                out.addField(vFieldName[i], Value(BSONNULL));
+            }
+            else {
+                out.addField(vFieldName[i], pValue);
+            }
+        }
+        mergedCurrent = out.freeze();
+    }
+
     Document DocumentSourceGroup::makeDocument(
-        const GroupsType::iterator &rIter) {
-        vector<intrusive_ptr<Accumulator> > *pGroup = &rIter->second;
+        const Value &id, const vector<intrusive_ptr<Accumulator> > &group) {
         const size_t n = vFieldName.size();
         MutableDocument out (1 + n);
 
         /* add the _id field */
-        out.addField("_id", rIter->first);
+        out.addField("_id", id);
 
         /* add the rest of the fields */
         for(size_t i = 0; i < n; ++i) {
-            Value pValue((*pGroup)[i]->getValue());
+            Value pValue(group[i]->getValue());
             if (pValue.missing()) {
                 // we return null in this case so return objects are predictable
                 out.addField(vFieldName[i], Value(BSONNULL));
@@ -44,17 +44,21 @@ namespace mongo {
 
         /*
           The matcher only takes BSON documents, so we have to make one.
-
-          LATER
-          We could optimize this by making a document with only the
-          fields referenced by the Matcher.  We could do this by looking inside
-          the Matcher's BSON before it is created, and recording those.  The
-          easiest implementation might be to hold onto an ExpressionDocument
-          in here, and give that pDocument to create the created subset of
-          fields, and then convert that instead.
+          Only the fields the matcher references are converted, the order
+          of top level fields doesn't matter to it.
         */
         BSONObjBuilder objBuilder;
-        pDocument->toBson(&objBuilder);
+        if (allFields) {
+            pDocument->toBson(&objBuilder);
+        }
+        else {
+            for (vector<string>::const_iterator it = matcherFields.begin();
+                 it != matcherFields.end(); ++it) {
+                const Value value(pDocument->getField(*it));
+                if (!value.missing())
+                    value.addToBsonObj(&objBuilder, *it);
+            }
+        }
         BSONObj obj(objBuilder.done());
 
         return matcher.matches(obj);
@@ -99,5 +103,8 @@ namespace mongo {
         const intrusive_ptr<ExpressionContext> &pExpCtx):
         DocumentSourceFilterBase(pExpCtx),
         matcher(query.getOwned()) {
+        set<string> fields;
+        allFields = !matcher.referencedTopLevelFields(&fields);
+        matcherFields.assign(fields.begin(), fields.end());
     }
 }
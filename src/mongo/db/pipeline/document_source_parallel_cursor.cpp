@@ -0,0 +1,319 @@
+/**
+*    Copyright (C) 2014 Tokutek Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mongo/pch.h"
+
+#include "mongo/db/pipeline/document_source.h"
+
+#include <boost/thread/thread.hpp>
+
+#include "mongo/db/client.h"
+#include "mongo/db/interrupt_status_mongod.h"
+#include "mongo/db/namespacestring.h"
+#include "mongo/db/parallel_scan.h"
+#include "mongo/db/pipeline/pipeline.h"
+#include "mongo/db/pipeline/pipeline_d.h"
+
+namespace mongo {
+
+    DocumentSourceParallelCursor::~DocumentSourceParallelCursor() {
+    }
+
+    bool DocumentSourceParallelCursor::eof() {
+        return !fillResults();
+    }
+
+    bool DocumentSourceParallelCursor::advance() {
+        DocumentSource::advance(); // check for interrupts
+
+        if (position < results.size())
+            ++position;
+        return fillResults();
+    }
+
+    Document DocumentSourceParallelCursor::getCurrent() {
+        verify(!eof());
+        return results[position];
+    }
+
+    bool DocumentSourceParallelCursor::getNextBatch(vector<Document>& batch, size_t maxDocs) {
+        pExpCtx->checkForInterrupt();
+
+        if (!fillResults())
+            return false;
+        const size_t n = std::min(maxDocs, results.size() - position);
+        batch.insert(batch.end(), results.begin() + position, results.begin() + position + n);
+        position += n;
+        return fillResults();
+    }
+
+    bool DocumentSourceParallelCursor::fillResults() {
+        /* once the results kept in memory are used up, read back the spilled ones */
+        while (position >= results.size()) {
+            if (!pSpill)
+                return false;
+
+            if (pSpillReader && pSpillReader->more()) {
+                results.clear();
+                position = 0;
+                while (results.size() < batchSize && pSpillReader->more())
+                    results.push_back(Document(pSpillReader->next()));
+                continue;
+            }
+
+            pSpillReader.reset();
+            if (spillRun == pSpill->numRuns()) {
+                pSpill.reset();
+                return false;
+            }
+            pSpillReader.reset(new SpillFile::Reader(*pSpill, spillRun++));
+        }
+        return true;
+    }
+
+    void DocumentSourceParallelCursor::setSource(DocumentSource *pSource) {
+        /* this doesn't take a source */
+        verify(false);
+    }
+
+    void DocumentSourceParallelCursor::dispose() {
+        vector<Document>().swap(results);
+        position = 0;
+        pSpillReader.reset();
+        pSpill.reset();
+    }
+
+    void DocumentSourceParallelCursor::sourceToBson(
+        BSONObjBuilder *pBuilder, bool explain) const {
+
+        /* this has no analog in the BSON world, so only allow it for explain */
+        if (explain) {
+            BSONObjBuilder insides(pBuilder->subobjStart("parallelCursor"));
+            insides.append("ns", ns);
+            insides.append("ranges", static_cast<int>(splitKeys.size() + 1));
+            insides.append("threads", nThreads);
+            insides.append(shardPipeline["pipeline"]);
+            insides.doneFast();
+        }
+    }
+
+    DocumentSourceParallelCursor::DocumentSourceParallelCursor(
+        const string &ns,
+        const BSONObj &shardPipeline,
+        const vector<BSONObj> &splitKeys,
+        int nThreads,
+        const intrusive_ptr<ExpressionContext> &pExpCtx):
+        DocumentSource(pExpCtx),
+        ns(ns),
+        shardPipeline(shardPipeline.getOwned()),
+        splitKeys(splitKeys),
+        nThreads(nThreads),
+        rangesStarted(0),
+        workersRunning(0),
+        aborted(false),
+        errorCode(0),
+        workerSpillThreshold(0),
+        position(0),
+        spillRun(0) {
+        for (vector<BSONObj>::iterator it = this->splitKeys.begin();
+             it != this->splitKeys.end(); ++it) {
+            *it = it->getOwned();
+        }
+    }
+
+    intrusive_ptr<DocumentSourceParallelCursor> DocumentSourceParallelCursor::create(
+        const string &ns,
+        const BSONObj &shardPipeline,
+        const vector<BSONObj> &splitKeys,
+        int nThreads,
+        const intrusive_ptr<ExpressionContext> &pExpCtx) {
+        verify(nThreads > 0);
+        intrusive_ptr<DocumentSourceParallelCursor> pSource(
+            new DocumentSourceParallelCursor(ns, shardPipeline, splitKeys, nThreads, pExpCtx));
+        return pSource;
+    }
+
+    void DocumentSourceParallelCursor::run() {
+        /* there is no point in having more workers than ranges */
+        const size_t nRanges = splitKeys.size() + 1;
+        const int nWorkers = static_cast<int>(std::min(static_cast<size_t>(nThreads), nRanges));
+        workerOutput.resize(nWorkers);
+        workerMemUsage.resize(nWorkers);
+
+        /*
+          The partial results wait here until every range is done, so the
+          workers share aggregationSpillThreshold and each spills its output
+          once it holds more than its part of it.
+        */
+        workerSpillThreshold = static_cast<uint64_t>(aggregationSpillThreshold) / nWorkers;
+        if (aggregationSpillThreshold && !workerSpillThreshold)
+            workerSpillThreshold = 1;
+
+        boost::thread_group workers;
+        try {
+            for (int i = 0; i < nWorkers; i++) {
+                {
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    ++workersRunning;
+                }
+                try {
+                    workers.create_thread(
+                        boost::bind(&DocumentSourceParallelCursor::workerThread, this, i));
+                }
+                catch (...) {
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    --workersRunning;
+                    throw;
+                }
+            }
+
+            /* wake up now and then to see if we were killed */
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (workersRunning > 0) {
+                doneCond.timed_wait(lock, boost::posix_time::milliseconds(100));
+                pExpCtx->checkForInterrupt();
+            }
+        }
+        catch (...) {
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                aborted = true;
+            }
+            workers.join_all();
+            throw;
+        }
+        workers.join_all();
+
+        if (!errorMessage.empty()) {
+            uasserted(errorCode, errorMessage);
+        }
+
+        /* the order of the partial results doesn't matter to the merge */
+        size_t total = 0;
+        for (size_t i = 0; i < workerOutput.size(); i++)
+            total += workerOutput[i].size();
+        results.reserve(total);
+        for (size_t i = 0; i < workerOutput.size(); i++) {
+            results.insert(results.end(), workerOutput[i].begin(), workerOutput[i].end());
+            vector<Document>().swap(workerOutput[i]);
+        }
+        position = 0;
+
+        if (pSpill) {
+            LOG(1) << "parallel aggregation spilled " << pSpill->numRuns() << " runs, "
+                   << pSpill->bytesSpilled() << " bytes" << endl;
+        }
+    }
+
+    void DocumentSourceParallelCursor::workerThread(size_t id) {
+        const string threadName = str::stream() << "aggregate worker " << id;
+        Client::initThread(threadName.c_str());
+
+        try {
+            size_t range;
+            while (nextRange(&range)) {
+                runRange(range, id);
+            }
+        }
+        catch (const DBException &e) {
+            fail(e.getCode(), e.what());
+        }
+        catch (const std::exception &e) {
+            fail(17389, str::stream() << "parallel aggregation worker failed: " << e.what());
+        }
+
+        cc().shutdown();
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (--workersRunning == 0) {
+            doneCond.notify_all();
+        }
+    }
+
+    void DocumentSourceParallelCursor::runRange(size_t range, size_t id) {
+        /* each range gets a pipeline of its own; they can't be shared between threads */
+        intrusive_ptr<ExpressionContext> pCtx(
+            ExpressionContext::create(&InterruptStatusMongod::status));
+        pCtx->setInShard(true);
+
+        string errmsg;
+        BSONObj cmdObj(shardPipeline);
+        intrusive_ptr<Pipeline> pPipeline(Pipeline::parseCommand(errmsg, cmdObj, pCtx));
+        uassert(17388, str::stream() << "parallel aggregation could not parse its pipeline: "
+                                     << errmsg,
+                pPipeline.get());
+
+        PipelineD::prepareCursorSource(pPipeline, nsToDatabase(ns), pCtx,
+                                       parallelScanMin(splitKeys, range),
+                                       parallelScanMax(splitKeys, range));
+        pPipeline->stitch();
+
+        DocumentSource *pSource = pPipeline->output();
+        vector<Document> &output = workerOutput[id];
+        for (bool more = true; more && !isAborted(); ) {
+            const size_t before = output.size();
+            more = pSource->getNextBatch(output, batchSize);
+            for (size_t i = before; i < output.size(); i++)
+                workerMemUsage[id] += output[i].getApproximateSize();
+
+            if (workerSpillThreshold && workerMemUsage[id] > workerSpillThreshold)
+                spill(id);
+        }
+    }
+
+    void DocumentSourceParallelCursor::spill(size_t id) {
+        vector<Document> &output = workerOutput[id];
+
+        /* a run must be written in one piece, so workers take turns */
+        {
+            boost::unique_lock<boost::mutex> lock(spillMutex);
+            if (!pSpill)
+                pSpill.reset(new SpillFile());
+            for (size_t i = 0; i < output.size(); i++) {
+                BSONObjBuilder builder;
+                output[i].toBson(&builder);
+                pSpill->write(builder.done());
+            }
+            pSpill->endRun();
+        }
+
+        vector<Document>().swap(output);
+        workerMemUsage[id] = 0;
+    }
+
+    bool DocumentSourceParallelCursor::nextRange(size_t *pRange) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (aborted || rangesStarted > splitKeys.size())
+            return false;
+        *pRange = rangesStarted++;
+        return true;
+    }
+
+    void DocumentSourceParallelCursor::fail(int code, const string &message) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (errorMessage.empty()) {
+            errorCode = (code != 0 ? code : 17389);
+            errorMessage = message;
+        }
+        aborted = true;
+    }
+
+    bool DocumentSourceParallelCursor::isAborted() {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        return aborted;
+    }
+
+}
@@ -49,8 +49,24 @@ namespace mongo {
     }
 
     Document DocumentSourceProject::getCurrent() {
-        Document pInDocument(pSource->getCurrent());
+        return project(pSource->getCurrent());
+    }
+
+    bool DocumentSourceProject::getNextBatch(vector<Document>& batch, size_t maxDocs) {
+        pExpCtx->checkForInterrupt();
+
+        inputBatch.clear();
+        const bool more = pSource->getNextBatch(inputBatch, maxDocs);
+        batch.reserve(batch.size() + inputBatch.size());
+        for (vector<Document>::const_iterator it = inputBatch.begin();
+             it != inputBatch.end(); ++it) {
+            batch.push_back(project(*it));
+        }
+        inputBatch.clear();
+        return more;
+    }
 
+    Document DocumentSourceProject::project(const Document& pInDocument) const {
         /* create the result document */
         const size_t sizeHint = pEO->getSizeHint();
         MutableDocument out (sizeHint);
@@ -68,7 +84,7 @@ namespace mongo {
             // Make sure we return the same results as Projection class
 
             BSONObjBuilder inputBuilder;
-            pSource->getCurrent()->toBson(&inputBuilder);
+            pInDocument->toBson(&inputBuilder);
             BSONObj input = inputBuilder.done();
 
             BSONObjBuilder outputBuilder;
@@ -40,6 +40,9 @@ namespace mongo {
         if (!populated)
             populate();
 
+        if (pSpill)
+            return mergeHeap.empty();
+
         return documents.empty();
     }
 
@@ -49,6 +52,24 @@ namespace mongo {
         if (!populated)
             populate();
 
+        if (pSpill) {
+            if (!mergeHeap.empty()) {
+                /* replace the current document with the next one from its run */
+                MergeComparator comparator(*this);
+                pop_heap(mergeHeap.begin(), mergeHeap.end(), comparator);
+                MergeEntry &entry = mergeHeap.back();
+                if (entry.reader->more()) {
+                    entry.kd = KeyAndDoc(Document(entry.reader->next()), vSortKey);
+                    push_heap(mergeHeap.begin(), mergeHeap.end(), comparator);
+                }
+                else {
+                    mergeHeap.pop_back();
+                }
+            }
+
+            return !mergeHeap.empty();
+        }
+
         if (!documents.empty())
             documents.pop_front(); // this way we release memory as we go
 
@@ -56,6 +77,11 @@ namespace mongo {
     }
 
     Document DocumentSourceSort::getCurrent() {
+        if (pSpill) {
+            verify(!mergeHeap.empty());
+            return mergeHeap.front().kd.doc;
+        }
+
         verify(!documents.empty());
         return documents.front().doc;
     }
@@ -71,6 +97,9 @@ namespace mongo {
             if (explain && limitSrc) {
                 insides.appendNumber("limit", limitSrc->getLimit());
             }
+
+            insides.appendNumber("bytesSpilled", bytesSpilled);
+            insides.appendNumber("runs", static_cast<long long>(nRuns));
             insides.doneFast();
             sortObj.doneFast();
         }
@@ -91,12 +120,16 @@ namespace mongo {
 
     void DocumentSourceSort::dispose() {
         documents.clear();
+        mergeHeap.clear();
+        pSpill.reset();
         pSource->dispose();
     }
 
     DocumentSourceSort::DocumentSourceSort(const intrusive_ptr<ExpressionContext> &pExpCtx)
         : SplittableDocumentSource(pExpCtx)
         , populated(false)
+        , bytesSpilled(0)
+        , nRuns(0)
     {}
 
     long long DocumentSourceSort::getLimit() const {
@@ -211,10 +244,30 @@ namespace mongo {
         /* track and warn about how much physical memory has been used */
         DocMemMonitor dmm(this);
 
+        /* mongos has nowhere to spill to */
+        const uint64_t spillThreshold = (pExpCtx->getInRouter()
+                                         ? 0 : static_cast<uint64_t>(aggregationSpillThreshold));
+        size_t memUsage = 0;
+
         /* pull everything from the underlying source */
         for (bool hasNext = !pSource->eof(); hasNext; hasNext = pSource->advance()) {
             documents.push_back(KeyAndDoc(pSource->getCurrent(), vSortKey));
-            dmm.addToTotal(documents.back().doc.getApproximateSize());
+            const size_t size = documents.back().doc.getApproximateSize();
+            dmm.addToTotal(size);
+            memUsage += size;
+
+            if (spillThreshold && memUsage > spillThreshold) {
+                spill();
+                dmm.subtractFromTotal(memUsage);
+                memUsage = 0;
+            }
+        }
+
+        if (pSpill) {
+            /* write out what's left so everything is merged the same way */
+            spill();
+            startMerge();
+            return;
         }
 
         /* sort the list */
@@ -222,6 +275,38 @@ namespace mongo {
         sort(documents.begin(), documents.end(), comparator);
     }
 
+    void DocumentSourceSort::spill() {
+        if (!pSpill)
+            pSpill.reset(new SpillFile());
+
+        Comparator comparator(*this);
+        sort(documents.begin(), documents.end(), comparator);
+
+        for (deque<KeyAndDoc>::const_iterator it = documents.begin(); it != documents.end(); ++it) {
+            BSONObjBuilder builder;
+            it->doc.toBson(&builder);
+            pSpill->write(builder.done());
+        }
+        pSpill->endRun();
+        documents.clear();
+
+        bytesSpilled = pSpill->bytesSpilled();
+        nRuns = pSpill->numRuns();
+    }
+
+    void DocumentSourceSort::startMerge() {
+        LOG(1) << "$sort merging " << nRuns << " runs, " << bytesSpilled
+               << " bytes spilled" << endl;
+
+        for (size_t run = 0; run < pSpill->numRuns(); run++) {
+            boost::shared_ptr<SpillFile::Reader> reader(new SpillFile::Reader(*pSpill, run));
+            mergeHeap.push_back(MergeEntry(Document(reader->next()), vSortKey, run, reader));
+        }
+
+        MergeComparator comparator(*this);
+        make_heap(mergeHeap.begin(), mergeHeap.end(), comparator);
+    }
+
     void DocumentSourceSort::populateOne() {
         if (pSource->eof())
             return;
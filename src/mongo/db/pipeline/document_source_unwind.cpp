@@ -177,6 +177,23 @@ namespace mongo {
         return _unwinder->getCurrent();
     }
 
+    bool DocumentSourceUnwind::getNextBatch(vector<Document>& batch, size_t maxDocs) {
+        pExpCtx->checkForInterrupt();
+        lazyInit();
+
+        // Unlike the other streaming stages, pSource stays on the document being unwound, so
+        // it is still advanced a document at a time.
+        for (size_t n = 0; n < maxDocs; ++n) {
+            if (_unwinder->eof()) {
+                return false;
+            }
+            batch.push_back(_unwinder->getCurrent());
+            _unwinder->advance();
+            mayAdvanceSource();
+        }
+        return !_unwinder->eof();
+    }
+
     void DocumentSourceUnwind::sourceToBson(
         BSONObjBuilder *pBuilder, bool explain) const {
         verify(_unwindPath);
@@ -416,18 +416,21 @@ namespace mongo {
             // cant use subArrayStart() due to error handling
             BSONArrayBuilder resultArray;
             DocumentSource* finalSource = sources.back().get();
-            for (bool hasDoc = !finalSource->eof(); hasDoc; hasDoc = finalSource->advance()) {
-                Document pDocument(finalSource->getCurrent());
-
-                /* add the document to the result set */
-                BSONObjBuilder documentBuilder (resultArray.subobjStart());
-                pDocument->toBson(&documentBuilder);
-                documentBuilder.doneFast();
-                // object will be too large, assert. the extra 1KB is for headers
-                uassert(16389,
-                        str::stream() << "aggregation result exceeds maximum document size ("
-                                      << BSONObjMaxUserSize / (1024 * 1024) << "MB)",
-                        resultArray.len() < BSONObjMaxUserSize - 1024);
+            vector<Document> batch;
+            for (bool more = true; more; ) {
+                batch.clear();
+                more = finalSource->getNextBatch(batch, DocumentSource::batchSize);
+                for (vector<Document>::const_iterator it = batch.begin(); it != batch.end(); ++it) {
+                    /* add the document to the result set */
+                    BSONObjBuilder documentBuilder (resultArray.subobjStart());
+                    (*it)->toBson(&documentBuilder);
+                    documentBuilder.doneFast();
+                    // object will be too large, assert. the extra 1KB is for headers
+                    uassert(16389,
+                            str::stream() << "aggregation result exceeds maximum document size ("
+                                          << BSONObjMaxUserSize / (1024 * 1024) << "MB)",
+                            resultArray.len() < BSONObjMaxUserSize - 1024);
+                }
             }
 
             resultArray.done();
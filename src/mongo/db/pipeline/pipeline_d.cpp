@@ -29,15 +29,150 @@
 #include "mongo/db/parsed_query.h"
 #include "mongo/db/pipeline/document_source.h"
 #include "mongo/db/query_optimizer.h"
+#include "mongo/base/counter.h"
+#include "mongo/db/commands/server_status.h"
+#include "mongo/db/parallel_scan.h"
+#include "mongo/db/server_parameters.h"
 
 
 namespace mongo {
 
-    void PipelineD::prepareCursorSource(
+    /*
+      Number of threads an aggregation may use to run the stages before its
+      first $group over ranges of the primary key.  1 runs every pipeline on
+      the thread that received it.
+     */
+    MONGO_EXPORT_SERVER_PARAMETER(aggregationThreads, int, 1);
+
+    //The aggregations run over ranges of the primary key on several threads
+    static Counter64 parallelPipelinesStats;
+    static ServerStatusMetricField<Counter64> displayParallelPipelines(
+                                                    "aggregate.parallel.pipelines",
+                                                    &parallelPipelinesStats );
+
+    namespace {
+
+        /**
+         * @return the query object for a ParsedQuery that reads query in order, restricted to
+         * the [min, max) range of an index when they are not empty.
+         */
+        BSONObj rangeQuery(const BSONObj &query, const BSONObj &order,
+                           const BSONObj &min, const BSONObj &max) {
+            if (order.isEmpty() && min.isEmpty() && max.isEmpty())
+                return query;
+
+            BSONObjBuilder b;
+            b.append("$query", query);
+            if (!order.isEmpty())
+                b.append("$orderby", order);
+            if (!min.isEmpty())
+                b.append("$min", min);
+            if (!max.isEmpty())
+                b.append("$max", max);
+            return b.obj();
+        }
+
+        /**
+         * @return true if documents read in sortKey order have equal values for paths next to
+         * each other, so that a $group on those paths can stream.  The sort must lead with
+         * exactly those paths, and no index leading with them may be multikey: an array is
+         * indexed by its elements, but grouped as a whole.
+         */
+        bool groupsAreAdjacent(const string &ns, const BSONObj &sortKey,
+                               const vector<string> &paths) {
+            const set<string> pathSet(paths.begin(), paths.end());
+            if (pathSet.empty() || sortKey.nFields() < static_cast<int>(pathSet.size()))
+                return false;
+
+            set<string> sortPrefix;
+            BSONObjIterator sortIt(sortKey);
+            for (size_t i = 0; i < pathSet.size(); i++)
+                sortPrefix.insert(sortIt.next().fieldName());
+            if (sortPrefix != pathSet)
+                return false;
+
+            Collection *cl = getCollection(ns);
+            if (cl == NULL)
+                return false;
+            for (int i = 0; i < cl->nIndexes(); i++) {
+                set<string> indexPrefix;
+                BSONObjIterator keyIt(cl->idx(i).keyPattern());
+                for (size_t j = 0; j < pathSet.size() && keyIt.more(); j++)
+                    indexPrefix.insert(keyIt.next().fieldName());
+                if (indexPrefix == pathSet && cl->isMultikey(i))
+                    return false;
+            }
+            return true;
+        }
+
+    } // namespace
+
+    bool PipelineD::prepareParallelSource(
         const intrusive_ptr<Pipeline> &pPipeline,
         const string &dbName,
         const intrusive_ptr<ExpressionContext> &pExpCtx) {
 
+        const int nThreads = aggregationThreads;
+        if (nThreads <= 1 || pPipeline->isExplain() ||
+            pExpCtx->getInShard() || pExpCtx->getInRouter())
+            return false;
+
+        /*
+          Only a $group can merge partial results, and everything ahead of it
+          must work on one document at a time for the ranges to be split
+          anywhere.  The partial groups reach the merge in whatever order the
+          workers finish, so the $group mustn't care about input order.
+        */
+        Pipeline::SourceContainer& sources = pPipeline->sources;
+        DocumentSourceGroup *pGroup = NULL;
+        for (size_t i = 0; i < sources.size() && !pGroup; i++) {
+            DocumentSource *pSource = sources[i].get();
+            pGroup = dynamic_cast<DocumentSourceGroup *>(pSource);
+            if (!pGroup &&
+                !dynamic_cast<DocumentSourceMatch *>(pSource) &&
+                !dynamic_cast<DocumentSourceProject *>(pSource) &&
+                !dynamic_cast<DocumentSourceUnwind *>(pSource))
+                return false;
+        }
+        if (!pGroup || pGroup->isOrderSensitive())
+            return false;
+
+        BSONObjBuilder queryBuilder;
+        pPipeline->getInitialQuery(&queryBuilder);
+
+        string fullName(dbName + "." + pPipeline->getCollectionName());
+        vector<BSONObj> splitKeys;
+        if (!splitForParallelScan(fullName, queryBuilder.obj(), nThreads, &splitKeys))
+            return false;
+
+        /*
+          Split the pipeline the way a sharded aggregation is split, with the
+          ranges as the shards.  The $group's merging half stays at the front
+          of this pipeline, and reads the partial groups from the workers.
+        */
+        intrusive_ptr<Pipeline> pShardPipeline(pPipeline->splitForSharded());
+        BSONObjBuilder shardBuilder;
+        pShardPipeline->toBson(&shardBuilder);
+
+        intrusive_ptr<DocumentSourceParallelCursor> pSource(
+            DocumentSourceParallelCursor::create(
+                fullName, shardBuilder.obj(), splitKeys, nThreads, pExpCtx));
+
+        /* run it now, while we don't hold a lock the workers could wait behind */
+        pSource->run();
+
+        pPipeline->addInitialSource(pSource);
+        parallelPipelinesStats.increment();
+        return true;
+    }
+
+    void PipelineD::prepareCursorSource(
+        const intrusive_ptr<Pipeline> &pPipeline,
+        const string &dbName,
+        const intrusive_ptr<ExpressionContext> &pExpCtx,
+        const BSONObj &min,
+        const BSONObj &max) {
+
         // We will be modifying the source vector as we go
         Pipeline::SourceContainer& sources = pPipeline->sources;
 
@@ -52,6 +187,11 @@ namespace mongo {
             }
         }
 
+        /* a range is already a worker's share of a parallel pipeline */
+        if (min.isEmpty() && max.isEmpty() &&
+            prepareParallelSource(pPipeline, dbName, pExpCtx))
+            return;
+
         /* look for an initial match */
         BSONObjBuilder queryBuilder;
         bool initQuery = pPipeline->getInitialQuery(&queryBuilder);
@@ -118,6 +258,20 @@ namespace mongo {
         /* Create the sort object; see comments on the query object above */
         shared_ptr<BSONObj> pSortObj(new BSONObj(sortBuilder.obj()));
 
+        /*
+          Look for a $group on a field path right after the cursor (or after
+          an initial $sort).  If the cursor returns equal group keys next to
+          each other, the group can emit each group as soon as the key
+          changes instead of holding all of them until the input runs out.
+        */
+        intrusive_ptr<DocumentSourceGroup> pGroup;
+        vector<string> groupPaths;
+        if (sources.size() > (pSort ? 1U : 0U)) {
+            pGroup = dynamic_cast<DocumentSourceGroup *>(sources[pSort ? 1 : 0].get());
+            if (pGroup && !pGroup->getIdFieldPaths(&groupPaths))
+                pGroup.reset();
+        }
+
         /* get the full "namespace" name */
         string fullName(dbName + "." + pPipeline->getCollectionName());
 
@@ -162,7 +316,7 @@ namespace mongo {
         shared_ptr<Cursor> pCursor;
         bool initSort = false;
         if (pSort) {
-            const BSONObj queryAndSort = BSON("$query" << *pQueryObj << "$orderby" << *pSortObj);
+            const BSONObj queryAndSort = rangeQuery(*pQueryObj, *pSortObj, min, max);
             shared_ptr<ParsedQuery> pq (new ParsedQuery(
                         fullName.c_str(), 0, 0, QueryOption_NoCursorTimeout, queryAndSort, projection));
 
@@ -186,9 +340,40 @@ namespace mongo {
             }
         }
 
+        bool groupSort = false;
+        if (!pCursor.get() && !pSort && pGroup && pQueryObj->isEmpty() &&
+            min.isEmpty() && max.isEmpty()) {
+            /*
+              With nothing to match, an index on the group key gives the
+              order for free.  We don't do this for a query, because the
+              ordered plan could pass over a more selective index; a $sort on
+              the group key ahead of the $group asks for it explicitly.
+            */
+            BSONObjBuilder groupOrder;
+            for (size_t i = 0; i < groupPaths.size(); i++)
+                groupOrder.append(groupPaths[i], 1);
+            shared_ptr<BSONObj> pGroupSortObj(new BSONObj(groupOrder.obj()));
+
+            if (groupsAreAdjacent(fullName, *pGroupSortObj, groupPaths)) {
+                shared_ptr<ParsedQuery> pq (new ParsedQuery(
+                            fullName.c_str(), 0, 0, QueryOption_NoCursorTimeout,
+                            BSON("$query" << *pQueryObj << "$orderby" << *pGroupSortObj),
+                            projection));
+
+                pCursor = getOptimizedCursor(
+                    fullName.c_str(), *pQueryObj, *pGroupSortObj,
+                    QueryPlanSelectionPolicy::any(), pq);
+                if (pCursor.get()) {
+                    pSortObj = pGroupSortObj;
+                    groupSort = true;
+                }
+            }
+        }
+
         if (!pCursor.get()) {
             shared_ptr<ParsedQuery> pq (new ParsedQuery(
-                        fullName.c_str(), 0, 0, QueryOption_NoCursorTimeout, *pQueryObj, projection));
+                        fullName.c_str(), 0, 0, QueryOption_NoCursorTimeout,
+                        rangeQuery(*pQueryObj, BSONObj(), min, max), projection));
 
             /* try to create the cursor without the sort */
             shared_ptr<Cursor> pUnsortedCursor(
@@ -217,9 +402,14 @@ namespace mongo {
           own copies of them.
         */
         pSource->setQuery(pQueryObj);
-        if (initSort)
+        if (initSort || groupSort)
             pSource->setSort(pSortObj);
 
+        if (pGroup && (groupSort || (initSort && sources.front() == pGroup &&
+                                     groupsAreAdjacent(fullName, *pSortObj, groupPaths)))) {
+            pGroup->setStreaming(true);
+        }
+
         if (haveProjection) {
             pSource->setProjection(projection, dependencies);
         }
@@ -19,6 +19,8 @@
 
 #include "mongo/pch.h"
 
+#include "mongo/db/jsobj.h"
+
 namespace mongo {
     class DocumentSourceCursor;
     class Pipeline;
@@ -48,17 +50,46 @@ namespace mongo {
 
            The cursor is added to the front of the pipeline's sources.
 
+           If the aggregationThreads parameter allows it, the part of the
+           pipeline before its first $group may instead be run on several
+           threads over ranges of the primary key, see prepareParallelSource().
+
            @param pPipeline the logical "this" for this operation
            @param dbName the name of the database
            @param pExpCtx the expression context for this pipeline
+           @param min if not empty, the inclusive lower bound ($min) of the
+             primary key range to read
+           @param max if not empty, the exclusive upper bound ($max) of the
+             primary key range to read
          */
         static void prepareCursorSource(
             const intrusive_ptr<Pipeline> &pPipeline,
             const string &dbName,
-            const intrusive_ptr<ExpressionContext> &pExpCtx);
+            const intrusive_ptr<ExpressionContext> &pExpCtx,
+            const BSONObj &min = BSONObj(),
+            const BSONObj &max = BSONObj());
 
     private:
         PipelineD(); // does not exist:  prevent instantiation
+
+        /**
+           If the pipeline starts with $match, $project and $unwind stages
+           followed by a $group that doesn't depend on the order of its input
+           ($first, $last and $push do), and would otherwise scan the whole primary
+           key, split the pipeline the way a sharded aggregation is split and
+           run the shard half over ranges of the primary key on several
+           threads, adding a DocumentSourceParallelCursor with the partial
+           groups in front of the merging $group.
+
+           Must be called without a lock or a transaction.
+
+           @returns true if the pipeline was prepared this way, false if
+             nothing was changed
+         */
+        static bool prepareParallelSource(
+            const intrusive_ptr<Pipeline> &pPipeline,
+            const string &dbName,
+            const intrusive_ptr<ExpressionContext> &pExpCtx);
     };
 
 } // namespace mongo
@@ -0,0 +1,138 @@
+/**
+*    Copyright (C) 2014 Tokutek Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+
+#include "db/pipeline/spill_file.h"
+
+#include <boost/filesystem/operations.hpp>
+
+#include "db/cmdline.h"
+#include "db/server_parameters.h"
+#include "util/mongoutils/str.h"
+
+namespace mongo {
+    using namespace mongoutils;
+
+    extern string dbpath;
+
+    MONGO_EXPORT_SERVER_PARAMETER(aggregationSpillThreshold, BytesQuantity<uint64_t>,
+                                  StringData("100MB"));
+
+    // Readers fetch at least this much of their run at a time.
+    static const size_t readBufferSize = 64 * 1024;
+
+    SpillFile::SpillFile()
+        : _writing(true),
+          _runStart(0),
+          _bytesSpilled(0) {
+        boost::filesystem::path dir(cmdLine.tmpDir.empty() ? dbpath : cmdLine.tmpDir);
+        dir /= "_tmp";
+        try {
+            boost::filesystem::create_directories(dir);
+        }
+        catch (const boost::filesystem::filesystem_error &e) {
+            uasserted(17364, str::stream() << "could not create directory " << dir.string()
+                             << " for aggregation spill files: " << e.what());
+        }
+        _path = (dir / (string("aggSpill.") + OID::gen().str())).string();
+
+        _stream.open(_path.c_str(), ios_base::in | ios_base::out | ios_base::trunc | ios_base::binary);
+        uassert(17361, str::stream() << "could not open aggregation spill file " << _path,
+                _stream.is_open());
+    }
+
+    SpillFile::~SpillFile() {
+        _stream.close();
+        try {
+            boost::filesystem::remove(_path);
+        }
+        catch (const boost::filesystem::filesystem_error &e) {
+            warning() << "could not remove aggregation spill file " << _path << ": "
+                      << e.what() << endl;
+        }
+    }
+
+    void SpillFile::write(const BSONObj &obj) {
+        verify(_writing);
+        _stream.write(obj.objdata(), obj.objsize());
+        uassert(17362, str::stream() << "error writing aggregation spill file " << _path,
+                _stream.good());
+        _bytesSpilled += obj.objsize();
+    }
+
+    void SpillFile::endRun() {
+        verify(_writing);
+        const long long runEnd = _bytesSpilled;
+        if (runEnd > _runStart) {
+            _runs.push_back(make_pair(_runStart, runEnd));
+            _runStart = runEnd;
+        }
+    }
+
+    SpillFile::Reader::Reader(SpillFile &file, size_t run)
+        : _file(file),
+          _pos(file._runs[run].first),
+          _end(file._runs[run].second),
+          _bufPos(0),
+          _bufLen(0) {
+        if (_file._writing) {
+            verify(_file._runStart == _file._bytesSpilled); // every run must be finished
+            _file._stream.flush();
+            _file._writing = false;
+        }
+    }
+
+    BSONObj SpillFile::Reader::next() {
+        verify(more());
+        fill(4);
+        const int size = *reinterpret_cast<const int *>(&_buf[_bufPos]);
+        fill(size);
+        BSONObj obj(&_buf[_bufPos]);
+        _bufPos += size;
+        _pos += size;
+        return obj;
+    }
+
+    void SpillFile::Reader::fill(size_t needed) {
+        if (_bufLen - _bufPos >= needed) {
+            return;
+        }
+
+        // keep what we have left of the current object, and read the rest of it plus as much
+        // more as fits
+        const size_t have = _bufLen - _bufPos;
+        const long long remaining = _end - _pos;
+        const size_t toRead = std::min(static_cast<long long>(std::max(readBufferSize, needed)),
+                                       remaining) - have;
+        std::vector<char> newBuf(have + toRead);
+        if (have > 0) {
+            memcpy(&newBuf[0], &_buf[_bufPos], have);
+        }
+        _buf.swap(newBuf);
+        _bufPos = 0;
+        _bufLen = have + toRead;
+
+        std::fstream &stream = _file._stream;
+        stream.clear();
+        stream.seekg(_pos + have);
+        stream.read(&_buf[have], toRead);
+        uassert(17363, str::stream() << "error reading aggregation spill file " << _file._path,
+                stream.good() && static_cast<size_t>(stream.gcount()) == toRead);
+        verify(_bufLen >= needed);
+    }
+
+}
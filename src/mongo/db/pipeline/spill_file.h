@@ -0,0 +1,94 @@
+/**
+*    Copyright (C) 2014 Tokutek Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "mongo/pch.h"
+
+#include <fstream>
+
+#include "mongo/base/units.h"
+#include "mongo/db/jsobj.h"
+
+namespace mongo {
+
+    /*
+      Amount of memory $sort and $group may use for buffered documents and
+      groups before they write what they have to a SpillFile as a sorted run.
+      Zero disables spilling, in which case DocMemMonitor's limits apply.
+     */
+    extern BytesQuantity<uint64_t> aggregationSpillThreshold;
+
+    /*
+      A temporary file of sorted runs of BSON objects, written by the
+      aggregation $sort and $group stages once they exceed
+      aggregationSpillThreshold, and read back to be k-way merged.
+
+      The file goes in the _tmp directory under --tmpDir (or --dbpath if that
+      is not set), next to the bulk loader's temporary files, and is removed
+      when the SpillFile is destroyed.
+
+      Runs are written one after another with write() and endRun().  Once
+      writing is done, each run can be read back with its own Reader; all the
+      Readers share the one file handle and buffer separately, so any number
+      of runs can be merged at once.
+     */
+    class SpillFile : boost::noncopyable {
+    public:
+        SpillFile();
+        ~SpillFile();
+
+        /* append obj to the current run */
+        void write(const BSONObj &obj);
+
+        /* finish the current run, if it has anything in it */
+        void endRun();
+
+        size_t numRuns() const { return _runs.size(); }
+        long long bytesSpilled() const { return _bytesSpilled; }
+
+        class Reader : boost::noncopyable {
+        public:
+            Reader(SpillFile &file, size_t run);
+
+            bool more() const { return _pos < _end; }
+
+            /* the returned object is only valid until the next call to next() */
+            BSONObj next();
+
+        private:
+            void fill(size_t needed);
+
+            SpillFile &_file;
+            long long _pos;  // file offset of the next object, which starts at _buf[_bufPos]
+            long long _end;  // file offset of the end of this run
+            std::vector<char> _buf;
+            size_t _bufPos;
+            size_t _bufLen;
+        };
+
+    private:
+        std::string _path;
+        std::fstream _stream;
+        bool _writing;
+
+        // [start, end) file offsets of each finished run
+        std::vector<std::pair<long long, long long> > _runs;
+        long long _runStart;
+        long long _bytesSpilled;
+    };
+
+}
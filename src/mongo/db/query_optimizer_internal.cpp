@@ -19,7 +19,9 @@
 
 #include "mongo/db/query_optimizer_internal.h"
 
+#include "mongo/base/counter.h"
 #include "mongo/client/dbclientinterface.h"
+#include "mongo/db/commands/server_status.h"
 #include "mongo/db/cursor.h"
 #include "mongo/db/cmdline.h"
 #include "mongo/db/namespacestring.h"
@@ -27,12 +29,22 @@
 #include "mongo/db/parsed_query.h"
 #include "mongo/db/query_plan_selection_policy.h"
 #include "mongo/db/queryutil.h"
+#include "mongo/db/server_parameters.h"
 
 //#define DEBUGQO(x) cout << x << endl;
 #define DEBUGQO(x)
 
 namespace mongo {
 
+    // A cached plan is evicted once this many consecutive runs of it have each scanned
+    // queryCachePlanDriftFactor times more documents per match than the run it was cached for.
+    MONGO_EXPORT_SERVER_PARAMETER(queryCachePlanDriftFactor, int, 10);
+    static const unsigned queryCacheDriftedRunsToEvict = 3;
+
+    static Counter64 queryCachePlansEvicted;
+    static ServerStatusMetricField<Counter64> queryCachePlansEvictedDisplay(
+            "queryOptimizer.cachedPlansEvicted", &queryCachePlansEvicted );
+
     // returns an IndexDetails* for a hint, 0 if hint is $natural.
     // hint must not be eoo()
     IndexDetails* parseHint( const BSONElement& hint, Collection *cl ) {
@@ -668,11 +680,25 @@ namespace mongo {
                                       const CachedQueryPlan& cachedPlan ) {
         verify( nPlans() == 0 );
         _usingCachedPlan = true;
+        _cachedPlan = cachedPlan;
         _oldNScanned = cachedPlan.nScanned();
         _cachedPlanCharacter = cachedPlan.planCharacter();
         pushPlan( plan );
     }
 
+    void QueryPlanSet::noteCachedPlanRun( long long nScanned, long long n ) {
+        verify( _usingCachedPlan );
+        const unsigned costlyRuns = _cachedPlan.noteRun( nScanned, n, queryCachePlanDriftFactor );
+        if ( costlyRuns >= queryCacheDriftedRunsToEvict ) {
+            LOG( 1 ) << "evicting cached plan " << _cachedPlan.indexKey() << " for "
+                     << _originalQuery << " after " << costlyRuns << " costly runs, last one "
+                     << nScanned << " scanned for " << n << " matches, cached for "
+                     << _cachedPlan.nScanned() << " scanned for " << _cachedPlan.n() << endl;
+            QueryUtilIndexed::clearIndexesForPatterns( *_frsp, _order );
+            queryCachePlansEvicted.increment();
+        }
+    }
+
     void QueryPlanSet::addCandidatePlan( const QueryPlanPtr& plan ) {
         // If _plans is nonempty, the new plan may be supplementing a recorded plan at the first
         // position of _plans.  It must not duplicate the first plan.
@@ -906,7 +932,11 @@ namespace mongo {
         if ( runner.complete() ) {
             if ( _plans.mayRecordPlan() && runner.mayRecordPlan() ) {
                 runner.queryPlan().registerSelf( runner.nscanned(),
-                                                 _plans.characterizeCandidatePlans() );
+                                                 _plans.characterizeCandidatePlans(),
+                                                 runner.nMatches() );
+            }
+            else if ( _plans.usingCachedPlan() ) {
+                _plans.noteCachedPlanRun( runner.nscanned(), runner.nMatches() );
             }
             _done = true;
             return holder._runner;
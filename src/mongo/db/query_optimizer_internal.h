@@ -142,6 +142,9 @@ namespace mongo {
          */
         long long nscanned() const;
 
+        /** @return the number of matches counted so far, if this runner is counting them. */
+        long long nMatches() const { return _matchCounter.count(); }
+
         BSONObj currPK() const { return _c ? _c->currPK() : BSONObj(); }
         BSONObj currKey() const { return _c ? _c->currKey() : BSONObj(); }
         BSONObj current() const { return _c ? _c->current() : BSONObj(); }
@@ -404,6 +407,14 @@ namespace mongo {
         void addFallbackPlans();
 
         void setUsingCachedPlan( bool usingCachedPlan ) { _usingCachedPlan = usingCachedPlan; }
+
+        /**
+         * Report how a plan from the plan cache did when run to completion.  If runs of the plan
+         * keep scanning many more documents per match than the run it was cached for, the data
+         * distribution has drifted away from it and the cache entry is cleared, so the next
+         * query for this pattern evaluates all candidate plans again.
+         */
+        void noteCachedPlanRun( long long nScanned, long long n );
         
         //for testing
 
@@ -435,6 +446,7 @@ namespace mongo {
         PlanVector _plans;
         bool _mayRecordPlan;
         bool _usingCachedPlan;
+        CachedQueryPlan _cachedPlan;
         CandidatePlanCharacter _cachedPlanCharacter;
         BSONObj _order;
         long long _oldNScanned;
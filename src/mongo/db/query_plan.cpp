@@ -295,7 +295,8 @@ doneCheckOrder:
     }
 
     void QueryPlan::registerSelf( long long nScanned,
-                                  CandidatePlanCharacter candidatePlans ) const {
+                                  CandidatePlanCharacter candidatePlans,
+                                  long long n ) const {
         // Impossible query constraints can be detected before scanning and historically could not
         // generate a QueryPattern.
         if ( _utility == Impossible ) {
@@ -307,7 +308,7 @@ doneCheckOrder:
             QueryCache &qc = cl->getQueryCache();
             QueryCache::Lock::Exclusive lk(qc);
             QueryPattern queryPattern = _frs.pattern( _order );
-            CachedQueryPlan queryPlanToCache( indexKey(), nScanned, candidatePlans );
+            CachedQueryPlan queryPlanToCache( indexKey(), nScanned, candidatePlans, n );
             qc.registerCachedQueryPlanForPattern( queryPattern, queryPlanToCache );
         }
     }
@@ -92,8 +92,12 @@ namespace mongo {
         /** @return a new cursor based on this QueryPlan's index and FieldRangeSet. */
         shared_ptr<Cursor> newCursor(const bool requestCountingCursor = false) const;
 
-        /** Register this plan as a winner for its QueryPattern, with specified 'nscanned'. */
-        void registerSelf( long long nScanned, CandidatePlanCharacter candidatePlans ) const;
+        /**
+         * Register this plan as a winner for its QueryPattern, with specified 'nscanned' and
+         * number of matches 'n'.
+         */
+        void registerSelf( long long nScanned, CandidatePlanCharacter candidatePlans,
+                           long long n = 0 ) const;
 
         int direction() const { return _direction; }
 
@@ -107,14 +107,30 @@ namespace mongo {
     }
     
     CachedQueryPlan::CachedQueryPlan( const BSONObj &indexKey, long long nScanned,
-                                     CandidatePlanCharacter planCharacter ) :
+                                     CandidatePlanCharacter planCharacter, long long n ) :
     _indexKey( indexKey ),
     _nScanned( nScanned ),
-    _planCharacter( planCharacter ) {
+    _n( n ),
+    _planCharacter( planCharacter ),
+    _costlyRuns( new AtomicUInt32() ) {
     }
 
-    QueryCache::QueryCache() :
-        _qcWriteCount(0) {
+    unsigned CachedQueryPlan::noteRun( long long nScanned, long long n, int factor ) const {
+        if ( !_costlyRuns ) {
+            return 0;
+        }
+        // Compare nscanned per match, cross multiplied.  Runs that scan little are never
+        // costly, whatever their ratio.
+        const bool costly = nScanned > 100 &&
+                nScanned * std::max( _n, 1LL ) > _nScanned * std::max( n, 1LL ) * factor;
+        if ( !costly ) {
+            _costlyRuns->store( 0 );
+            return 0;
+        }
+        return _costlyRuns->addAndFetch( 1 );
+    }
+
+    QueryCache::QueryCache() {
     }
 
     CachedQueryPlan QueryCache::cachedQueryPlanForPattern( const QueryPattern &pattern ) {
@@ -127,19 +143,9 @@ namespace mongo {
         _qcCache[ pattern ] = cachedQueryPlan;
     }
 
-    void QueryCache::notifyOfWriteOp() {
-        if ( _qcCache.empty() ) {
-            return;
-        }
-        if ( ++_qcWriteCount >= 100 ) {
-            clearQueryCache();
-        }
-    }
-
     void QueryCache::clearQueryCache() {
         QueryCache::Lock::Exclusive lk(*this);
         _qcCache.clear();
-        _qcWriteCount = 0;
     }
     
 } // namespace mongo
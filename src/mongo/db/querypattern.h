@@ -18,6 +18,7 @@
 #pragma once
 
 #include "mongo/db/jsobj.h"
+#include "mongo/platform/atomic_word.h"
 #include "mongo/util/concurrency/rwlock.h"
 #include "mongo/util/concurrency/simplerwlock.h"
 
@@ -82,17 +83,30 @@ namespace mongo {
     class CachedQueryPlan {
     public:
         CachedQueryPlan() :
-        _nScanned() {
+        _nScanned(),
+        _n() {
         }
         CachedQueryPlan( const BSONObj &indexKey, long long nScanned,
-                        CandidatePlanCharacter planCharacter );
+                        CandidatePlanCharacter planCharacter, long long n = 0 );
         BSONObj indexKey() const { return _indexKey; }
         long long nScanned() const { return _nScanned; }
+        /** Number of matches found in nScanned. */
+        long long n() const { return _n; }
         CandidatePlanCharacter planCharacter() const { return _planCharacter; }
+
+        /**
+         * Feedback from later runs of this plan out of the cache.  Record whether a run cost
+         * more per match than the run this plan was cached for, by at least 'factor'.
+         * @return the number of consecutive runs that have.
+         */
+        unsigned noteRun( long long nScanned, long long n, int factor ) const;
     private:
         BSONObj _indexKey;
         long long _nScanned;
+        long long _n;
         CandidatePlanCharacter _planCharacter;
+        // Shared by every copy of this plan handed out by the QueryCache.
+        shared_ptr<AtomicUInt32> _costlyRuns;
     };
 
     /** A cache of query plans */
@@ -116,13 +130,10 @@ namespace mongo {
         void registerCachedQueryPlanForPattern(const QueryPattern &pattern,
                                                const CachedQueryPlan &cachedQueryPlan) ;
 
-        void notifyOfWriteOp();
-
         void clearQueryCache();
 
     private:
         SimpleRWLock _rwlock;
-        int _qcWriteCount;
         map<QueryPattern, CachedQueryPlan> _qcCache;
     };
 
@@ -248,6 +248,18 @@ namespace mongo {
         }
     }
 
+    BSONObj replAppliedSnapshot() {
+        uassert(17384, "$appliedSnapshot requires --replSet", replSet);
+        uassert(17385, "$appliedSnapshot: replica set is not initialized yet",
+                theReplSet && theReplSet->gtidManager);
+        GTID minLiveGTID;
+        GTID minUnappliedGTID;
+        theReplSet->gtidManager->getMins(&minLiveGTID, &minUnappliedGTID);
+        BSONObjBuilder b;
+        addGTIDToBSON("minUnappliedGTID", minUnappliedGTID, b);
+        return b.obj();
+    }
+
     OpCounterServerStatusSection replOpCounterServerStatusSection( "opcountersRepl", &replOpCounters );
 
 } // namespace mongo
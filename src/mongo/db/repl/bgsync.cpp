@@ -22,6 +22,7 @@
 #include "mongo/db/commands/server_status.h"
 #include "mongo/db/crash.h"
 #include "mongo/db/repl/bgsync.h"
+#include "mongo/db/repl/oplog_applier.h"
 #include "mongo/db/repl/rs_sync.h"
 #include "mongo/base/counter.h"
 #include "mongo/db/stats/timer_stats.h"
@@ -54,16 +55,6 @@ namespace mongo {
     static ServerStatusMetricField<Counter64> displayBufferSize( "repl.buffer.sizeBytes",
                                                                 &bufferSizeGauge );
 
-    // Number and time of each ApplyOps worker pool round
-    static TimerStats applyBatchStats;
-    static ServerStatusMetricField<TimerStats> displayOpBatchesApplied(
-                                                    "repl.apply.batches",
-                                                    &applyBatchStats );
-    //The oplog entries applied
-    static Counter64 opsAppliedStats;
-    static ServerStatusMetricField<Counter64> displayOpsApplied( "repl.apply.ops",
-                                                                &opsAppliedStats );
-
     BackgroundSync::BackgroundSync() : _opSyncShouldRun(false),
                                             _opSyncRunning(false),
                                             _currentSyncTarget(NULL),
@@ -139,11 +130,14 @@ namespace mongo {
     }
 
     void BackgroundSync::applyOpsFromOplog() {
-        GTID lastLiveGTID;
-        GTID lastUnappliedGTID;
+        scoped_ptr<ParallelOplogApplier> parallelApplier;
+        if (replApplierThreads > 1) {
+            parallelApplier.reset(new ParallelOplogApplier(replApplierThreads));
+        }
+        std::vector<BSONObj> batch;
         while (1) {
             try {
-                BSONObj curr;
+                batch.clear();
                 {
                     boost::unique_lock<boost::mutex> lck(_mutex);
                     // wait until we know an item has been produced
@@ -154,41 +148,38 @@ namespace mongo {
                     if (_deque.size() == 0 && _applierShouldExit) {
                         return; 
                     }
-                    curr = _deque.front();
-                }
-                GTID currEntry = getGTIDFromOplogEntry(curr);
-                theReplSet->gtidManager->noteApplyingGTID(currEntry);
-                // we must do applyTransactionFromOplog in a loop
-                // because once we have called noteApplyingGTID, we must
-                // continue until we are successful in applying the transaction.
-                for (uint32_t numTries = 0; numTries <= 100; numTries++) {
-                    try {
-                        numTries++;
-                        TimerHolder timer(&applyBatchStats);
-                        applyTransactionFromOplog(curr);
-                        opsAppliedStats.increment();
-                        break;
-                    }
-                    catch (std::exception &e) {
-                        log() << "exception during applying transaction from oplog: " << e.what() << endl;
-                        log() << "oplog entry: " << curr.str() << endl;
-                        if (numTries == 100) {
-                            // something is really wrong if we fail 100 times, let's abort
-                            dumpCrashInfo("100 errors applying oplog entry");
-                            ::abort();
+                    batch.push_back(_deque.front());
+                    // gather consecutive entries that may be applied in
+                    // parallel, stopping at the first barrier
+                    if (parallelApplier && !OplogApplier::isBarrier(batch[0])) {
+                        const size_t maxBatch = std::max(replApplierBatchSize, 1);
+                        for (size_t i = 1; i < _deque.size() && batch.size() < maxBatch; i++) {
+                            if (OplogApplier::isBarrier(_deque[i])) {
+                                break;
+                            }
+                            batch.push_back(_deque[i]);
                         }
-                        sleepsecs(1);
                     }
                 }
-                LOG(3) << "applied " << curr.toString(false, true) << endl;
-                theReplSet->gtidManager->noteGTIDApplied(currEntry);
+                if (batch.size() > 1) {
+                    parallelApplier->applyBatch(batch);
+                }
+                else {
+                    const BSONObj& curr = batch[0];
+                    GTID currEntry = getGTIDFromOplogEntry(curr);
+                    theReplSet->gtidManager->noteApplyingGTID(currEntry);
+                    applyTransactionFromOplogWithRetries(curr);
+                    theReplSet->gtidManager->noteGTIDApplied(currEntry);
+                }
 
                 {
                     boost::unique_lock<boost::mutex> lck(_mutex);
-                    dassert(_deque.size() > 0);
-                    _deque.pop_front();
-                    bufferCountGauge.increment(-1);
-                    bufferSizeGauge.increment(-curr.objsize());
+                    dassert(_deque.size() >= batch.size());
+                    for (size_t i = 0; i < batch.size(); i++) {
+                        _deque.pop_front();
+                        bufferCountGauge.increment(-1);
+                        bufferSizeGauge.increment(-batch[i].objsize());
+                    }
                     
                     // this is a flow control mechanism, with bad numbers
                     // hard coded for now just to get something going.
@@ -197,7 +188,7 @@ namespace mongo {
                     // 10000. This is where we signal that we have gotten there
                     // Once we have spilling of transactions working, this
                     // logic will need to be redone
-                    if (_deque.size() == 10000) {
+                    if (_deque.size() <= 10000 && _deque.size() + batch.size() > 10000) {
                         _queueCond.notify_all();
                     }
                 }
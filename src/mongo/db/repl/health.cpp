@@ -428,6 +428,9 @@ namespace mongo {
                 if( !s.empty() )
                     bb.append("errmsg", s);
             }
+            if (!_initialSyncProgress.empty()) {
+                _initialSyncProgress.append(bb, "initialSyncProgress");
+            }
             bb.append("self", true);
             v.push_back(bb.obj());
         }
@@ -0,0 +1,361 @@
+/**
+ *    Copyright (C) 2014 Tokutek Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mongo/pch.h"
+
+#include "mongo/db/repl/oplog_applier.h"
+
+#include <boost/bind.hpp>
+
+#include "mongo/base/counter.h"
+#include "mongo/db/client.h"
+#include "mongo/db/collection.h"
+#include "mongo/db/commands/server_status.h"
+#include "mongo/db/crash.h"
+#include "mongo/db/gtid.h"
+#include "mongo/db/namespacestring.h"
+#include "mongo/db/oplog.h"
+#include "mongo/db/repl/rs.h"
+#include "mongo/db/server_parameters.h"
+#include "mongo/db/stats/timer_stats.h"
+
+namespace mongo {
+
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(replApplierThreads, int, 1);
+    MONGO_EXPORT_SERVER_PARAMETER(replApplierBatchSize, int, 256);
+
+    // Number and time of each ApplyOps worker pool round
+    static TimerStats applyBatchStats;
+    static ServerStatusMetricField<TimerStats> displayOpBatchesApplied(
+                                                    "repl.apply.batches",
+                                                    &applyBatchStats );
+    //The oplog entries applied
+    static Counter64 opsAppliedStats;
+    static ServerStatusMetricField<Counter64> displayOpsApplied( "repl.apply.ops",
+                                                                &opsAppliedStats );
+
+    //The batches handed to the parallel applier
+    static Counter64 parallelBatchesStats;
+    static ServerStatusMetricField<Counter64> displayParallelBatches( "repl.apply.parallel.batches",
+                                                                      &parallelBatchesStats );
+    //The conflict-free groups those batches were split into
+    static Counter64 parallelGroupsStats;
+    static ServerStatusMetricField<Counter64> displayParallelGroups( "repl.apply.parallel.groups",
+                                                                     &parallelGroupsStats );
+
+    void applyTransactionFromOplogWithRetries(const BSONObj& entry) {
+        // we must do applyTransactionFromOplog in a loop
+        // because once we have called noteApplyingGTID, we must
+        // continue until we are successful in applying the transaction.
+        for (uint32_t numTries = 0; numTries <= 100; numTries++) {
+            try {
+                numTries++;
+                TimerHolder timer(&applyBatchStats);
+                applyTransactionFromOplog(entry);
+                opsAppliedStats.increment();
+                break;
+            }
+            catch (std::exception &e) {
+                log() << "exception during applying transaction from oplog: " << e.what() << endl;
+                log() << "oplog entry: " << entry.str() << endl;
+                if (numTries == 100) {
+                    // something is really wrong if we fail 100 times, let's abort
+                    dumpCrashInfo("100 errors applying oplog entry");
+                    ::abort();
+                }
+                sleepsecs(1);
+            }
+        }
+        LOG(3) << "applied " << entry.toString(false, true) << endl;
+    }
+
+    namespace OplogApplier {
+
+        static bool isDocumentOp(const char* opType) {
+            return str::equals(opType, "i") || str::equals(opType, "d") ||
+                   str::equals(opType, "u") || str::equals(opType, "ur");
+        }
+
+        bool isBarrier(const BSONObj& entry) {
+            if (entry.hasElement("ref") || !entry.hasElement("ops")) {
+                // big transactions live in oplog.refs, we don't look inside them
+                return true;
+            }
+            for (BSONObjIterator it(entry["ops"].Obj()); it.more(); ) {
+                const BSONObj op = it.next().Obj();
+                if (str::equals(op["op"].valuestrsafe(), "c")) {
+                    return true;
+                }
+                // system.indexes inserts build indexes, and other system
+                // collections may be read by the server while we apply
+                if (NamespaceString::isSystem(op["ns"].valuestrsafe())) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void resolvePKPatterns(const std::vector<BSONObj>& entries, PKPatternMap* patterns) {
+            std::set<std::string> namespaces;
+            for (std::vector<BSONObj>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+                for (BSONObjIterator opIt((*it)["ops"].Obj()); opIt.more(); ) {
+                    const BSONObj op = opIt.next().Obj();
+                    const char* opType = op["op"].valuestrsafe();
+                    // updates carry their pk, only inserts and deletes need the pattern
+                    if (str::equals(opType, "i") || str::equals(opType, "d")) {
+                        namespaces.insert(op["ns"].String());
+                    }
+                }
+            }
+            for (std::set<std::string>::const_iterator it = namespaces.begin(); it != namespaces.end(); ++it) {
+                const std::string& ns = *it;
+                LOCK_REASON(lockReason, "repl: looking up primary key pattern");
+                Client::ReadContext ctx(ns, lockReason);
+                Client::Transaction txn(DB_TXN_SNAPSHOT | DB_TXN_READ_ONLY);
+                Collection* cl = getCollection(ns);
+                // a missing collection will be created by the first insert, and
+                // capped or hidden pk collections must be applied in order, in
+                // either case leaving it out of the map serializes its ops
+                if (cl != NULL && !cl->isCapped() && !cl->isPKHidden()) {
+                    (*patterns)[ns] = cl->pkPattern().getOwned();
+                }
+                txn.commit();
+            }
+        }
+
+        // extracts the primary key of row in the same format the oplog uses for "pk"
+        static BSONObj pkFromRow(const BSONObj& row, const BSONObj& pattern) {
+            BSONObjBuilder b(64);
+            for (BSONObjIterator it(pattern); it.more(); ) {
+                const BSONElement x = row.getFieldDotted(it.next().fieldName());
+                if (x.eoo()) {
+                    b.appendNull("");
+                }
+                else {
+                    b.appendAs(x, "");
+                }
+            }
+            return b.obj();
+        }
+
+        namespace {
+
+            // union-find over the indexes of a batch
+            class ConflictSets {
+            public:
+                explicit ConflictSets(size_t n) : _parent(n) {
+                    for (size_t i = 0; i < n; i++) {
+                        _parent[i] = i;
+                    }
+                }
+                size_t find(size_t i) {
+                    while (_parent[i] != i) {
+                        _parent[i] = _parent[_parent[i]];
+                        i = _parent[i];
+                    }
+                    return i;
+                }
+                void merge(size_t a, size_t b) {
+                    a = find(a);
+                    b = find(b);
+                    // keep the smallest index as the root so groups sort by first entry
+                    if (a < b) {
+                        _parent[b] = a;
+                    }
+                    else if (b < a) {
+                        _parent[a] = b;
+                    }
+                }
+            private:
+                std::vector<size_t> _parent;
+            };
+
+            // what we know about the entries touching one namespace
+            struct NsConflicts {
+                NsConflicts() : wide(false) {}
+                // true once some op on this ns could not be narrowed to a pk,
+                // from then on all entries touching the ns share one group
+                bool wide;
+                std::vector<size_t> entries;
+                std::map<BSONObj, size_t, BSONObjCmp> pkOwners;
+            };
+
+        } // namespace
+
+        void partition(const std::vector<BSONObj>& entries, const PKPatternMap& patterns,
+                       std::vector<std::vector<size_t> >* groups) {
+            ConflictSets sets(entries.size());
+            std::map<std::string, NsConflicts> conflicts;
+
+            for (size_t i = 0; i < entries.size(); i++) {
+                dassert(!isBarrier(entries[i]));
+                for (BSONObjIterator it(entries[i]["ops"].Obj()); it.more(); ) {
+                    const BSONObj op = it.next().Obj();
+                    const char* opType = op["op"].valuestrsafe();
+                    if (str::equals(opType, "n")) {
+                        continue;
+                    }
+                    const std::string ns = op["ns"].String();
+                    NsConflicts& nsc = conflicts[ns];
+                    if (nsc.entries.empty() || nsc.entries.back() != i) {
+                        nsc.entries.push_back(i);
+                    }
+
+                    BSONObj pk;
+                    if (isDocumentOp(opType)) {
+                        if (op.hasElement("pk")) {
+                            pk = op["pk"].Obj();
+                        }
+                        else {
+                            PKPatternMap::const_iterator pattern = patterns.find(ns);
+                            if (pattern != patterns.end()) {
+                                pk = pkFromRow(op["o"].Obj(), pattern->second);
+                            }
+                        }
+                    }
+
+                    if (!nsc.wide && pk.isEmpty()) {
+                        nsc.wide = true;
+                        for (size_t j = 0; j < nsc.entries.size(); j++) {
+                            sets.merge(nsc.entries[0], nsc.entries[j]);
+                        }
+                        nsc.pkOwners.clear();
+                    }
+                    if (nsc.wide) {
+                        sets.merge(nsc.entries[0], i);
+                        continue;
+                    }
+
+                    std::map<BSONObj, size_t, BSONObjCmp>::iterator owner = nsc.pkOwners.find(pk);
+                    if (owner == nsc.pkOwners.end()) {
+                        nsc.pkOwners.insert(std::make_pair(pk, i));
+                    }
+                    else {
+                        sets.merge(owner->second, i);
+                    }
+                }
+            }
+
+            // roots are the smallest index of their set, so visiting entries in
+            // order creates groups in order of their first entry
+            std::map<size_t, size_t> groupForRoot;
+            groups->clear();
+            for (size_t i = 0; i < entries.size(); i++) {
+                const size_t root = sets.find(i);
+                std::map<size_t, size_t>::const_iterator g = groupForRoot.find(root);
+                if (g == groupForRoot.end()) {
+                    groupForRoot[root] = groups->size();
+                    groups->push_back(std::vector<size_t>(1, i));
+                }
+                else {
+                    (*groups)[g->second].push_back(i);
+                }
+            }
+        }
+
+    } // namespace OplogApplier
+
+    ParallelOplogApplier::ParallelOplogApplier(int nThreads) :
+        _entries(NULL),
+        _outstanding(0),
+        _shouldExit(false) {
+        verify(nThreads > 0);
+        for (int i = 0; i < nThreads; i++) {
+            _threads.push_back(new boost::thread(boost::bind(&ParallelOplogApplier::workerThread, this, i)));
+        }
+    }
+
+    ParallelOplogApplier::~ParallelOplogApplier() {
+        {
+            boost::unique_lock<boost::mutex> lock(_mutex);
+            dassert(_outstanding == 0);
+            _shouldExit = true;
+            _workCond.notify_all();
+        }
+        for (std::vector<boost::thread*>::iterator it = _threads.begin(); it != _threads.end(); ++it) {
+            (*it)->join();
+            delete *it;
+        }
+    }
+
+    void ParallelOplogApplier::applyBatch(const std::vector<BSONObj>& entries) {
+        OplogApplier::PKPatternMap patterns;
+        OplogApplier::resolvePKPatterns(entries, &patterns);
+        std::vector<std::vector<size_t> > groups;
+        OplogApplier::partition(entries, patterns, &groups);
+        parallelBatchesStats.increment();
+        parallelGroupsStats.increment(groups.size());
+        LOG(2) << "applying " << entries.size() << " oplog entries in "
+               << groups.size() << " groups" << endl;
+
+        // the GTIDManager requires that we start applying GTIDs in order,
+        // they may finish in any order
+        for (std::vector<BSONObj>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+            theReplSet->gtidManager->noteApplyingGTID(getGTIDFromOplogEntry(*it));
+        }
+
+        boost::unique_lock<boost::mutex> lock(_mutex);
+        dassert(_outstanding == 0);
+        _entries = &entries;
+        _outstanding = groups.size();
+        for (std::vector<std::vector<size_t> >::iterator it = groups.begin(); it != groups.end(); ++it) {
+            _groups.push_back(std::vector<size_t>());
+            _groups.back().swap(*it);
+        }
+        _workCond.notify_all();
+        while (_outstanding > 0) {
+            _doneCond.wait(lock);
+        }
+        _entries = NULL;
+    }
+
+    void ParallelOplogApplier::workerThread(int id) {
+        const string threadName = str::stream() << "applier worker " << id;
+        Client::initThread(threadName.c_str());
+        replLocalAuth();
+        // same as the applier thread, we must finish work we start
+        cc().setGloballyUninterruptible(true);
+        while (true) {
+            std::vector<size_t> group;
+            const std::vector<BSONObj>* entries;
+            {
+                boost::unique_lock<boost::mutex> lock(_mutex);
+                while (_groups.empty() && !_shouldExit) {
+                    _workCond.wait(lock);
+                }
+                if (_groups.empty()) {
+                    break;
+                }
+                group.swap(_groups.front());
+                _groups.pop_front();
+                entries = _entries;
+            }
+            for (std::vector<size_t>::const_iterator it = group.begin(); it != group.end(); ++it) {
+                const BSONObj& entry = (*entries)[*it];
+                applyTransactionFromOplogWithRetries(entry);
+                theReplSet->gtidManager->noteGTIDApplied(getGTIDFromOplogEntry(entry));
+            }
+            {
+                boost::unique_lock<boost::mutex> lock(_mutex);
+                if (--_outstanding == 0) {
+                    _doneCond.notify_all();
+                }
+            }
+        }
+        cc().shutdown();
+    }
+
+} // namespace mongo
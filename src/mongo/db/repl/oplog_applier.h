@@ -0,0 +1,105 @@
+/**
+ *    Copyright (C) 2014 Tokutek Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "mongo/db/jsobj.h"
+
+namespace mongo {
+
+    // number of worker threads used to apply oplog entries on a secondary,
+    // 1 means entries are applied serially by the applier thread
+    extern int replApplierThreads;
+    // maximum number of oplog entries grouped into a single parallel batch
+    extern int replApplierBatchSize;
+
+    // Applies a transaction from the oplog, retrying on failure. Once
+    // noteApplyingGTID has been called for an entry, we must keep going
+    // until it has been applied, so after 100 failures we abort.
+    void applyTransactionFromOplogWithRetries(const BSONObj& entry);
+
+    namespace OplogApplier {
+
+        // map of ns -> primary key pattern, for the namespaces touched by a batch
+        // namespaces that are missing from the map are treated conservatively,
+        // meaning every op on them conflicts with every other op on them
+        typedef std::map<std::string, BSONObj> PKPatternMap;
+
+        // Returns true if the entry must be applied on its own, after everything
+        // before it and before everything after it. This is the case for
+        // transactions spilled to oplog.refs, commands, and ops on system namespaces.
+        bool isBarrier(const BSONObj& entry);
+
+        // Fills patterns with the primary key patterns of the collections touched
+        // by entries. Takes a read lock on each namespace in turn.
+        void resolvePKPatterns(const std::vector<BSONObj>& entries, PKPatternMap* patterns);
+
+        // Partitions entries (none of which may be barriers) into groups of
+        // transactions such that two transactions that touch the same (ns, pk)
+        // are in the same group. Each group lists indexes into entries in
+        // increasing (i.e. GTID) order, and groups are ordered by their first entry.
+        void partition(const std::vector<BSONObj>& entries, const PKPatternMap& patterns,
+                       std::vector<std::vector<size_t> >* groups);
+
+    } // namespace OplogApplier
+
+    /**
+     * Pool of worker threads that apply a batch of consecutive oplog entries
+     * concurrently. Entries are partitioned by OplogApplier::partition, each
+     * group is applied in order by a single worker, and groups that share no
+     * (ns, pk) run in parallel.
+     *
+     * GTIDManager::noteApplyingGTID is called for every entry, in GTID order,
+     * before any of them is dispatched, and noteGTIDApplied is called as each
+     * one completes. The GTIDManager tracks the unapplied set, so
+     * minUnappliedGTID never moves past an entry that has yet to be applied.
+     */
+    class ParallelOplogApplier : boost::noncopyable {
+    public:
+        explicit ParallelOplogApplier(int nThreads);
+        // stops and joins the worker threads
+        ~ParallelOplogApplier();
+
+        // Applies every entry in the batch and returns once all of them have been applied.
+        void applyBatch(const std::vector<BSONObj>& entries);
+
+    private:
+        void workerThread(int id);
+
+        boost::mutex _mutex;
+        // signaled when there is work for the workers, or when they should exit
+        boost::condition_variable _workCond;
+        // signaled when the last group of a batch has been applied
+        boost::condition_variable _doneCond;
+
+        // the batch currently being applied, only valid while _outstanding > 0
+        const std::vector<BSONObj>* _entries;
+        std::deque<std::vector<size_t> > _groups;
+        size_t _outstanding;
+        bool _shouldExit;
+
+        std::vector<boost::thread*> _threads;
+    };
+
+} // namespace mongo
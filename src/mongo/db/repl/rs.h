@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include "mongo/db/cloner.h"
 #include "mongo/db/commands.h"
 #include "mongo/db/collection.h"
 #include "mongo/db/oplog.h"
@@ -500,6 +501,7 @@ namespace mongo {
     protected:
         Member *_self;
         bool _buildIndexes;       // = _self->config().buildIndexes
+        CloneProgress _initialSyncProgress; // per collection, shown by replSetGetStatus
 
         ReplSetImpl();
         /* throws exception if a problem initializing. */
@@ -89,7 +89,8 @@ namespace mongo {
         const std::string& db,
         shared_ptr<DBClientConnection> conn,
         bool syncIndexes,
-        ProgressMeter &progress
+        ProgressMeter &progress,
+        CloneProgress &collProgress
         ) 
     {
         CloneOptions options;
@@ -104,6 +105,9 @@ namespace mongo {
         options.syncData = true;
         options.syncIndexes = syncIndexes;
 
+        options.bulkLoad = true;
+        options.progress = &collProgress;
+
         string err;
         return cloneFrom(master, options, conn, err, &progress);
     }
@@ -128,7 +132,7 @@ namespace mongo {
             }
 
             Client::Context ctx(db);
-            if (!clone(master, db, conn, _buildIndexes, dbsProgress)) {
+            if (!clone(master, db, conn, _buildIndexes, dbsProgress, _initialSyncProgress)) {
                 sethbmsg(str::stream() << "initial sync error clone of " << db << " failed sleeping 5 minutes", 0);
                 return false;
             }
@@ -444,6 +448,7 @@ namespace mongo {
 
             try {
                 sethbmsg("initial sync clone all databases", 0);
+                _initialSyncProgress.clear();
             
                 shared_ptr<DBClientConnection> conn(r.conn_shared());
                 RemoteTransaction rtxn(*conn, "mvcc");
@@ -526,6 +531,7 @@ namespace mongo {
         }
         _applyMissingOpsDuringInitialSync();
 
+        _initialSyncProgress.clear();
         sethbmsg("initial sync done",0);
 
         return true;
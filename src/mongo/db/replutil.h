@@ -74,4 +74,13 @@ namespace mongo {
     
     void replVerifyReadsOk(const ParsedQuery* pq = 0);
 
+    /**
+     * Describes the replicated state that a snapshot transaction begun after this call reflects,
+     * for queries run with $appliedSnapshot.  Every GTID before the returned minUnappliedGTID
+     * has been applied and committed, so it is visible to the snapshot.  Transactions the
+     * applier is still committing may be visible as well, since the applier threads commit out
+     * of order within a batch.
+     */
+    BSONObj replAppliedSnapshot();
+
 } // namespace mongo
@@ -26,6 +26,7 @@
 #include "mongo/db/auth/privilege.h"
 #include "mongo/util/net/message.h"
 #include "mongo/db/commands.h"
+#include "mongo/db/commands/server_status.h"
 
 namespace mongo {
 
@@ -48,21 +49,86 @@ namespace mongo {
 
     }
 
+    const char* Top::LatencyData::opTypeName( OpType type ) {
+        switch ( type ) {
+        case QUERIES: return "queries";
+        case GETMORE: return "getmore";
+        case INSERT: return "insert";
+        case UPDATE: return "update";
+        case REMOVE: return "remove";
+        case COMMANDS: return "commands";
+        default: verify( false ); return "";
+        }
+    }
+
+    void Top::LatencyData::append( BSONObjBuilder& b ) const {
+        for ( int t = 0; t < NUM_OP_TYPES; t++ ) {
+            if ( ops[t].count() == 0 )
+                continue;
+
+            BSONObjBuilder bb( b.subobjStart( opTypeName( static_cast<OpType>( t ) ) ) );
+            ops[t].appendPercentileFields( bb );
+            ops[t].appendBuckets( bb , "buckets" );
+            bb.done();
+        }
+    }
+
     void Top::record( const StringData& ns , int op , int lockType , long long micros , bool command ) {
         if ( ns[0] == '?' )
             return;
 
         //cout << "record: " << ns << "\t" << op << "\t" << command << endl;
-        SimpleMutex::scoped_lock lk(_lock);
+        boost::shared_ptr<LatencyData> latency;
+        {
+            SimpleMutex::scoped_lock lk(_lock);
+
+            if ( ( command || op == dbQuery ) && ns == _lastDropped ) {
+                _lastDropped = "";
+                return;
+            }
 
-        if ( ( command || op == dbQuery ) && ns == _lastDropped ) {
-            _lastDropped = "";
+            CollectionData& coll = _usage[ns];
+            _record( coll , op , lockType , micros , command );
+            _record( _global , op , lockType , micros , command );
+
+            boost::shared_ptr<LatencyData>& l = _latency[ns];
+            if ( !l )
+                l.reset( new LatencyData() );
+            latency = l;
+        }
+
+        _recordLatency( *latency , op , micros , command );
+    }
+
+    void Top::_recordLatency( LatencyData& latency , int op , long long micros , bool command ) {
+        LatencyData::OpType type;
+        switch ( op ) {
+        case dbQuery:
+            type = command ? LatencyData::COMMANDS : LatencyData::QUERIES;
+            break;
+        case dbGetMore:
+            type = LatencyData::GETMORE;
+            break;
+        case dbInsert:
+            type = LatencyData::INSERT;
+            break;
+        case dbUpdate:
+            type = LatencyData::UPDATE;
+            break;
+        case dbDelete:
+            type = LatencyData::REMOVE;
+            break;
+        default:
             return;
         }
 
-        CollectionData& coll = _usage[ns];
-        _record( coll , op , lockType , micros , command );
-        _record( _global , op , lockType , micros , command );
+        latency.inc( type , micros );
+        _globalLatency.inc( type , micros );
+    }
+
+    void Top::cloneLatency( LatencyMap& out ) const {
+        SimpleMutex::scoped_lock lk( _lock );
+        out = _latency;
     }
 
     void Top::_record( CollectionData& c , int op , int lockType , long long micros , bool command ) {
@@ -111,6 +177,7 @@ namespace mongo {
         //cout << "collectionDropped: " << ns << endl;
         SimpleMutex::scoped_lock lk(_lock);
         _usage.erase(ns);
+        _latency.erase(ns);
         _lastDropped = ns.toString();
     }
 
@@ -121,10 +188,11 @@ namespace mongo {
 
     void Top::append( BSONObjBuilder& b ) {
         SimpleMutex::scoped_lock lk( _lock );
-        _appendToUsageMap( b , _usage );
+        _appendToUsageMap( b , _usage , _latency );
     }
 
-    void Top::_appendToUsageMap( BSONObjBuilder& b , const UsageMap& map ) const {
+    void Top::_appendToUsageMap( BSONObjBuilder& b , const UsageMap& map ,
+                                 const LatencyMap& latency ) const {
         // pull all the names into a vector so we can sort them for the user
         
         vector<string> names;
@@ -151,6 +219,13 @@ namespace mongo {
             _appendStatsEntry( b , "remove" , coll.remove );
             _appendStatsEntry( b , "commands" , coll.commands );
 
+            LatencyMap::const_iterator l = latency.find( names[i] );
+            if ( l != latency.end() ) {
+                BSONObjBuilder lb( bb.subobjStart( "latency" ) );
+                l->second->append( lb );
+                lb.done();
+            }
+
             bb.done();
         }
     }
@@ -187,6 +262,46 @@ namespace mongo {
 
     } topCmd;
 
+    /**
+     * Latency histograms by op type, over all namespaces.  With { latency : { namespaces : 1 } }
+     * they are also broken down by namespace, as in the top command.
+     */
+    class LatencyServerStatusSection : public ServerStatusSection {
+    public:
+        LatencyServerStatusSection() : ServerStatusSection( "latency" ) {}
+        virtual bool includeByDefault() const { return true; }
+
+        BSONObj generateSection( const BSONElement& configElement ) const {
+            Top::LatencyMap latency;
+            Top::global.cloneLatency( latency );
+
+            BSONObjBuilder b;
+            b.append( "note" , "all times in microseconds" );
+            {
+                BSONObjBuilder gb( b.subobjStart( "global" ) );
+                Top::global.getGlobalLatency().append( gb );
+                gb.done();
+            }
+
+            if ( configElement.type() == Object && configElement.Obj()["namespaces"].trueValue() ) {
+                vector<string> names;
+                for ( Top::LatencyMap::const_iterator i = latency.begin(); i != latency.end(); ++i )
+                    names.push_back( i->first );
+                std::sort( names.begin(), names.end() );
+
+                BSONObjBuilder nb( b.subobjStart( "namespaces" ) );
+                for ( size_t i = 0; i < names.size(); i++ ) {
+                    BSONObjBuilder bb( nb.subobjStart( names[i] ) );
+                    latency.find( names[i] )->second->append( bb );
+                    bb.done();
+                }
+                nb.done();
+            }
+            return b.obj();
+        }
+
+    } latencyServerStatusSection;
+
     Top Top::global;
 
 }
@@ -18,7 +18,10 @@
 #pragma once
 
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/shared_ptr.hpp>
 
+#include "mongo/util/concurrency/mutex.h"
+#include "mongo/util/histogram.h"
 #include "mongo/util/string_map.h"
 
 namespace mongo {
@@ -65,6 +68,31 @@ namespace mongo {
 
         typedef StringMap<CollectionData> UsageMap;
 
+        /**
+         * Latency histograms for each op type.  There is one of these per namespace, so the
+         * histograms are a coarse variant of LatencyHistogram, and every thread records into the
+         * same one without a lock.
+         */
+        struct LatencyData : boost::noncopyable {
+            enum OpType { QUERIES , GETMORE , INSERT , UPDATE , REMOVE , COMMANDS , NUM_OP_TYPES };
+            typedef BasicLatencyHistogram<1> OpHistogram;
+
+            void inc( OpType type , long long micros ) { ops[type].insert( micros ); }
+
+            /**
+             * Append one object per op type that has any ops:
+             *   { count , avgMicros , p50 , p90 , p99 , p999 , maxMicros ,
+             *     buckets : [ { upTo , count } , ... ] }
+             */
+            void append( BSONObjBuilder& b ) const;
+
+            static const char* opTypeName( OpType type );
+
+            OpHistogram ops[NUM_OP_TYPES];
+        };
+
+        typedef StringMap< boost::shared_ptr<LatencyData> > LatencyMap;
+
     public:
         void record( const StringData& ns , int op , int lockType , long long micros , bool command );
         void append( BSONObjBuilder& b );
@@ -72,18 +100,31 @@ namespace mongo {
         CollectionData getGlobalData() const { return _global; }
         void collectionDropped( const StringData& ns );
 
+        /**
+         * The latency histograms by namespace.  They are shared, not copied, so they keep
+         * counting after this returns.
+         */
+        void cloneLatency( LatencyMap& out ) const;
+        const LatencyData& getGlobalLatency() const { return _globalLatency; }
+
     public: // static stuff
         static Top global;
 
     private:
-        void _appendToUsageMap( BSONObjBuilder& b , const UsageMap& map ) const;
+        void _appendToUsageMap( BSONObjBuilder& b , const UsageMap& map ,
+                                const LatencyMap& latency ) const;
         void _appendStatsEntry( BSONObjBuilder& b , const char * statsName , const UsageData& map ) const;
         void _record( CollectionData& c , int op , int lockType , long long micros , bool command );
+        void _recordLatency( LatencyData& latency , int op , long long micros , bool command );
 
         mutable SimpleMutex _lock;
         CollectionData _global;
         UsageMap _usage;
         string _lastDropped;
+
+        // recorded into outside of _lock, which only guards the map
+        LatencyMap _latency;
+        LatencyData _globalLatency;
     };
 
 } // namespace mongo
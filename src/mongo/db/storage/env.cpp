@@ -30,6 +30,7 @@
 #include <partitioned_counter.h>
 
 #include <boost/filesystem.hpp>
+#include <boost/thread/condition_variable.hpp>
 #ifdef _WIN32
 # error "Doesn't support windows."
 #endif
@@ -46,7 +47,9 @@
 #include "mongo/db/storage/exception.h"
 #include "mongo/db/storage/key.h"
 #include "mongo/util/assert_util.h"
+#include "mongo/util/histogram.h"
 #include "mongo/util/log.h"
+#include "mongo/util/timer.h"
 
 namespace mongo {
 
@@ -163,7 +166,7 @@ namespace mongo {
                 descriptor.generateKeys(obj, keys);
                 dbt_array_clear_and_resize(dest_keys, keys.size());
                 for (BSONObjSet::const_iterator i = keys.begin(); i != keys.end(); i++) {
-                    const Key sKey(*i, &pk);
+                    const Key sKey(*i, &pk, descriptor.keyFormat());
                     dbt_array_push(dest_keys, sKey.buf(), sKey.size());
                 }
                 // Set the multiKey bool if it's provided and we generated multiple keys.
@@ -662,6 +665,10 @@ namespace mongo {
                     status.appendInfo(result, "count", "LOGGER_NUM_WRITES");
                     status.appendInfo(result, "time", "LOGGER_TOKUTIME_WRITES");
                     status.appendInfo(result, "bytes", "LOGGER_BYTES_WRITTEN", scale);
+                    {
+                        NestedBuilder _n2(result, "groupCommit");
+                        logFlushGroup.appendStats(result);
+                    }
                 }
                 {
                     NestedBuilder _n1(result, "cachetable");
@@ -1040,6 +1047,97 @@ namespace mongo {
             }
         }
 
+        /**
+         * Group commit for log_flush.
+         *
+         * Each caller takes a ticket.  If nobody is flushing, the caller becomes the leader: it
+         * flushes on behalf of every ticket issued so far, so everything those callers
+         * committed before asking is covered.  Callers that arrive while the leader is flushing
+         * wait, and when it finishes one of them leads the next flush for all of them at once.
+         */
+        class LogFlushGroup : boost::noncopyable {
+          public:
+            LogFlushGroup() : _requested(0), _flushed(0), _flushing(false),
+                              _flushes(0), _batchSizes(batchSizeOptions()),
+                              _flushMicros(flushMicrosOptions()) {}
+
+            void flush() {
+                boost::unique_lock<boost::mutex> lk(_mutex);
+                const uint64_t ticket = ++_requested;
+                while (_flushed < ticket) {
+                    if (_flushing) {
+                        _flushDone.wait(lk);
+                        continue;
+                    }
+
+                    _flushing = true;
+                    const uint64_t upTo = _requested;
+                    lk.unlock();
+                    Timer t;
+                    try {
+                        log_flush();
+                    } catch (...) {
+                        // Let a waiter try again as the next leader.
+                        lk.lock();
+                        _flushing = false;
+                        _flushDone.notify_all();
+                        throw;
+                    }
+                    const unsigned long long micros = t.micros();
+                    lk.lock();
+
+                    _flushes++;
+                    _batchSizes.insert(upTo - _flushed);
+                    _flushMicros.insert(micros);
+                    _flushed = upTo;
+                    _flushing = false;
+                    _flushDone.notify_all();
+                }
+            }
+
+            void appendStats(BSONObjBuilder &b) {
+                boost::unique_lock<boost::mutex> lk(_mutex);
+                b.append("requests", static_cast<long long>(_requested));
+                b.append("flushes", static_cast<long long>(_flushes));
+                _batchSizes.append(b, "batchSizes");
+                _flushMicros.append(b, "flushMicros");
+            }
+
+          private:
+            static Histogram::Options batchSizeOptions() {
+                // 1, 2, 4, ..., 2048, more
+                Histogram::Options opts;
+                opts.numBuckets = 13;
+                opts.bucketSize = 1;
+                opts.exponential = true;
+                return opts;
+            }
+
+            static Histogram::Options flushMicrosOptions() {
+                // 100us, 200us, 400us, ..., ~1.6s, more
+                Histogram::Options opts;
+                opts.numBuckets = 16;
+                opts.bucketSize = 100;
+                opts.exponential = true;
+                return opts;
+            }
+
+            boost::mutex _mutex;
+            boost::condition_variable _flushDone;
+            uint64_t _requested; // last ticket handed out
+            uint64_t _flushed;   // every ticket up to this one has been flushed
+            bool _flushing;
+
+            // stats, protected by _mutex
+            uint64_t _flushes;
+            Histogram _batchSizes;
+            Histogram _flushMicros;
+        } logFlushGroup;
+
+        void group_log_flush() {
+            logFlushGroup.flush();
+        }
+
         void checkpoint() {
             // Run a checkpoint. The zeros mean nothing (bdb-API artifacts).
             int r = env->txn_checkpoint(env, 0, 0, 0);
@@ -48,6 +48,8 @@ namespace mongo {
         void get_pending_lock_request_status(vector<BSONObj> &pendingLockRequests);
         void get_live_transaction_status(vector<BSONObj> &liveTransactions);
         void log_flush();
+        // Like log_flush, but concurrent callers share one flush of the recovery log.
+        void group_log_flush();
         void checkpoint();
 
         void set_log_flush_interval(uint32_t period_ms);
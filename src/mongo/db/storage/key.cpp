@@ -22,6 +22,7 @@
 #include "mongo/bson/util/builder.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/storage/key.h"
+#include "mongo/util/mongoutils/str.h"
 #include "mongo/server.h"
 
 namespace mongo {
@@ -546,6 +547,448 @@ namespace mongo {
             return true;
         }
 
+        KeyFormat::Version KeyFormat::parseVersion(const BSONElement &e) {
+            if (e.eoo() || (e.type() == String && e.Stringdata() == "v1")) {
+                return V1;
+            }
+            uassert(17357, mongoutils::str::stream() << "bad keyFormat " << e
+                           << ", must be \"v1\" or \"memcmp\"",
+                    e.type() == String && e.Stringdata() == "memcmp");
+            return MEMCMP;
+        }
+
+        // Doubles at least this large in magnitude are not exact for every long, so we
+        // encode the difference between a long and its double approximation after them.
+        static const double MemcmpExactDoubleLimit = 9007199254740992.0; // 2^53
+
+        // Type hint for a NumberDouble -0.0, which is encoded like 0.0. Not a BSONType.
+        static const unsigned char MemcmpNegativeZeroHint = 0x80 | NumberDouble;
+
+        class MemcmpEncoder {
+        public:
+            MemcmpEncoder(StackBufBuilder &b, StackBufBuilder &hints) :
+                _b(b), _hints(hints), _mask(0) {
+            }
+
+            void setDescending(const bool descending) {
+                _mask = descending ? 0xff : 0;
+            }
+
+            void appendElement(const BSONElement &e, const bool withFieldName) {
+                // Canonical types start at -1 (MinKey), and 0 is reserved for terminators.
+                appendByte(e.canonicalType() + 2);
+                _hints.appendUChar(isNegativeZero(e) ? MemcmpNegativeZeroHint : (unsigned char) e.type());
+                if (withFieldName) {
+                    appendCString(e.fieldName());
+                }
+                switch (e.type()) {
+                case MinKey:
+                case MaxKey:
+                case EOO:
+                case Undefined:
+                case jstNULL:
+                    break;
+                case NumberDouble:
+                case NumberInt:
+                case NumberLong:
+                    appendNumber(e);
+                    break;
+                case String:
+                case Symbol:
+                case Code:
+                    appendString(e.valuestr(), e.valuestrsize() - 1);
+                    break;
+                case Object:
+                case Array:
+                    appendObject(e.embeddedObject());
+                    break;
+                case BinData: {
+                    // Length first, then subtype and data, like compareElementValues.
+                    const int len = e.objsize();
+                    appendBigEndian(len, 4);
+                    appendRaw(e.value() + 4, len + 1);
+                    break;
+                }
+                case jstOID:
+                    appendRaw(e.value(), 12);
+                    break;
+                case Bool:
+                    appendByte(e.boolean() ? 1 : 0);
+                    break;
+                case Date:
+                    // Flip the sign bit so that signed dates sort as unsigned bytes.
+                    appendBigEndian(e.date().millis ^ (1ULL << 63), 8);
+                    break;
+                case Timestamp:
+                    // Timestamps compare as unsigned already.
+                    appendBigEndian(e.date().millis, 8);
+                    break;
+                case RegEx:
+                    appendCString(e.regex());
+                    appendCString(e.regexFlags());
+                    break;
+                case DBRef:
+                    appendBigEndian(e.valuesize(), 4);
+                    appendRaw(e.value(), e.valuesize());
+                    break;
+                case CodeWScope:
+                    appendString(e.codeWScopeCode(), strlen(e.codeWScopeCode()));
+                    appendObject(e.codeWScopeObject());
+                    break;
+                default:
+                    msgasserted(17358, mongoutils::str::stream() << "cannot encode BSON type "
+                                       << e.type() << " in the memcmp key format");
+                }
+            }
+
+        private:
+            void appendByte(const unsigned char c) {
+                _b.appendUChar(c ^ _mask);
+            }
+
+            void appendRaw(const char *p, const int len) {
+                for (int i = 0; i < len; i++) {
+                    appendByte(p[i]);
+                }
+            }
+
+            void appendBigEndian(const unsigned long long v, const int bytes) {
+                for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+                    appendByte((v >> shift) & 0xff);
+                }
+            }
+
+            // Field names and regexes can't contain a zero byte, so a terminator is enough.
+            void appendCString(const char *s) {
+                for (; *s != '\0'; s++) {
+                    appendByte(*s);
+                }
+                appendByte(0);
+            }
+
+            // Strings may contain zero bytes. Escape them as 00 ff and terminate with 00 00,
+            // so that a string sorts before any longer string it is a prefix of.
+            void appendString(const char *s, const size_t len) {
+                for (size_t i = 0; i < len; i++) {
+                    appendByte(s[i]);
+                    if (s[i] == '\0') {
+                        appendByte(0xff);
+                    }
+                }
+                appendByte(0);
+                appendByte(0);
+            }
+
+            void appendObject(const BSONObj &obj) {
+                for (BSONObjIterator it(obj); it.more(); ) {
+                    appendElement(it.next(), true);
+                }
+                appendByte(0);
+            }
+
+            static bool isNegativeZero(const BSONElement &e) {
+                return e.type() == NumberDouble && e._numberDouble() == 0 && signbit(e._numberDouble());
+            }
+
+            static unsigned long long orderedDoubleBits(const double d) {
+                unsigned long long bits;
+                memcpy(&bits, &d, sizeof bits);
+                return (bits & (1ULL << 63)) ? ~bits : bits | (1ULL << 63);
+            }
+
+            // Numbers are a NaN byte (NaN sorts below every other number), the value as an
+            // order-preserving double, and for magnitudes of 2^53 and up, the remainder that
+            // makes a long exact. The double is rounded toward zero so the remainder always
+            // moves away from it, which keeps longs between two doubles in order.
+            void appendNumber(const BSONElement &e) {
+                double d;
+                long long remainder = 0;
+                if (e.type() == NumberLong) {
+                    const long long L = e._numberLong();
+                    d = (double) L;
+                    if (d >= 9223372036854775808.0 /* 2^63 */ ||
+                        (L > 0 && (long long) d > L) || (L < 0 && (long long) d < L)) {
+                        d = nextafter(d, 0.0);
+                    }
+                    remainder = L - (long long) d;
+                } else {
+                    d = e.number();
+                }
+                if (isNaN(d)) {
+                    appendByte(0);
+                    return;
+                }
+                appendByte(1);
+                if (d == 0) {
+                    // -0.0 == 0.0, its hint remembers the sign
+                    d = 0;
+                }
+                appendBigEndian(orderedDoubleBits(d), 8);
+                if (fabs(d) >= MemcmpExactDoubleLimit) {
+                    appendBigEndian(remainder + 0x8000, 2);
+                }
+            }
+
+            StackBufBuilder &_b;
+            StackBufBuilder &_hints;
+            unsigned char _mask;
+        };
+
+        void Key::appendMemcmp(StackBufBuilder &b, const BSONObj &key, const BSONObj *pk,
+                               const Ordering &ordering) {
+            StackBufBuilder keyBuf, pkBuf, keyHints, pkHints;
+            MemcmpEncoder keyEncoder(keyBuf, keyHints);
+            unsigned mask = 1;
+            for (BSONObjIterator it(key); it.more(); mask <<= 1) {
+                keyEncoder.setDescending(ordering.descending(mask));
+                keyEncoder.appendElement(it.next(), false);
+            }
+            if (pk != NULL) {
+                // The primary key part is always ascending, see woCompare.
+                MemcmpEncoder pkEncoder(pkBuf, pkHints);
+                for (BSONObjIterator it(*pk); it.more(); ) {
+                    pkEncoder.appendElement(it.next(), false);
+                }
+            }
+            uassert(17359, mongoutils::str::stream() << "key " << key
+                           << " is too large for the memcmp key format",
+                    keyBuf.len() <= 0xffff && pkBuf.len() <= 0xffff &&
+                    keyHints.len() <= 0xffff && pkHints.len() <= 0xffff);
+            b.appendUChar(MemcmpMarker);
+            const int lengths[] = { keyBuf.len(), pkBuf.len(), keyHints.len(), pkHints.len() };
+            for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+                b.appendUChar(lengths[i] >> 8);
+                b.appendUChar(lengths[i] & 0xff);
+            }
+            b.appendBuf(keyBuf.buf(), keyBuf.len());
+            b.appendBuf(pkBuf.buf(), pkBuf.len());
+            b.appendBuf(keyHints.buf(), keyHints.len());
+            b.appendBuf(pkHints.buf(), pkHints.len());
+        }
+
+        class MemcmpDecoder {
+        public:
+            MemcmpDecoder(const unsigned char *p, const unsigned char *end, const unsigned char *hints) :
+                _p(p), _end(end), _hints(hints), _mask(0) {
+            }
+
+            // Decodes top level elements, which have no field names, until the end.
+            void decodeAll(BSONObjBuilder &b) {
+                while (_p < _end) {
+                    // Ascending type bytes are canonical type + 2, i.e. at most 67 or exactly
+                    // 129 (MaxKey). Descending ones are inverted, i.e. at least 126 but not 129.
+                    _mask = (*_p >= 126 && *_p != 129) ? 0xff : 0;
+                    readByte();
+                    decodeValue(b, "");
+                }
+                verify(_p == _end);
+            }
+
+        private:
+            unsigned char readByte() {
+                return *_p++ ^ _mask;
+            }
+
+            unsigned long long readBigEndian(const int bytes) {
+                unsigned long long v = 0;
+                for (int i = 0; i < bytes; i++) {
+                    v = (v << 8) | readByte();
+                }
+                return v;
+            }
+
+            void readRaw(BufBuilder &bb, const int len) {
+                for (int i = 0; i < len; i++) {
+                    bb.appendUChar(readByte());
+                }
+            }
+
+            void readCString(BufBuilder &bb) {
+                for (unsigned char c = readByte(); c != 0; c = readByte()) {
+                    bb.appendUChar(c);
+                }
+                bb.appendUChar(0);
+            }
+
+            // Appends the unescaped string, and returns its length (without a terminator).
+            int readString(BufBuilder &bb) {
+                int len = 0;
+                while (true) {
+                    const unsigned char c = readByte();
+                    if (c == 0 && readByte() == 0) {
+                        return len;
+                    }
+                    // either a regular byte, or an escaped zero (00 ff)
+                    bb.appendUChar(c);
+                    len++;
+                }
+            }
+
+            void decodeObject(BSONObjBuilder &b) {
+                for (unsigned char c = readByte(); c != 0; c = readByte()) {
+                    BufBuilder name;
+                    readCString(name);
+                    decodeValue(b, name.buf());
+                }
+            }
+
+            double readNumber(long long &remainder) {
+                remainder = 0;
+                if (readByte() == 0) {
+                    return numeric_limits<double>::quiet_NaN();
+                }
+                unsigned long long bits = readBigEndian(8);
+                bits = (bits & (1ULL << 63)) ? bits & ~(1ULL << 63) : ~bits;
+                double d;
+                memcpy(&d, &bits, sizeof d);
+                if (fabs(d) >= MemcmpExactDoubleLimit) {
+                    remainder = (long long) readBigEndian(2) - 0x8000;
+                }
+                return d;
+            }
+
+            // Decodes the value of an element whose type byte was already read.
+            void decodeValue(BSONObjBuilder &b, const StringData &fieldName) {
+                if (*_hints == MemcmpNegativeZeroHint) {
+                    _hints++;
+                    long long remainder;
+                    readNumber(remainder);
+                    b.append(fieldName, -0.0);
+                    return;
+                }
+                const BSONType type = (BSONType) (signed char) *_hints++;
+                switch (type) {
+                case MinKey: b.appendMinKey(fieldName); break;
+                case MaxKey: b.appendMaxKey(fieldName); break;
+                case jstNULL: b.appendNull(fieldName); break;
+                case Undefined: b.appendUndefined(fieldName); break;
+                case NumberDouble:
+                case NumberInt:
+                case NumberLong: {
+                    long long remainder;
+                    const double d = readNumber(remainder);
+                    if (type == NumberInt) {
+                        b.append(fieldName, (int) d);
+                    } else if (type == NumberLong) {
+                        b.append(fieldName, (long long) d + remainder);
+                    } else {
+                        b.append(fieldName, d);
+                    }
+                    break;
+                }
+                case String:
+                case Symbol:
+                case Code: {
+                    // we build the element ourself as the string may contain zeros
+                    BufBuilder &bb = b.bb();
+                    bb.appendNum((char) type);
+                    bb.appendStr(fieldName);
+                    const int lenOffset = bb.len();
+                    bb.appendNum((int) 0);
+                    const int len = readString(bb);
+                    bb.appendUChar(0);
+                    *reinterpret_cast<int *>(bb.buf() + lenOffset) = len + 1;
+                    break;
+                }
+                case Object: {
+                    BSONObjBuilder sub(b.subobjStart(fieldName));
+                    decodeObject(sub);
+                    sub.done();
+                    break;
+                }
+                case Array: {
+                    BSONObjBuilder sub(b.subarrayStart(fieldName));
+                    decodeObject(sub);
+                    sub.done();
+                    break;
+                }
+                case BinData: {
+                    const int len = readBigEndian(4);
+                    BufBuilder &bb = b.bb();
+                    bb.appendNum((char) type);
+                    bb.appendStr(fieldName);
+                    bb.appendNum(len);
+                    readRaw(bb, len + 1);
+                    break;
+                }
+                case jstOID: {
+                    BufBuilder &bb = b.bb();
+                    bb.appendNum((char) type);
+                    bb.appendStr(fieldName);
+                    readRaw(bb, 12);
+                    break;
+                }
+                case Bool:
+                    b.appendBool(fieldName, readByte() != 0);
+                    break;
+                case Date:
+                    b.appendDate(fieldName, Date_t(readBigEndian(8) ^ (1ULL << 63)));
+                    break;
+                case Timestamp:
+                    b.appendTimestamp(fieldName, readBigEndian(8));
+                    break;
+                case RegEx: {
+                    BufBuilder &bb = b.bb();
+                    bb.appendNum((char) type);
+                    bb.appendStr(fieldName);
+                    readCString(bb);
+                    readCString(bb);
+                    break;
+                }
+                case DBRef: {
+                    const int len = readBigEndian(4);
+                    BufBuilder &bb = b.bb();
+                    bb.appendNum((char) type);
+                    bb.appendStr(fieldName);
+                    readRaw(bb, len);
+                    break;
+                }
+                case CodeWScope: {
+                    BufBuilder code;
+                    const int len = readString(code);
+                    BSONObjBuilder scope;
+                    decodeObject(scope);
+                    b.appendCodeWScope(fieldName, StringData(code.buf(), len), scope.done());
+                    break;
+                }
+                default:
+                    msgasserted(17360, mongoutils::str::stream() << "bad BSON type " << type
+                                       << " in a memcmp key");
+                }
+            }
+
+            const unsigned char *_p;
+            const unsigned char *const _end;
+            const unsigned char *_hints;
+            unsigned char _mask;
+        };
+
+        BSONObj Key::memcmpKey(BufBuilder &bb) const {
+            const unsigned char *p = reinterpret_cast<const unsigned char *>(_buf);
+            const size_t keyLen = readLength(p + 1);
+            const size_t pkLen = readLength(p + 3);
+            const unsigned char *keyData = p + MemcmpHeaderSize;
+            MemcmpDecoder decoder(keyData, keyData + keyLen, keyData + keyLen + pkLen);
+            BSONObjBuilder b(bb);
+            decoder.decodeAll(b);
+            return b.done();
+        }
+
+        BSONObj Key::memcmpPK() const {
+            const unsigned char *p = reinterpret_cast<const unsigned char *>(_buf);
+            const size_t keyLen = readLength(p + 1);
+            const size_t pkLen = readLength(p + 3);
+            const size_t keyHintsLen = readLength(p + 5);
+            if (pkLen == 0) {
+                return BSONObj();
+            }
+            const unsigned char *pkData = p + MemcmpHeaderSize + keyLen;
+            MemcmpDecoder decoder(pkData, pkData + pkLen, pkData + pkLen + keyHintsLen);
+            BSONObjBuilder b;
+            decoder.decodeAll(b);
+            return b.obj();
+        }
+
     } // namespace storage
 
 } // namespace mongo
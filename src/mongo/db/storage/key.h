@@ -113,40 +113,100 @@ namespace mongo {
             void traditional(const BSONObj& obj); // store as traditional bson not as compact format
         };
 
+        // Describes how a dictionary serializes its keys.
+        //
+        // V1 is the KeyV1 compact format, followed by the BSON primary key for secondary keys.
+        // Comparing two V1 keys decodes both, and falls back to BSONObj::woCompare for the pk.
+        //
+        // MEMCMP is an order-preserving byte format, so that two keys compare with memcmp:
+        //
+        //    [ 1 byte: MemcmpMarker,
+        //      2 bytes: big-endian length of the encoded key,
+        //      2 bytes: big-endian length of the encoded primary key (0 if there is none),
+        //      2 bytes: big-endian length of the key's type hints,
+        //      2 bytes: big-endian length of the primary key's type hints,
+        //      encoded key, with descending fields' bytes inverted,
+        //      encoded primary key, always ascending,
+        //      type hints: the BSONType of each encoded element of the key, in encoding order,
+        //      type hints for the primary key ]
+        //
+        // Elements are encoded as their canonical type, then a value whose bytes sort the way
+        // compareElementValues does. Values that compare equal but have different types (1 and
+        // 1.0, strings and symbols) encode to the same bytes; the type hints are only used to
+        // decode the key back to BSON and are never compared.
+        class KeyFormat {
+        public:
+            enum Version {
+                V1 = 0,
+                MEMCMP = 1
+            };
+
+            KeyFormat(const Version version, const Ordering &ordering) :
+                _version(version), _ordering(ordering) {
+            }
+
+            // Parses the "keyFormat" field of an index spec, which may be absent (V1).
+            static Version parseVersion(const BSONElement &e);
+
+            Version version() const {
+                return _version;
+            }
+
+            bool memcmp() const {
+                return _version == MEMCMP;
+            }
+
+            const Ordering &ordering() const {
+                return _ordering;
+            }
+
+        private:
+            Version _version;
+            Ordering _ordering;
+        };
+
         // Dictionary key format:
-        // { KeyV1 key [, BSONObj primary key] }
+        // { KeyV1 key [, BSONObj primary key] }, or the MEMCMP format described above.
         class Key {
         public:
             // For serializing
-            Key(const BSONObj &key, const BSONObj *pk) {
-                KeyV1Owned keyOwned(key);
-                _b.appendBuf(keyOwned.data(), keyOwned.dataSize());
-                if (pk != NULL) {
-                    _b.appendBuf(pk->objdata(), pk->objsize());
-                }
-                _buf = _b.buf();
-                _size = _b.len();
+            Key(const BSONObj &key, const BSONObj *pk, const KeyFormat &format) :
+                _keyOnly(false) {
+                append(key, pk, format);
             }
 
             // For deserializing
-            Key() : _buf(NULL), _size(0) {
+            Key() : _buf(NULL), _size(0), _keyOnly(false) {
             }
 
             Key(const DBT *dbt) :
-                _buf(static_cast<const char *>(dbt->data)), _size(dbt->size) {
+                _buf(static_cast<const char *>(dbt->data)), _size(dbt->size), _keyOnly(false) {
             }
 
-            Key(const char *buf, const bool hasPK) : _buf(buf) {
-                storage::KeyV1 kv1(_buf);
-                const size_t keySize = kv1.dataSize();
-                _size = keySize + (hasPK ? BSONObj(_buf + keySize).objsize() : 0);
+            // If hasPK is false, the Key only looks at the secondary key part of buf, and
+            // ignores the appended primary key (if any) when comparing.
+            Key(const char *buf, const bool hasPK) : _buf(buf), _keyOnly(false) {
+                if (isMemcmp(_buf)) {
+                    // The header knows the full size, we remember to ignore the pk instead.
+                    _size = memcmpSize(_buf);
+                    _keyOnly = !hasPK;
+                } else {
+                    storage::KeyV1 kv1(_buf);
+                    const size_t keySize = kv1.dataSize();
+                    _size = keySize + (hasPK ? BSONObj(_buf + keySize).objsize() : 0);
+                }
             }
 
             static int woCompare(const Key &key1, const Key &key2, const Ordering &ordering) {
-                // Interpret the beginning of the Key's buf as KeyV1. The size of the Key
-                // must be at least as big as the size of the KeyV1 (otherwise format error).
                 dassert(key1.buf());
                 dassert(key2.buf());
+                if (isMemcmp(key1.buf())) {
+                    dassert(isMemcmp(key2.buf()));
+                    return memcmpCompare(key1, key2);
+                }
+
+                // Interpret the beginning of the Key's buf as KeyV1. The size of the Key
+                // must be at least as big as the size of the KeyV1 (otherwise format error).
                 const KeyV1 k1(static_cast<const char *>(key1.buf()));
                 const KeyV1 k2(static_cast<const char *>(key2.buf()));
                 dassert((int) key1.size() >= k1.dataSize());
@@ -194,6 +254,25 @@ namespace mongo {
                 return 0;
             }
 
+            // Compares two keys in the MEMCMP format: the encoded keys with memcmp, and if
+            // they are equal, the encoded primary keys (unless either side ignores its pk).
+            static int memcmpCompare(const Key &key1, const Key &key2) {
+                const unsigned char *p1 = reinterpret_cast<const unsigned char *>(key1.buf());
+                const unsigned char *p2 = reinterpret_cast<const unsigned char *>(key2.buf());
+                const size_t keyLen1 = readLength(p1 + 1);
+                const size_t keyLen2 = readLength(p2 + 1);
+                const int c = compareBytes(p1 + MemcmpHeaderSize, keyLen1, p2 + MemcmpHeaderSize, keyLen2);
+                if (c != 0 || key1._keyOnly || key2._keyOnly) {
+                    return c;
+                }
+                const size_t pkLen1 = readLength(p1 + 3);
+                const size_t pkLen2 = readLength(p2 + 3);
+                // The associated primary key must exist in both keys, or neither.
+                dassert((pkLen1 == 0) == (pkLen2 == 0));
+                return compareBytes(p1 + MemcmpHeaderSize + keyLen1, pkLen1,
+                                    p2 + MemcmpHeaderSize + keyLen2, pkLen2);
+            }
+
             // The real comparison function is a function of two keys
             // and an ordering, which is a bit more clear.
             int woCompare(const Key &key, const Ordering &ordering) const {
@@ -208,27 +287,22 @@ namespace mongo {
             void set(const char *buf, size_t size) {
                 _buf = buf;
                 _size = size;
+                _keyOnly = false;
             }
 
-            void reset(const BSONObj &other, const BSONObj *pk) {
+            void reset(const BSONObj &other, const BSONObj *pk, const KeyFormat &format) {
                 _b.reset();
-                KeyV1Owned otherOwned(other);
-                _b.appendBuf(otherOwned.data(), otherOwned.dataSize());
-                if (pk != NULL) {
-                    _b.appendBuf(pk->objdata(), pk->objsize());
-                }
-                _buf = _b.buf();
-                _size = _b.len();
+                _keyOnly = false;
+                append(other, pk, format);
             }
 
-            void reset(const KeyV1 &other, const BSONObj *pk) {
+            // Makes this Key an owned copy of other, including its primary key.
+            void reset(const Key &other) {
                 _b.reset();
-                _b.appendBuf(other.data(), other.dataSize());
-                if (pk != NULL) {
-                    _b.appendBuf(pk->objdata(), pk->objsize());
-                }
+                _b.appendBuf(other.buf(), other.size());
                 _buf = _b.buf();
                 _size = _b.len();
+                _keyOnly = false;
             }
 
             BSONObj key() const {
@@ -237,28 +311,99 @@ namespace mongo {
             }
 
             BSONObj key(BufBuilder &bb) const {
+                if (isMemcmp(_buf)) {
+                    return memcmpKey(bb);
+                }
                 storage::KeyV1 kv1(_buf);
                 return kv1.toBson(bb);
             }
 
             BSONObj pk() const {
+                if (isMemcmp(_buf)) {
+                    return memcmpPK();
+                }
                 storage::KeyV1 kv1(_buf);
                 const size_t keySize = kv1.dataSize();
                 return keySize < _size ? BSONObj(_buf + keySize) : BSONObj();
             }
 
+            // Cheaper than !pk().isEmpty(), which has to decode memcmp keys.
+            bool hasPK() const {
+                if (isMemcmp(_buf)) {
+                    return readLength(reinterpret_cast<const unsigned char *>(_buf) + 3) > 0;
+                }
+                storage::KeyV1 kv1(_buf);
+                return (size_t) kv1.dataSize() < _size;
+            }
+
             const char *buf() const {
                 return _buf;
             }
 
+            // The encoded key of a MEMCMP key, without its header, primary key or type hints.
+            // Its bytes compare with memcmp the way the key does.
+            StringData memcmpKeyBytes() const {
+                dassert(isMemcmp(_buf));
+                return StringData(_buf + MemcmpHeaderSize,
+                                  readLength(reinterpret_cast<const unsigned char *>(_buf) + 1));
+            }
+
             int size() const {
                 return _size;
             }
 
+            // KeyV1 data never has the high bit set in its first byte unless it is the IsBSON
+            // sentinel (0xff), so this marker cannot be mistaken for a V1 key.
+            static const unsigned char MemcmpMarker = 0xfe;
+            static const size_t MemcmpHeaderSize = 9;
+
+            static bool isMemcmp(const char *buf) {
+                return *reinterpret_cast<const unsigned char *>(buf) == MemcmpMarker;
+            }
+
         private:
+            void append(const BSONObj &key, const BSONObj *pk, const KeyFormat &format) {
+                if (format.memcmp()) {
+                    appendMemcmp(_b, key, pk, format.ordering());
+                } else {
+                    KeyV1Owned keyOwned(key);
+                    _b.appendBuf(keyOwned.data(), keyOwned.dataSize());
+                    if (pk != NULL) {
+                        _b.appendBuf(pk->objdata(), pk->objsize());
+                    }
+                }
+                _buf = _b.buf();
+                _size = _b.len();
+            }
+
+            static size_t readLength(const unsigned char *p) {
+                return (size_t(p[0]) << 8) | p[1];
+            }
+
+            static int compareBytes(const unsigned char *p1, size_t len1,
+                                    const unsigned char *p2, size_t len2) {
+                const int c = memcmp(p1, p2, std::min(len1, len2));
+                if (c != 0) {
+                    return c < 0 ? -1 : 1;
+                }
+                return len1 < len2 ? -1 : (len1 == len2 ? 0 : 1);
+            }
+
+            static size_t memcmpSize(const char *buf) {
+                const unsigned char *p = reinterpret_cast<const unsigned char *>(buf);
+                return MemcmpHeaderSize + readLength(p + 1) + readLength(p + 3) +
+                       readLength(p + 5) + readLength(p + 7);
+            }
+
+            static void appendMemcmp(StackBufBuilder &b, const BSONObj &key, const BSONObj *pk,
+                                     const Ordering &ordering);
+            BSONObj memcmpKey(BufBuilder &bb) const;
+            BSONObj memcmpPK() const;
+
             StackBufBuilder _b;
             const char *_buf;
             size_t _size;
+            bool _keyOnly;
         };
 
     } // namespace storage
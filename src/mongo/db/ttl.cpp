@@ -26,6 +26,7 @@
 #include "mongo/db/commands/server_status.h"
 #include "mongo/db/databaseholder.h"
 #include "mongo/db/instance.h"
+#include "mongo/db/namespacestring.h"
 #include "mongo/db/ops/delete.h"
 #include "mongo/db/replutil.h"
 #include "mongo/db/server_parameters.h"
@@ -39,11 +40,58 @@ namespace mongo {
     ServerStatusMetricField<Counter64> ttlPassesDisplay("ttl.passes", &ttlPasses);
     ServerStatusMetricField<Counter64> ttlDeletedDocumentsDisplay("ttl.deletedDocuments", &ttlDeletedDocuments);
 
+    Counter64 ttlPartitionsAdded;
+    Counter64 ttlPartitionsDropped;
+
+    ServerStatusMetricField<Counter64> ttlPartitionsAddedDisplay("ttl.partitionsAdded", &ttlPartitionsAdded);
+    ServerStatusMetricField<Counter64> ttlPartitionsDroppedDisplay("ttl.partitionsDropped", &ttlPartitionsDropped);
+
     MONGO_EXPORT_SERVER_PARAMETER( ttlMonitorEnabled, bool, true );
+    // expired documents deleted per transaction
+    MONGO_EXPORT_SERVER_PARAMETER( ttlDeleteBatchSize, int, 1000 );
+    // maximum documents deleted per second by the TTL monitor, 0 means no limit
+    MONGO_EXPORT_SERVER_PARAMETER( ttlDeletesPerSecond, int, 0 );
+
+    /**
+     * What the TTL monitor is up to, for serverStatus.
+     */
+    class TTLStats : public ServerStatusSection {
+    public:
+        TTLStats() : ServerStatusSection( "ttl" ), _passMillis( 0 ), _passDeleted( 0 ) {}
+        virtual bool includeByDefault() const { return true; }
+
+        void startPass() {
+            _passMillis.store( 0 );
+            _passDeleted.store( 0 );
+        }
+
+        void deleted( long long n, long long passMillis ) {
+            _passDeleted.fetchAndAdd( n );
+            _passMillis.store( passMillis );
+            _batches.increment();
+        }
+
+        BSONObj generateSection(const BSONElement& configElement) const {
+            BSONObjBuilder b;
+            b.appendNumber( "batches", _batches.get() );
+            const long long millis = _passMillis.load();
+            b.append( "deletesPerSecond",
+                      millis > 0 ? _passDeleted.load() * 1000.0 / millis : 0.0 );
+            b.append( "deletesPerSecondLimit", ttlDeletesPerSecond );
+            b.append( "batchSize", ttlDeleteBatchSize );
+            return b.obj();
+        }
+
+    private:
+        Counter64 _batches;
+        // over the current (or last) pass, for the delete rate
+        AtomicInt64 _passMillis;
+        AtomicInt64 _passDeleted;
+    } ttlStats;
     
     class TTLMonitor : public BackgroundJob {
     public:
-        TTLMonitor(){}
+        TTLMonitor() : _passDeleted(0) {}
         virtual ~TTLMonitor(){}
 
         virtual string name() const { return "TTLMonitor"; }
@@ -95,32 +143,167 @@ namespace mongo {
                 }
                 
                 LOG(1) << "TTL: " << key << " \t " << query << endl;
-                
-                long long n = 0;
-                {
-                    string ns = idx["ns"].String();
-                    OpSettings settings;
-                    settings.setQueryCursorMode(WRITE_LOCK_CURSOR);
-                    cc().setOpSettings(settings);
-
-                    LOCK_REASON(lockReason, "ttl: deleting expired documents");
-                    Client::ReadContext ctx(ns, lockReason);
-                    Client::Transaction transaction(DB_SERIALIZABLE);
-                    Collection *cl = getCollection(ns);
-                    if (!cl) {
+
+                // only do deletes if on master
+                if ( ! isMaster ) {
+                    continue;
+                }
+
+                const string ns = idx["ns"].String();
+
+                // Delete in batches, each in its own transaction, so that a big backlog doesn't
+                // become one huge transaction and oplog entry.  A batch that comes up short has
+                // found everything left to delete.
+                long long total = 0;
+                while ( ! inShutdown() && ttlMonitorEnabled ) {
+                    const long long n = deleteBatch( ns, query );
+                    if ( n < 0 ) {
                         // collection was dropped
-                        continue;
+                        break;
                     }
-                    // only do deletes if on master
-                    if ( ! isMaster ) {
-                        continue;
-                    }
-                    n = deleteObjects(ns.c_str(), query, false, true);
-                    transaction.commit();
+                    total += n;
+                    _passDeleted += n;
                     ttlDeletedDocuments.increment( n );
+                    ttlStats.deleted( n, _passTimer.millis() );
+                    if ( n < std::max( ttlDeleteBatchSize, 1 ) ) {
+                        break;
+                    }
+                    throttle();
+                }
+
+                LOG(1) << "\tTTL deleted: " << total << endl;
+            }
+        }
+
+        /**
+         * Partitioned collections created with expireAfterSeconds expire whole partitions instead
+         * of documents: a new partition is started every partitionIntervalSeconds, and the
+         * oldest partitions are dropped once the newest primary key they hold has expired.  The
+         * primary key must lead with a Date, Timestamp or ObjectId for a partition's age to be
+         * known.
+         */
+        void doPartitionTTLForDB( const string& dbName ) {
+            if ( ! isMasterNs( dbName.c_str() ) ) {
+                return;
+            }
+
+            Client::GodScope god;
+
+            vector<BSONObj> collections;
+            {
+                auto_ptr<DBClientCursor> cursor =
+                                db.query( getSisterNS(dbName, "system.namespaces") ,
+                                          BSON( "options.partitioned" << true <<
+                                                "options." + secondsExpireField << BSON( "$exists" << true ) ) );
+                if ( cursor.get() ) {
+                    while ( cursor->more() ) {
+                        collections.push_back( cursor->next().getOwned() );
+                    }
+                }
+            }
+
+            for ( unsigned i=0; i<collections.size(); i++ ) {
+                const string ns = collections[i]["name"].String();
+                const BSONObj options = collections[i]["options"].Obj();
+                const long long expireMillis = 1000 * options[secondsExpireField].numberLong();
+                if ( expireMillis <= 0 ) {
+                    continue;
+                }
+                // same schedule as the partitioned oplog when no interval is given
+                long long intervalMillis = 1000 * options["partitionIntervalSeconds"].numberLong();
+                if ( intervalMillis <= 0 ) {
+                    intervalMillis = expireMillis >= 24*60*60*1000 ? 24*60*60*1000 : 60*60*1000;
                 }
 
-                LOG(1) << "\tTTL deleted: " << n << endl;
+                const string coll = nsToCollectionSubstring( ns ).toString();
+                BSONObj info;
+                if ( ! db.runCommand( dbName, BSON( "getPartitionInfo" << coll ), info ) ) {
+                    LOG(1) << "TTL: could not get partitions of " << ns << ": " << info << endl;
+                    continue;
+                }
+                const vector<BSONElement> partitions = info["partitions"].Array();
+                const long long now = curTimeMillis64();
+
+                // Drop every partition but the last whose newest key is past its expiry.
+                // Partitions are in key order, so stop at the first one that isn't.
+                for ( size_t p = 0; p + 1 < partitions.size(); p++ ) {
+                    const BSONObj partition = partitions[p].Obj();
+                    const BSONElement newest = partition["max"].Obj().firstElement();
+                    long long newestMillis;
+                    if ( newest.type() == Date ) {
+                        newestMillis = newest.date().millis;
+                    }
+                    else if ( newest.type() == Timestamp ) {
+                        newestMillis = newest.timestampTime().millis;
+                    }
+                    else if ( newest.type() == jstOID ) {
+                        OID oid = newest.__oid();
+                        newestMillis = oid.asDateT().millis;
+                    }
+                    else {
+                        LOG(1) << "TTL: can't tell the age of partition " << partition
+                               << " of " << ns << ", its key doesn't start with a time" << endl;
+                        break;
+                    }
+                    if ( newestMillis > now - expireMillis ) {
+                        break;
+                    }
+                    BSONObj res;
+                    if ( ! db.runCommand( dbName, BSON( "dropPartition" << coll <<
+                                                        "id" << partition["_id"].numberLong() ), res ) ) {
+                        warning() << "TTL: failed to drop partition " << partition << " of " << ns
+                                  << ": " << res << endl;
+                        break;
+                    }
+                    LOG(1) << "TTL: dropped partition " << partition << " of " << ns << endl;
+                    ttlPartitionsDropped.increment();
+                }
+
+                const long long lastCreateTime =
+                        partitions.back().Obj()["createTime"].date().millis;
+                if ( now - lastCreateTime >= intervalMillis ) {
+                    BSONObj res;
+                    // fails harmlessly if the last partition is still empty
+                    if ( db.runCommand( dbName, BSON( "addPartition" << coll ), res ) ) {
+                        LOG(1) << "TTL: added a partition to " << ns << endl;
+                        ttlPartitionsAdded.increment();
+                    }
+                    else {
+                        LOG(1) << "TTL: did not add a partition to " << ns << ": " << res << endl;
+                    }
+                }
+            }
+        }
+
+        /** @return the number of documents deleted, or -1 if the collection doesn't exist */
+        long long deleteBatch( const string& ns, const BSONObj& query ) {
+            OpSettings settings;
+            settings.setQueryCursorMode(WRITE_LOCK_CURSOR);
+            cc().setOpSettings(settings);
+
+            LOCK_REASON(lockReason, "ttl: deleting expired documents");
+            Client::ReadContext ctx(ns, lockReason);
+            Client::Transaction transaction(DB_SERIALIZABLE);
+            Collection *cl = getCollection(ns);
+            if (!cl) {
+                return -1;
+            }
+            const long long n = deleteObjects(ns.c_str(), query, false, true,
+                                              std::max( ttlDeleteBatchSize, 1 ));
+            transaction.commit();
+            return n;
+        }
+
+        /** Sleeps long enough to keep this pass's deletes within ttlDeletesPerSecond. */
+        void throttle() {
+            const int rate = ttlDeletesPerSecond;
+            if ( rate <= 0 ) {
+                return;
+            }
+            const long long targetMillis = _passDeleted * 1000 / rate;
+            const long long elapsed = _passTimer.millis();
+            if ( targetMillis > elapsed ) {
+                sleepmillis( targetMillis - elapsed );
             }
         }
 
@@ -149,11 +332,15 @@ namespace mongo {
                 }
                 
                 ttlPasses.increment();
+                ttlStats.startPass();
+                _passTimer.reset();
+                _passDeleted = 0;
 
                 for ( set<string>::const_iterator i=dbs.begin(); i!=dbs.end(); ++i ) {
                     string db = *i;
                     try {
                         doTTLForDB( db );
+                        doPartitionTTLForDB( db );
                     }
                     catch ( DBException& e ) {
                         error() << "error processing ttl for db: " << db << " " << e << endl;
@@ -164,6 +351,10 @@ namespace mongo {
         }
 
         DBDirectClient db;
+
+        // for rate limiting and stats over one pass through all dbs
+        Timer _passTimer;
+        long long _passDeleted;
     };
 
     void startTTLBackgroundJob() {
@@ -50,6 +50,7 @@ namespace mongo {
             }
             
             chunkRanges.reloadAll( chunkMap );
+            _buildRoutingIndex();
         }
     };
     
@@ -357,6 +357,85 @@ namespace CursorTests {
             }
         };
 
+        /**
+         * A bulk fetching scan of a non-clustering secondary index looks up the documents of
+         * buffered rows ahead of time, in primary key order, and each row still gets its own
+         * document.
+         */
+        class PrefetchDocuments : public Base {
+        public:
+            void run() {
+                _c.dropCollection( ns() );
+                _c.ensureIndex( ns(), BSON( "a" << 1 ) );
+                // a is in the reverse order of _id, so index order is not pk order
+                for( int i = 0; i < 1000; ++i ) {
+                    _c.insert( ns(), BSON( "_id" << i << "a" << 1000 - i << "b" << i * 2 ) );
+                }
+                // a multikey document, whose pk is in the index twice
+                _c.insert( ns(), BSON( "_id" << 1000 << "a" << BSON_ARRAY( 2000 << 2001 ) ) );
+
+                Client::WithOpSettings wos( OpSettings().setBulkFetch( true ) );
+                Client::Transaction transaction(DB_TXN_SNAPSHOT | DB_TXN_READ_ONLY);
+                Client::ReadContext ctx( ns(), mongo::unittest::EMPTY_STRING );
+                {
+                    Collection *cl = getCollection( ns() );
+                    shared_ptr<Cursor> c( Cursor::make( cl, cl->idx(1), BSON( "" << 1 ),
+                                                        BSON( "" << 3000 ), true, 1 ) );
+                    int n = 0;
+                    for( ; c->ok(); c->advance(), ++n ) {
+                        BSONObj obj = c->current();
+                        ASSERT_EQUALS( c->currPK().firstElement().numberInt(),
+                                       obj[ "_id" ].numberInt() );
+                        if ( obj[ "_id" ].numberInt() < 1000 ) {
+                            ASSERT_EQUALS( c->currKey().firstElement().numberInt(),
+                                           obj[ "a" ].numberInt() );
+                            ASSERT_EQUALS( obj[ "_id" ].numberInt() * 2, obj[ "b" ].numberInt() );
+                        }
+                    }
+                    ASSERT_EQUALS( 1002, n );
+                }
+                transaction.commit();
+            }
+        };
+
+        /** Rows the key matcher rejects aren't prefetched, but the ones it keeps still are. */
+        class PrefetchDocumentsKeyMatcher : public Base {
+        public:
+            void run() {
+                _c.dropCollection( ns() );
+                _c.ensureIndex( ns(), BSON( "a" << 1 ) );
+                for( int i = 0; i < 1000; ++i ) {
+                    _c.insert( ns(), BSON( "_id" << i << "a" << 1000 - i << "b" << i * 2 ) );
+                }
+
+                Client::WithOpSettings wos( OpSettings().setBulkFetch( true ) );
+                Client::Transaction transaction(DB_TXN_SNAPSHOT | DB_TXN_READ_ONLY);
+                Client::ReadContext ctx( ns(), mongo::unittest::EMPTY_STRING );
+                {
+                    Collection *cl = getCollection( ns() );
+                    shared_ptr<Cursor> c( Cursor::make( cl, cl->idx(1), BSON( "" << 1 ),
+                                                        BSON( "" << 500 ), true, 1 ) );
+                    BSONObj query = BSON( "a" << BSON( "$mod" << BSON_ARRAY( 7 << 0 ) ) );
+                    c->setMatcher( shared_ptr<CoveredIndexMatcher>(
+                            new CoveredIndexMatcher( query, BSON( "a" << 1 ) ) ) );
+                    int n = 0;
+                    for( ; c->ok(); c->advance() ) {
+                        if ( !c->currentMatches() ) {
+                            continue;
+                        }
+                        BSONObj obj = c->current();
+                        ASSERT_EQUALS( c->currPK().firstElement().numberInt(),
+                                       obj[ "_id" ].numberInt() );
+                        ASSERT_EQUALS( 0, obj[ "a" ].numberInt() % 7 );
+                        ASSERT_EQUALS( obj[ "_id" ].numberInt() * 2, obj[ "b" ].numberInt() );
+                        ++n;
+                    }
+                    ASSERT_EQUALS( 71, n );
+                }
+                transaction.commit();
+            }
+        };
+
         class RequestMatcherFalse : public QueryPlanSelectionPolicy {
             virtual string name() const { return "RequestMatcherFalse"; }
             virtual bool requestMatcher() const { return false; }
@@ -643,6 +722,38 @@ namespace CursorTests {
             
         } // namespace Pin
 
+        /** Cursors spread over every registry stripe are all counted, found and invalidated. */
+        class ManyCursors {
+        public:
+            void run() {
+                Client::Transaction transaction(DB_SERIALIZABLE);
+                Client::WriteContext ctx(ns(), mongo::unittest::EMPTY_STRING);
+                const unsigned before = ClientCursor::numCursors();
+                vector<ClientCursor *> cursors;
+                for (int i = 0; i < 100; ++i) {
+                    cursors.push_back(new ClientCursor(0, BasicCursor::make(getCollection(ns())), ns()));
+                }
+                ASSERT_EQUALS(before + 100, ClientCursor::numCursors());
+
+                set<CursorId> ids;
+                ClientCursor::find(ns(), ids);
+                ASSERT_EQUALS(100U, ids.size());
+                for (vector<ClientCursor *>::const_iterator it = cursors.begin(); it != cursors.end(); ++it) {
+                    ASSERT(ids.count((*it)->cursorid()));
+                }
+
+                // Erase one by id, invalidate the rest.
+                ASSERT(ClientCursor::erase(cursors[0]->cursorid()));
+                ASSERT_EQUALS(before + 99, ClientCursor::numCursors());
+                ClientCursor::invalidate(ns());
+                ASSERT_EQUALS(before, ClientCursor::numCursors());
+                ids.clear();
+                ClientCursor::find(ns(), ids);
+                ASSERT(ids.empty());
+                transaction.commit();
+            }
+        };
+
     } // namespace ClientCursor
     
     class All : public Suite {
@@ -659,6 +770,8 @@ namespace CursorTests {
             add<IndexCursor::RangeEq>();
             add<IndexCursor::RangeIn>();
             add<IndexCursor::AbortImplicitScan>();
+            add<IndexCursor::PrefetchDocuments>();
+            add<IndexCursor::PrefetchDocumentsKeyMatcher>();
             add<IndexCursor::DontMatchOutOfIndexBoundsDocuments>();
             add<IndexCursor::MatcherRequiredTwoConstraintsSameField>();
             add<IndexCursor::MatcherRequiredTwoConstraintsDifferentFields>();
@@ -667,6 +780,7 @@ namespace CursorTests {
             add<ClientCursor::Pin::PinCursor>();
             add<ClientCursor::Pin::PinTwice>();
             add<ClientCursor::Pin::CursorDeleted>();
+            add<ClientCursor::ManyCursors>();
         }
     } myall;
 } // namespace CursorTests
@@ -46,6 +46,26 @@ namespace DocumentSourceTests {
         }
     };
 
+    /** Lowers aggregationSpillThreshold so that every document is spilled in its own run. */
+    class SpillEverything {
+    public:
+        SpillEverything() : _saved( aggregationSpillThreshold ) {
+            aggregationSpillThreshold = 1;
+        }
+        ~SpillEverything() {
+            aggregationSpillThreshold = _saved;
+        }
+    private:
+        BytesQuantity<uint64_t> _saved;
+    };
+
+    /** Returns the number of runs a stage reports in its explain output. */
+    long long explainedRuns( const intrusive_ptr<DocumentSource>& source ) {
+        BSONArrayBuilder bab;
+        source->addToBsonArray( &bab, true );
+        return bab.arr()[ 0 ].Obj().firstElement().Obj()[ "runs" ].numberLong();
+    }
+
     namespace DocumentSourceClass {
         using mongo::DocumentSource;
 
@@ -218,6 +238,35 @@ namespace DocumentSourceTests {
             }
         };
 
+        /** Iterate a DocumentSourceCursor in batches, mixed with single documents. */
+        class IterateBatches : public Base {
+        public:
+            void run() {
+                for( int i = 1; i <= 5; ++i ) {
+                    client.insert( ns, BSON( "a" << i ) );
+                }
+                createSource();
+                vector<Document> batch;
+                // A full batch, with more results to come.
+                ASSERT( source()->getNextBatch( batch, 2 ) );
+                ASSERT_EQUALS( 2U, batch.size() );
+                ASSERT_EQUALS( 1, batch[ 0 ]->getValue( "a" ).coerceToInt() );
+                ASSERT_EQUALS( 2, batch[ 1 ]->getValue( "a" ).coerceToInt() );
+                // The source is positioned after the batch.
+                ASSERT( !source()->eof() );
+                ASSERT_EQUALS( 3, source()->getCurrent()->getValue( "a" ).coerceToInt() );
+                ASSERT( source()->advance() );
+                // The last batch is appended, and the source is exhausted.
+                ASSERT( !source()->getNextBatch( batch, 10 ) );
+                ASSERT_EQUALS( 4U, batch.size() );
+                ASSERT_EQUALS( 4, batch[ 2 ]->getValue( "a" ).coerceToInt() );
+                ASSERT_EQUALS( 5, batch[ 3 ]->getValue( "a" ).coerceToInt() );
+                ASSERT( source()->eof() );
+                // Exhausting the source releases the read lock.
+                ASSERT( !Lock::isReadLocked() );
+            }
+        };
+
         /** Set a value or await an expected value. */
         class PendingValue {
         public:
@@ -275,6 +324,80 @@ namespace DocumentSourceTests {
 
     } // namespace DocumentSourceCursor
 
+    namespace DocumentSourceParallelCursor {
+
+        using mongo::DocumentSourceParallelCursor;
+
+        class Base : public CollectionBase {
+        public:
+            Base() :
+                _ctx( ExpressionContext::create( &InterruptStatusMongod::status ) ) {
+                for( int i = 0; i < 100; ++i ) {
+                    client.insert( ns, BSON( "_id" << i << "a" << i % 3 ) );
+                }
+            }
+        protected:
+            /** Split the collection at _id 25, 50 and 75 and group it by a on two threads. */
+            void createSource() {
+                BSONObj shardPipeline = fromjson( "{aggregate:'documentsourcetests',"
+                                                  "pipeline:[{$group:{_id:'$a',n:{$sum:1}}}]}" );
+                vector<BSONObj> splitKeys;
+                for( int i = 25; i < 100; i += 25 ) {
+                    splitKeys.push_back( BSON( "_id" << i ) );
+                }
+                _source = DocumentSourceParallelCursor::create( ns, shardPipeline, splitKeys, 2,
+                                                                _ctx );
+            }
+            DocumentSourceParallelCursor* source() { return _source.get(); }
+        private:
+            intrusive_ptr<ExpressionContext> _ctx;
+            intrusive_ptr<DocumentSourceParallelCursor> _source;
+        };
+
+        /** Each range produces its own partial groups, which add up to the whole collection. */
+        class PartialGroups : public Base {
+        public:
+            void run() {
+                createSource();
+                source()->run();
+                // The workers take their own locks, and release them.
+                ASSERT( !Lock::isLocked() );
+
+                vector<Document> partials;
+                while( source()->getNextBatch( partials, 5 ) ) {
+                }
+                // Every one of the four ranges has every value of a.
+                ASSERT_EQUALS( 12U, partials.size() );
+                map<int, long long> counts;
+                for( size_t i = 0; i < partials.size(); ++i ) {
+                    counts[ partials[ i ]->getValue( "_id" ).coerceToInt() ] +=
+                            partials[ i ]->getValue( "n" ).coerceToLong();
+                }
+                ASSERT_EQUALS( 3U, counts.size() );
+                ASSERT_EQUALS( 34, counts[ 0 ] );
+                ASSERT_EQUALS( 33, counts[ 1 ] );
+                ASSERT_EQUALS( 33, counts[ 2 ] );
+                ASSERT( source()->eof() );
+            }
+        };
+
+        /** The explain output describes the ranges and the pipeline run over them. */
+        class Explain : public Base {
+        public:
+            void run() {
+                createSource();
+                BSONArrayBuilder bab;
+                source()->addToBsonArray( &bab, true );
+                BSONObj explained = bab.arr()[ 0 ].Obj()[ "parallelCursor" ].Obj();
+                ASSERT_EQUALS( string( ns ), explained[ "ns" ].String() );
+                ASSERT_EQUALS( 4, explained[ "ranges" ].numberInt() );
+                ASSERT_EQUALS( 2, explained[ "threads" ].numberInt() );
+                ASSERT_EQUALS( 1U, explained[ "pipeline" ].Array().size() );
+            }
+        };
+
+    } // namespace DocumentSourceParallelCursor
+
     namespace DocumentSourceLimit {
 
         using mongo::DocumentSourceLimit;
@@ -763,6 +886,119 @@ namespace DocumentSourceTests {
             }
         };
 
+        /** Groups spilled in separate runs are merged back together, in input order. */
+        class SpilledRuns : public CheckResultsBase {
+        public:
+            void run() {
+                SpillEverything spill;
+                CheckResultsBase::run();
+            }
+        private:
+            void populateData() {
+                for( int i = 0; i < 10; ++i ) {
+                    client.insert( ns, BSON( "id" << i % 2 << "a" << i ) );
+                }
+            }
+            virtual BSONObj groupSpec() {
+                return BSON( "_id" << "$id"
+                             << "first" << BSON( "$first" << "$a" )
+                             << "last" << BSON( "$last" << "$a" )
+                             << "avg" << BSON( "$avg" << "$a" )
+                             << "list" << BSON( "$push" << "$a" )
+                             << "missing" << BSON( "$first" << "$b" ) );
+            }
+            virtual string expectedResultSetString() {
+                return "[{_id:0,first:0,last:8,avg:4.0,list:[0,2,4,6,8],missing:null},"
+                        "{_id:1,first:1,last:9,avg:5.0,list:[1,3,5,7,9],missing:null}]";
+            }
+        };
+
+        /** Explain reports how many runs were spilled. */
+        class SpilledRunsExplain : public Base {
+        public:
+            void run() {
+                SpillEverything spill;
+                for( int i = 0; i < 4; ++i ) {
+                    client.insert( ns, BSON( "_id" << i ) );
+                }
+                createSource();
+                createGroup( BSON( "_id" << "$_id" ) );
+                ASSERT_EQUALS( 0, explainedRuns( group() ) );
+                while( group()->advance() );
+                ASSERT_EQUALS( 4, explainedRuns( group() ) );
+            }
+        };
+
+        /** Input with adjacent equal _ids is grouped one group at a time, in input order. */
+        class Streaming : public Base {
+        public:
+            void run() {
+                // Each group spans several of the source's batches.
+                for( int i = 0; i < 1000; ++i ) {
+                    client.insert( ns, BSON( "_id" << i << "a" << i / 300 << "b" << i ) );
+                }
+                createSource();
+                createGroup( BSON( "_id" << "$a"
+                                   << "n" << BSON( "$sum" << 1 )
+                                   << "first" << BSON( "$first" << "$b" )
+                                   << "last" << BSON( "$last" << "$b" ) ) );
+                static_cast<DocumentSourceGroup*>( group() )->setStreaming( true );
+
+                BSONArrayBuilder results;
+                for( bool more = !group()->eof(); more; more = group()->advance() ) {
+                    BSONObjBuilder bob;
+                    group()->getCurrent()->toBson( &bob );
+                    results << bob.obj();
+                }
+                ASSERT_EQUALS( fromjson( "[{_id:0,n:300,first:0,last:299},"
+                                         "{_id:1,n:300,first:300,last:599},"
+                                         "{_id:2,n:300,first:600,last:899},"
+                                         "{_id:3,n:100,first:900,last:999}]" ),
+                               results.arr() );
+                assertExhausted( group() );
+
+                BSONArrayBuilder bab;
+                group()->addToBsonArray( &bab, true );
+                ASSERT( bab.arr()[ 0 ].Obj()[ "streaming" ].trueValue() );
+            }
+        };
+
+        /**
+         * The field path of an _id is found only if the _id is a lone field path; an object _id
+         * tells a missing field from a null one, which an index doesn't.
+         */
+        class IdFieldPaths : public Base {
+        public:
+            void run() {
+                createSource();
+                assertPaths( "{_id:'$a'}", "['a']" );
+                assertPaths( "{_id:'$a.b'}", "['a.b']" );
+                assertPaths( "{_id:{x:'$a'}}", "" );
+                assertPaths( "{_id:{x:'$a',y:{z:'$b.c'}}}", "" );
+                assertPaths( "{_id:1}", "" );
+                assertPaths( "{_id:'a'}", "" );
+                assertPaths( "{_id:{x:'$a',y:'b'}}", "" );
+                assertPaths( "{_id:{x:{$add:['$a',1]}}}", "" );
+            }
+        private:
+            /** Asserts the paths found for spec, or that none are found if expected is empty. */
+            void assertPaths( const string& spec, const string& expected ) {
+                createGroup( fromjson( spec ) );
+                vector<string> paths;
+                const bool found =
+                        static_cast<DocumentSourceGroup*>( group() )->getIdFieldPaths( &paths );
+                ASSERT_EQUALS( !expected.empty(), found );
+                if ( !found ) {
+                    return;
+                }
+                BSONArrayBuilder bab;
+                for( size_t i = 0; i < paths.size(); ++i ) {
+                    bab << paths[ i ];
+                }
+                ASSERT_EQUALS( fromjson( "{p:" + expected + "}" )[ "p" ].Obj(), bab.arr() );
+            }
+        };
+
         /** Null and undefined _id values are grouped together. */
         class GroupNullUndefinedIds : public CheckResultsBase {
             void populateData() {
@@ -1035,6 +1271,28 @@ namespace DocumentSourceTests {
             }
         };
 
+        /** Documents are projected a batch at a time. */
+        class Batches : public Base {
+        public:
+            void run() {
+                for( int i = 0; i < 3; ++i ) {
+                    client.insert( ns, BSON( "a" << i << "b" << i ) );
+                }
+                createSource();
+                createProject();
+                vector<Document> batch;
+                ASSERT( project()->getNextBatch( batch, 2 ) );
+                ASSERT_EQUALS( 2U, batch.size() );
+                ASSERT_EQUALS( 1, batch[ 1 ]->getField( "a" ).getInt() );
+                ASSERT( batch[ 1 ]->getField( "b" ).missing() );
+                ASSERT_EQUALS( 2, project()->getCurrent()->getField( "a" ).getInt() );
+                ASSERT( !project()->getNextBatch( batch, 2 ) );
+                ASSERT_EQUALS( 3U, batch.size() );
+                ASSERT( batch[ 2 ]->getField( "b" ).missing() );
+                assertExhausted();
+            }
+        };
+
         /** List of dependent field paths. */
         class Dependencies : public Base {
         public:
@@ -1409,6 +1667,27 @@ namespace DocumentSourceTests {
             BSONObj sortSpec() { return BSON( "a.b" << 1 ); }
         };
 
+        /** Documents spilled in separate runs are merged back in order. */
+        class SpilledRuns : public CheckResultsBase {
+        public:
+            void run() {
+                SpillEverything spill;
+                CheckResultsBase::run();
+                ASSERT_EQUALS( 5, explainedRuns( sort() ) );
+            }
+        private:
+            void populateData() {
+                client.insert( ns, BSON( "_id" << 0 << "a" << 3 ) );
+                client.insert( ns, BSON( "_id" << 1 << "a" << 1 ) );
+                client.insert( ns, BSON( "_id" << 2 ) );
+                client.insert( ns, BSON( "_id" << 3 << "a" << 4 ) );
+                client.insert( ns, BSON( "_id" << 4 << "a" << 2 ) );
+            }
+            string expectedResultSetString() {
+                return "[{_id:2},{_id:1,a:1},{_id:4,a:2},{_id:0,a:3},{_id:3,a:4}]";
+            }
+        };
+
         /** Dependant field paths. */
         class Dependencies : public Base {
         public:
@@ -1483,6 +1762,30 @@ namespace DocumentSourceTests {
             }
         };
 
+        /** Documents are unwound a batch at a time, across input documents. */
+        class Batches : public Base {
+        public:
+            void run() {
+                client.insert( ns, BSON( "_id" << 0 << "a" << BSON_ARRAY( 1 << 2 << 3 ) ) );
+                client.insert( ns, BSON( "_id" << 1 << "a" << BSONArray() ) );
+                client.insert( ns, BSON( "_id" << 2 << "a" << BSON_ARRAY( 4 ) ) );
+                createSource();
+                createUnwind();
+                vector<Document> batch;
+                ASSERT( unwind()->getNextBatch( batch, 2 ) );
+                ASSERT_EQUALS( 2U, batch.size() );
+                ASSERT_EQUALS( 3, unwind()->getCurrent()->getField( "a" ).coerceToInt() );
+                ASSERT( !unwind()->getNextBatch( batch, 10 ) );
+                ASSERT_EQUALS( 4U, batch.size() );
+                for( int i = 0; i < 4; ++i ) {
+                    // Each document keeps its own unwound value.
+                    ASSERT_EQUALS( i + 1, batch[ i ]->getField( "a" ).coerceToInt() );
+                }
+                ASSERT_EQUALS( 2, batch[ 3 ]->getField( "_id" ).coerceToInt() );
+                assertExhausted();
+            }
+        };
+
         class CheckResultsBase : public Base {
         public:
             virtual ~CheckResultsBase() {}
@@ -1750,6 +2053,10 @@ namespace DocumentSourceTests {
             add<DocumentSourceCursor::Iterate>();
             add<DocumentSourceCursor::Dispose>();
             add<DocumentSourceCursor::IterateDispose>();
+            add<DocumentSourceCursor::IterateBatches>();
+
+            add<DocumentSourceParallelCursor::PartialGroups>();
+            add<DocumentSourceParallelCursor::Explain>();
 
             add<DocumentSourceLimit::DisposeSource>();
             add<DocumentSourceLimit::DisposeSourceCascade>();
@@ -1786,6 +2093,10 @@ namespace DocumentSourceTests {
             add<DocumentSourceGroup::TwoValuesTwoKeys>();
             add<DocumentSourceGroup::FourValuesTwoKeys>();
             add<DocumentSourceGroup::FourValuesTwoKeysTwoAccumulators>();
+            add<DocumentSourceGroup::SpilledRuns>();
+            add<DocumentSourceGroup::SpilledRunsExplain>();
+            add<DocumentSourceGroup::Streaming>();
+            add<DocumentSourceGroup::IdFieldPaths>();
             add<DocumentSourceGroup::GroupNullUndefinedIds>();
             add<DocumentSourceGroup::ComplexId>();
             add<DocumentSourceGroup::UndefinedAccumulatorValue>();
@@ -1803,6 +2114,7 @@ namespace DocumentSourceTests {
             add<DocumentSourceProject::TopLevelDollar>();
             add<DocumentSourceProject::InvalidSpec>();
             add<DocumentSourceProject::TwoDocuments>();
+            add<DocumentSourceProject::Batches>();
             add<DocumentSourceProject::Dependencies>();
 
             add<DocumentSourceSort::EofInit>();
@@ -1825,10 +2137,12 @@ namespace DocumentSourceTests {
             add<DocumentSourceSort::NullValue>();
             add<DocumentSourceSort::MissingObjectWithinArray>();
             add<DocumentSourceSort::ExtractArrayValues>();
+            add<DocumentSourceSort::SpilledRuns>();
             add<DocumentSourceSort::Dependencies>();
 
             add<DocumentSourceUnwind::EofInit>();
             add<DocumentSourceUnwind::AdvanceInit>();
+            add<DocumentSourceUnwind::Batches>();
             add<DocumentSourceUnwind::Empty>();
             add<DocumentSourceUnwind::MissingField>();
             add<DocumentSourceUnwind::NullField>();
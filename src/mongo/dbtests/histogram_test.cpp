@@ -24,6 +24,8 @@
 namespace mongo {
 
     using mongo::Histogram;
+    using mongo::BasicLatencyHistogram;
+    using mongo::LatencyHistogram;
 
     class BoundariesInit {
     public:
@@ -79,6 +81,111 @@ namespace mongo {
         }
     };
 
+    class AppendBSON {
+    public:
+        void run() {
+            Histogram::Options opts;
+            opts.numBuckets = 3;
+            opts.bucketSize = 10;
+            Histogram h( opts );
+
+            h.insert( 15 );
+            h.insert( 25 );
+            h.insert( 30 );
+
+            BSONObjBuilder b;
+            h.append( b, "h" );
+            BSONObj obj = b.obj();
+            ASSERT_EQUALS( BSON( "h" << BSON_ARRAY( BSON( "upTo" << 10LL << "count" << 0LL ) <<
+                                                    BSON( "upTo" << 20LL << "count" << 1LL ) <<
+                                                    BSON( "upTo" << static_cast<long long>( numeric_limits<uint32_t>::max() ) <<
+                                                          "count" << 2LL ) ) ),
+                           obj );
+        }
+    };
+
+    /** H is LatencyHistogram or a coarser BasicLatencyHistogram. */
+    template <typename H>
+    class LatencyBuckets {
+    public:
+        void run() {
+            // one bucket per value below subBuckets
+            for ( uint64_t v = 0; v < H::subBuckets; v++ ) {
+                ASSERT_EQUALS( H::bucketFor( v ), v );
+                ASSERT_EQUALS( H::bucketUpperBound( v ), v );
+            }
+
+            // every value falls between the bounds of its bucket and the one before
+            for ( uint64_t v = 1; v < ( 1ULL << 41 ); v += v / 3 + 1 ) {
+                const uint32_t bucket = H::bucketFor( v );
+                ASSERT( bucket < H::numBuckets );
+                ASSERT( v <= H::bucketUpperBound( bucket ) );
+                ASSERT( v > H::bucketUpperBound( bucket - 1 ) );
+            }
+
+            // buckets are no wider than 1/subBuckets of their values
+            const uint32_t bucket = H::bucketFor( 1000 );
+            const uint64_t width = H::bucketUpperBound( bucket ) -
+                                   H::bucketUpperBound( bucket - 1 );
+            ASSERT( width * H::subBuckets <= 1000 );
+
+            ASSERT_EQUALS( H::bucketFor( numeric_limits<uint64_t>::max() ),
+                           H::numBuckets - 1 );
+        }
+    };
+
+    class LatencyPercentiles {
+    public:
+        void run() {
+            LatencyHistogram h;
+            ASSERT_EQUALS( h.percentile( 0.5 ), 0u );
+
+            for ( uint64_t v = 1; v <= 1000; v++ ) {
+                h.insert( v );
+            }
+            h.insert( 100000 );
+
+            ASSERT_EQUALS( h.count(), 1001u );
+            ASSERT_EQUALS( h.maxMicros(), 100000u );
+            ASSERT_EQUALS( h.percentile( 1.0 ), 100000u );
+
+            // an upper bound, within a bucket's width
+            const uint64_t p50 = h.percentile( 0.5 );
+            ASSERT( p50 >= 501 );
+            ASSERT( p50 <= 501 + 501 / LatencyHistogram::subBuckets );
+            const uint64_t p99 = h.percentile( 0.99 );
+            ASSERT( p99 >= 991 );
+            ASSERT( p99 <= 991 + 991 / LatencyHistogram::subBuckets );
+        }
+    };
+
+    class LatencyMerge {
+    public:
+        void run() {
+            LatencyHistogram a;
+            LatencyHistogram b;
+            a.insert( 10 );
+            a.insert( 20 );
+            b.insert( 20 );
+            b.insert( 5000 );
+
+            a.merge( b );
+            ASSERT_EQUALS( a.count(), 4u );
+            ASSERT_EQUALS( a.totalMicros(), 5050u );
+            ASSERT_EQUALS( a.maxMicros(), 5000u );
+
+            BSONObjBuilder bb;
+            a.appendBuckets( bb, "h" );
+            BSONObj buckets = bb.obj()["h"].Obj();
+            ASSERT_EQUALS( buckets.nFields(), 3 );
+            ASSERT_EQUALS( buckets["1"]["count"].numberLong(), 2 );
+
+            a.reset();
+            ASSERT_EQUALS( a.count(), 0u );
+            ASSERT_EQUALS( a.maxMicros(), 0u );
+        }
+    };
+
     class HistogramSuite : public Suite {
     public:
         HistogramSuite() : Suite( "histogram" ) {}
@@ -87,6 +194,11 @@ namespace mongo {
             add< BoundariesInit >();
             add< BoundariesExponential >();
             add< BoundariesFind >();
+            add< AppendBSON >();
+            add< LatencyBuckets<LatencyHistogram> >();
+            add< LatencyBuckets< BasicLatencyHistogram<1> > >();
+            add< LatencyPercentiles >();
+            add< LatencyMerge >();
             // TODO: complete the test suite
         }
     } histogramSuite;
@@ -156,6 +156,68 @@ namespace JsobjHashingTests {
         }
     };
 
+    /** The MurmurHash3 version squashes numeric types and nests the same way MD5 does. */
+    class Murmur3HashingTest {
+    public:
+        void run() {
+            const HashSeed seed = 0;
+            const HashVersion v = HASH_VERSION_MURMUR3;
+
+            BSONObj o = BSON( "a" << 42 );
+            ASSERT_NOT_EQUALS( BSONElementHasher::hash64( o.firstElement() , seed ) ,
+                               BSONElementHasher::hash64( o.firstElement() , seed , v ) );
+            ASSERT_NOT_EQUALS( BSONElementHasher::hash64( o.firstElement() , seed , v ) ,
+                               BSONElementHasher::hash64( o.firstElement() , 1 , v ) );
+
+            ASSERT_EQUALS( BSONElementHasher::hash64( o.firstElement() , seed , v ) ,
+                           BSONElementHasher::hash64( BSON( "b" << 42.3 ).firstElement() , seed , v ) );
+            ASSERT_EQUALS( BSONElementHasher::hash64( o.firstElement() , seed , v ) ,
+                           BSONElementHasher::hash64( BSON( "c" << 42LL ).firstElement() , seed , v ) );
+            ASSERT_NOT_EQUALS( BSONElementHasher::hash64( o.firstElement() , seed , v ) ,
+                               BSONElementHasher::hash64( BSON( "a" << "42" ).firstElement() , seed , v ) );
+
+            BSONObj nested1 = BSON( "a" << BSON( "b" << 4 ) );
+            BSONObj nested2 = BSON( "a" << BSON( "b" << 4.1 ) );
+            BSONObj nested3 = BSON( "a" << BSON( "c" << 4 ) );
+            ASSERT_EQUALS( BSONElementHasher::hash64( nested1.firstElement() , seed , v ) ,
+                           BSONElementHasher::hash64( nested2.firstElement() , seed , v ) );
+            ASSERT_NOT_EQUALS( BSONElementHasher::hash64( nested1.firstElement() , seed , v ) ,
+                               BSONElementHasher::hash64( nested3.firstElement() , seed , v ) );
+
+            // long enough to outgrow the Hasher's stack buffer
+            string big( 4096 , 'x' );
+            string big2( big );
+            big2[4000] = 'y';
+            ASSERT_NOT_EQUALS( BSONElementHasher::hash64( BSON( "a" << big ).firstElement() , seed , v ) ,
+                               BSONElementHasher::hash64( BSON( "a" << big2 ).firstElement() , seed , v ) );
+        }
+    };
+
+    /** Compares the cost of each hash version over typical shard key values. */
+    class HashVersionTiming {
+    public:
+        long time( const BSONObj& obj , HashVersion v ) {
+            Timer t;
+            long long sum = 0;
+            for ( int i=0; i<100000; i++ ) {
+                sum += BSONElementHasher::hash64( obj.firstElement() , 0 , v );
+            }
+            ASSERT( sum != 1 );  // keep the loop from being optimized away
+            return t.millis();
+        }
+        void run() {
+            BSONObj objs[] = { BSON( "a" << 12345 ) ,
+                               BSONObjBuilder().genOID().obj() ,
+                               BSON( "a" << "user@example.com" ) ,
+                               BSON( "a" << BSON( "x" << 1 << "y" << "abc" ) ) };
+            for ( size_t i=0; i<sizeof(objs)/sizeof(objs[0]); i++ ) {
+                long md5 = time( objs[i] , HASH_VERSION_MD5 );
+                long murmur3 = time( objs[i] , HASH_VERSION_MURMUR3 );
+                cerr << objs[i] << " md5: " << md5 << "ms murmur3: " << murmur3 << "ms" << endl;
+            }
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "jsobjhashing" ) {
@@ -163,6 +225,8 @@ namespace JsobjHashingTests {
 
         void setupTests() {
             add< BSONElementHashingTest >();
+            add< Murmur3HashingTest >();
+            add< HashVersionTiming >();
         }
     } myall;
 
@@ -0,0 +1,291 @@
+/*
+ *    Copyright (C) 2014 Tokutek Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pch.h"
+#include "dbtests.h"
+
+#include "mongo/db/descriptor.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/db/storage/key.h"
+
+namespace KeyFormatTests {
+
+    using storage::Key;
+    using storage::KeyFormat;
+
+    static int sign(const int c) {
+        return c < 0 ? -1 : (c > 0 ? 1 : 0);
+    }
+
+    // A sample of single field keys in many types, in no particular order.
+    static vector<BSONObj> sampleKeys() {
+        vector<BSONObj> keys;
+        keys.push_back(BSON("" << MINKEY));
+        keys.push_back(BSON("" << MAXKEY));
+        keys.push_back(BSONObjBuilder().appendNull("").obj());
+        {
+            BSONObjBuilder b;
+            b.appendUndefined("");
+            keys.push_back(b.obj());
+        }
+        keys.push_back(BSON("" << 0));
+        keys.push_back(BSON("" << -0.0));
+        keys.push_back(BSON("" << 1));
+        keys.push_back(BSON("" << 1.0));
+        keys.push_back(BSON("" << 1.5));
+        keys.push_back(BSON("" << -7));
+        keys.push_back(BSON("" << -7.25));
+        keys.push_back(BSON("" << 1LL));
+        keys.push_back(BSON("" << (1LL << 40)));
+        keys.push_back(BSON("" << -(1LL << 40)));
+        keys.push_back(BSON("" << numeric_limits<double>::infinity()));
+        keys.push_back(BSON("" << -numeric_limits<double>::infinity()));
+        keys.push_back(BSON("" << numeric_limits<double>::quiet_NaN()));
+        keys.push_back(BSON("" << numeric_limits<long long>::max()));
+        keys.push_back(BSON("" << numeric_limits<long long>::min()));
+        keys.push_back(BSON("" << ""));
+        keys.push_back(BSON("" << "a"));
+        keys.push_back(BSON("" << "ab"));
+        keys.push_back(BSON("" << "b"));
+        keys.push_back(BSONObjBuilder().append("", "a\0b", 4).obj());
+        keys.push_back(BSONObjBuilder().append("", "a\0", 3).obj());
+        keys.push_back(BSONObjBuilder().appendSymbol("", "a").obj());
+        keys.push_back(BSON("" << BSONObj()));
+        keys.push_back(BSON("" << BSON("a" << 1)));
+        keys.push_back(BSON("" << BSON("a" << 1 << "b" << 2)));
+        keys.push_back(BSON("" << BSON("b" << 1)));
+        keys.push_back(BSON("" << BSON("a" << "x")));
+        keys.push_back(BSON("" << BSON_ARRAY(1 << 2)));
+        keys.push_back(BSON("" << BSON_ARRAY(1 << BSON("c" << 3))));
+        keys.push_back(BSONObjBuilder().appendBinData("", 3, BinDataGeneral, "abc").obj());
+        keys.push_back(BSONObjBuilder().appendBinData("", 2, BinDataGeneral, "zz").obj());
+        keys.push_back(BSONObjBuilder().appendBinData("", 3, Function, "abc").obj());
+        keys.push_back(BSON("" << OID("000000000000000000000001")));
+        keys.push_back(BSON("" << OID("0000000000000000000000ff")));
+        keys.push_back(BSON("" << true));
+        keys.push_back(BSON("" << false));
+        keys.push_back(BSON("" << Date_t(0)));
+        keys.push_back(BSON("" << Date_t(1000)));
+        keys.push_back(BSONObjBuilder().appendTimestamp("", 5ULL << 32).obj());
+        keys.push_back(BSONObjBuilder().appendTimestamp("", 1ULL << 63).obj());
+        keys.push_back(BSONObjBuilder().appendRegex("", "ab", "i").obj());
+        keys.push_back(BSONObjBuilder().appendRegex("", "a", "").obj());
+        keys.push_back(BSONObjBuilder().appendCode("", "function() {}").obj());
+        keys.push_back(BSONObjBuilder().appendCodeWScope("", "x", BSON("y" << 1)).obj());
+        return keys;
+    }
+
+    static void assertSameBSON(const BSONObj &expected, const BSONObj &actual) {
+        ASSERT_EQUALS(expected.objsize(), actual.objsize());
+        ASSERT(memcmp(expected.objdata(), actual.objdata(), expected.objsize()) == 0);
+    }
+
+    class RoundTrip {
+    public:
+        void run() {
+            const BSONObj pattern = BSON("a" << 1 << "b" << -1);
+            const KeyFormat format(KeyFormat::MEMCMP, Ordering::make(pattern));
+            const vector<BSONObj> keys = sampleKeys();
+            for (vector<BSONObj>::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+                const BSONObj key = BSONObjBuilder().appendAs(it->firstElement(), "")
+                                                    .appendAs(it->firstElement(), "").obj();
+                const BSONObj pk = BSON("" << it->firstElement().canonicalType() << "" << "pk");
+                const Key sKey(key, &pk, format);
+                ASSERT(Key::isMemcmp(sKey.buf()));
+                assertSameBSON(key, sKey.key());
+                assertSameBSON(pk, sKey.pk());
+                ASSERT(sKey.hasPK());
+
+                // Reading it back from a buffer finds the same size, with or without the pk.
+                ASSERT_EQUALS(sKey.size(), Key(sKey.buf(), true).size());
+                ASSERT_EQUALS(sKey.size(), Key(sKey.buf(), false).size());
+
+                const Key noPK(key, NULL, format);
+                ASSERT(noPK.pk().isEmpty());
+                ASSERT(!noPK.hasPK());
+            }
+        }
+    };
+
+    class LargeLongs {
+    public:
+        void run() {
+            const KeyFormat format(KeyFormat::MEMCMP, Ordering::make(BSON("a" << 1)));
+            const long long big = 1LL << 60;
+            const long long values[] = { big - 1, big, big + 1, numeric_limits<long long>::max() - 1,
+                                         numeric_limits<long long>::max(), -big - 1, -big,
+                                         numeric_limits<long long>::min() + 1,
+                                         numeric_limits<long long>::min() };
+            const size_t n = sizeof(values) / sizeof(values[0]);
+            for (size_t i = 0; i < n; i++) {
+                const Key k1(BSON("" << values[i]), NULL, format);
+                ASSERT_EQUALS(values[i], k1.key().firstElement().Long());
+                for (size_t j = 0; j < n; j++) {
+                    const Key k2(BSON("" << values[j]), NULL, format);
+                    const int expected = values[i] < values[j] ? -1 : (values[i] == values[j] ? 0 : 1);
+                    ASSERT_EQUALS(expected, Key::memcmpCompare(k1, k2));
+                }
+            }
+        }
+    };
+
+    // The memcmp format must order keys exactly like the V1 format does.
+    class SameOrderAsV1 {
+    public:
+        void run() {
+            const BSONObj pattern = BSON("a" << 1 << "b" << -1);
+            const Ordering ordering = Ordering::make(pattern);
+            const KeyFormat v1Format(KeyFormat::V1, ordering);
+            const KeyFormat memcmpFormat(KeyFormat::MEMCMP, ordering);
+            // V1 only compares longs of 2^53 and up exactly against each other, skip them here.
+            vector<BSONObj> values;
+            const vector<BSONObj> samples = sampleKeys();
+            for (vector<BSONObj>::const_iterator it = samples.begin(); it != samples.end(); ++it) {
+                const BSONElement e = it->firstElement();
+                if (e.type() != NumberLong || fabs((double) e._numberLong()) < (double) (1LL << 53)) {
+                    values.push_back(*it);
+                }
+            }
+            vector<BSONObj> keys;
+            for (size_t a = 0; a < values.size(); a += 3) {
+                for (size_t b = 0; b < values.size(); b += 5) {
+                    keys.push_back(BSONObjBuilder().appendAs(values[a].firstElement(), "")
+                                                   .appendAs(values[b].firstElement(), "").obj());
+                }
+            }
+            const BSONObj pk1 = BSON("" << 1);
+            const BSONObj pk2 = BSON("" << "x");
+            for (vector<BSONObj>::const_iterator i = keys.begin(); i != keys.end(); ++i) {
+                for (vector<BSONObj>::const_iterator j = keys.begin(); j != keys.end(); ++j) {
+                    const BSONObj *pks[] = { &pk1, &pk2 };
+                    for (int p = 0; p < 2; p++) {
+                        const Key v1i(*i, &pk1, v1Format);
+                        const Key v1j(*j, pks[p], v1Format);
+                        const Key mi(*i, &pk1, memcmpFormat);
+                        const Key mj(*j, pks[p], memcmpFormat);
+                        const int expected = sign(Key::woCompare(v1i, v1j, ordering));
+                        const int actual = Key::woCompare(mi, mj, ordering);
+                        if (expected != actual) {
+                            log() << "mismatch comparing " << *i << " " << pk1 << " with "
+                                  << *j << " " << *pks[p] << endl;
+                        }
+                        ASSERT_EQUALS(expected, actual);
+                    }
+                }
+            }
+        }
+    };
+
+    // Dates compare as signed and timestamps as unsigned, up to the bounds used for ranges.
+    class DatesAndTimestamps {
+    public:
+        void run() {
+            const KeyFormat format(KeyFormat::MEMCMP, Ordering::make(BSON("a" << 1)));
+            vector<BSONObj> values;
+            const unsigned long long timestamps[] = { 0, 1, 5ULL << 32, (1ULL << 63) - 1, 1ULL << 63,
+                                                      (1ULL << 63) + 1,
+                                                      numeric_limits<unsigned long long>::max() };
+            for (size_t i = 0; i < sizeof(timestamps) / sizeof(timestamps[0]); i++) {
+                values.push_back(BSONObjBuilder().appendTimestamp("", timestamps[i]).obj());
+            }
+            const long long dates[] = { numeric_limits<long long>::min(), -1, 0, 1,
+                                        numeric_limits<long long>::max() };
+            for (size_t i = 0; i < sizeof(dates) / sizeof(dates[0]); i++) {
+                values.push_back(BSON("" << Date_t(dates[i])));
+            }
+            const BSONType types[] = { Timestamp, Date };
+            for (int t = 0; t < 2; t++) {
+                BSONObjBuilder min;
+                min.appendMinForType("", types[t]);
+                values.push_back(min.obj());
+                BSONObjBuilder max;
+                max.appendMaxForType("", types[t]);
+                values.push_back(max.obj());
+            }
+
+            for (vector<BSONObj>::const_iterator i = values.begin(); i != values.end(); ++i) {
+                const Key ki(*i, NULL, format);
+                assertSameBSON(*i, ki.key());
+                for (vector<BSONObj>::const_iterator j = values.begin(); j != values.end(); ++j) {
+                    const Key kj(*j, NULL, format);
+                    const int expected = sign(i->woCompare(*j));
+                    if (expected != Key::memcmpCompare(ki, kj)) {
+                        log() << "mismatch comparing " << *i << " with " << *j << endl;
+                    }
+                    ASSERT_EQUALS(expected, Key::memcmpCompare(ki, kj));
+                }
+            }
+        }
+    };
+
+    class KeyOnlyComparison {
+    public:
+        void run() {
+            const KeyFormat format(KeyFormat::MEMCMP, Ordering::make(BSON("a" << 1)));
+            const Key k1(BSON("" << 5), &minKey, format);
+            const Key k2(BSON("" << 5), &maxKey, format);
+            ASSERT_EQUALS(-1, Key::memcmpCompare(k1, k2));
+            const Key k1KeyOnly(k1.buf(), false);
+            const Key k2KeyOnly(k2.buf(), false);
+            ASSERT_EQUALS(0, Key::memcmpCompare(k1KeyOnly, k2KeyOnly));
+            ASSERT_EQUALS(0, Key::memcmpCompare(k1KeyOnly, k2));
+        }
+    };
+
+    class DescriptorVersions {
+    public:
+        void run() {
+            const BSONObj pattern = BSON("a" << 1 << "b" << -1);
+            const Descriptor v1Format(pattern, false, 0, false, false, KeyFormat::V1);
+            const Descriptor memcmpFormat(pattern, false, 0, false, false, KeyFormat::MEMCMP);
+            ASSERT(!(v1Format == memcmpFormat));
+            ASSERT_EQUALS(KeyFormat::V1, v1Format.keyFormat().version());
+            ASSERT_EQUALS(KeyFormat::MEMCMP, memcmpFormat.keyFormat().version());
+            const BSONObj key = BSON("" << 1 << "" << 2);
+            assertSameBSON(BSON("a" << 1 << "b" << 2), memcmpFormat.fillKeyFieldNames(key));
+
+            // Only the memcmp format needs a version 2 descriptor, with a key format byte.
+            ASSERT_EQUALS(1, v1Format.version());
+            ASSERT_EQUALS(2, memcmpFormat.version());
+            ASSERT_EQUALS(memcmpFormat.dbt().size, v1Format.dbt().size + 1);
+            assertSameBSON(BSON("a" << 1 << "b" << 2), v1Format.fillKeyFieldNames(key));
+
+            // A version 2 descriptor of V1 keys is read the same way.
+            const DBT dbt = v1Format.dbt();
+            string v2(static_cast<const char *>(dbt.data), dbt.size);
+            v2[4] = 2; // version
+            v2.insert(16, 1, (char) KeyFormat::V1); // key format byte
+            const Descriptor v1InV2(v2.data(), v2.size());
+            ASSERT_EQUALS(2, v1InV2.version());
+            ASSERT_EQUALS(KeyFormat::V1, v1InV2.keyFormat().version());
+            assertSameBSON(BSON("a" << 1 << "b" << 2), v1InV2.fillKeyFieldNames(key));
+        }
+    };
+
+    class All : public Suite {
+    public:
+        All() : Suite("keyformat") {}
+        void setupTests() {
+            add<RoundTrip>();
+            add<LargeLongs>();
+            add<SameOrderAsV1>();
+            add<DatesAndTimestamps>();
+            add<KeyOnlyComparison>();
+            add<DescriptorVersions>();
+        }
+    } all;
+
+} // namespace KeyFormatTests
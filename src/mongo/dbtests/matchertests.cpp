@@ -190,6 +190,61 @@ namespace MatcherTests {
         }
     };
 
+    /** Predicates are evaluated cheapest first, with the same result as in query order. */
+    class CompiledOrder {
+    public:
+        void run() {
+            Matcher m( fromjson( "{ a:{ $in:[ 1, 2, 3 ] }, 'b.c':{ $gt:4 }, d:5, e:{ $ne:6 } }" ) );
+            ASSERT( m.matches( fromjson( "{ a:2, b:{ c:5 }, d:5 }" ) ) );
+            ASSERT( m.matches( fromjson( "{ d:5, b:[ { c:1 }, { c:7 } ], e:7, a:[ 9, 3 ] }" ) ) );
+            ASSERT( !m.matches( fromjson( "{ a:2, b:{ c:5 }, d:6 }" ) ) );
+            ASSERT( !m.matches( fromjson( "{ a:2, b:{ c:5 }, d:5, e:6 }" ) ) );
+            ASSERT( !m.matches( fromjson( "{ a:2, b:5, d:5 }" ) ) );
+            ASSERT( !m.matches( fromjson( "{ a:4, b:{ c:5 }, d:5 }" ) ) );
+        }
+    };
+
+    /** Top level fields are extracted as getField() finds them: the first occurrence wins. */
+    class CompiledDuplicateField {
+    public:
+        void run() {
+            Matcher m( fromjson( "{ a:1, 'a.b':{ $exists:false } }" ) );
+            BSONObjBuilder b;
+            b.append( "a", 1 );
+            b.append( "a", BSON( "b" << 1 ) );
+            ASSERT( m.matches( b.obj() ) );
+        }
+    };
+
+    /** Fields past the extracted slots are still matched by looking them up. */
+    class CompiledManyFields {
+    public:
+        void run() {
+            BSONObjBuilder query;
+            BSONObjBuilder doc;
+            for ( int i = 0; i < 40; ++i ) {
+                query.append( string( str::stream() << "f" << i ), i );
+                doc.append( string( str::stream() << "f" << ( 39 - i ) ), 39 - i );
+            }
+            Matcher m( query.obj() );
+            BSONObj matching = doc.obj();
+            ASSERT( m.matches( matching ) );
+            ASSERT( !m.matches( matching.removeField( "f35" ) ) );
+        }
+    };
+
+    class ReferencedTopLevelFields {
+    public:
+        void run() {
+            Matcher m( fromjson( "{ a:1, 'b.c':{ $gt:2 }, d:/x/, $or:[ { e:1 }, { 'f.g':2 } ] }" ) );
+            set<string> fields;
+            ASSERT( m.referencedTopLevelFields( &fields ) );
+            ASSERT_EQUALS( 5U, fields.size() );
+            ASSERT( fields.count( "b" ) );
+            ASSERT( fields.count( "f" ) );
+        }
+    };
+
     namespace Covered { // Tests for CoveredIndexMatcher.
     
         /**
@@ -298,6 +353,35 @@ namespace MatcherTests {
         }
     };
 
+    /**
+     * Benchmark of a selective query over wide documents: the mismatching predicate comes last
+     * in the query and its field last in the document.
+     */
+    class CompiledTiming {
+    public:
+        void run() {
+            BSONObjBuilder doc;
+            for ( int i = 0; i < 50; ++i ) {
+                doc.append( string( str::stream() << "f" << i ), i );
+            }
+            doc.append( "tags", BSON_ARRAY( "a" << "b" << "c" << "d" ) );
+            doc.append( "sub", BSON( "x" << 1 << "y" << 2 ) );
+            doc.append( "status", 2 );
+            BSONObj obj = doc.obj();
+
+            Matcher m( fromjson( "{ tags:{ $in:[ 'x', 'y', 'd' ] }, 'sub.y':{ $gte:2 }, f40:40,"
+                                 " f45:{ $lt:50 }, status:1 }" ) );
+            const int iterations = 100000;
+            Timer t;
+            for ( int i = 0; i < iterations; ++i ) {
+                ASSERT( !m.matches( obj ) );
+            }
+            long long micros = t.micros();
+            cerr << "compiled matcher: " << iterations << " documents in " << micros / 1000
+                 << "ms, " << micros * 1000 / iterations << "ns per document" << endl;
+        }
+    };
+
     /**
      * Helper class to extract the top level equality fields of a matcher, which can serve as a
      * useful way to identify the matcher.
@@ -419,6 +503,11 @@ namespace MatcherTests {
             add<Covered::ElemMatchKeyIndexed>();
             add<Covered::ElemMatchKeyIndexedSingleKey>();
             add<AllTiming>();
+            add<CompiledOrder>();
+            add<CompiledDuplicateField>();
+            add<CompiledManyFields>();
+            add<ReferencedTopLevelFields>();
+            add<CompiledTiming>();
             add<Visit>();
             add<WithinBox>();
             add<WithinCenter>();
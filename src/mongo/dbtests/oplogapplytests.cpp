@@ -0,0 +1,171 @@
+/*
+ *    Copyright (C) 2014 Tokutek Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pch.h"
+#include "dbtests.h"
+
+#include "mongo/db/jsobj.h"
+#include "mongo/db/repl/oplog_applier.h"
+
+namespace OplogApplyTests {
+
+    using namespace OplogApplier;
+
+    class Base {
+      protected:
+        vector<BSONObj> _entries;
+        PKPatternMap _patterns;
+        vector<vector<size_t> > _groups;
+
+        Base() {
+            _patterns["test.a"] = BSON("_id" << 1);
+            _patterns["test.b"] = BSON("x" << 1 << "_id" << 1);
+        }
+        void addEntry(const BSONArray& ops) {
+            _entries.push_back(BSON("_id" << (int) _entries.size() << "a" << false << "ops" << ops));
+        }
+        static BSONObj insert(const char* ns, const BSONObj& row) {
+            return BSON("op" << "i" << "ns" << ns << "o" << row);
+        }
+        static BSONObj update(const char* ns, const BSONObj& pk) {
+            return BSON("op" << "u" << "ns" << ns << "pk" << pk <<
+                        "o" << BSONObj() << "o2" << BSONObj());
+        }
+        static BSONObj remove(const char* ns, const BSONObj& row) {
+            return BSON("op" << "d" << "ns" << ns << "o" << row);
+        }
+        void doPartition() {
+            partition(_entries, _patterns, &_groups);
+        }
+    };
+
+    class Barriers : Base {
+      public:
+        void run() {
+            ASSERT_FALSE(isBarrier(BSON("ops" << BSON_ARRAY(insert("test.a", BSON("_id" << 1))))));
+            ASSERT_TRUE(isBarrier(BSON("ref" << OID::gen())));
+            ASSERT_TRUE(isBarrier(BSON("ops" << BSON_ARRAY(
+                insert("test.a", BSON("_id" << 1)) <<
+                BSON("op" << "c" << "ns" << "test.$cmd" << "o" << BSON("drop" << "a"))))));
+            ASSERT_TRUE(isBarrier(BSON("ops" << BSON_ARRAY(
+                insert("test.system.indexes", BSON("ns" << "test.a" << "key" << BSON("x" << 1)))))));
+        }
+    };
+
+    class DisjointKeys : Base {
+      public:
+        void run() {
+            for (int i = 0; i < 10; ++i) {
+                addEntry(BSON_ARRAY(insert("test.a", BSON("_id" << i))));
+            }
+            doPartition();
+            ASSERT_EQUALS(10U, _groups.size());
+            for (size_t i = 0; i < _groups.size(); ++i) {
+                ASSERT_EQUALS(1U, _groups[i].size());
+                ASSERT_EQUALS(i, _groups[i][0]);
+            }
+        }
+    };
+
+    class SameKeyConflicts : Base {
+      public:
+        void run() {
+            addEntry(BSON_ARRAY(insert("test.a", BSON("_id" << 1 << "v" << 1))));
+            addEntry(BSON_ARRAY(insert("test.a", BSON("_id" << 2))));
+            // updates carry the pk with empty field names, and may use another numeric type
+            addEntry(BSON_ARRAY(update("test.a", BSON("" << 1.0))));
+            addEntry(BSON_ARRAY(remove("test.a", BSON("_id" << 1 << "v" << 2))));
+            // same _id in a different collection does not conflict
+            addEntry(BSON_ARRAY(insert("test.b", BSON("_id" << 1 << "x" << 1))));
+            doPartition();
+            ASSERT_EQUALS(3U, _groups.size());
+            ASSERT_EQUALS(3U, _groups[0].size());
+            ASSERT_EQUALS(0U, _groups[0][0]);
+            ASSERT_EQUALS(2U, _groups[0][1]);
+            ASSERT_EQUALS(3U, _groups[0][2]);
+            ASSERT_EQUALS(1U, _groups[1][0]);
+            ASSERT_EQUALS(4U, _groups[2][0]);
+        }
+    };
+
+    class TransitiveConflicts : Base {
+      public:
+        void run() {
+            // a transaction touching two keys joins the groups of both
+            addEntry(BSON_ARRAY(insert("test.a", BSON("_id" << 1))));
+            addEntry(BSON_ARRAY(insert("test.a", BSON("_id" << 2))));
+            addEntry(BSON_ARRAY(insert("test.a", BSON("_id" << 3))));
+            addEntry(BSON_ARRAY(update("test.a", BSON("" << 1)) << update("test.a", BSON("" << 2))));
+            doPartition();
+            ASSERT_EQUALS(2U, _groups.size());
+            ASSERT_EQUALS(3U, _groups[0].size());
+            ASSERT_EQUALS(0U, _groups[0][0]);
+            ASSERT_EQUALS(1U, _groups[0][1]);
+            ASSERT_EQUALS(3U, _groups[0][2]);
+            ASSERT_EQUALS(1U, _groups[1].size());
+            ASSERT_EQUALS(2U, _groups[1][0]);
+        }
+    };
+
+    class CompoundPK : Base {
+      public:
+        void run() {
+            addEntry(BSON_ARRAY(insert("test.b", BSON("_id" << 1 << "x" << 1))));
+            addEntry(BSON_ARRAY(insert("test.b", BSON("_id" << 1 << "x" << 2))));
+            addEntry(BSON_ARRAY(update("test.b", BSON("" << 2 << "" << 1))));
+            doPartition();
+            ASSERT_EQUALS(2U, _groups.size());
+            ASSERT_EQUALS(1U, _groups[0].size());
+            ASSERT_EQUALS(2U, _groups[1].size());
+            ASSERT_EQUALS(1U, _groups[1][0]);
+            ASSERT_EQUALS(2U, _groups[1][1]);
+        }
+    };
+
+    class UnknownPatternSerializesNamespace : Base {
+      public:
+        void run() {
+            addEntry(BSON_ARRAY(update("test.c", BSON("" << 1))));
+            addEntry(BSON_ARRAY(insert("test.a", BSON("_id" << 1))));
+            addEntry(BSON_ARRAY(update("test.c", BSON("" << 2))));
+            // test.c has no known pattern, so this insert conflicts with everything on test.c
+            addEntry(BSON_ARRAY(insert("test.c", BSON("_id" << 3))));
+            addEntry(BSON_ARRAY(update("test.c", BSON("" << 4))));
+            doPartition();
+            ASSERT_EQUALS(2U, _groups.size());
+            ASSERT_EQUALS(4U, _groups[0].size());
+            ASSERT_EQUALS(0U, _groups[0][0]);
+            ASSERT_EQUALS(2U, _groups[0][1]);
+            ASSERT_EQUALS(3U, _groups[0][2]);
+            ASSERT_EQUALS(4U, _groups[0][3]);
+            ASSERT_EQUALS(1U, _groups[1][0]);
+        }
+    };
+
+    class All : public Suite {
+      public:
+        All() : Suite("oplogapply") {}
+        void setupTests() {
+            add<Barriers>();
+            add<DisjointKeys>();
+            add<SameKeyConflicts>();
+            add<TransitiveConflicts>();
+            add<CompoundPK>();
+            add<UnknownPatternSerializesNamespace>();
+        }
+    } all;
+
+}
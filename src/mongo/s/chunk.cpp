@@ -25,6 +25,7 @@
 #include "mongo/client/dbclientcursor.h"
 #include "mongo/db/namespacestring.h"
 #include "mongo/db/queryutil.h"
+#include "mongo/db/storage/key.h"
 #include "mongo/platform/random.h"
 #include "mongo/s/chunk_diff.h"
 #include "mongo/s/chunk_version.h"
@@ -671,6 +672,7 @@ namespace mongo {
                     const_cast<set<Shard>&>(_shards).swap(shards);
                     const_cast<ShardVersionMap&>(_shardVersions).swap(shardVersions);
                     const_cast<ChunkRangeManager&>(_chunkRanges).reloadAll(_chunkMap);
+                    _buildRoutingIndex();
 
                     // Once we load data, clear reference to old manager
                     _oldManager.reset();
@@ -921,6 +923,57 @@ namespace mongo {
 #undef ENSURE
     }
 
+    namespace {
+
+        /**
+         * Encodes shard keys in the memcmp index key format, all ascending.  That format
+         * compares longs of 2^53 and up exactly against doubles, where woCompare() compares them
+         * as doubles, so keys with numbers that large are left to woCompare(), and so are keys
+         * with embedded objects and arrays, which could hold them.
+         */
+        class MemcmpShardKeyEncoder : public ChunkRoutingIndex::KeyEncoder {
+        public:
+            MemcmpShardKeyEncoder()
+                : _format(storage::KeyFormat::MEMCMP, Ordering::make(BSONObj())) {
+            }
+
+            virtual bool encode(const BSONObj& key, std::string* out) const {
+                BSONForEach(e, key) {
+                    if (e.type() == Object || e.type() == Array ||
+                            (e.isNumber() && fabs(e.number()) >= 9007199254740992.0 /* 2^53 */)) {
+                        return false;
+                    }
+                }
+                const storage::Key encoded(key, NULL, _format);
+                const StringData bytes = encoded.memcmpKeyBytes();
+                out->assign(bytes.rawData(), bytes.size());
+                return true;
+            }
+
+        private:
+            const storage::KeyFormat _format;
+        };
+
+        const MemcmpShardKeyEncoder memcmpShardKeyEncoder;
+
+    } // namespace
+
+    void ChunkManager::_buildRoutingIndex() {
+        vector<ChunkPtr> chunks;
+        vector<BSONObj> maxBounds;
+        chunks.reserve(_chunkMap.size());
+        maxBounds.reserve(_chunkMap.size());
+        for (ChunkMap::const_iterator it = _chunkMap.begin(), end = _chunkMap.end(); it != end; ++it) {
+            chunks.push_back(it->second);
+            maxBounds.push_back(it->first);
+        }
+
+        // Only called while loading, before the manager is shared, see loadExistingRanges().
+        const_cast<vector<ChunkPtr>&>(_chunkList).swap(chunks);
+        const_cast<ChunkRoutingIndex&>(_routingIndex) =
+                ChunkRoutingIndex(maxBounds, &memcmpShardKeyEncoder);
+    }
+
     void ChunkManager::_printChunks() const {
         for (ChunkMap::const_iterator it=_chunkMap.begin(), end=_chunkMap.end(); it != end; ++it) {
             log() << *it->second << endl;
@@ -1045,30 +1098,22 @@ namespace mongo {
     }
 
     ChunkPtr ChunkManager::findIntersectingChunk( const BSONObj& point ) const {
-        {
-            BSONObj foo;
-            ChunkPtr c;
-            {
-                ChunkMap::const_iterator it = _chunkMap.upper_bound( point );
-                if (it != _chunkMap.end()) {
-                    foo = it->first;
-                    c = it->second;
-                }
-            }
-
-            if ( c ) {
-                if ( c->containsPoint( point ) ){
-                    dassert( c->containsPoint( point ) ); // doesn't use fast-path in extractKey
-                    return c;
-                }
-
-                PRINT(foo);
+        const size_t pos = _routingIndex.find( point );
+        if ( pos != ChunkRoutingIndex::npos ) {
+            const ChunkPtr& c = _chunkList[pos];
+
+            // The chunks are contiguous and start at MinKey (see _isValid()), so the first
+            // chunk whose max is above point contains it.  Check anyway: a routing bug would
+            // otherwise send writes to the wrong shard.
+            if ( ! c->containsPoint( point ) ) {
+                PRINT(c->getMax());
                 PRINT(*c);
                 PRINT( point );
 
                 reload();
                 massert(13141, "Chunk map pointed to incorrect chunk", false);
             }
+            return c;
         }
 
         msgasserted( 8070 ,
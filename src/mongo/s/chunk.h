@@ -21,6 +21,7 @@
 
 #include "mongo/bson/util/atomic_int.h"
 #include "mongo/client/distlock.h"
+#include "mongo/s/chunk_routing_index.h"
 #include "mongo/s/chunk_version.h"
 #include "mongo/s/shard.h"
 #include "mongo/s/shardkey.h"
@@ -442,6 +443,7 @@ namespace mongo {
         bool _load( const string& config, ChunkMap& chunks, set<Shard>& shards,
                                     ShardVersionMap& shardVersions, ChunkManagerPtr oldManager);
         static bool _isValid(const ChunkMap& chunks);
+        void _buildRoutingIndex();
 
         // end helpers
 
@@ -453,6 +455,11 @@ namespace mongo {
         const ChunkMap _chunkMap;
         const ChunkRangeManager _chunkRanges;
 
+        // _chunkMap flattened for findIntersectingChunk(): the chunks in order, and an index
+        // over their upper bounds giving the position of the chunk for a key
+        const vector<ChunkPtr> _chunkList;
+        const ChunkRoutingIndex _routingIndex;
+
         const set<Shard> _shards;
 
         const ShardVersionMap _shardVersions; // max version per shard
@@ -0,0 +1,153 @@
+// @file chunk_routing_index.cpp
+
+/**
+*    Copyright (C) 2014 Tokutek Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mongo/pch.h"
+
+#include "mongo/s/chunk_routing_index.h"
+
+#include <cstring>
+
+#include "mongo/db/jsobj.h"
+
+namespace mongo {
+
+    namespace {
+
+        bool isIntegral(const BSONElement& e) {
+            return e.type() == NumberInt || e.type() == NumberLong;
+        }
+
+        /**
+         * Returns the number of elements of [base, base + n) that are not greater than key,
+         * which must be sorted.  The loop body has no data-dependent branches, so it compiles to
+         * conditional moves and the search costs the same for every key.
+         */
+        template <typename T, typename LessEqual>
+        size_t countNotGreater(const T* base, size_t n, const T& key, const LessEqual& le) {
+            if (n == 0) {
+                return 0;
+            }
+            const T* const first = base;
+            while (n > 1) {
+                const size_t half = n / 2;
+                base = le(base[half], key) ? base + half : base;
+                n -= half;
+            }
+            return (base - first) + (le(*base, key) ? 1 : 0);
+        }
+
+        struct EncodedLessEqual {
+            bool operator()(uint64_t l, uint64_t r) const { return l <= r; }
+        };
+
+        struct BSONLessEqual {
+            bool operator()(const BSONObj& l, const BSONObj& r) const { return l.woCompare(r) <= 0; }
+        };
+
+        struct BytesLessEqual {
+            bool operator()(const std::string& l, const std::string& r) const {
+                const int c = memcmp(l.data(), r.data(), std::min(l.size(), r.size()));
+                return c < 0 || (c == 0 && l.size() <= r.size());
+            }
+        };
+
+    } // namespace
+
+    ChunkRoutingIndex::ChunkRoutingIndex(const std::vector<BSONObj>& maxBounds,
+                                         const KeyEncoder* keyEncoder)
+        : _bounds(maxBounds),
+          _encodable(false),
+          _keyEncoder(NULL) {
+        if (_bounds.empty()) {
+            return;
+        }
+
+        if (keyEncoder != NULL) {
+            // every bound must be encoded for the byte search to be complete
+            _byteBounds.resize(_bounds.size());
+            size_t i = 0;
+            while (i < _bounds.size() && keyEncoder->encode(_bounds[i], &_byteBounds[i])) {
+                ++i;
+            }
+            if (i == _bounds.size()) {
+                _keyEncoder = keyEncoder;
+            }
+            else {
+                std::vector<std::string>().swap(_byteBounds);
+            }
+        }
+
+        // The integer fast path needs a single field shard key, integral bounds and a final
+        // MaxKey, which every integral key sorts before.
+        const BSONObj& last = _bounds.back();
+        if (last.nFields() != 1 || last.firstElement().type() != MaxKey) {
+            return;
+        }
+        const char* fieldName = last.firstElement().fieldName();
+        _encoded.reserve(_bounds.size() - 1);
+        for (size_t i = 0; i + 1 < _bounds.size(); ++i) {
+            const BSONObj& b = _bounds[i];
+            if (b.nFields() != 1 || !isIntegral(b.firstElement()) ||
+                    strcmp(b.firstElement().fieldName(), fieldName) != 0) {
+                std::vector<uint64_t>().swap(_encoded);
+                return;
+            }
+            _encoded.push_back(encode(b.firstElement().numberLong()));
+        }
+        _fieldName = fieldName;
+        _encodable = true;
+    }
+
+    bool ChunkRoutingIndex::_encodeKey(const BSONObj& key, uint64_t* out) const {
+        if (!_encodable) {
+            return false;
+        }
+        const BSONElement e = key.firstElement();
+        if (!isIntegral(e) || strcmp(e.fieldName(), _fieldName.c_str()) != 0 ||
+                key.nFields() != 1) {
+            return false;
+        }
+        *out = encode(e.numberLong());
+        return true;
+    }
+
+    size_t ChunkRoutingIndex::find(const BSONObj& key) const {
+        uint64_t encodedKey;
+        size_t pos;
+        if (_encodeKey(key, &encodedKey)) {
+            // below the final MaxKey by construction
+            pos = _encoded.empty()
+                    ? 0
+                    : countNotGreater(&_encoded[0], _encoded.size(), encodedKey, EncodedLessEqual());
+        }
+        else if (_bounds.empty()) {
+            pos = 0;
+        }
+        else {
+            std::string bytes;
+            if (_keyEncoder != NULL && _keyEncoder->encode(key, &bytes)) {
+                pos = countNotGreater(&_byteBounds[0], _byteBounds.size(), bytes, BytesLessEqual());
+            }
+            else {
+                pos = countNotGreater(&_bounds[0], _bounds.size(), key, BSONLessEqual());
+            }
+        }
+        return pos < _bounds.size() ? pos : npos;
+    }
+
+} // namespace mongo
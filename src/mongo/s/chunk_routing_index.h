@@ -0,0 +1,108 @@
+// @file chunk_routing_index.h
+
+/**
+*    Copyright (C) 2014 Tokutek Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "mongo/bson/bsonobj.h"
+#include "mongo/platform/cstdint.h"
+
+namespace mongo {
+
+    /**
+     * Immutable, flat index over the upper bounds of a collection's chunks, used by mongos to
+     * find the chunk a shard key belongs to without walking a map of BSONObj keys.
+     *
+     * The bounds are kept in one contiguous sorted array and searched with a branch-free binary
+     * search.  When the shard key is a single integral field (including hashed shard keys),
+     * every bound but the final MaxKey is also pre-encoded as an unsigned 64-bit integer whose
+     * natural order matches BSON order, so an integral key is routed by comparing plain
+     * integers.  Other keys can be routed by comparing bytes, if the index is given a
+     * KeyEncoder; what that can't encode falls back to searching the BSONObj bounds with
+     * woCompare().
+     *
+     * Once built, an index is only read, so it can be shared between threads without locking.
+     */
+    class ChunkRoutingIndex {
+    public:
+        static const size_t npos = static_cast<size_t>(-1);
+
+        /**
+         * Encodes shard keys as strings whose byte order (as with memcmp) is their BSON order.
+         */
+        class KeyEncoder {
+        public:
+            virtual ~KeyEncoder() {}
+
+            /** @return false if key can't be encoded in an order that matches woCompare(). */
+            virtual bool encode(const BSONObj& key, std::string* out) const = 0;
+        };
+
+        ChunkRoutingIndex() : _encodable(false), _keyEncoder(NULL) {}
+
+        /**
+         * Builds the index from the upper bounds of the chunks, in ascending order.  The chunks
+         * are assumed to be contiguous and to start at MinKey.  If keyEncoder is given, it must
+         * outlive the index, and it is used for keys that don't take the integer fast path.
+         */
+        explicit ChunkRoutingIndex(const std::vector<BSONObj>& maxBounds,
+                                   const KeyEncoder* keyEncoder = NULL);
+
+        /**
+         * Returns the position of the first bound strictly greater than key, i.e. the chunk
+         * that contains key, or npos if key is not below the last bound.
+         */
+        size_t find(const BSONObj& key) const;
+
+        size_t size() const { return _bounds.size(); }
+
+        /** @return whether keys of the collection's type can take the integer fast path. */
+        bool hasEncodedBounds() const { return _encodable; }
+
+        /** @return whether other keys can be searched by their bytes, see KeyEncoder. */
+        bool hasByteBounds() const { return _keyEncoder != NULL; }
+
+        /**
+         * Encodes an integral value so that unsigned comparison of the result matches BSON
+         * comparison of the values.
+         */
+        static uint64_t encode(long long value) {
+            return static_cast<uint64_t>(value) ^ (1ULL << 63);
+        }
+
+    private:
+        // Sets *out to the encoded key and returns true if key can use the encoded bounds.
+        bool _encodeKey(const BSONObj& key, uint64_t* out) const;
+
+        std::vector<BSONObj> _bounds;
+
+        // _bounds minus the trailing MaxKey, encoded; only valid if _encodable
+        std::vector<uint64_t> _encoded;
+        bool _encodable;
+
+        // name of the single shard key field
+        std::string _fieldName;
+
+        // _bounds, encoded by _keyEncoder; only used if _keyEncoder is set
+        const KeyEncoder* _keyEncoder;
+        std::vector<std::string> _byteBounds;
+    };
+
+} // namespace mongo
@@ -0,0 +1,190 @@
+/**
+*    Copyright (C) 2014 Tokutek Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mongo/pch.h"
+
+#include "mongo/db/jsobj.h"
+#include "mongo/s/chunk_routing_index.h"
+#include "mongo/unittest/unittest.h"
+
+namespace mongo {
+namespace {
+
+    BSONObj maxKeyBound() {
+        BSONObjBuilder b;
+        b.appendMaxKey("a");
+        return b.obj();
+    }
+
+    // Bounds of the chunks [MinKey, -100), [-100, 0), [0, 100), [100, MaxKey) on {a: 1}.
+    vector<BSONObj> integralBounds() {
+        vector<BSONObj> bounds;
+        bounds.push_back(BSON("a" << -100));
+        bounds.push_back(BSON("a" << 0LL));
+        bounds.push_back(BSON("a" << 100));
+        bounds.push_back(maxKeyBound());
+        return bounds;
+    }
+
+    TEST(ChunkRoutingIndex, Empty) {
+        ChunkRoutingIndex index;
+        ASSERT_EQUALS(ChunkRoutingIndex::npos, index.find(BSON("a" << 1)));
+    }
+
+    TEST(ChunkRoutingIndex, SingleChunk) {
+        vector<BSONObj> bounds;
+        bounds.push_back(maxKeyBound());
+        ChunkRoutingIndex index(bounds);
+        ASSERT(index.hasEncodedBounds());
+        ASSERT_EQUALS(0U, index.find(BSON("a" << 1)));
+        ASSERT_EQUALS(0U, index.find(BSON("a" << "str")));
+        ASSERT_EQUALS(ChunkRoutingIndex::npos, index.find(maxKeyBound()));
+    }
+
+    TEST(ChunkRoutingIndex, EncodingPreservesOrder) {
+        const long long values[] = { LLONG_MIN, -1000000000000LL, -1, 0, 1, 1LL << 40, LLONG_MAX };
+        for (size_t i = 1; i < sizeof(values) / sizeof(values[0]); ++i) {
+            ASSERT_LESS_THAN(ChunkRoutingIndex::encode(values[i - 1]),
+                             ChunkRoutingIndex::encode(values[i]));
+        }
+    }
+
+    TEST(ChunkRoutingIndex, IntegralKeys) {
+        ChunkRoutingIndex index(integralBounds());
+        ASSERT(index.hasEncodedBounds());
+        ASSERT_EQUALS(0U, index.find(BSON("a" << LLONG_MIN)));
+        ASSERT_EQUALS(0U, index.find(BSON("a" << -101)));
+        ASSERT_EQUALS(1U, index.find(BSON("a" << -100LL)));
+        ASSERT_EQUALS(1U, index.find(BSON("a" << -1)));
+        ASSERT_EQUALS(2U, index.find(BSON("a" << 0)));
+        ASSERT_EQUALS(2U, index.find(BSON("a" << 99LL)));
+        ASSERT_EQUALS(3U, index.find(BSON("a" << 100)));
+        ASSERT_EQUALS(3U, index.find(BSON("a" << LLONG_MAX)));
+    }
+
+    TEST(ChunkRoutingIndex, OtherKeysFallBack) {
+        ChunkRoutingIndex index(integralBounds());
+        ASSERT_EQUALS(1U, index.find(BSON("a" << -0.5)));
+        ASSERT_EQUALS(2U, index.find(BSON("a" << 0.0)));
+        ASSERT_EQUALS(3U, index.find(BSON("a" << 1e300)));
+        // strings sort after numbers
+        ASSERT_EQUALS(3U, index.find(BSON("a" << "x")));
+        ASSERT_EQUALS(ChunkRoutingIndex::npos, index.find(maxKeyBound()));
+
+        BSONObjBuilder minKey;
+        minKey.appendMinKey("a");
+        ASSERT_EQUALS(0U, index.find(minKey.obj()));
+    }
+
+    TEST(ChunkRoutingIndex, CompoundKeys) {
+        vector<BSONObj> bounds;
+        bounds.push_back(BSON("a" << 1 << "b" << "m"));
+        bounds.push_back(BSON("a" << 2 << "b" << "a"));
+        BSONObjBuilder last;
+        last.appendMaxKey("a");
+        last.appendMaxKey("b");
+        bounds.push_back(last.obj());
+
+        ChunkRoutingIndex index(bounds);
+        ASSERT(!index.hasEncodedBounds());
+        ASSERT_EQUALS(0U, index.find(BSON("a" << 1 << "b" << "c")));
+        ASSERT_EQUALS(1U, index.find(BSON("a" << 1 << "b" << "m")));
+        ASSERT_EQUALS(1U, index.find(BSON("a" << 1 << "b" << "z")));
+        ASSERT_EQUALS(2U, index.find(BSON("a" << 2 << "b" << "a")));
+        ASSERT_EQUALS(2U, index.find(BSON("a" << 3 << "b" << "a")));
+    }
+
+    // Encodes keys of strings without zero bytes, and MaxKey, in byte order.
+    class StringEncoder : public ChunkRoutingIndex::KeyEncoder {
+    public:
+        StringEncoder() : calls(0) {}
+
+        virtual bool encode(const BSONObj& key, std::string* out) const {
+            ++calls;
+            out->clear();
+            BSONForEach(e, key) {
+                if (e.type() == MaxKey) {
+                    out->append("\xff");
+                }
+                else if (e.type() == String) {
+                    out->append(e.valuestr());
+                    out->push_back('\0');
+                }
+                else {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        mutable int calls;
+    };
+
+    TEST(ChunkRoutingIndex, ByteKeys) {
+        vector<BSONObj> bounds;
+        bounds.push_back(BSON("a" << "b"));
+        bounds.push_back(BSON("a" << "m"));
+        bounds.push_back(maxKeyBound());
+        StringEncoder encoder;
+        ChunkRoutingIndex index(bounds, &encoder);
+        ASSERT(!index.hasEncodedBounds());
+        ASSERT(index.hasByteBounds());
+
+        const int built = encoder.calls;
+        ASSERT_EQUALS(0U, index.find(BSON("a" << "")));
+        ASSERT_EQUALS(0U, index.find(BSON("a" << "a")));
+        ASSERT_EQUALS(1U, index.find(BSON("a" << "b")));
+        ASSERT_EQUALS(1U, index.find(BSON("a" << "ba")));
+        ASSERT_EQUALS(2U, index.find(BSON("a" << "m")));
+        ASSERT_EQUALS(2U, index.find(BSON("a" << "zzz")));
+        ASSERT_EQUALS(ChunkRoutingIndex::npos, index.find(maxKeyBound()));
+        ASSERT_EQUALS(built + 7, encoder.calls);
+
+        // keys the encoder refuses are compared as BSON
+        ASSERT_EQUALS(0U, index.find(BSON("a" << 5)));
+    }
+
+    TEST(ChunkRoutingIndex, UnencodableBounds) {
+        vector<BSONObj> bounds;
+        bounds.push_back(BSON("a" << 7.5));
+        bounds.push_back(BSON("a" << "b"));
+        bounds.push_back(maxKeyBound());
+        StringEncoder encoder;
+        ChunkRoutingIndex index(bounds, &encoder);
+        ASSERT(!index.hasByteBounds());
+        ASSERT_EQUALS(1U, index.find(BSON("a" << "a")));
+        ASSERT_EQUALS(2U, index.find(BSON("a" << "c")));
+    }
+
+    TEST(ChunkRoutingIndex, ManyChunks) {
+        const int n = 1000;
+        vector<BSONObj> bounds;
+        for (int i = 1; i < n; ++i) {
+            bounds.push_back(BSON("a" << (long long)i * 10));
+        }
+        bounds.push_back(maxKeyBound());
+        ChunkRoutingIndex index(bounds);
+        ASSERT(index.hasEncodedBounds());
+
+        for (long long k = -5; k < n * 10 + 5; ++k) {
+            const size_t expected = k < 10 ? 0 : std::min<long long>(k / 10, n - 1);
+            ASSERT_EQUALS(expected, index.find(BSON("a" << k)));
+            ASSERT_EQUALS(expected, index.find(BSON("a" << (double)k + 0.5)));
+        }
+    }
+
+} // namespace
+} // namespace mongo
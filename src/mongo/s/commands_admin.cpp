@@ -34,6 +34,7 @@
 #include "mongo/s/config.h"
 #include "mongo/s/field_parser.h"
 #include "mongo/s/grid.h"
+#include "mongo/s/shardkey.h"
 #include "mongo/s/strategy.h"
 #include "mongo/s/type_chunk.h"
 #include "mongo/s/type_database.h"
@@ -532,6 +533,7 @@ namespace mongo {
                     BSONObj currentKey = idx["key"].embeddedObject();
                     // Check 2.i. and 2.ii.
                     if ( ! idx["sparse"].trueValue() && proposedKey.isPrefixOf( currentKey ) ) {
+                        uassertShardKeyIndexHashVersion( idx );
                         BSONElement ce = cmdObj["clustering"];
                         if (idx["clustering"].trueValue()) {
                             if (ce.ok() && !ce.trueValue()) {
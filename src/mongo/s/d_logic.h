@@ -223,6 +223,10 @@ namespace mongo {
 
         static ShardedConnectionInfo* get( bool create );
         static void reset();
+
+        // for moving a connection's info between threads, see MessageHandler::detach()
+        static ShardedConnectionInfo* release();
+        static void set( ShardedConnectionInfo* info );
         static void addHook();
 
         bool inForceVersionOkMode() const {
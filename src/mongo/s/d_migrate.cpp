@@ -65,6 +65,7 @@
 #include "mongo/client/connpool.h"
 #include "mongo/client/distlock.h"
 #include "mongo/client/dbclientcursor.h"
+#include "mongo/client/parallel.h"
 #include "mongo/client/remote_transaction.h"
 
 #include "mongo/util/queue.h"
@@ -78,6 +79,7 @@
 #include "mongo/s/config.h"
 #include "mongo/s/d_logic.h"
 #include "mongo/s/shard.h"
+#include "mongo/s/shardkey.h"
 #include "mongo/s/type_chunk.h"
 #include "mongo/util/assert_util.h"
 #include "mongo/util/elapsed_tracker.h"
@@ -92,6 +94,8 @@ namespace mongo {
 
     MONGO_EXPORT_SERVER_PARAMETER(migrateUniqueChecks, bool, true);
     MONGO_EXPORT_SERVER_PARAMETER(migrateStartCloneLockTimeout, uint64_t, 60000);
+    // Load the chunk with the bulk loader when the recipient doesn't have the collection yet.
+    MONGO_EXPORT_SERVER_PARAMETER(migrateBulkLoad, bool, true);
 
     bool findShardKeyIndexPattern_locked( const string& ns,
                                           const BSONObj& shardKeyPattern,
@@ -103,6 +107,7 @@ namespace mongo {
         const IndexDetails* idx = cl->findIndexByPrefix( shardKeyPattern , true );  /* require single key */
         if ( !idx )
             return false;
+        uassertShardKeyIndexHashVersion( idx->info() );
         *indexPattern = idx->keyPattern().getOwned();
         return true;
     }
@@ -176,6 +181,31 @@ namespace mongo {
             _b.append( field , s );
         }
 
+        /**
+         * Records how fast a phase of the migration moved documents, in the changelog entry and
+         * the migrate log.  bytes may be negative if unknown.
+         */
+        void throughput( const string& phase , long long docs , long long bytes , long long millis ) {
+            const double secs = std::max( millis , 1LL ) / 1000.0;
+
+            BSONObjBuilder b( _b.subobjStart( phase ) );
+            b.appendNumber( "docs" , docs );
+            b.appendNumber( "millis" , millis );
+            b.append( "docsPerSec" , docs / secs );
+            if ( bytes >= 0 ) {
+                b.appendNumber( "bytes" , bytes );
+                b.append( "bytesPerSec" , bytes / secs );
+            }
+            b.done();
+
+            StringBuilder ss;
+            ss << "moveChunk " << _where << " " << phase << " phase moved " << docs << " documents";
+            if ( bytes >= 0 )
+                ss << " (" << bytes << " bytes)";
+            ss << " in " << millis << "ms";
+            log() << ss.str() << migrateLog;
+        }
+
     private:
         Timer _t;
 
@@ -459,6 +489,7 @@ namespace mongo {
                 errmsg = mongoutils::str::stream() << "can't find index for " << cmdobj["keyPattern"].Obj() << " in _migrateStartCloneTransaction";
                 return 0;
             }
+            uassertShardKeyIndexHashVersion(idx->info());
 
             KeyPattern kp(idx->keyPattern());
             BSONObj min = KeyPattern::toKeyFormat(kp.extendRangeBound(cmdobj["min"].Obj(), false));
@@ -549,6 +580,7 @@ namespace mongo {
                     _txn.reset();
                     return false;
                 }
+                uassertShardKeyIndexHashVersion( idx->info() );
                 // Assume both min and max non-empty, append MinKey's to make them fit chosen index
                 KeyPattern kp( idx->keyPattern() );
                 BSONObj min = KeyPattern::toKeyFormat( kp.extendRangeBound( _min, false ) );
@@ -1111,6 +1143,8 @@ namespace mongo {
             timing.done( 3 );
 
             // 4.
+            Timer transferTimer;
+            BSONObj transferCounts;
             for ( int i=0; i<86400; i++ ) { // don't want a single chunk move to take more than a day
                 verify( !Lock::isLocked() );
                 // Exponential sleep backoff, up to 1024ms. Don't sleep much on the first few
@@ -1141,11 +1175,15 @@ namespace mongo {
                     return false;
                 }
 
+                if ( res["counts"].isABSONObj() )
+                    transferCounts = res["counts"].Obj();
                 if ( res["state"].String() == "steady" )
                     break;
 
                 killCurrentOp.checkForInterrupt();
             }
+            timing.throughput( "clone" , transferCounts["cloned"].numberLong() ,
+                               transferCounts["clonedBytes"].numberLong() , transferTimer.millis() );
             timing.done(4);
 
             // 5.
@@ -1464,6 +1502,85 @@ namespace mongo {
        commend to "commit"
     */
 
+    /**
+     * Bulk loads a chunk into a collection that doesn't exist yet on the recipient, building its
+     * indexes as part of the load instead of maintaining them insert by insert.  The load is one
+     * transaction, aborted if the migration fails before commit().
+     */
+    class MigrateBulkLoad : boost::noncopyable {
+    public:
+        explicit MigrateBulkLoad(const string &ns)
+            : _ns(ns),
+              _txn(DB_SERIALIZABLE),
+              _loading(false) {
+        }
+
+        ~MigrateBulkLoad() {
+            if (_loading) {
+                try {
+                    LOCK_REASON(lockReason, "sharding: aborting bulk load for migrate");
+                    Client::WriteContext ctx(_ns, lockReason);
+                    abortBulkLoad(_ns);
+                }
+                catch (std::exception &e) {
+                    warning() << "error aborting bulk load of " << _ns << " for migrate: "
+                              << e.what() << migrateLog;
+                }
+            }
+        }
+
+        /**
+         * Creates the collection with the given indexes, in bulk load mode.  Returns false if
+         * the collection has appeared in the meantime.
+         */
+        bool begin(const vector<BSONObj> &indexes, const BSONObj &options) {
+            LOCK_REASON(lockReason, "sharding: beginning bulk load for migrate");
+            Client::WriteContext ctx(_ns, lockReason);
+            if (getCollection(_ns) != NULL) {
+                return false;
+            }
+
+            vector<BSONObj> secondaryIndexes;
+            for (vector<BSONObj>::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
+                if (it->getStringField("name") != string("_id_")) {
+                    secondaryIndexes.push_back(*it);
+                }
+            }
+            beginBulkLoad(_ns, secondaryIndexes, options);
+            _loading = true;
+
+            // beginBulkLoad doesn't log the create, so log what the regular path would have.
+            BSONObjBuilder b;
+            b.append("create", nsToCollectionSubstring(_ns));
+            b.appendElements(options);
+            const string logNs = nsToDatabase(_ns) + ".$cmd";
+            OplogHelpers::logCommand(logNs.c_str(), b.obj());
+            const string systemIndexes = getSisterNS(_ns, "system.indexes");
+            for (vector<BSONObj>::const_iterator it = secondaryIndexes.begin();
+                 it != secondaryIndexes.end(); ++it) {
+                OplogHelpers::logInsert(systemIndexes.c_str(), *it, true);
+            }
+            return true;
+        }
+
+        void commit() {
+            verify(_loading);
+            {
+                LOCK_REASON(lockReason, "sharding: committing bulk load for migrate");
+                Client::WriteContext ctx(_ns, lockReason);
+                // commitBulkLoad closes the loader even if it fails, so it must not be aborted
+                _loading = false;
+                commitBulkLoad(_ns);
+            }
+            _txn.commit();
+        }
+
+    private:
+        const string _ns;
+        Client::Transaction _txn;
+        bool _loading;
+    };
+
     class MigrateStatus {
         long long _lastAppliedMigrateLogID;
 
@@ -1796,6 +1913,23 @@ namespace mongo {
             ScopedDbConnection& conn = *connPtr;
             conn->getLastError(); // just test connection
 
+            bool hasNewCloneCommands;
+            {
+                BSONObj res;
+                if (!conn->runCommand("admin", BSON("listCommands" << 1), res)) {
+                    state = FAIL;
+                    errmsg = mongoutils::str::stream() << "listCommands failed: " << res.toString();
+                    error() << errmsg << migrateLog;
+                    conn.done();
+                    return;
+                }
+                BSONObj cmds = res["commands"].Obj();
+                hasNewCloneCommands = cmds.hasField("_migrateStartCloneTransaction");
+            }
+
+            // Set if the collection is new here and is being loaded with the bulk loader.
+            scoped_ptr<MigrateBulkLoad> bulkLoad;
+
             {
                 // 0. copy system.namespaces entry if collection doesn't already exist
                 vector<BSONObj> indexes;
@@ -1825,10 +1959,27 @@ namespace mongo {
                     txn.commit();
                 }
 
+                BSONObj entry;
                 if (needCreate) {
                     string system_namespaces = getSisterNS(ns, "system.namespaces");
-                    BSONObj entry = conn->findOne(system_namespaces, BSON( "name" << ns ));
+                    entry = conn->findOne(system_namespaces, BSON( "name" << ns ));
+
+                    // The clone cursor delivers the documents in shard key order into an empty
+                    // collection, so it can be loaded with all its indexes in one pass.
+                    if (migrateBulkLoad && hasNewCloneCommands &&
+                            bulkLoadable(ns, entry.getObjectField("options"))) {
+                        bulkLoad.reset(new MigrateBulkLoad(ns));
+                        if (bulkLoad->begin(indexes, entry.getObjectField("options").getOwned())) {
+                            needCreate = false;
+                            timing.note("bulkLoad");
+                        }
+                        else {
+                            bulkLoad.reset();
+                        }
+                    }
+                }
 
+                if (needCreate) {
                     LOCK_REASON(lockReason, "sharding: creating collection for migrate");
                     Client::WriteContext ctx(ns, lockReason);
                     Client::Transaction txn(DB_SERIALIZABLE);
@@ -1869,7 +2020,11 @@ namespace mongo {
                 timing.done(1);
             }
 
-            {
+            if (bulkLoad) {
+                // 2. nothing to delete, the collection was just created
+                timing.done(2);
+            }
+            else {
                 // 2. delete any data already in range
                 LOCK_REASON(lockReason, "sharding: deleting old documents before migrate");
                 Client::ReadContext ctx(ns, lockReason);
@@ -1898,19 +2053,10 @@ namespace mongo {
             {
                 // 3. initial bulk clone
                 state = CLONE;
+                Timer cloneTimer;
 
                 BSONObj res;
 
-                if (!conn->runCommand("admin", BSON("listCommands" << 1), res)) {
-                    state = FAIL;
-                    errmsg = mongoutils::str::stream() << "listCommands failed: " << res.toString();
-                    error() << errmsg << migrateLog;
-                    conn.done();
-                    return;
-                }
-                BSONObj cmds = res["commands"].Obj();
-                bool hasNewCloneCommands = cmds.hasField("_migrateStartCloneTransaction");
-
                 if (hasNewCloneCommands) {
                     if (!conn->runCommand("admin", BSON("_migrateStartCloneTransaction" << 1 <<
                                                         "ns" << ns <<
@@ -1949,8 +2095,16 @@ namespace mongo {
                         lockedMigrateInsertFirstBatch(cursorObj["firstBatch"].Obj(), insertFlags);
                     }
 
-                    for (DBClientCursor cursor(conn.get(), ns, cursorObj["id"].Long(), 0, 0);
-                         cursor.more(); ) {
+                    // Read the rest of the chunk on its own pooled connections, requesting each
+                    // batch as soon as the previous one arrives, so the donor reads the next batch
+                    // while we insert this one.
+                    scoped_ptr<ScopedDbConnection> cursorConn(
+                            ScopedDbConnection::getScopedDbConnection( from ) );
+                    DBClientCursor cursor(cursorConn->get(), ns, cursorObj["id"].Long(), 0, 0);
+                    cursor.attach(cursorConn.get());
+                    cursor.enablePrefetch(maxShardPrefetches);
+
+                    while (cursor.more()) {
                         try {
                             Client::ReadContext ctx(ns, lockReason);
                             CounterResetter<long long> numClonedResetter(numCloned);
@@ -1970,6 +2124,11 @@ namespace mongo {
                             lockedMigrateInsertBatch(iter, insertFlags);
                         }
                     }
+
+                    if (bulkLoad) {
+                        bulkLoad->commit();
+                        bulkLoad.reset();
+                    }
                 } else {
                     // The old path, for compatibility with older TokuMX servers.
                     LOG(0) << "moveChunk using old migrate path, please upgrade all shards soon" << migrateLog;
@@ -2008,6 +2167,7 @@ namespace mongo {
                     }
                 }
 
+                timing.throughput("clone", numCloned, clonedBytes, cloneTimer.millis());
                 timing.done(3);
             }
 
@@ -2017,6 +2177,7 @@ namespace mongo {
             {
                 // 4. do bulk of mods
                 state = CATCHUP;
+                Timer catchupTimer;
 
                 lastGTID = transferMods(conn);
 
@@ -2047,6 +2208,7 @@ namespace mongo {
                     return;
                 }
 
+                timing.throughput("catchup", numCatchup, -1, catchupTimer.millis());
                 timing.done(4);
             }
 
@@ -2066,6 +2228,7 @@ namespace mongo {
                 // 5. wait for commit
 
                 state = STEADY;
+                Timer steadyTimer;
                 bool transferAfterCommit = false;
                 while ( state == STEADY || state == COMMIT_START ) {
 
@@ -2087,7 +2250,7 @@ namespace mongo {
                     // 2) We've checked at least one more time for un-transmitted mods
                     if ( state == COMMIT_START && transferAfterCommit == true ) {
                         if (opReplicatedEnough(lastGTID)) {
-                            storage::log_flush();
+                            storage::group_log_flush();
                             break;
                         }
                     }
@@ -2101,6 +2264,7 @@ namespace mongo {
                     return;
                 }
 
+                timing.throughput("steady", numSteady, -1, steadyTimer.millis());
                 timing.done(5);
             }
 
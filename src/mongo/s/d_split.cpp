@@ -44,6 +44,7 @@
 #include "mongo/s/chunk_version.h"
 #include "mongo/s/config.h"
 #include "mongo/s/d_logic.h"
+#include "mongo/s/shardkey.h"
 #include "mongo/s/type_chunk.h"
 #include "mongo/util/timer.h"
 
@@ -120,6 +121,7 @@ namespace mongo {
                 errmsg = "couldn't find valid index for shard key";
                 return false;
             }
+            uassertShardKeyIndexHashVersion( idx->info() );
             // extend min to get (min, MinKey, MinKey, ....)
             KeyPattern kp( idx->keyPattern() );
             min = KeyPattern::toKeyFormat( kp.extendRangeBound( min, false ) );
@@ -202,18 +204,20 @@ namespace mongo {
         bool _useCursor;
         BSONObj _lastSplitKey;
 
-        void isTooBigCallback(const storage::KeyV1 *endKey, BSONObj *endPK __attribute__((unused)), uint64_t skipped) {
+        void isTooBigCallback(const storage::Key *endKey, uint64_t skipped) {
             if (endKey == NULL) {
                 return;
             }
-            const storage::KeyV1 max(_chunkMax.buf());
-            const int c = endKey->woCompare(max, _ordering);
+            // Only compare the key parts, ignoring the primary keys.
+            const storage::Key end(endKey->buf(), false);
+            const storage::Key max(_chunkMax.buf(), false);
+            const int c = end.woCompare(max, _ordering);
             if (c < 0) {
                 _chunkTooBig = true;
             }
         }
         
-        void getPointCallback(const storage::KeyV1 *endKey, BSONObj *endPK, uint64_t skipped) {
+        void getPointCallback(const storage::Key *endKey, uint64_t skipped) {
             if (endKey == NULL) {
                 _doneFindingPoints = true;
                 return;
@@ -225,16 +229,17 @@ namespace mongo {
                 return;
             }
 
-            const storage::KeyV1 max(_chunkMax.buf());
-            int c = endKey->woCompare(max, _ordering);
+            const storage::Key end(endKey->buf(), false);
+            const storage::Key max(_chunkMax.buf(), false);
+            int c = end.woCompare(max, _ordering);
             if (c >= 0) {
                 _doneFindingPoints = true;
                 return;
             }
 
-            // This wastefully constructs two BSONs when we should be able to go straight from KeyV1
-            // format to a BSON with field names.  TODO: optimize it if it shows up in profiling.
-            BSONObj splitKey = _chunkPattern.prettyKey(endKey->toBson());
+            // This wastefully constructs two BSONs when we should be able to go straight from the
+            // key format to a BSON with field names.  TODO: optimize it if it shows up in profiling.
+            BSONObj splitKey = _chunkPattern.prettyKey(endKey->key());
             c = splitKey.woCompare(_lastSplitKey, _ordering);
             if (c < 0) {
                 stringstream ss;
@@ -256,7 +261,7 @@ namespace mongo {
                 // with that same key (or a few really big ones).  Since we can't split in the
                 // middle of them, we fall back to just using a cursor from this point forward.
                 if (!_idx->isIdIndex()) {
-                    _chunkMin.reset(*endKey, endPK);
+                    _chunkMin.reset(*endKey);
                     _justSkipped += skipped;
                 }
                 _useCursor = true;
@@ -269,7 +274,7 @@ namespace mongo {
             _splitPoints.push_back(_lastSplitKey);
             KeyPattern kp(_idx->keyPattern());
             BSONObj modSplitKey = KeyPattern::toKeyFormat(kp.extendRangeBound(_lastSplitKey, false));
-            _chunkMin.reset(modSplitKey, _idx->isIdIndex() ? NULL : &minKey);
+            _chunkMin.reset(modSplitKey, _idx->isIdIndex() ? NULL : &minKey, _idx->keyFormat());
         }
 
         void slowFindSplitPoint(long long targetChunkSize) {
@@ -293,7 +298,7 @@ namespace mongo {
                         _splitPoints.push_back(_lastSplitKey);
                         KeyPattern kp(_idx->keyPattern());
                         BSONObj modSplitKey = KeyPattern::toKeyFormat(kp.extendRangeBound(_lastSplitKey, false));
-                        _chunkMin.reset(modSplitKey, _idx->isIdIndex() ? NULL : &minKey);
+                        _chunkMin.reset(modSplitKey, _idx->isIdIndex() ? NULL : &minKey, _idx->keyFormat());
                         return;
                     }
                 }
@@ -310,8 +315,8 @@ namespace mongo {
                   _idx(idx),
                   _chunkPattern(chunkPattern.getOwned()),
                   _ordering(Ordering::make(_idx->keyPattern())),
-                  _chunkMin(min, _idx->isIdIndex() ? NULL : &minKey),
-                  _chunkMax(max, _idx->isIdIndex() ? NULL : &maxKey),
+                  _chunkMin(min, _idx->isIdIndex() ? NULL : &minKey, _idx->keyFormat()),
+                  _chunkMax(max, _idx->isIdIndex() ? NULL : &maxKey, _idx->keyFormat()),
                   _splitPoints(splitPoints),
                   _chunkTooBig(false),
                   _doneFindingPoints(false),
@@ -327,16 +332,16 @@ namespace mongo {
             SplitVectorFinder &_finder;
           public:
             IsTooBigCallback(SplitVectorFinder &finder) : _finder(finder) {}
-            void operator()(const storage::KeyV1 *endKey, BSONObj *endPK, uint64_t skipped) {
-                _finder.isTooBigCallback(endKey, endPK, skipped);
+            void operator()(const storage::Key *endKey, uint64_t skipped) {
+                _finder.isTooBigCallback(endKey, skipped);
             }
         };
         class GetPointCallback {
             SplitVectorFinder &_finder;
           public:
             GetPointCallback(SplitVectorFinder &finder) : _finder(finder) {}
-            void operator()(const storage::KeyV1 *endKey, BSONObj *endPK, uint64_t skipped) {
-                _finder.getPointCallback(endKey, endPK, skipped);
+            void operator()(const storage::Key *endKey, uint64_t skipped) {
+                _finder.getPointCallback(endKey, skipped);
             }
         };
 
@@ -459,6 +464,7 @@ namespace mongo {
                          keyPattern.clientReadable().toString();
                 return false;
             }
+            uassertShardKeyIndexHashVersion( idx->info() );
             // extend min to get (min, MinKey, MinKey, ....)
             KeyPattern kp( idx->keyPattern() );
             min = KeyPattern::toKeyFormat( kp.extendRangeBound( min, false ) );
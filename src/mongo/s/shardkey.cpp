@@ -20,6 +20,7 @@
 #include "pch.h"
 #include "chunk.h"
 #include "../db/jsobj.h"
+#include "mongo/db/hasher.h"
 #include "mongo/db/json.h"
 #include "../util/startup_test.h"
 #include "../util/timer.h"
@@ -74,6 +75,19 @@ namespace mongo {
         return pattern.toBSON().isFieldNamePrefixOf( uniqueIndexPattern.toBSON() );
     }
 
+    void uassertShardKeyIndexHashVersion( const BSONObj& indexSpec ) {
+        BSONForEach( e, indexSpec.getObjectField( "key" ) ) {
+            if ( e.type() == String && str::equals( e.valuestr(), "hashed" ) ) {
+                uassert( 17393, str::stream() << "hashed index " << indexSpec["name"].str()
+                                              << " uses hashVersion "
+                                              << indexSpec["hashVersion"].numberInt()
+                                              << ", but hashed shard keys require hashVersion "
+                                              << HASH_VERSION_MD5,
+                         indexSpec["hashVersion"].numberInt() == HASH_VERSION_MD5 );
+            }
+        }
+    }
+
     string ShardKeyPattern::toString() const {
         return pattern.toString();
     }
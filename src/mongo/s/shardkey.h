@@ -155,4 +155,11 @@ namespace mongo {
         return k;
     }
 
+    /**
+     * Hashed shard keys are always computed with hashVersion 0 (MD5), so a hashed index built
+     * with another version orders its keys differently from the chunk ranges over it.
+     * uasserts if indexSpec, an index's system.indexes entry, describes such an index.
+     */
+    void uassertShardKeyIndexHashVersion( const BSONObj& indexSpec );
+
 }
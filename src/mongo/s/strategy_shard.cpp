@@ -496,6 +496,307 @@ namespace mongo {
             }
         }
 
+        /**
+         * The inserts of one round of a continue-on-error bulk insert bound for a single shard.
+         */
+        struct ShardInsertBatch {
+
+            ShardInsertBatch() :
+                    size(0)
+            {
+            }
+
+            vector<BSONObj> inserts;
+            map<ChunkPtr, int> chunkData;
+            int size;
+            shared_ptr<ShardConnection> conn;
+            string sendErr;
+
+        };
+
+        typedef map<Shard, ShardInsertBatch> ShardInsertBatches;
+
+        /**
+         * Partitions the next documents of a continue-on-error insert into per-shard batches.
+         * Stops once any shard's batch is full, so each shard gets at most one insert message per
+         * round.  Documents without a valid shard key are skipped, recording the error in
+         * *lastBadDocErr, unless they may be due to stale config, in which case this returns
+         * false without consuming any documents.
+         */
+        bool _partitionInserts(const string& ns, DbMessage& d, ChunkManagerPtr manager,
+                               bool reloadedConfig, ShardInsertBatches* batches,
+                               string* lastBadDocErr) {
+            d.markSet();
+
+            while (d.moreJSObjs()) {
+
+                const char* prevObjMark = d.markGet();
+                BSONObj o = d.nextJsObj();
+
+                if (!manager->hasShardKey(o)) {
+
+                    bool bad = true;
+
+                    // Same as _getNextInsertGroup(), autogenerate a missing _id in the shard key
+                    if (manager->getShardKey().partOfShardKey("_id") && !o.hasField("_id")) {
+
+                        BSONObjBuilder b;
+                        b.appendOID("_id", 0, true);
+                        b.appendElements(o);
+                        o = b.obj();
+                        bad = !manager->hasShardKey(o);
+
+                    }
+
+                    if (bad && !reloadedConfig) {
+                        warning() << "shard key mismatch for insert " << o
+                                  << ", expected values for " << manager->getShardKey()
+                                  << ", reloading config data to ensure not stale" << endl;
+                        batches->clear();
+                        d.markReset();
+                        return false;
+                    }
+
+                    if (bad) {
+                        _sleepForVerifiedLocalError();
+
+                        log() << "tried to insert object with no valid shard key for "
+                              << manager->getShardKey() << " : " << o << endl;
+
+                        *lastBadDocErr = str::stream()
+                                << "tried to insert object with no valid shard key for "
+                                << manager->getShardKey().toString() << " : " << o.toString();
+
+                        // continuing on error, so carry on with the next document
+                        continue;
+                    }
+                }
+
+                lastBadDocErr->clear();
+
+                int objSize = o.objsize();
+                verify( objSize <= BSONObjMaxUserSize );
+
+                ChunkPtr chunk = manager->findChunkForDoc(o);
+                ShardInsertBatch& batch = (*batches)[chunk->getShard()];
+
+                // Same limit per shard as for an insert group, see _getNextInsertGroup()
+                if (batch.inserts.size() > 0 && batch.size + objSize > BSONObjMaxUserSize / 2) {
+                    d.markReset(prevObjMark);
+
+                    LOG(3) << "ending bulk insert round to " << ns << " at size "
+                           << batch.size << " (" << batch.inserts.size()
+                           << " documents) for shard " << chunk->getShard() << endl;
+
+                    break;
+                }
+
+                batch.inserts.push_back(manager->getShardKey().moveToFront(o));
+                batch.chunkData[chunk] += objSize;
+                batch.size += objSize;
+            }
+
+            return true;
+        }
+
+        /**
+         * Handles a continue-on-error insert into a sharded collection.  Instead of sending runs
+         * of consecutive documents to one shard at a time and waiting for each to acknowledge,
+         * the message is partitioned by shard up front and every shard's batch is sent before
+         * waiting on any of them, so the shards insert concurrently.  Per-shard errors are left
+         * for the client's getLastError, which gathers and merges them from all the shards.
+         *
+         * Returns false, leaving the remaining documents unconsumed, if the collection is not
+         * sharded.
+         */
+        bool _insertConcurrent(const string& ns, DbMessage& d, int flags, Request& r) {
+
+            int retries = 0;
+            bool reloadedConfig = false;
+            bool prevInsertException = false;
+
+            while (d.moreJSObjs()) {
+
+                uassert( 16055, str::stream() << "too many retries during insert", retries < 30 );
+
+                ChunkManagerPtr manager;
+                ShardPtr primary;
+                grid.getDBConfig(ns)->getChunkManagerOrPrimary(ns, manager, primary);
+                if (!manager) {
+                    return false;
+                }
+
+                //
+                // PARTITION INSERTS BY SHARD
+                //
+
+                ShardInsertBatches batches;
+                string lastBadDocErr;
+                if (!_partitionInserts(ns, d, manager, reloadedConfig, &batches,
+                                       &lastBadDocErr)) {
+                    // If this is our retry, force talking to the config server
+                    grid.getDBConfig(ns)->getChunkManagerIfExists(ns, true);
+                    reloadedConfig = true;
+                    continue;
+                }
+
+                //
+                // CHECK VERSIONS
+                //
+
+                // All connections are versioned before anything is sent, so a stale config can
+                // be retried from the start of the round.  Any other failure only affects its own
+                // shard: it becomes that batch's send error and the batch is dropped, while the
+                // other shards still get theirs.
+                try {
+                    for (ShardInsertBatches::iterator it = batches.begin(); it != batches.end();
+                            ++it) {
+                        ShardInsertBatch& batch = it->second;
+                        try {
+                            batch.conn.reset(new ShardConnection(it->first, ns, manager));
+                            batch.conn->setVersion();
+                        }
+                        catch (StaleConfigException&) {
+                            throw;
+                        }
+                        catch (DBException& e) {
+                            if (batch.conn) {
+                                batch.conn->kill();
+                                batch.conn.reset();
+                            }
+                            batch.chunkData.clear();
+
+                            batch.sendErr = str::stream()
+                                    << "error setting version to insert " << batch.inserts.size()
+                                    << " documents to shard " << it->first.toString()
+                                    << " at version " << manager->getVersion().toString()
+                                    << causedBy(e.what());
+                            warning() << batch.sendErr << endl;
+                        }
+                    }
+                }
+                catch (StaleConfigException& e) {
+                    BSONObj firstInsert;
+                    for (ShardInsertBatches::iterator it = batches.begin(); it != batches.end();
+                            ++it) {
+                        if (it->second.conn) it->second.conn->done();
+                        if (firstInsert.isEmpty()) firstInsert = it->second.inserts[0];
+                    }
+
+                    _handleRetries("insert", retries, ns, firstInsert, e, r);
+                    retries++;
+
+                    d.markReset();
+                    continue;
+                }
+
+                retries = 0;
+
+                //
+                // SEND ALL INSERTS
+                //
+
+                for (ShardInsertBatches::iterator it = batches.begin(); it != batches.end(); ++it) {
+                    ShardInsertBatch& batch = it->second;
+                    if (!batch.conn) {
+                        // Could not be versioned, nothing to send
+                        continue;
+                    }
+
+                    LOG(5) << "inserting " << batch.inserts.size() << " documents to shard "
+                           << it->first << " at version " << manager->getVersion().toString()
+                           << endl;
+
+                    try {
+                        (*batch.conn)->insert(ns, batch.inserts, flags);
+
+                        // Return the connection so getLastError is checked on it, see _insert()
+                        batch.conn->done();
+
+                        globalOpCounters.gotInsert(batch.inserts.size());
+                    }
+                    catch (DBException& e) {
+                        batch.conn->kill();
+
+                        batch.sendErr = str::stream()
+                                << "error inserting " << batch.inserts.size()
+                                << " documents to shard " << it->first.toString()
+                                << " at version " << manager->getVersion().toString()
+                                << causedBy(e.what());
+                        warning() << batch.sendErr << endl;
+                    }
+                }
+
+                //
+                // SPLIT CHUNKS IF NEEDED
+                //
+
+                if (r.getClientInfo()->autoSplitOk()) {
+                    for (ShardInsertBatches::iterator it = batches.begin(); it != batches.end();
+                            ++it) {
+                        map<ChunkPtr, int>& chunkData = it->second.chunkData;
+                        for (map<ChunkPtr, int>::iterator cit = chunkData.begin();
+                                cit != chunkData.end(); ++cit) {
+                            cit->first->splitIfShould(cit->second);
+                        }
+                    }
+                }
+
+                //
+                // CHECK ERRORS
+                //
+
+                // As in _insert(), errors before the last round are swallowed by design, the
+                // final one is thrown.  An intermediate getLastError also waits for writebacks
+                // and keeps a later round from overwriting an earlier error on the shards.
+                bool lastRound = !d.moreJSObjs();
+                bool lastDocBad = lastRound && !lastBadDocErr.empty();
+                string insertErr;
+                for (ShardInsertBatches::iterator it = batches.begin();
+                        insertErr.empty() && it != batches.end(); ++it) {
+                    insertErr = it->second.sendErr;
+                }
+
+                if (!lastRound || lastDocBad || prevInsertException) {
+                    ClientInfo* ci = r.getClientInfo();
+                    ci->newRequest();
+
+                    BSONObjBuilder gleB;
+                    string errMsg;
+                    ci->getLastError("admin", BSON( "getLastError" << 1 ), gleB, errMsg, false);
+
+                    BSONObj gle = gleB.obj();
+                    if (insertErr.empty()) {
+                        insertErr = errMsg;
+                        if (gle["err"].type() == String)
+                            insertErr = gle["err"].String();
+                    }
+
+                    LOG(3) << "intermediate GLE result during concurrent bulk insert was " << gle
+                           << " errmsg: " << errMsg << endl;
+
+                    ci->clearSinceLastGetError();
+                }
+
+                if (lastDocBad) {
+                    if (!insertErr.empty()) warning() << insertErr << endl;
+                    uasserted(8011, str::stream() << "error preparing documents for insert"
+                                                  << causedBy(lastBadDocErr));
+                }
+
+                if (!insertErr.empty() || !lastBadDocErr.empty()) {
+                    if (lastRound && !insertErr.empty()) {
+                        uasserted(17021, insertErr);
+                    }
+                    warning() << "swallowing exception during insert"
+                              << causedBy(insertErr.empty() ? lastBadDocErr : insertErr) << endl;
+                    prevInsertException = true;
+                }
+            }
+
+            return true;
+        }
+
         /**
          * This insert function now handes all inserts, unsharded or sharded, through mongos.
          *
@@ -530,6 +831,13 @@ namespace mongo {
 
             bool continueOnError = flags & InsertOption_ContinueOnError;
 
+            // Without continue-on-error, inserts stop at the first error, so they have to go to
+            // the shards in order.
+            if (continueOnError && !(flags & WriteOption_FromWriteback) &&
+                    _insertConcurrent(ns, d, flags, r)) {
+                return;
+            }
+
             // Sanity check, probably not needed but for safety
             int retries = 0;
 
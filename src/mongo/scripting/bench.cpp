@@ -66,11 +66,13 @@ namespace mongo {
     void BenchRunEventCounter::reset() {
         _numEvents = 0;
         _totalTimeMicros = 0;
+        _latency.reset();
     }
 
     void BenchRunEventCounter::updateFrom(const BenchRunEventCounter &other) {
         _numEvents += other._numEvents;
         _totalTimeMicros += other._totalTimeMicros;
+        _latency.merge(other._latency);
     }
 
     BenchRunStats::BenchRunStats() {
@@ -88,6 +90,7 @@ namespace mongo {
         insertCounter.reset();
         deleteCounter.reset();
         queryCounter.reset();
+        commandCounter.reset();
 
         trappedErrors.clear();
     }
@@ -102,6 +105,7 @@ namespace mongo {
         insertCounter.updateFrom(other.insertCounter);
         deleteCounter.updateFrom(other.deleteCounter);
         queryCounter.updateFrom(other.queryCounter);
+        commandCounter.updateFrom(other.commandCounter);
 
         for (size_t i = 0; i < other.trappedErrors.size(); ++i)
             trappedErrors.push_back(other.trappedErrors[i]);
@@ -119,6 +123,7 @@ namespace mongo {
 
         parallel = 1;
         seconds = 1;
+        opsPerSecond = 0;
         hideResults = true;
         handleErrors = false;
         hideErrors = false;
@@ -156,6 +161,8 @@ namespace mongo {
             this->parallel = args["parallel"].numberInt();
         if ( args["seconds"].isNumber() )
             this->seconds = args["seconds"].number();
+        if ( args["opsPerSecond"].isNumber() )
+            this->opsPerSecond = args["opsPerSecond"].number();
         if ( ! args["hideResults"].eoo() )
             this->hideResults = args["hideResults"].trueValue();
         if ( ! args["handleErrors"].eoo() )
@@ -319,6 +326,11 @@ namespace mongo {
 
         BsonTemplateEvaluator bsonTemplateEvaluator;
 
+        // in open loop mode, this thread's share of the rate
+        const double opIntervalMicros = _config->opsPerSecond > 0 ?
+                Timer::microsPerSecond * _config->parallel / _config->opsPerSecond : 0;
+        unsigned long long opsScheduled = 0;
+
         while ( !shouldStop() ) {
             BSONObjIterator i( _config->ops );
             while ( i.more() ) {
@@ -327,6 +339,20 @@ namespace mongo {
 
                 BSONElement e = i.next();
 
+                // how late this op starts, compared to the schedule
+                unsigned long long lagMicros = 0;
+                if ( opIntervalMicros > 0 ) {
+                    const unsigned long long dueMicros =
+                            static_cast<unsigned long long>( opsScheduled++ * opIntervalMicros );
+                    unsigned long long nowMicros = timer.micros();
+                    if ( nowMicros < dueMicros ) {
+                        sleepmicros( dueMicros - nowMicros );
+                        nowMicros = timer.micros();
+                    }
+                    if ( nowMicros > dueMicros )
+                        lagMicros = nowMicros - dueMicros;
+                }
+
                 string ns = e["ns"].String();
                 string op = e["op"].String();
 
@@ -373,7 +399,7 @@ namespace mongo {
 
                         BSONObj result;
                         {
-                            BenchRunEventTrace _bret(&_stats.findOneCounter);
+                            BenchRunEventTrace _bret(&_stats.findOneCounter, lagMicros);
                             result = conn->findOne( ns , fixQuery( e["query"].Obj(),
                                                                    bsonTemplateEvaluator ) );
                         }
@@ -395,8 +421,11 @@ namespace mongo {
                     else if ( op == "command" ) {
 
                         BSONObj result;
-                        conn->runCommand( ns, fixQuery( e["command"].Obj(), bsonTemplateEvaluator ),
-                                          result, e["options"].numberInt() );
+                        {
+                            BenchRunEventTrace _bret(&_stats.commandCounter, lagMicros);
+                            conn->runCommand( ns, fixQuery( e["command"].Obj(), bsonTemplateEvaluator ),
+                                              result, e["options"].numberInt() );
+                        }
 
                         if( check ){
                             int err = scope->invoke( scopeFunc , 0 , &result,  1000 * 60 , false );
@@ -428,12 +457,12 @@ namespace mongo {
 
                         // use special query function for exhaust query option
                         if (options & QueryOption_Exhaust) {
-                            BenchRunEventTrace _bret(&_stats.queryCounter);
+                            BenchRunEventTrace _bret(&_stats.queryCounter, lagMicros);
                             boost::function<void (const BSONObj&)> castedDoNothing(doNothing);
                             count =  conn->query(castedDoNothing, ns, fixedQuery, &filter, options);
                         }
                         else {
-                            BenchRunEventTrace _bret(&_stats.queryCounter);
+                            BenchRunEventTrace _bret(&_stats.queryCounter, lagMicros);
                             cursor = conn->query(ns, fixedQuery, limit, skip, &filter, options,
                                                  batchSize);
                             count = cursor->itcount();
@@ -469,7 +498,7 @@ namespace mongo {
                         bool safe = e["safe"].trueValue();
 
                         {
-                            BenchRunEventTrace _bret(&_stats.updateCounter);
+                            BenchRunEventTrace _bret(&_stats.updateCounter, lagMicros);
                             conn->update( ns, fixQuery( query, bsonTemplateEvaluator ), update,
                                           upsert , multi );
                             if (safe)
@@ -503,7 +532,7 @@ namespace mongo {
                         }
                         BSONObj result;
                         {
-                            BenchRunEventTrace _bret(&_stats.insertCounter);
+                            BenchRunEventTrace _bret(&_stats.insertCounter, lagMicros);
                             vector<BSONObj> insertBatch(batchSize);
                             for (int i = 0; i < batchSize; i++) {
                                 insertBatch[i] = fixQuery( e["doc"].Obj(), bsonTemplateEvaluator );
@@ -540,7 +569,7 @@ namespace mongo {
                         BSONObj result;
 
                         {
-                            BenchRunEventTrace _bret(&_stats.deleteCounter);
+                            BenchRunEventTrace _bret(&_stats.deleteCounter, lagMicros);
                             conn->remove( ns, fixQuery( query, bsonTemplateEvaluator ), ! multi );
                             if (safe)
                                 result = conn->getLastErrorDetailed();
@@ -615,7 +644,8 @@ namespace mongo {
                     conn->getLastError();
                 }
 
-                sleepmillis( delay );
+                if ( opIntervalMicros == 0 )
+                    sleepmillis( delay );
             }
         }
 
@@ -770,6 +800,13 @@ namespace mongo {
                         static_cast<double>(counter.getTotalTimeMicros()) / counter.getNumEvents());
      }
 
+     static void appendLatencyPercentilesIfAvailable(
+             BSONObjBuilder &buf, const std::string &name, const BenchRunEventCounter &counter) {
+
+         if (counter.getNumEvents() > 0)
+             counter.getLatencyHistogram().appendPercentiles(buf, name.c_str());
+     }
+
      BSONObj BenchRunner::finish( BenchRunner* runner ) {
 
          runner->stop();
@@ -796,6 +833,14 @@ namespace mongo {
          appendAverageMicrosIfAvailable(buf, "deleteLatencyAverageMicros", stats.deleteCounter);
          appendAverageMicrosIfAvailable(buf, "updateLatencyAverageMicros", stats.updateCounter);
          appendAverageMicrosIfAvailable(buf, "queryLatencyAverageMicros", stats.queryCounter);
+         appendAverageMicrosIfAvailable(buf, "commandLatencyAverageMicros", stats.commandCounter);
+
+         appendLatencyPercentilesIfAvailable(buf, "findOneLatencyMicros", stats.findOneCounter);
+         appendLatencyPercentilesIfAvailable(buf, "insertLatencyMicros", stats.insertCounter);
+         appendLatencyPercentilesIfAvailable(buf, "deleteLatencyMicros", stats.deleteCounter);
+         appendLatencyPercentilesIfAvailable(buf, "updateLatencyMicros", stats.updateCounter);
+         appendLatencyPercentilesIfAvailable(buf, "queryLatencyMicros", stats.queryCounter);
+         appendLatencyPercentilesIfAvailable(buf, "commandLatencyMicros", stats.commandCounter);
 
          {
              BSONObjIterator i( after );
@@ -26,6 +26,7 @@
 #include "mongo/bson/util/atomic_int.h"
 #include "mongo/client/dbclientinterface.h"
 #include "mongo/db/jsobj.h"
+#include "mongo/util/histogram.h"
 #include "mongo/util/timer.h"
 
 namespace mongo {
@@ -85,6 +86,15 @@ namespace mongo {
          */
         double seconds;
 
+        /**
+         * If positive, run open loop: start operations at this fixed rate, summed over all the
+         * threads, instead of each thread starting the next operation when the last one is
+         * done.  Latencies are then measured from when an operation should have started, so
+         * that a stall is counted against every operation it held back.  Per-op "delay" is
+         * ignored in this mode.
+         */
+        double opsPerSecond;
+
         bool hideResults;
         bool handleErrors;
         bool hideErrors;
@@ -142,6 +152,7 @@ namespace mongo {
         void countOne(unsigned long long timeMicros) {
             ++_numEvents;
             _totalTimeMicros += timeMicros;
+            _latency.insert(timeMicros);
         }
 
         /**
@@ -154,9 +165,15 @@ namespace mongo {
          */
         unsigned long long getNumEvents() const { return _numEvents; }
 
+        /**
+         * Get the distribution of the durations of all observed events.
+         */
+        const LatencyHistogram &getLatencyHistogram() const { return _latency; }
+
     private:
         unsigned long long _numEvents;
         unsigned long long _totalTimeMicros;
+        LatencyHistogram _latency;
     };
 
     /**
@@ -171,21 +188,28 @@ namespace mongo {
      * event, and otherwise, the succes counter will.
      *
      * In all cases, the counter objects must outlive the trace object.
+     *
+     * "startLagMicros" is how late the event started, in open loop mode, and is counted as part
+     * of its duration.
      */
     class BenchRunEventTrace : private boost::noncopyable {
     public:
-        explicit BenchRunEventTrace(BenchRunEventCounter *eventCounter) {
+        explicit BenchRunEventTrace(BenchRunEventCounter *eventCounter,
+                                    unsigned long long startLagMicros=0)
+            : _startLagMicros(startLagMicros) {
             initialize(eventCounter, eventCounter, false);
         }
 
         BenchRunEventTrace(BenchRunEventCounter *successCounter,
                            BenchRunEventCounter *failCounter,
-                           bool defaultToFailure=true) {
+                           bool defaultToFailure=true)
+            : _startLagMicros(0) {
             initialize(successCounter, failCounter, defaultToFailure);
         }
 
         ~BenchRunEventTrace() {
-            (_succeeded ? _successCounter : _failCounter)->countOne(_timer.micros());
+            (_succeeded ? _successCounter : _failCounter)->countOne(_startLagMicros +
+                                                                    _timer.micros());
         }
 
         void succeed() { _succeeded = true; }
@@ -201,6 +225,7 @@ namespace mongo {
         }
 
         Timer _timer;
+        unsigned long long _startLagMicros;
         BenchRunEventCounter *_successCounter;
         BenchRunEventCounter *_failCounter;
         bool _succeeded;
@@ -226,6 +251,7 @@ namespace mongo {
         BenchRunEventCounter insertCounter;
         BenchRunEventCounter deleteCounter;
         BenchRunEventCounter queryCounter;
+        BenchRunEventCounter commandCounter;
 
         std::map<std::string, long long> opcounters;
         std::vector<BSONObj> trappedErrors;
@@ -25,10 +25,12 @@
 
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/convenience.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "mongo/base/initializer.h"
 #include "mongo/client/dbclientcursor.h"
 #include "mongo/db/namespacestring.h"
+#include "mongo/tools/dump_file.h"
 #include "mongo/tools/tool.h"
 
 using namespace mongo;
@@ -39,19 +41,22 @@ class Dump : public Tool {
     class FilePtr : boost::noncopyable {
     public:
         /*implicit*/ FilePtr(FILE* f) : _f(f) {}
-        ~FilePtr() { fclose(_f); }
+        ~FilePtr() { if (_f) fclose(_f); }
         operator FILE*() { return _f; }
     private:
         FILE* _f;
     };
 public:
-    Dump() : Tool( "dump" , ALL , "" , "" , true ) {
+    Dump() : Tool( "dump" , ALL , "" , "" , true ), _numThreads(1), _splitSize(64), _compress(false) {
         add_options()
         ("out,o", po::value<string>()->default_value("dump"), "output directory or \"-\" for stdout")
         ("query,q", po::value<string>() , "json query" )
         ("oplog", "Use oplog for point-in-time snapshotting" )
         ("repair", "try to recover a crashed database" )
         ("forceTableScan", "deprecated" )
+        ("numThreads", po::value<int>()->default_value(1), "split each collection into key ranges and dump them over this many connections at once, into <collection>.bson.part<N> files. Each range is read in a snapshot of its own, so use --oplog for a consistent dump while there are writes" )
+        ("splitSize", po::value<int>()->default_value(64), "approximate size in MB of each key range for --numThreads" )
+        ("compress", "zlib compress collection data, in files with a .zlib suffix" )
         ;
     }
 
@@ -70,39 +75,54 @@ public:
 
     // This is a functor that writes a BSONObj to a file
     struct Writer {
-        Writer(FILE* out, ProgressMeter* m) :_out(out), _m(m) {}
+        Writer(DumpFileWriter& out, ProgressMeter* m, mongo::mutex* meterMutex)
+            : _out(out), _m(m), _meterMutex(meterMutex), _hits(0) {}
+
+        ~Writer() {
+            hitMeter();
+        }
 
         void operator () (const BSONObj& obj) {
-            size_t toWrite = obj.objsize();
-            size_t written = 0;
-
-            while (toWrite) {
-                size_t ret = fwrite( obj.objdata()+written, 1, toWrite, _out );
-                uassert(14035, errnoWithPrefix("couldn't write to file"), ret);
-                toWrite -= ret;
-                written += ret;
+            _out.write(obj);
+
+            // if there's a progress bar, hit it, only now and then if others share it
+            _hits++;
+            if (!_meterMutex || _hits == 1024) {
+                hitMeter();
             }
+        }
 
-            // if there's a progress bar, hit it
-            if (_m) {
-                _m->hit();
+        void hitMeter() {
+            if (_m && _hits) {
+                if (_meterMutex) {
+                    scoped_lock lk(*_meterMutex);
+                    _m->hit(_hits);
+                }
+                else {
+                    _m->hit(_hits);
+                }
             }
+            _hits = 0;
         }
 
-        FILE* _out;
+        DumpFileWriter& _out;
         ProgressMeter* _m;
+        mongo::mutex* _meterMutex;
+        int _hits;
     };
 
-    void doCollection( const string coll , FILE* out , ProgressMeter *m ) {
-        Query q = _query;
+    void doCollection( const string coll , DumpFileWriter& out , ProgressMeter *m ) {
+        doCollection( conn(true), coll, _query, out, m, NULL );
+    }
 
+    void doCollection( DBClientBase& connBase , const string coll , Query q , DumpFileWriter& out ,
+                       ProgressMeter *m , mongo::mutex* meterMutex ) {
         int queryOptions = QueryOption_SlaveOk | QueryOption_NoCursorTimeout;
         if (startsWith(coll.c_str(), "local.oplog.")) {
             queryOptions |= QueryOption_OplogReplay;
         }
         
-        DBClientBase& connBase = conn(true);
-        Writer writer(out, m);
+        Writer writer(out, m, meterMutex);
 
         // use low-latency "exhaust" mode if going over the network
         if (!_usingMongos && typeid(connBase) == typeid(DBClientConnection&)) {
@@ -119,7 +139,7 @@ public:
         }
     }
 
-    void writeCollectionFile( const string coll , boost::filesystem::path outputFile ) {
+    void writeCollectionFile( const string coll , boost::filesystem::path outputFile , bool compress = false ) {
         log() << "\t" << coll << " to " << outputFile.string() << endl;
 
         FilePtr f (fopen(outputFile.string().c_str(), "wb"));
@@ -129,11 +149,170 @@ public:
         m.setName("Collection File Writing Progress");
         m.setUnits("objects");
 
-        doCollection(coll, f, &m);
+        DumpFileWriter writer(f, compress);
+        doCollection(coll, writer, &m);
+        writer.flush();
 
         log() << "\t\t " << m.done() << " objects" << endl;
     }
 
+    /**
+     * Writes a collection's data for mongorestore, in parallel and/or compressed as requested.
+     * @param outputFile the file a serial, uncompressed dump would write
+     */
+    void writeCollectionData( const string coll , boost::filesystem::path outputFile ,
+                              const BSONObj& options ) {
+        BSONObj keyPattern;
+        vector<BSONObj> splitPoints;
+        if (_numThreads > 1 && splitCollection(coll, options, &keyPattern, &splitPoints)) {
+            writeCollectionParts(coll, outputFile, keyPattern, splitPoints);
+        }
+        else {
+            writeCollectionFile(coll, dumpFileName(outputFile.string(), -1, _compress), _compress);
+        }
+    }
+
+    /**
+     * Finds key ranges to dump coll in parallel: chunk boundaries if it's sharded (so that each
+     * range is read from one shard), otherwise primary key split points from splitVector.
+     * @return false if coll can't be split, and should be dumped serially
+     */
+    bool splitCollection( const string& coll , const BSONObj& options , BSONObj* keyPattern ,
+                          vector<BSONObj>* splitPoints ) {
+        if (typeid(conn(true)) != typeid(DBClientConnection&)) {
+            LOG(1) << "\tcan't open more connections, dumping " << coll << " serially" << endl;
+            return false;
+        }
+
+        if (_usingMongos) {
+            BSONObj shardedColl = conn(true).findOne("config.collections",
+                                                     BSON("_id" << coll << "dropped" << BSON("$ne" << true)));
+            if (!shardedColl.isEmpty()) {
+                *keyPattern = shardedColl["key"].Obj().getOwned();
+                scoped_ptr<DBClientCursor> cursor(conn(true).query("config.chunks",
+                                                                   Query(BSON("ns" << coll)).sort(BSON("min" << 1))));
+                bool first = true;
+                while (cursor->more()) {
+                    BSONObj chunk = cursor->nextSafe();
+                    if (!first) {
+                        splitPoints->push_back(chunk["min"].Obj().getOwned());
+                    }
+                    first = false;
+                }
+                if (splitPoints->empty()) {
+                    LOG(1) << "\t" << coll << " has one chunk, dumping it serially" << endl;
+                    return false;
+                }
+                return true;
+            }
+        }
+
+        *keyPattern = options["primaryKey"].isABSONObj() ? options["primaryKey"].Obj().getOwned() : BSON("_id" << 1);
+        BSONObj res;
+        if (!conn(true).runCommand(nsToDatabase(coll),
+                                   BSON("splitVector" << coll << "keyPattern" << *keyPattern <<
+                                        "maxChunkSizeBytes" << (static_cast<long long>(_splitSize) << 20)),
+                                   res)) {
+            log() << "\tcouldn't split " << coll << ", dumping it serially: " << res << endl;
+            return false;
+        }
+        vector<BSONElement> keys = res["splitKeys"].Array();
+        for (vector<BSONElement>::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+            splitPoints->push_back(it->Obj().getOwned());
+        }
+        if (splitPoints->empty()) {
+            LOG(1) << "\t" << coll << " is too small to split, dumping it serially" << endl;
+            return false;
+        }
+        return true;
+    }
+
+    struct PartsState {
+        PartsState(const string& coll, const BSONObj& keyPattern, long long count)
+            : coll(coll), keyPattern(keyPattern), mutex("Dump::PartsState"), nextRange(0), m(count) {
+            m.setName("Collection File Writing Progress");
+            m.setUnits("objects");
+        }
+
+        const string coll;
+        const BSONObj keyPattern;
+        // [min, max) key ranges; an empty bound is open
+        vector<pair<BSONObj, BSONObj> > ranges;
+
+        // everything below is protected by mutex
+        mongo::mutex mutex;
+        size_t nextRange;
+        ProgressMeter m;
+        string error;
+    };
+
+    void writeCollectionParts( const string coll , boost::filesystem::path outputFile ,
+                               const BSONObj& keyPattern , const vector<BSONObj>& splitPoints ) {
+        PartsState state(coll, keyPattern, conn(true).count(coll.c_str(), BSONObj(), QueryOption_SlaveOk));
+        BSONObj lastBound;
+        for (vector<BSONObj>::const_iterator it = splitPoints.begin(); it != splitPoints.end(); ++it) {
+            state.ranges.push_back(make_pair(lastBound, *it));
+            lastBound = *it;
+        }
+        state.ranges.push_back(make_pair(lastBound, BSONObj()));
+
+        // there's no point in threads (or files) without a range to dump
+        const int numThreads = static_cast<int>(std::min(static_cast<size_t>(_numThreads),
+                                                         state.ranges.size()));
+
+        log() << "\t" << coll << " to " << numThreads << " files like "
+              << dumpFileName(outputFile.string(), 0, _compress) << ", "
+              << state.ranges.size() << " ranges of " << keyPattern << endl;
+
+        const string host = conn(true).getServerAddress();
+        boost::thread_group threads;
+        for (int i = 0; i < numThreads; i++) {
+            threads.create_thread(boost::bind(&Dump::writeRanges, this, &state, host,
+                                              dumpFileName(outputFile.string(), i, _compress)));
+        }
+        threads.join_all();
+        uassert(17375, str::stream() << "error dumping " << coll << ": " << state.error,
+                state.error.empty());
+
+        log() << "\t\t " << state.m.done() << " objects" << endl;
+    }
+
+    void writeRanges( PartsState* state , const string host , const string fileName ) {
+        try {
+            scoped_ptr<DBClientConnection> c(newConnection(host));
+            FilePtr f (fopen(fileName.c_str(), "wb"));
+            uassert(10262, errnoWithPrefix("couldn't open file"), f);
+            DumpFileWriter writer(f, _compress);
+
+            while (true) {
+                pair<BSONObj, BSONObj> range;
+                {
+                    scoped_lock lk(state->mutex);
+                    if (state->nextRange == state->ranges.size() || !state->error.empty()) {
+                        break;
+                    }
+                    range = state->ranges[state->nextRange++];
+                }
+
+                Query q = _query;
+                q.hint(state->keyPattern);
+                if (!range.first.isEmpty()) {
+                    q.minKey(range.first);
+                }
+                if (!range.second.isEmpty()) {
+                    q.maxKey(range.second);
+                }
+                doCollection(*c, state->coll, q, writer, &state->m, &state->mutex);
+            }
+
+            writer.flush();
+        }
+        catch (const DBException& e) {
+            scoped_lock lk(state->mutex);
+            state->error = e.toString();
+        }
+    }
+
     void writeMetadataFile( const string coll, boost::filesystem::path outputFile, 
                             map<string, BSONObj> options, multimap<string, BSONObj> indexes, map<string, BSONObj> partitionInfo) {
         log() << "\tMetadata for " << coll << " to " << outputFile.string() << endl;
@@ -173,7 +352,8 @@ public:
 
 
     void writeCollectionStdout( const string coll ) {
-        doCollection(coll, stdout, NULL);
+        DumpFileWriter writer(stdout, false);
+        doCollection(coll, writer, NULL);
     }
 
     void go( const string db , const boost::filesystem::path outdir ) {
@@ -247,7 +427,9 @@ public:
         for (vector<string>::iterator it = collections.begin(); it != collections.end(); ++it) {
             string name = *it;
             const string filename = name.substr( db.size() + 1 );
-            writeCollectionFile( name , outdir / ( filename + ".bson" ) );
+            const map<string, BSONObj>::const_iterator options = collectionOptions.find(name);
+            writeCollectionData( name , outdir / ( filename + ".bson" ) ,
+                                 options == collectionOptions.end() ? BSONObj() : options->second );
             writeMetadataFile( name, outdir / (filename + ".metadata.json"), collectionOptions, indexes, partitionInfo);
         }
 
@@ -333,6 +515,18 @@ public:
         }
 
         _usingMongos = isMongos();
+        _numThreads = getParam("numThreads", 1);
+        _splitSize = getParam("splitSize", 64);
+        _compress = hasParam("compress");
+        if (_numThreads < 1 || _splitSize < 1) {
+            log() << "--numThreads and --splitSize must be positive" << endl;
+            return -1;
+        }
+        if (_numThreads > 1 && opLogName.empty()) {
+            warning() << "--numThreads reads each key range in a snapshot of its own, so "
+                      << "collections written to during the dump may be inconsistent. "
+                      << "Use --oplog for a consistent dump." << endl;
+        }
 
         boost::filesystem::path root( out );
         string db = _db;
@@ -388,6 +582,9 @@ public:
 
     bool _usingMongos;
     BSONObj _query;
+    int _numThreads;
+    int _splitSize;
+    bool _compress;
 };
 
 int main( int argc , char ** argv, char ** envp ) {
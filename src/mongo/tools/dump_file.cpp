@@ -0,0 +1,195 @@
+/**
+*    Copyright (C) 2014 Tokutek Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mongo/pch.h"
+
+#include "mongo/tools/dump_file.h"
+
+#include <zlib.h>
+
+#include <boost/filesystem/operations.hpp>
+
+#include "mongo/util/mongoutils/str.h"
+
+namespace mongo {
+
+    using namespace mongoutils;
+
+    static const char compressedSuffix[] = ".zlib";
+    static const char partInfix[] = ".part";
+
+    // Objects are gathered into blocks of about this much before being compressed.
+    static const size_t blockSize = 1 << 20;
+
+    std::string dumpFileName(const std::string &collFileName, int part, bool compressed) {
+        str::stream ss;
+        ss << collFileName;
+        if (part >= 0) {
+            ss << partInfix << part;
+        }
+        if (compressed) {
+            ss << compressedSuffix;
+        }
+        return ss;
+    }
+
+    void parseDumpFileName(const std::string &fileName, std::string *collFileName, int *part,
+                           bool *compressed) {
+        std::string name = fileName;
+        *compressed = str::endsWith(name, compressedSuffix);
+        if (*compressed) {
+            name.erase(name.size() - strlen(compressedSuffix));
+        }
+        *part = -1;
+        const size_t pos = name.rfind(partInfix);
+        if (pos != std::string::npos && pos + strlen(partInfix) < name.size()) {
+            const std::string digits = name.substr(pos + strlen(partInfix));
+            if (digits.find_first_not_of("0123456789") == std::string::npos) {
+                *part = atoi(digits.c_str());
+                name.erase(pos);
+            }
+        }
+        *collFileName = name;
+    }
+
+    DumpFileWriter::DumpFileWriter(FILE *out, bool compress)
+        : _out(out),
+          _compress(compress) {
+        if (_compress) {
+            _block.reserve(blockSize);
+        }
+    }
+
+    DumpFileWriter::~DumpFileWriter() {
+    }
+
+    void DumpFileWriter::write(const BSONObj &obj) {
+        if (!_compress) {
+            writeRaw(obj.objdata(), obj.objsize());
+            return;
+        }
+        if (!_block.empty() && _block.size() + obj.objsize() > blockSize) {
+            flush();
+        }
+        _block.insert(_block.end(), obj.objdata(), obj.objdata() + obj.objsize());
+    }
+
+    void DumpFileWriter::flush() {
+        if (_block.empty()) {
+            return;
+        }
+        uLongf compressedLen = compressBound(_block.size());
+        _compressed.resize(compressedLen);
+        const int r = compress2(reinterpret_cast<Bytef *>(&_compressed[0]), &compressedLen,
+                                reinterpret_cast<const Bytef *>(&_block[0]), _block.size(),
+                                Z_BEST_SPEED);
+        uassert(17367, str::stream() << "zlib compression failed with code " << r, r == Z_OK);
+
+        const int header[2] = { static_cast<int>(compressedLen), static_cast<int>(_block.size()) };
+        writeRaw(reinterpret_cast<const char *>(header), sizeof header);
+        writeRaw(&_compressed[0], compressedLen);
+        _block.clear();
+    }
+
+    void DumpFileWriter::writeRaw(const char *data, size_t len) {
+        size_t written = 0;
+        while (written < len) {
+            size_t ret = fwrite(data + written, 1, len - written, _out);
+            uassert(14035, errnoWithPrefix("couldn't write to file"), ret);
+            written += ret;
+        }
+    }
+
+    DumpFileReader::DumpFileReader(const std::string &fileName, bool compressed)
+        : _fileName(fileName),
+          _in(NULL),
+          _compressed(compressed),
+          _fileLength(boost::filesystem::file_size(fileName)),
+          _bytesRead(0),
+          _bufPos(0),
+          _bufLen(0) {
+        _in = fopen(_fileName.c_str(), "rb");
+        uassert(17368, str::stream() << "error opening file " << _fileName << ": "
+                                     << errnoWithDescription(),
+                _in != NULL);
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fileno(_in), 0, _fileLength, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+    DumpFileReader::~DumpFileReader() {
+        if (_in != NULL) {
+            fclose(_in);
+        }
+    }
+
+    bool DumpFileReader::more() {
+        return _bufPos < _bufLen || _bytesRead < _fileLength;
+    }
+
+    BSONObj DumpFileReader::next() {
+        verify(more());
+        if (_compressed) {
+            if (_bufPos == _bufLen) {
+                readBlock();
+            }
+            uassert(17369, str::stream() << "truncated object in compressed block of " << _fileName,
+                    _bufLen - _bufPos >= 4);
+            const int size = *reinterpret_cast<const int *>(&_buf[_bufPos]);
+            uassert(10264, str::stream() << "invalid object size: " << size,
+                    size >= 5 && static_cast<size_t>(size) <= _bufLen - _bufPos);
+            BSONObj obj(&_buf[_bufPos]);
+            _bufPos += size;
+            return obj;
+        }
+
+        int size;
+        readRaw(reinterpret_cast<char *>(&size), 4);
+        uassert(10264, str::stream() << "invalid object size: " << size,
+                size >= 5 && size <= BSONObjMaxUserSize + (1024 * 1024));
+        _buf.resize(size);
+        memcpy(&_buf[0], &size, 4);
+        readRaw(&_buf[4], size - 4);
+        return BSONObj(&_buf[0]);
+    }
+
+    void DumpFileReader::readBlock() {
+        int header[2];
+        readRaw(reinterpret_cast<char *>(header), sizeof header);
+        const int compressedLen = header[0];
+        const int rawLen = header[1];
+        uassert(17370, str::stream() << "invalid compressed block in " << _fileName,
+                compressedLen > 0 && rawLen > 0);
+        _compressedBuf.resize(compressedLen);
+        readRaw(&_compressedBuf[0], compressedLen);
+
+        _buf.resize(rawLen);
+        uLongf len = rawLen;
+        const int r = uncompress(reinterpret_cast<Bytef *>(&_buf[0]), &len,
+                                 reinterpret_cast<const Bytef *>(&_compressedBuf[0]), compressedLen);
+        uassert(17371, str::stream() << "error decompressing " << _fileName << ", zlib code " << r,
+                r == Z_OK && len == static_cast<uLongf>(rawLen));
+        _bufPos = 0;
+        _bufLen = rawLen;
+    }
+
+    void DumpFileReader::readRaw(char *buf, size_t len) {
+        const size_t amt = fread(buf, 1, len, _in);
+        uassert(17372, str::stream() << "unexpected end of file " << _fileName, amt == len);
+        _bytesRead += len;
+    }
+
+}
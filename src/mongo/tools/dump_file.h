@@ -0,0 +1,106 @@
+/**
+*    Copyright (C) 2014 Tokutek Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "mongo/pch.h"
+
+#include <cstdio>
+
+#include "mongo/db/jsobj.h"
+
+namespace mongo {
+
+    /*
+      Naming of the files mongodump writes for a collection's data.
+
+      A serial dump of collection "c" writes "c.bson".  A parallel dump writes one file per
+      thread instead, "c.bson.part0", "c.bson.part1", ..., each holding some of the
+      collection's primary key ranges.  Either kind of file gets a ".zlib" suffix if its
+      contents are compressed.
+     */
+    std::string dumpFileName(const std::string &collFileName, int part, bool compressed);
+
+    /*
+      Splits a file name written by mongodump into the name a serial, uncompressed dump would
+      have used ("c.bson"), its part number (-1 if it's not a part) and whether it's
+      compressed.
+     */
+    void parseDumpFileName(const std::string &fileName, std::string *collFileName, int *part,
+                           bool *compressed);
+
+    /*
+      Writes BSON objects to a dump file, either as they are or in zlib compressed blocks.
+
+      A compressed block is two little endian int32s, the compressed and uncompressed
+      lengths, followed by the compressed bytes, which inflate to a run of whole BSON
+      objects.
+     */
+    class DumpFileWriter : boost::noncopyable {
+    public:
+        /* does not take ownership of out */
+        DumpFileWriter(FILE *out, bool compress);
+        ~DumpFileWriter();
+
+        void write(const BSONObj &obj);
+
+        /*
+          writes out any partial block, must be called before closing the file.  A block that
+          isn't flushed is dropped, e.g. when a write error unwinds past the writer.
+         */
+        void flush();
+
+    private:
+        void writeRaw(const char *data, size_t len);
+
+        FILE *_out;
+        const bool _compress;
+        std::vector<char> _block;
+        std::vector<char> _compressed;
+    };
+
+    /*
+      Reads the BSON objects of a file written by DumpFileWriter.
+     */
+    class DumpFileReader : boost::noncopyable {
+    public:
+        DumpFileReader(const std::string &fileName, bool compressed);
+        ~DumpFileReader();
+
+        bool more();
+
+        /* the returned object is only valid until the next call to next() */
+        BSONObj next();
+
+        /* bytes of the file consumed so far */
+        unsigned long long bytesRead() const { return _bytesRead; }
+
+    private:
+        void readRaw(char *buf, size_t len);
+        void readBlock();
+
+        std::string _fileName;
+        FILE *_in;
+        const bool _compressed;
+        unsigned long long _fileLength;
+        unsigned long long _bytesRead;
+        std::vector<char> _buf;
+        size_t _bufPos;
+        size_t _bufLen;
+        std::vector<char> _compressedBuf;
+    };
+
+}
@@ -69,7 +69,8 @@ struct LoadGeneratorOptions {
         durationSeconds( 60 ),
         parallelThreads( 32 ),
         trials( 5 ),
-        docsPerDB( 0 )
+        docsPerDB( 0 ),
+        opsPerSecond( 0 )
      { }
 
     string hostname;
@@ -82,20 +83,26 @@ struct LoadGeneratorOptions {
     int parallelThreads;
     int trials;
     unsigned long long docsPerDB;
+    double opsPerSecond;
 };
 
 
 struct OperationStats {
-    OperationStats( const unsigned long long numEvents, const unsigned long long totalTimeMicros,
-                    const long long opcounter ) :
-        numEvents( numEvents ),
-        totalTimeMicros( totalTimeMicros ),
-        opcounter( opcounter ) { }
+    OperationStats( const BenchRunEventCounter& counter, const long long opcounter ) :
+        numEvents( counter.getNumEvents() ),
+        totalTimeMicros( counter.getTotalTimeMicros() ),
+        opcounter( opcounter ) {
+        BSONObjBuilder b;
+        counter.getLatencyHistogram().appendPercentiles( b, "latency" );
+        latencyPercentiles = b.obj().firstElement().Obj().getOwned();
+    }
     OperationStats() { }
 
     unsigned long long numEvents;
     unsigned long long totalTimeMicros;
     long long opcounter;
+    // { count, avgMicros, p50, p90, p99, p999, maxMicros }
+    BSONObj latencyPercentiles;
 };
 
 // ------Globals and typedefs----------
@@ -215,6 +222,7 @@ mongo::BenchRunConfig *createBenchRunConfig() {
             BSON( "ops" << ops <<
                   "parallel" << globalLoadGenOption.parallelThreads <<
                   "seconds" << globalLoadGenOption.durationSeconds <<
+                  "opsPerSecond" << globalLoadGenOption.opsPerSecond <<
                   "host"<< globalLoadGenOption.hostname ) );
 }
 
@@ -227,13 +235,11 @@ void collectAllStats( const BenchRunStats& stats, OpStatsMap& allStats ) {
 
     allStats.clear();
     allStats.insert( std::make_pair("findOne",
-                                    OperationStats(stats.findOneCounter.getNumEvents(),
-                                                   stats.findOneCounter.getTotalTimeMicros(),
+                                    OperationStats(stats.findOneCounter,
                                                    mapFindWithDefault(stats.opcounters, "query", 0)
                                                    )) );
     allStats.insert( std::make_pair("insert",
-                                    OperationStats(stats.insertCounter.getNumEvents(),
-                                                   stats.insertCounter.getTotalTimeMicros(),
+                                    OperationStats(stats.insertCounter,
                                                    mapFindWithDefault(stats.opcounters, "insert", 0)
                                                    )) );
 
@@ -252,8 +258,10 @@ BSONObj makeTrialDocument( const OpStatsMap& allStats ) {
         innerDocBuilder.append("numEvents", static_cast<long long>(numEvents));
         innerDocBuilder.append("totalTimeMicros", static_cast<long long>(totalTimeMicros));
 
-        if (numEvents)
+        if (numEvents) {
             innerDocBuilder.append("latencyMicros", static_cast<double>(totalTimeMicros/numEvents));
+            innerDocBuilder.append("latencyPercentilesMicros", it->second.latencyPercentiles);
+        }
 
         outerBuilder.append(it->first, innerDocBuilder.obj());
     }
@@ -275,6 +283,7 @@ BSONObj createResultDoc(const BSONArray& trialsArray) {
                                     "durationSeconds" <<  globalLoadGenOption.durationSeconds <<
                                     "parallelThreads" <<  globalLoadGenOption.parallelThreads <<
                                     "numOps" <<  globalLoadGenOption.numOps <<
+                                    "opsPerSecond" <<  globalLoadGenOption.opsPerSecond <<
                                     "Date" << 10 <<
                                     "buildInfo" << buildInformation()
                                    ) <<
@@ -353,6 +362,9 @@ int parseCmdLineOptions(int argc, char **argv) {
         ("durationSeconds,D", po::value<double>(), "how long should each trial run")
         ("parallelThreads,P",po::value<int>(), "number of threads")
         ("numOps", po::value<int>(), "number of ops per thread")
+        ("opsPerSecond", po::value<double>(), "start ops at this fixed total rate (open loop), "
+                "measuring latency from when each op was due. 0 runs closed loop, as fast as "
+                "each thread can")
         ("resultNS", po::value<string>(), "result NS where you would like to save the results."
                 "If this parameter is empty results will not be written")
         ;
@@ -393,6 +405,9 @@ int parseCmdLineOptions(int argc, char **argv) {
         if (params.count("numOps")) {
             globalLoadGenOption.numOps = params["numOps"].as<int>();
         }
+        if (params.count("opsPerSecond")) {
+            globalLoadGenOption.opsPerSecond = params["opsPerSecond"].as<double>();
+        }
         if (params.count("resultNS")) {
            globalLoadGenOption.resultNS = params["resultNS"].as<string>();
        }
@@ -30,6 +30,7 @@
 
 #include "mongo/base/initializer.h"
 #include "mongo/db/namespacestring.h"
+#include "mongo/tools/dump_file.h"
 #include "mongo/tools/tool.h"
 #include "mongo/util/stringutils.h"
 #include "mongo/db/json.h"
@@ -48,6 +49,7 @@ public:
     bool _restoreIndexes;
     int _w;
     bool _doBulkLoad;
+    int _numThreads;
     string _curns;
     string _curdb;
     string _curcoll;
@@ -59,7 +61,7 @@ public:
 
     Restore() : BSONTool( "restore" ),
         _drop(false), _restoreOptions(false), _restoreIndexes(false),
-        _w(0), _doBulkLoad(false) {
+        _w(0), _doBulkLoad(false), _numThreads(1) {
         // Default values set here will show up in help text, but will supercede any default value
         // used when calling getParam below.
         add_options()
@@ -71,6 +73,7 @@ public:
         ("noIndexRestore" , "don't restore indexes")
         ("w" , po::value<int>()->default_value(0) , "minimum number of replicas per write. WARNING, setting w > 1 prevents the bulk load optimization." )
         ("noLoader", "don't use bulk loader")
+        ("numThreads", po::value<int>()->default_value(4), "number of threads reading and decompressing the files of a collection dumped with --numThreads")
         ("defaultCompression", po::value(&_defaultCompression)->default_value(""), "default compression method to use for collections and indexes (unless otherwise specified in metadata.json)")
         ("defaultPageSize", po::value(&_defaultPageSize)->default_value(0), "default pageSize value to use for collections and indexes (unless otherwise specified in metadata.json)")
         ("defaultReadPageSize", po::value(&_defaultReadPageSize)->default_value(0), "default readPageSize value to use for collections and indexes (unless otherwise specified in metadata.json)")
@@ -113,6 +116,11 @@ public:
         if (hasParam( "noLoader" )) {
             _doBulkLoad = false;
         }
+        _numThreads = getParam( "numThreads" , 4 );
+        if (_numThreads < 1) {
+            log() << "--numThreads must be positive" << endl;
+            return -1;
+        }
         if (hasParam( "keepIndexVersion" )) {
             log() << "warning: --keepIndexVersion is deprecated in TokuMX" << endl;
         }
@@ -191,15 +199,40 @@ public:
             return;
         }
 
-        if ( ! ( endsWith( root.string().c_str() , ".bson" ) ||
-                 endsWith( root.string().c_str() , ".bin" ) ) ) {
+        // A parallel or compressed mongodump names its files after the .bson file a plain one
+        // would have written.
+        string dataFile;
+        int part;
+        bool compressed;
+        parseDumpFileName( root.leaf().string() , &dataFile , &part , &compressed );
+        if ( part > 0 ) {
+            // All parts are handled with part 0
+            return;
+        }
+
+        if ( ! ( endsWith( dataFile.c_str() , ".bson" ) ||
+                 endsWith( dataFile.c_str() , ".bin" ) ) ) {
             error() << "don't know what to do with file [" << root.string() << "]" << endl;
             return;
         }
 
+        vector<boost::filesystem::path> files;
+        if ( part == 0 ) {
+            for ( int i = 0; ; i++ ) {
+                boost::filesystem::path p = root.branch_path() / dumpFileName( dataFile , i , compressed );
+                if ( ! boost::filesystem::exists( p ) ) {
+                    break;
+                }
+                files.push_back( p );
+            }
+        }
+        else {
+            files.push_back( root );
+        }
+
         log() << root.string() << endl;
 
-        if ( root.leaf() == "system.profile.bson" ) {
+        if ( dataFile == "system.profile.bson" ) {
             log() << "\t skipping" << endl;
             return;
         }
@@ -216,7 +249,7 @@ public:
 
         verify( ns.size() );
 
-        string oldCollName = root.leaf().string(); // Name of the collection that was dumped from
+        string oldCollName = dataFile; // Name of the collection that was dumped from
         oldCollName = oldCollName.substr( 0 , oldCollName.find_last_of( "." ) );
         if (use_coll) {
             ns += "." + _coll;
@@ -228,7 +261,7 @@ public:
         log() << "\tgoing into namespace [" << ns << "]" << endl;
 
         if ( _drop ) {
-            if (root.leaf() != "system.users.bson" ) {
+            if (dataFile != "system.users.bson" ) {
                 log() << "\t dropping" << endl;
                 conn().dropCollection( ns );
             } else {
@@ -290,7 +323,7 @@ public:
 
         if (_doBulkLoad && !options["partitioned"].trueValue()) {
             RemoteLoader loader(conn(), _curdb, _curcoll, indexes, options);
-            processFile( root );
+            processDataFiles( files , compressed );
             BSONObj res;
             bool ok = loader.commit(&res);
             if (!ok) {
@@ -302,13 +335,13 @@ public:
                 createCollectionWithOptions(options, metadataObject);
             }
             // Build indexes last - it's a little faster.
-            processFile( root );
+            processDataFiles( files , compressed );
             for (vector<BSONObj>::iterator it = indexes.begin(); it != indexes.end(); ++it) {
                 createIndex(*it);
             }
         }
 
-        if (_drop && root.leaf() == "system.users.bson") {
+        if (_drop && dataFile == "system.users.bson") {
             // Delete any users that used to exist but weren't in the dump file
             for (set<string>::iterator it = _users.begin(); it != _users.end(); ++it) {
                 BSONObj userMatch = BSON("user" << *it);
@@ -343,6 +376,15 @@ public:
 
 private:
 
+    void processDataFiles( const vector<boost::filesystem::path>& files , bool compressed ) {
+        if ( files.size() == 1 && ! compressed ) {
+            processFile( files[0] );
+        }
+        else {
+            processFiles( files , compressed , _numThreads );
+        }
+    }
+
     BSONObj updateOptions(const BSONObj &originalOptions) {
         BSONObjBuilder newOptsBuilder;
         bool compressionSpecified = false;
@@ -20,6 +20,7 @@
 #include "mongo/tools/tool.h"
 
 #include <boost/filesystem/operations.hpp>
+#include <boost/thread/thread.hpp>
 #include <fstream>
 #include <iostream>
 
@@ -32,6 +33,7 @@
 #include "mongo/db/txn_complete_hooks.h"
 #include "mongo/db/storage/env.h"
 #include "mongo/platform/posix_fadvise.h"
+#include "mongo/tools/dump_file.h"
 #include "mongo/util/password.h"
 #include "mongo/util/version.h"
 
@@ -432,10 +434,25 @@ namespace mongo {
             return;
         }
 
-        _conn->auth( BSON( saslCommandPrincipalSourceFieldName << getAuthenticationDatabase() <<
-                           saslCommandPrincipalFieldName << _username <<
-                           saslCommandPasswordFieldName << _password  <<
-                           saslCommandMechanismFieldName << _authenticationMechanism ) );
+        _conn->auth( authParams() );
+    }
+
+    BSONObj Tool::authParams() {
+        return BSON( saslCommandPrincipalSourceFieldName << getAuthenticationDatabase() <<
+                     saslCommandPrincipalFieldName << _username <<
+                     saslCommandPasswordFieldName << _password  <<
+                     saslCommandMechanismFieldName << _authenticationMechanism );
+    }
+
+    DBClientConnection *Tool::newConnection( const string &host ) {
+        auto_ptr<DBClientConnection> c( new DBClientConnection( _autoreconnect ) );
+        string errmsg;
+        uassert( 17373 , str::stream() << "couldn't connect to [" << host << "] " << errmsg ,
+                 c->connect( host , errmsg ) );
+        if ( ! _username.empty() ) {
+            c->auth( authParams() );
+        }
+        return c.release();
     }
 
     BSONTool::BSONTool( const char * name, DBAccess access , bool objcheck )
@@ -543,4 +560,94 @@ namespace mongo {
         return processed;
     }
 
+    struct BSONTool::FileReaderState {
+        FileReaderState( const vector<boost::filesystem::path>& files , bool compressed ,
+                         unsigned long long totalLength ) :
+            files( files ), compressed( compressed ), mutex( "BSONTool::processFiles" ),
+            nextFile( 0 ), num( 0 ), processed( 0 ), m( totalLength ) {
+            m.setUnits( "bytes" );
+        }
+
+        const vector<boost::filesystem::path>& files;
+        const bool compressed;
+
+        // everything below is protected by mutex
+        mongo::mutex mutex;
+        size_t nextFile;
+        long long num;
+        long long processed;
+        ProgressMeter m;
+        string error;
+    };
+
+    void BSONTool::readFiles( FileReaderState* state ) {
+        try {
+            while ( true ) {
+                string fileName;
+                {
+                    scoped_lock lk( state->mutex );
+                    if ( state->nextFile == state->files.size() || ! state->error.empty() ) {
+                        return;
+                    }
+                    fileName = state->files[state->nextFile++].string();
+                }
+                LOG(1) << "\t reading " << fileName << endl;
+
+                DumpFileReader reader( fileName , state->compressed );
+                unsigned long long lastBytesRead = 0;
+                while ( reader.more() ) {
+                    BSONObj o = reader.next();
+                    if ( _objcheck && ! o.valid() ) {
+                        error() << "INVALID OBJECT in " << fileName << ", size: " << o.objsize() << endl;
+                    }
+                    const bool matches = _matcher.get() == 0 || _matcher->matches( o );
+
+                    scoped_lock lk( state->mutex );
+                    if ( matches ) {
+                        gotObject( o );
+                        state->processed++;
+                    }
+                    state->num++;
+                    state->m.hit( reader.bytesRead() - lastBytesRead );
+                    lastBytesRead = reader.bytesRead();
+                }
+            }
+        }
+        catch ( const DBException& e ) {
+            scoped_lock lk( state->mutex );
+            state->error = e.toString();
+        }
+        catch ( const std::exception& e ) {
+            scoped_lock lk( state->mutex );
+            state->error = e.what();
+        }
+    }
+
+    long long BSONTool::processFiles( const vector<boost::filesystem::path>& files , bool compressed ,
+                                      int nThreads ) {
+        unsigned long long totalLength = 0;
+        for ( vector<boost::filesystem::path>::const_iterator it = files.begin(); it != files.end(); ++it ) {
+            totalLength += file_size( *it );
+        }
+        if ( totalLength == 0 ) {
+            out() << "files empty, skipping" << endl;
+            return 0;
+        }
+        FileReaderState state( files , compressed , totalLength );
+
+        boost::thread_group readers;
+        const int n = std::max( 1 , std::min( nThreads , static_cast<int>( files.size() ) ) );
+        for ( int i = 0; i < n; i++ ) {
+            readers.create_thread( boost::bind( &BSONTool::readFiles , this , &state ) );
+        }
+        readers.join_all();
+        uassert( 17374 , str::stream() << "error reading dump files: " << state.error ,
+                 state.error.empty() );
+
+        (_usesstdout ? cout : cerr ) << state.num << " objects found" << endl;
+        if ( _matcher.get() )
+            (_usesstdout ? cout : cerr ) << state.processed << " objects processed" << endl;
+        return state.processed;
+    }
+
 }
@@ -106,6 +106,12 @@ namespace mongo {
 
         mongo::DBClientBase &conn( bool slaveIfPaired = false );
 
+        /**
+         * Opens another connection to host, authenticated like the main one, for tools that
+         * work over several connections at once.  The caller owns the result.
+         */
+        mongo::DBClientConnection *newConnection( const string &host );
+
         string _name;
 
         string _db;
@@ -144,6 +150,7 @@ namespace mongo {
 
     private:
         void auth();
+        BSONObj authParams();
     };
 
     class BSONTool : public Tool {
@@ -160,6 +167,18 @@ namespace mongo {
 
         long long processFile( const boost::filesystem::path& file );
 
+        /**
+         * Like processFile(), for the parts of a parallel mongodump, and for compressed dump
+         * files.  Up to nThreads threads read and decompress the files at once; gotObject() is
+         * called by one thread at a time.
+         */
+        long long processFiles( const vector<boost::filesystem::path>& files , bool compressed ,
+                                int nThreads );
+
+    private:
+        struct FileReaderState;
+        void readFiles( FileReaderState* state );
+
     };
 
 }
@@ -16,6 +16,10 @@
 
 #include "histogram.h"
 
+#include "mongo/db/jsobj.h"
+
+#include <algorithm>
+#include <cmath>
 #include <iomanip>
 #include <limits>
 #include <sstream>
@@ -92,6 +96,17 @@ namespace mongo {
         return ss.str();
     }
 
+    void Histogram::append( BSONObjBuilder& b, const char* name ) const {
+        BSONArrayBuilder buckets( b.subarrayStart( name ) );
+        for ( uint32_t i = 0; i < _numBuckets; i++ ) {
+            BSONObjBuilder bucket( buckets.subobjStart() );
+            bucket.append( "upTo", static_cast<long long>( _boundaries[i] ) );
+            bucket.append( "count", static_cast<long long>( _buckets[i] ) );
+            bucket.doneFast();
+        }
+        buckets.doneFast();
+    }
+
     uint64_t Histogram::getCount( uint32_t bucket ) const {
         if ( bucket >= _numBuckets ) return 0;
 
@@ -126,4 +141,169 @@ namespace mongo {
         return low;
     }
 
+
+    template <uint32_t SubBucketBits>
+    BasicLatencyHistogram<SubBucketBits>::BasicLatencyHistogram() {
+    }
+
+    template <uint32_t SubBucketBits>
+    void BasicLatencyHistogram<SubBucketBits>::insert( uint64_t micros ) {
+        _buckets[ bucketFor( micros ) ].fetchAndAdd( 1 );
+        _totalMicros.fetchAndAdd( micros );
+
+        uint64_t max = _maxMicros.load();
+        while ( micros > max ) {
+            const uint64_t seen = _maxMicros.compareAndSwap( max, micros );
+            if ( seen == max ) {
+                break;
+            }
+            max = seen;
+        }
+    }
+
+    template <uint32_t SubBucketBits>
+    void BasicLatencyHistogram<SubBucketBits>::merge( const BasicLatencyHistogram& other ) {
+        for ( uint32_t i = 0; i < numBuckets; i++ ) {
+            const uint64_t n = other._buckets[i].load();
+            if ( n > 0 ) {
+                _buckets[i].fetchAndAdd( n );
+            }
+        }
+        _totalMicros.fetchAndAdd( other._totalMicros.load() );
+
+        const uint64_t otherMax = other._maxMicros.load();
+        uint64_t max = _maxMicros.load();
+        while ( otherMax > max ) {
+            const uint64_t seen = _maxMicros.compareAndSwap( max, otherMax );
+            if ( seen == max ) {
+                break;
+            }
+            max = seen;
+        }
+    }
+
+    template <uint32_t SubBucketBits>
+    void BasicLatencyHistogram<SubBucketBits>::reset() {
+        for ( uint32_t i = 0; i < numBuckets; i++ ) {
+            _buckets[i].store( 0 );
+        }
+        _totalMicros.store( 0 );
+        _maxMicros.store( 0 );
+    }
+
+    template <uint32_t SubBucketBits>
+    uint64_t BasicLatencyHistogram<SubBucketBits>::count() const {
+        uint64_t n = 0;
+        for ( uint32_t i = 0; i < numBuckets; i++ ) {
+            n += _buckets[i].load();
+        }
+        return n;
+    }
+
+    template <uint32_t SubBucketBits>
+    uint64_t BasicLatencyHistogram<SubBucketBits>::percentile( double fraction ) const {
+        uint64_t counts[numBuckets];
+        uint64_t total = 0;
+        for ( uint32_t i = 0; i < numBuckets; i++ ) {
+            counts[i] = _buckets[i].load();
+            total += counts[i];
+        }
+        if ( total == 0 ) {
+            return 0;
+        }
+
+        // the rank of the value we want, from 1 to total
+        uint64_t rank = static_cast<uint64_t>( ceil( fraction * total ) );
+        if ( rank < 1 ) rank = 1;
+        if ( rank > total ) rank = total;
+
+        uint64_t seen = 0;
+        uint32_t bucket = 0;
+        for ( ; bucket < numBuckets - 1; bucket++ ) {
+            seen += counts[bucket];
+            if ( seen >= rank ) {
+                break;
+            }
+        }
+        return std::min<uint64_t>( bucketUpperBound( bucket ), _maxMicros.load() );
+    }
+
+    template <uint32_t SubBucketBits>
+    void BasicLatencyHistogram<SubBucketBits>::appendPercentiles( BSONObjBuilder& b,
+                                                                  const char* name ) const {
+        BSONObjBuilder summary( b.subobjStart( name ) );
+        appendPercentileFields( summary );
+        summary.doneFast();
+    }
+
+    template <uint32_t SubBucketBits>
+    void BasicLatencyHistogram<SubBucketBits>::appendPercentileFields( BSONObjBuilder& b ) const {
+        const uint64_t n = count();
+        b.append( "count", static_cast<long long>( n ) );
+        if ( n > 0 ) {
+            b.append( "avgMicros", static_cast<double>( totalMicros() ) / n );
+        }
+        b.append( "p50", static_cast<long long>( percentile( 0.5 ) ) );
+        b.append( "p90", static_cast<long long>( percentile( 0.9 ) ) );
+        b.append( "p99", static_cast<long long>( percentile( 0.99 ) ) );
+        b.append( "p999", static_cast<long long>( percentile( 0.999 ) ) );
+        b.append( "maxMicros", static_cast<long long>( maxMicros() ) );
+    }
+
+    template <uint32_t SubBucketBits>
+    void BasicLatencyHistogram<SubBucketBits>::appendBuckets( BSONObjBuilder& b,
+                                                              const char* name ) const {
+        BSONArrayBuilder buckets( b.subarrayStart( name ) );
+        for ( uint32_t i = 0; i < numBuckets; i++ ) {
+            const uint64_t n = _buckets[i].load();
+            if ( n == 0 ) {
+                continue;
+            }
+            BSONObjBuilder bucket( buckets.subobjStart() );
+            bucket.append( "upTo", static_cast<long long>( bucketUpperBound( i ) ) );
+            bucket.append( "count", static_cast<long long>( n ) );
+            bucket.doneFast();
+        }
+        buckets.doneFast();
+    }
+
+    template <uint32_t SubBucketBits>
+    uint32_t BasicLatencyHistogram<SubBucketBits>::bucketFor( uint64_t micros ) {
+        if ( micros < subBuckets ) {
+            return static_cast<uint32_t>( micros );
+        }
+
+        // micros is in [2^k, 2^(k+1)), k >= subBucketBits
+        uint32_t k = 0;
+        for ( uint64_t x = micros >> 1; x != 0; x >>= 1 ) {
+            k++;
+        }
+        if ( k >= maxBits ) {
+            return numBuckets - 1;
+        }
+
+        const uint32_t shift = k - subBucketBits;
+        const uint32_t sub = static_cast<uint32_t>( micros >> shift ) & ( subBuckets - 1 );
+        return subBuckets * ( shift + 1 ) + sub;
+    }
+
+    template <uint32_t SubBucketBits>
+    uint64_t BasicLatencyHistogram<SubBucketBits>::bucketUpperBound( uint32_t bucket ) {
+        if ( bucket < subBuckets ) {
+            return bucket;
+        }
+        if ( bucket >= numBuckets - 1 ) {
+            // still fits in the long long that append() reports it as
+            return std::numeric_limits<long long>::max();
+        }
+
+        const uint32_t shift = bucket / subBuckets - 1;
+        const uint64_t sub = bucket % subBuckets;
+        return ( ( subBuckets + sub + 1 ) << shift ) - 1;
+    }
+
+    template class BasicLatencyHistogram<3>;
+    // Top keeps one per namespace and op type
+    template class BasicLatencyHistogram<1>;
+
 }  // namespace mongo
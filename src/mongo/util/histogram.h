@@ -20,8 +20,12 @@
 #include <string>
 #include <stdint.h>
 
+#include "mongo/platform/atomic_word.h"
+
 namespace mongo {
 
+    class BSONObjBuilder;
+
     /**
      * A histogram for a 32-bit integer range.
      */
@@ -81,6 +85,12 @@ namespace mongo {
          */
         std::string toHTML() const;
 
+        /**
+         * Append the histogram to 'b' as an array named 'name' with one
+         * { upTo: <bucket boundary>, count: <count> } object per bucket.
+         */
+        void append( BSONObjBuilder& b, const char* name ) const;
+
         // testing interface below -- consider it private
 
         /**
@@ -118,6 +128,97 @@ namespace mongo {
         Histogram& operator=( const Histogram& );
     };
 
+    /**
+     * A histogram of latencies in microseconds, with log-linear buckets: every power of two
+     * range [2^k, 2^(k+1)) is split into 'subBuckets' equal buckets, so a bucket is never wider
+     * than 1/subBuckets of the values in it, from 1us up to days.  Values below 'subBuckets'
+     * each get a bucket of their own.
+     *
+     * insert() is lock-free and may be called from any number of threads at once.  Histograms
+     * have the same buckets, so that they can be merged, for instance one per thread.
+     *
+     * LatencyHistogram is the one to use; fewer 'SubBucketBits' make a coarser histogram that
+     * takes less memory, for when there are many of them.  Only the instantiations in
+     * histogram.cpp exist.
+     *
+     * Usage example:
+     *   LatencyHistogram h;
+     *   h.insert( t.micros() );
+     *   h.percentile( 0.99 );   // an upper bound on the 99th percentile
+     */
+    template <uint32_t SubBucketBits>
+    class BasicLatencyHistogram {
+    public:
+        static const uint32_t subBucketBits = SubBucketBits;
+        static const uint32_t subBuckets = 1 << subBucketBits;
+        // values of 2^maxBits us (about 12 days) and more go in the last bucket
+        static const uint32_t maxBits = 40;
+        static const uint32_t numBuckets = subBuckets * ( maxBits - subBucketBits + 1 );
+
+        BasicLatencyHistogram();
+
+        void insert( uint64_t micros );
+
+        /** Add the counts of 'other' into this one. */
+        void merge( const BasicLatencyHistogram& other );
+
+        void reset();
+
+        uint64_t count() const;
+        uint64_t totalMicros() const { return _totalMicros.load(); }
+        uint64_t maxMicros() const { return _maxMicros.load(); }
+
+        /**
+         * Return the upper bound of the bucket that holds the value at 'fraction' (0 < fraction
+         * <= 1) of the way through the sorted values, but no more than the largest value seen,
+         * or 0 if the histogram is empty.
+         */
+        uint64_t percentile( double fraction ) const;
+
+        /**
+         * Append a summary as an object named 'name':
+         *   { count, avgMicros, p50, p90, p99, p999, maxMicros }
+         * with every percentile in microseconds.
+         */
+        void appendPercentiles( BSONObjBuilder& b, const char* name ) const;
+
+        /** Append the fields of the appendPercentiles() summary directly to 'b'. */
+        void appendPercentileFields( BSONObjBuilder& b ) const;
+
+        /**
+         * Append the non-empty buckets as an array named 'name' of { upTo: <microseconds>,
+         * count: <count> } objects, like Histogram::append().
+         */
+        void appendBuckets( BSONObjBuilder& b, const char* name ) const;
+
+        static uint32_t bucketFor( uint64_t micros );
+
+        /**
+         * Return the largest value that falls in 'bucket'; for the last bucket, which takes
+         * every value from 2^maxBits up, that is the largest long long.
+         */
+        static uint64_t bucketUpperBound( uint32_t bucket );
+
+    private:
+        AtomicUInt64 _buckets[numBuckets];
+        AtomicUInt64 _totalMicros;
+        AtomicUInt64 _maxMicros;
+
+        BasicLatencyHistogram( const BasicLatencyHistogram& );
+        BasicLatencyHistogram& operator=( const BasicLatencyHistogram& );
+    };
+
+    template <uint32_t SubBucketBits>
+    const uint32_t BasicLatencyHistogram<SubBucketBits>::subBucketBits;
+    template <uint32_t SubBucketBits>
+    const uint32_t BasicLatencyHistogram<SubBucketBits>::subBuckets;
+    template <uint32_t SubBucketBits>
+    const uint32_t BasicLatencyHistogram<SubBucketBits>::maxBits;
+    template <uint32_t SubBucketBits>
+    const uint32_t BasicLatencyHistogram<SubBucketBits>::numBuckets;
+
+    typedef BasicLatencyHistogram<3> LatencyHistogram;
+
 }  // namespace mongo
 
 #endif  //  UTIL_HISTOGRAM_HEADER
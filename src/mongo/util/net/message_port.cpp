@@ -166,26 +166,11 @@ again:
             int lft = 4;
             psock->recv( lenbuf, lft );
 
-            if ( len < 16 || len > MaxMessageSizeBytes ) { // messages must be large enough for headers
-                if ( len == -1 ) {
-                    // Endian check from the client, after connecting, to see what mode server is running in.
-                    unsigned foo = 0x10203040;
-                    send( (char *) &foo, 4, "endian" );
+            bool readAgain = false;
+            if ( ! checkMessageLength( len , &readAgain ) ) {
+                if ( readAgain ) {
                     goto again;
                 }
-
-                if ( len == 542393671 ) {
-                    // an http GET
-                    LOG( psock->getLogLevel() ) << "looks like you're trying to access db over http on native driver port.  please add 1000 for webserver" << endl;
-                    string msg = "You are trying to access MongoDB on the native driver port. For http diagnostic access, add 1000 to the port number\n";
-                    stringstream ss;
-                    ss << "HTTP/1.0 200 OK\r\nConnection: close\r\nContent-Type: text/plain\r\nContent-Length: " << msg.size() << "\r\n\r\n" << msg;
-                    string s = ss.str();
-                    send( s.c_str(), s.size(), "http" );
-                    return false;
-                }
-                LOG(0) << "recv(): message len " << len << " is too large. "
-                       << "Max is " << MaxMessageSizeBytes << endl;
                 return false;
             }
 
@@ -213,6 +198,35 @@ again:
         }
     }
 
+    bool MessagingPort::checkMessageLength( int len , bool* again ) {
+        *again = false;
+        if ( len >= 16 && len <= MaxMessageSizeBytes ) { // messages must be large enough for headers
+            return true;
+        }
+
+        if ( len == -1 ) {
+            // Endian check from the client, after connecting, to see what mode server is running in.
+            unsigned foo = 0x10203040;
+            send( (char *) &foo, 4, "endian" );
+            *again = true;
+            return false;
+        }
+
+        if ( len == 542393671 ) {
+            // an http GET
+            LOG( psock->getLogLevel() ) << "looks like you're trying to access db over http on native driver port.  please add 1000 for webserver" << endl;
+            string msg = "You are trying to access MongoDB on the native driver port. For http diagnostic access, add 1000 to the port number\n";
+            stringstream ss;
+            ss << "HTTP/1.0 200 OK\r\nConnection: close\r\nContent-Type: text/plain\r\nContent-Length: " << msg.size() << "\r\n\r\n" << msg;
+            string s = ss.str();
+            send( s.c_str(), s.size(), "http" );
+            return false;
+        }
+        LOG(0) << "recv(): message len " << len << " is too large. "
+               << "Max is " << MaxMessageSizeBytes << endl;
+        return false;
+    }
+
     void MessagingPort::reply(Message& received, Message& response) {
         say(/*received.from, */response, received.header()->id);
     }
@@ -71,6 +71,15 @@ namespace mongo {
            also, the Message data will go out of scope on the subsequent recv call.
         */
         bool recv(Message& m);
+
+        /**
+         * Checks the length a message starts with, and answers the lengths that don't start a
+         * message: a client's endian check, and an http request on the wrong port.
+         * @return true if len is the length of a message.  Otherwise *again says whether to read
+         *     the next length or to close the connection.
+         */
+        bool checkMessageLength( int len , bool* again );
+
         void reply(Message& received, Message& response, MSGID responseTo);
         void reply(Message& received, Message& response);
         bool call(Message& toSend, Message& response);
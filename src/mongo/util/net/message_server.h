@@ -47,6 +47,29 @@ namespace mongo {
          * called once when a socket is disconnected
          */
         virtual void disconnected( AbstractMessagingPort* p ) = 0;
+
+        /**
+         * Per-connection state that connected() and process() keep in thread locals.
+         */
+        class ConnectionState : boost::noncopyable {
+        public:
+            virtual ~ConnectionState() {}
+        };
+
+        /**
+         * Used by the async connection model between messages.  Moves this connection's
+         * thread local state out of the calling thread so that whichever worker thread gets
+         * the connection's next message can attach() it.
+         * @return NULL if the connection must stay on the calling thread for now, e.g. while
+         *     it has a multi-statement transaction open.  The default never lets it go.
+         */
+        virtual ConnectionState* detach( AbstractMessagingPort* p ) { return NULL; }
+
+        /**
+         * Installs state returned by detach() in the calling thread's thread locals, and
+         * takes ownership of it.
+         */
+        virtual void attach( ConnectionState* state ) { verify( false ); }
     };
 
     class MessageServer {
@@ -54,8 +77,10 @@ namespace mongo {
         struct Options {
             int port;                   // port to bind to
             string ipList;             // addresses to bind to
+            bool async;                // poll idle connections, run messages on a worker pool
+            int workers;               // size of that worker pool
 
-            Options() : port(0), ipList("") {}
+            Options() : port(0), ipList(""), async(false), workers(0) {}
         };
 
         virtual ~MessageServer() {}
@@ -34,10 +34,432 @@
 
 #ifdef __linux__  // TODO: consider making this ifndef _WIN32
 # include <sys/resource.h>
+# include <sys/epoll.h>
 #endif
 
 namespace mongo {
 
+#ifdef __linux__
+    /**
+     * The async connection model.  Rather than a thread per connection, idle connections sit
+     * in an epoll set watched by one poller thread.  The poller reads each connection's next
+     * message without blocking, and once it is complete, queues the connection for a pool of
+     * worker threads, which process the message.  A slow client, or one that sends part of a
+     * message and stops, therefore never holds a worker.
+     *
+     * Between messages, the handler detach()es the connection's thread local state (its
+     * Client, LastError, etc.) from the worker, and whichever worker runs the next message
+     * attach()es it.  A connection the handler won't detach, e.g. one with a multi-statement
+     * transaction open, stays pinned to its worker, which then serves it exactly like the
+     * thread-per-connection model until it can be detached again.  Pinned workers don't count
+     * against the pool size; a replacement is started for each, and the extra workers exit as
+     * connections get unpinned.  Likewise, if messages are waiting and every worker has been
+     * busy for a while (long queries, awaitData, waiting for fsyncLock, ...), the poller starts
+     * another worker, and extra workers exit once there is nothing left to do.
+     */
+    class AsyncConnections : boost::noncopyable {
+    public:
+        AsyncConnections( MessageHandler* handler , int nWorkers ) :
+            _handler( handler ),
+            _nWorkers( nWorkers ),
+            _mutex( "AsyncConnections" ),
+            _workers( 0 ),
+            _pinned( 0 ),
+            _idle( 0 ),
+            _lastDispatch( curTimeMillis64() ) {
+            _epfd = epoll_create( 1024 );
+            massert( 17365, str::stream() << "epoll_create failed: " << errnoWithDescription(),
+                     _epfd >= 0 );
+            boost::thread poller( boost::bind( &AsyncConnections::pollThread, this ) );
+            scoped_lock lk( _mutex );
+            for ( int i = 0; i < _nWorkers; i++ ) {
+                startWorker_inlock();
+            }
+        }
+
+        /** Takes ownership of p, and of a ticket from Listener::globalTicketHolder. */
+        void add( MessagingPort* p ) {
+            schedule( new Connection( p ) );
+        }
+
+    private:
+        struct Connection : boost::noncopyable {
+            explicit Connection( MessagingPort* p ) :
+                port( p ), le( NULL ), isNew( true ), registered( false ),
+                len( 0 ), lenRead( 0 ), md( NULL ), mdRead( 0 ), closing( false ) {}
+            ~Connection() { free( md ); }
+
+            scoped_ptr<MessagingPort> port;
+            string otherSide;
+            LastError* le;
+            // the handler's state, held here while no worker has the connection
+            auto_ptr<MessageHandler::ConnectionState> state;
+            bool isNew;       // connected() has not been called yet
+            bool registered;  // the socket has been added to the epoll set
+
+            // The next message, as far as the poller has read it.  Workers only read messages
+            // themselves, with a blocking recv, while the connection is pinned to them.
+            int len;          // the message's length, once all 4 bytes of it are in
+            int lenRead;      // bytes of len read so far
+            MsgData* md;      // the message, allocated once len is known
+            int mdRead;       // bytes of md read so far, including len
+            bool closing;     // the client hung up, or sent something that isn't a message
+        };
+
+        // a worker is added if messages have waited this long with every worker busy
+        static const unsigned long long stallMillis = 100;
+
+        void startWorker_inlock() {
+            _workers++;
+            boost::thread worker( boost::bind( &AsyncConnections::workerThread, this ) );
+        }
+
+        void schedule( Connection* c ) {
+            scoped_lock lk( _mutex );
+            _ready.push_back( c );
+            _readyCondition.notify_one();
+        }
+
+        void pollThread() {
+            setThreadName( "connPoller" );
+            const int maxEvents = 256;
+            epoll_event events[maxEvents];
+            std::vector<Connection*> ready;
+            while ( ! inShutdown() ) {
+                const int n = epoll_wait( _epfd , events , maxEvents , stallMillis );
+                if ( n < 0 ) {
+                    if ( errno != EINTR ) {
+                        error() << "epoll_wait failed: " << errnoWithDescription() << endl;
+                        sleepmillis( 10 );
+                    }
+                    continue;
+                }
+                ready.clear();
+                for ( int i = 0; i < n; i++ ) {
+                    Connection* c = static_cast<Connection*>( events[i].data.ptr );
+                    if ( readMessage( c ) ) {
+                        ready.push_back( c );
+                    }
+                    else if ( ! rearm( c ) ) {
+                        c->closing = true;
+                        ready.push_back( c );
+                    }
+                }
+
+                scoped_lock lk( _mutex );
+                _ready.insert( _ready.end() , ready.begin() , ready.end() );
+                if ( ready.size() == 1 ) {
+                    _readyCondition.notify_one();
+                }
+                else if ( ready.size() > 1 ) {
+                    _readyCondition.notify_all();
+                }
+
+                const unsigned long long now = curTimeMillis64();
+                if ( ! _ready.empty() && _idle == 0 && now - _lastDispatch > stallMillis ) {
+                    LOG(1) << "all " << _workers << " connection workers are busy, starting another" << endl;
+                    startWorker_inlock();
+                    _lastDispatch = now;
+                }
+            }
+        }
+
+        /**
+         * Reads what has arrived of c's next message without blocking.
+         * @return true if c is ready for a worker: its message is complete, or it is closing
+         */
+        bool readMessage( Connection* c ) {
+            while ( c->lenRead < 4 ) {
+                if ( ! readSome( c , reinterpret_cast<char*>( &c->len ) + c->lenRead , 4 - c->lenRead ) ) {
+                    return c->closing;
+                }
+                if ( c->lenRead < 4 ) {
+                    continue;
+                }
+                bool again = false;
+                bool ok = false;
+                try {
+                    ok = c->port->checkMessageLength( c->len , &again );
+                }
+                catch ( SocketException& e ) {
+                    LOG(1) << "SocketException: remote: " << c->otherSide << " error: " << e << endl;
+                }
+                if ( ! ok ) {
+                    if ( ! again ) {
+                        c->closing = true;
+                        return true;
+                    }
+                    c->lenRead = 0;
+                    continue;
+                }
+                const int z = ( c->len + 1023 ) & 0xfffffc00;
+                verify( z >= c->len );
+                c->md = static_cast<MsgData*>( malloc( z ) );
+                verify( c->md );
+                c->md->len = c->len;
+                c->mdRead = 4;
+            }
+            while ( c->mdRead < c->len ) {
+                if ( ! readSome( c , reinterpret_cast<char*>( c->md ) + c->mdRead , c->len - c->mdRead ) ) {
+                    return c->closing;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * Reads up to n bytes of c's next message into buf, advancing lenRead or mdRead.
+         * @return false if nothing could be read, either for now or because c is closing
+         */
+        bool readSome( Connection* c , char* buf , int n ) {
+            const int r = ::recv( c->port->psock->rawFD() , buf , n , MSG_DONTWAIT );
+            if ( r > 0 ) {
+                ( c->md ? c->mdRead : c->lenRead ) += r;
+                return true;
+            }
+            if ( r < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ) ) {
+                return false;
+            }
+            if ( r < 0 ) {
+                LOG(1) << "recv failed for client connection " << c->otherSide << ": "
+                       << errnoWithDescription() << endl;
+            }
+            c->closing = true;
+            return false;
+        }
+
+        /** Moves c's complete message into m, and makes c ready to read the next one. */
+        static void takeMessage( Connection* c , Message& m ) {
+            verify( c->md && c->mdRead == c->len );
+            m.setData( c->md , true );
+            c->md = NULL;
+            c->mdRead = 0;
+            c->lenRead = 0;
+        }
+
+        void workerThread() {
+            setThreadName( "connWorker" );
+            while ( true ) {
+                Connection* c;
+                {
+                    scoped_lock lk( _mutex );
+                    if ( _ready.empty() && _workers - _pinned > _nWorkers ) {
+                        // added while the others were busy, and no longer needed
+                        _workers--;
+                        break;
+                    }
+                    _idle++;
+                    while ( _ready.empty() ) {
+                        _readyCondition.wait( lk.boost() );
+                    }
+                    _idle--;
+                    c = _ready.front();
+                    _ready.pop_front();
+                    _lastDispatch = curTimeMillis64();
+                }
+                if ( ! serve( c ) ) {
+                    break;
+                }
+            }
+#ifdef MONGO_SSL
+            SSLManager::cleanupThreadLocals();
+#endif
+        }
+
+        /**
+         * Runs c's next message, and more if c is pinned to this thread, then detaches c and
+         * puts it back in the epoll set, or closes it.
+         * @return false if this worker should exit
+         */
+        bool serve( Connection* c ) {
+            MessagingPort* p = c->port.get();
+            bool open = true;
+            bool pinned = false;
+            bool retire = false;
+
+            Message m;
+            try {
+                if ( c->isNew ) {
+                    p->psock->setLogLevel(1);
+                    c->otherSide = p->psock->remoteString();
+                    c->le = new LastError();
+                    lastError.reset( c->le );
+                    p->psock->doSSLHandshake();
+                    _handler->connected( p );
+                }
+                else {
+                    lastError.reset( c->le );
+                    _handler->attach( c->state.release() );
+                }
+
+                while ( true ) {
+                    if ( ! c->isNew ) {
+                        m.reset();
+                        p->psock->clearCounters();
+                        int received = 0;
+
+                        // the poller has read the first message, a pinned worker reads the rest
+                        bool ok;
+                        if ( c->closing ) {
+                            ok = false;
+                        }
+                        else if ( c->md ) {
+                            received = c->len;
+                            takeMessage( c , m );
+                            ok = true;
+                        }
+                        else {
+                            ok = p->recv(m);
+                        }
+                        if ( ! ok ) {
+                            if( !cmdLine.quiet ){
+                                int conns = Listener::globalTicketHolder.used()-1;
+                                const char* word = (conns == 1 ? " connection" : " connections");
+                                log() << "end connection " << c->otherSide << " (" << conns << word << " now open)" << endl;
+                            }
+                            p->shutdown();
+                            open = false;
+                            break;
+                        }
+
+                        _handler->process( m , p , c->le );
+                        networkCounter.hit( received + p->psock->getBytesIn() , p->psock->getBytesOut() );
+                    }
+                    c->isNew = false;
+
+                    if ( inShutdown() ) {
+                        p->shutdown();
+                        open = false;
+                        break;
+                    }
+
+                    // Decrypted data may already be waiting inside SSL, where epoll can't see it,
+                    // so secure connections never leave their worker.
+                    MessageHandler::ConnectionState* state =
+                        p->psock->isSecure() ? NULL : _handler->detach( p );
+                    if ( state ) {
+                        c->state.reset( state );
+                        break;
+                    }
+                    if ( ! pinned ) {
+                        pin();
+                        pinned = true;
+                    }
+                }
+            }
+            catch ( AssertionException& e ) {
+                log() << "AssertionException handling request, closing client connection: " << e << endl;
+                p->shutdown();
+                open = false;
+            }
+            catch ( SocketException& e ) {
+                log() << "SocketException handling request, closing client connection: " << e << endl;
+                p->shutdown();
+                open = false;
+            }
+            catch ( const DBException& e ) { // must be right above std::exception to avoid catching subclasses
+                log() << "DBException handling request, closing client connection: " << e << endl;
+                p->shutdown();
+                open = false;
+            }
+            catch ( std::exception &e ) {
+                error() << "Uncaught std::exception: " << e.what() << ", terminating" << endl;
+                dbexit( EXIT_UNCAUGHT );
+            }
+            catch ( ... ) {
+                error() << "Uncaught exception, terminating" << endl;
+                dbexit( EXIT_UNCAUGHT );
+            }
+
+            if ( pinned ) {
+                retire = unpin();
+            }
+
+            if ( open ) {
+                lastError.release();
+                setThreadName( "connWorker" );
+                if ( rearm( c ) ) {
+                    return ! retire;
+                }
+                // couldn't go back to the poller, close it from here instead
+                lastError.reset( c->le );
+                _handler->attach( c->state.release() );
+                p->shutdown();
+            }
+
+            // Normal disconnect path.
+            _handler->disconnected( p );
+            if ( c->registered ) {
+                epoll_event unused;
+                epoll_ctl( _epfd , EPOLL_CTL_DEL , p->psock->rawFD() , &unused );
+            }
+            scoped_ptr<MessageHandler::ConnectionState> leftover( _handler->detach( p ) );
+            if ( ! leftover && ! retire ) {
+                // the handler's thread locals are only cleaned up when this thread exits
+                retire = true;
+                scoped_lock lk( _mutex );
+                _workers--;
+                if ( _workers - _pinned < _nWorkers ) {
+                    startWorker_inlock();
+                }
+            }
+            lastError.reset( NULL );
+            setThreadName( "connWorker" );
+            delete c;
+            Listener::globalTicketHolder.release();
+            return ! retire;
+        }
+
+        bool rearm( Connection* c ) {
+            epoll_event ev;
+            memset( &ev , 0 , sizeof(ev) );
+            ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+            ev.data.ptr = c;
+            const int op = c->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+            // once armed, another worker may own c, so we must not touch it after this succeeds
+            c->registered = true;
+            if ( epoll_ctl( _epfd , op , c->port->psock->rawFD() , &ev ) != 0 ) {
+                error() << "epoll_ctl failed, closing client connection " << c->otherSide
+                        << ": " << errnoWithDescription() << endl;
+                c->registered = ( op == EPOLL_CTL_MOD );
+                return false;
+            }
+            return true;
+        }
+
+        void pin() {
+            scoped_lock lk( _mutex );
+            _pinned++;
+            if ( _workers - _pinned < _nWorkers ) {
+                startWorker_inlock();
+            }
+        }
+
+        /** @return true if the calling worker is now surplus and should exit */
+        bool unpin() {
+            scoped_lock lk( _mutex );
+            _pinned--;
+            if ( _workers - _pinned > _nWorkers ) {
+                _workers--;
+                return true;
+            }
+            return false;
+        }
+
+        MessageHandler* const _handler;
+        const int _nWorkers;
+        int _epfd;
+
+        mongo::mutex _mutex;
+        boost::condition _readyCondition;
+        std::deque<Connection*> _ready;   // connections with a message to run
+        int _workers;                     // live worker threads, including pinned ones
+        int _pinned;                      // workers serving a pinned connection
+        int _idle;                        // workers waiting for a connection
+        unsigned long long _lastDispatch; // when a worker last took a connection
+    };
+#endif
+
     class PortMessageServer : public MessageServer , public Listener {
     public:
         /**
@@ -48,7 +470,13 @@ namespace mongo {
          *     and should make sure that it lives longer than this server.
          */
         PortMessageServer(  const MessageServer::Options& opts, MessageHandler * handler ) :
-            Listener( "" , opts.ipList, opts.port ), _handler(handler) {
+            Listener( "" , opts.ipList, opts.port ), _handler(handler), _async(opts.async), _nWorkers(opts.workers) {
+#ifndef __linux__
+            if ( _async ) {
+                warning() << "async connection model is only supported on linux, using a thread per connection" << endl;
+                _async = false;
+            }
+#endif
         }
 
         virtual void acceptedMP(MessagingPort * p) {
@@ -64,6 +492,13 @@ namespace mongo {
                 return;
             }
 
+#ifdef __linux__
+            if ( _asyncConnections ) {
+                _asyncConnections->add( p );
+                return;
+            }
+#endif
+
             try {
 #ifndef __linux__  // TODO: consider making this ifdef _WIN32
                 {
@@ -130,6 +565,12 @@ namespace mongo {
         }
 
         void run() {
+#ifdef __linux__
+            if ( _async ) {
+                log() << "using async connection model with " << _nWorkers << " worker threads" << endl;
+                _asyncConnections.reset( new AsyncConnections( _handler , _nWorkers ) );
+            }
+#endif
             initAndListen();
         }
 
@@ -137,6 +578,11 @@ namespace mongo {
 
     private:
         MessageHandler* _handler;
+        bool _async;
+        int _nWorkers;
+#ifdef __linux__
+        scoped_ptr<AsyncConnections> _asyncConnections;
+#endif
 
         /**
          * Simple holder for threadRun parameters. Should not destroy the objects it holds -
@@ -213,6 +213,21 @@ namespace mongo {
         
         void setTimeout( double secs );
 
+        /** @return the underlying file descriptor, for registering with a poller */
+        int rawFD() const { return _fd; }
+
+        /**
+         * @return true if traffic on this socket is encrypted.  Decrypted data may then be
+         * buffered inside SSL, where polling the file descriptor does not see it.
+         */
+        bool isSecure() const {
+#ifdef MONGO_SSL
+            return _ssl != NULL;
+#else
+            return false;
+#endif
+        }
+
 #ifdef MONGO_SSL
         /** secures inline */
         void secure( SSLManager * ssl );